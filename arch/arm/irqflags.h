@@ -56,6 +56,21 @@ static inline void arch_irq_disable(void)
 	asm("msr cpsr_c, %0" :: "r"(cpsr | 0x80));
 }
 
+static inline uint32_t arch_irq_save(void)
+{
+	uint32_t cpsr;
+	asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+	asm volatile("msr cpsr_c, %0" :: "r"(cpsr | 0x80) : "memory");
+	return cpsr & 0x80;
+}
+
+static inline void arch_irq_restore(uint32_t flags)
+{
+	uint32_t cpsr;
+	asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+	asm volatile("msr cpsr_c, %0" :: "r"((cpsr & ~0x80) | flags) : "memory");
+}
+
 #elif defined(CONFIG_ARCH_ARMV7A)
 
 static inline void arch_irq_enable(void)
@@ -68,6 +83,21 @@ static inline void arch_irq_disable(void)
 	asm("cpsid if");
 }
 
+static inline uint32_t arch_irq_save(void)
+{
+	uint32_t cpsr;
+	asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+	asm volatile("cpsid if" ::: "memory");
+	return cpsr & 0xc0;
+}
+
+static inline void arch_irq_restore(uint32_t flags)
+{
+	uint32_t cpsr;
+	asm volatile("mrs %0, cpsr" : "=r"(cpsr));
+	asm volatile("msr cpsr_c, %0" :: "r"((cpsr & ~0xc0) | flags) : "memory");
+}
+
 #elif defined(CONFIG_ARCH_ARMV7M)
 
 static inline void arch_irq_enable(void)
@@ -80,6 +110,19 @@ static inline void arch_irq_disable(void)
 	asm("cpsid i");
 }
 
+static inline uint32_t arch_irq_save(void)
+{
+	uint32_t primask;
+	asm volatile("mrs %0, primask" : "=r"(primask));
+	asm volatile("cpsid i" ::: "memory");
+	return primask;
+}
+
+static inline void arch_irq_restore(uint32_t flags)
+{
+	asm volatile("msr primask, %0" :: "r"(flags) : "memory");
+}
+
 #endif
 
 #endif /* ARM_IRQFLAGS_H_ */
@@ -42,6 +42,7 @@
 #include "board.h"
 #include "can/mcand.h"
 #include "errno.h"
+#include "intmath.h"
 #include "irq/irq.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
@@ -630,9 +631,11 @@ static void _mcand_rx_buffer_handler(struct _mcan_desc *desc)
 
 	status = mcan->MCAN_NDAT1;
 	mcan->MCAN_NDAT1 = status;
-	for (buf_idx = 0; buf_idx < buf_count; buf_idx ++) {
-		if (status & (1 << buf_idx))
-			_mcand_rx_proc(desc, MCAN_RAM_RX_BUFFER, buf_idx);
+	if (buf_count < 32)
+		status &= (1u << buf_count) - 1;
+	while (status) {
+		buf_idx = pop_lsb_u32(&status);
+		_mcand_rx_proc(desc, MCAN_RAM_RX_BUFFER, buf_idx);
 	}
 
 	if (buf_count < 32)
@@ -640,9 +643,11 @@ static void _mcand_rx_buffer_handler(struct _mcan_desc *desc)
 
 	status = mcan->MCAN_NDAT2;
 	mcan->MCAN_NDAT2 = status;
-	for (buf_idx = 32; buf_idx < buf_count; buf_idx ++) {
-		if (status & (1 << (buf_idx - 32)))
-			_mcand_rx_proc(desc, MCAN_RAM_RX_BUFFER, buf_idx);
+	if (buf_count - 32 < 32)
+		status &= (1u << (buf_count - 32)) - 1;
+	while (status) {
+		buf_idx = 32 + pop_lsb_u32(&status);
+		_mcand_rx_proc(desc, MCAN_RAM_RX_BUFFER, buf_idx);
 	}
 }
 
@@ -117,7 +117,8 @@ void aes_set_op_mode(uint32_t mode)
 
 void aes_set_start_mode(uint32_t mode)
 {
-	AES->AES_MR |= AES_MR_SMOD(mode) | AES_MR_CKEY_PASSWD;
+	AES->AES_MR = (AES->AES_MR & ~AES_MR_SMOD_Msk) | AES_MR_SMOD(mode)
+		| AES_MR_CKEY_PASSWD;
 }
 
 void aes_set_key_size(uint32_t size)
@@ -210,6 +211,14 @@ void aes_set_vector(const uint32_t* vector)
 
 #ifdef CONFIG_HAVE_AES_GCM
 
+void aes_gcm_tag_enable(bool enable)
+{
+	if (enable)
+		AES->AES_MR |= AES_MR_GTAGEN | AES_MR_CKEY_PASSWD;
+	else
+		AES->AES_MR = (AES->AES_MR & ~AES_MR_GTAGEN) | AES_MR_CKEY_PASSWD;
+}
+
 void aes_set_aad_len(uint32_t len)
 {
 	AES->AES_AADLENR = len;
@@ -139,6 +139,14 @@ void aes_set_vector(const uint32_t * vector);
 
 #ifdef CONFIG_HAVE_AES_GCM
 
+/**
+ * \brief Enable or disable the GCM automatic tag generation. When enabled, the
+ * tag is computed once AES_AADLENR + AES_CLENR bytes have been processed, and
+ * TAGRDY is set in AES_ISR.
+ * \param enable  True to enable the automatic tag generation.
+ */
+void aes_gcm_tag_enable(bool enable);
+
 /**
  * \brief Set Length in bytes of the Additional Authenticated Data that are to
  * be processed.
@@ -40,11 +40,22 @@
 #include "crypto/aes.h"
 #include "crypto/aesd.h"
 #include "dma/dma.h"
+#include "intmath.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "trace.h"
 
+/*----------------------------------------------------------------------------
+ *        Local constants
+ *----------------------------------------------------------------------------*/
+
+#ifndef AESD_QUEUE_BATCH_MAX
+/** Maximum number of queued jobs chained into a single DMA transfer */
+#define AESD_QUEUE_BATCH_MAX 8
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -59,9 +70,9 @@ static int _aesd_dma_read_callback(void* arg, void* arg2)
 
 	cache_invalidate_region((uint32_t*)desc->xfer.bufout->data, desc->xfer.bufout->size);
 
-	mutex_unlock(&desc->mutex);
+	desc->xfer.dma_done = true;
 
-	return callback_call(&desc->xfer.callback, NULL);
+	return 0;
 }
 
 /* Operation Mode Chunk Size Data Transfer Type
@@ -130,6 +141,7 @@ static void _aesd_transfer_buffer_dma(struct _aesd_desc* desc)
 	struct _callback _cb;
 
 	cache_clean_region((uint32_t*)desc->xfer.bufin->data, desc->xfer.bufin->size);
+	desc->xfer.dma_done = false;
 
 	memset(&cfg_dma, 0, sizeof(cfg_dma));
 	cfg_dma.incr_saddr = true;
@@ -159,28 +171,275 @@ static void _aesd_transfer_buffer_dma(struct _aesd_desc* desc)
 	dma_start_transfer(desc->xfer.dma.tx.channel);
 	dma_start_transfer(desc->xfer.dma.rx.channel);
 
-	aesd_wait_transfer(desc);
+	while (!desc->xfer.dma_done)
+		dma_poll();
 }
 
-static void _aesd_transfer_buffer_polling(struct _aesd_desc* desc)
+static void _aesd_process_polling(struct _aesd_desc* desc,
+		struct _buffer* bufin, struct _buffer* bufout)
 {
 	uint32_t i;
 
 	aes_enable_it(AES_IER_DATRDY);
-	for (i = 0; i < desc->xfer.bufin->size; i+= _aesd_get_size_per_trans(desc)) {
-		aes_set_input((uint32_t *)((desc->xfer.bufin->data) + i));
+	for (i = 0; i < bufin->size; i+= _aesd_get_size_per_trans(desc)) {
+		aes_set_input((uint32_t *)((bufin->data) + i));
 		if (desc->cfg.transfer_mode == AESD_TRANS_POLLING_MANUAL)
 			/* Set the START bit in the AES Control register
 			 to begin the encrypt. or decrypt. process. */
 			aes_start();
 		while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
-		aes_get_output((uint32_t *)((desc->xfer.bufout->data) + i));
+		aes_get_output((uint32_t *)((bufout->data) + i));
 	}
+}
+
+static void _aesd_transfer_buffer_polling(struct _aesd_desc* desc)
+{
+	_aesd_process_polling(desc, desc->xfer.bufin, desc->xfer.bufout);
 	mutex_unlock(&desc->mutex);
 
 	callback_call(&desc->xfer.callback, NULL);
 }
 
+/* Load the context of a queued job in the peripheral, unless it is loaded
+ * already, then its IV if any. */
+static void _aesd_queue_load(struct _aesd_desc* desc, const struct _aesd_job* job)
+{
+	const struct _aesd_ctx* ctx = job->ctx;
+
+	if (ctx != desc->queue.ctx) {
+		desc->cfg.encrypt = ctx->encrypt;
+		desc->cfg.mode = ctx->mode;
+		desc->cfg.key_size = ctx->key_size;
+		desc->cfg.cfbs = ctx->cfbs;
+		memcpy(desc->cfg.key, ctx->key, sizeof(desc->cfg.key));
+		if (job->vector)
+			memcpy(desc->cfg.vector, job->vector, sizeof(desc->cfg.vector));
+		aesd_configure_mode(desc);
+		aes_encrypt_enable(desc->cfg.encrypt);
+		aes_set_start_mode(desc->cfg.transfer_mode);
+		desc->queue.ctx = ctx;
+	} else if (job->vector) {
+		aes_set_vector(job->vector);
+	}
+}
+
+/* Save the configuration of the descriptor, that the jobs overwrite */
+static void _aesd_queue_save_cfg(struct _aesd_desc* desc)
+{
+	desc->queue.saved.ctx.encrypt = desc->cfg.encrypt;
+	desc->queue.saved.ctx.mode = desc->cfg.mode;
+	desc->queue.saved.ctx.key_size = desc->cfg.key_size;
+	desc->queue.saved.ctx.cfbs = desc->cfg.cfbs;
+	memcpy(desc->queue.saved.ctx.key, desc->cfg.key, sizeof(desc->cfg.key));
+	memcpy(desc->queue.saved.vector, desc->cfg.vector, sizeof(desc->cfg.vector));
+}
+
+/* Restore the configuration of the descriptor. The peripheral is only
+ * configured with it by the next transfer, out of the DMA interrupt. */
+static void _aesd_queue_restore_cfg(struct _aesd_desc* desc)
+{
+	desc->cfg.encrypt = desc->queue.saved.ctx.encrypt;
+	desc->cfg.mode = desc->queue.saved.ctx.mode;
+	desc->cfg.key_size = desc->queue.saved.ctx.key_size;
+	desc->cfg.cfbs = desc->queue.saved.ctx.cfbs;
+	memcpy(desc->cfg.key, desc->queue.saved.ctx.key, sizeof(desc->cfg.key));
+	memcpy(desc->cfg.vector, desc->queue.saved.vector, sizeof(desc->cfg.vector));
+	desc->queue.reload = true;
+}
+
+/* Remove the jobs up to last from the queue. Return true if jobs remain,
+ * restore the configuration and release the driver otherwise. */
+static bool _aesd_queue_pop(struct _aesd_desc* desc, struct _aesd_job* last)
+{
+	uint32_t flags;
+	bool more;
+
+	flags = arch_irq_save();
+	desc->queue.head = last->next;
+	more = desc->queue.head != NULL;
+	if (!more) {
+		desc->queue.tail = NULL;
+		desc->queue.ctx = NULL;
+		_aesd_queue_restore_cfg(desc);
+		mutex_unlock(&desc->mutex);
+	}
+	arch_irq_restore(flags);
+	return more;
+}
+
+static void _aesd_queue_start_dma(struct _aesd_desc* desc);
+
+/* Configure both DMA channels for a batch of count jobs */
+static int _aesd_queue_configure_dma(struct _aesd_desc* desc,
+				   struct _dma_cfg* cfg_dma,
+				   struct _dma_transfer_cfg* tx,
+				   struct _dma_transfer_cfg* rx, uint8_t count)
+{
+	int err;
+
+	cfg_dma->incr_saddr = true;
+	cfg_dma->incr_daddr = false;
+	err = dma_configure_transfer(desc->xfer.dma.tx.channel, cfg_dma, tx, count);
+	if (err < 0)
+		return err;
+
+	cfg_dma->incr_saddr = false;
+	cfg_dma->incr_daddr = true;
+	return dma_configure_transfer(desc->xfer.dma.rx.channel, cfg_dma, rx, count);
+}
+
+static int _aesd_queue_dma_callback(void* arg, void* arg2)
+{
+	struct _aesd_desc* desc = (struct _aesd_desc*)arg;
+	struct _aesd_job *job, *next, *last = desc->queue.batch_last;
+
+	dma_reset_channel(desc->xfer.dma.tx.channel);
+	dma_reset_channel(desc->xfer.dma.rx.channel);
+
+	job = desc->queue.head;
+	for (next = job; ; next = next->next) {
+		cache_invalidate_region((uint32_t*)next->bufout->data,
+					next->bufout->size);
+		if (next == last)
+			break;
+	}
+
+	/* Keep the peripheral busy while the callbacks run */
+	if (_aesd_queue_pop(desc, last))
+		_aesd_queue_start_dma(desc);
+
+	for (;; job = next) {
+		next = job->next;
+		callback_call(&job->callback, job);
+		if (job == last)
+			break;
+	}
+	return 0;
+}
+
+/* Start a DMA transfer for the job at the head of the queue, chained with the
+ * following jobs of the same context that do not load an IV. */
+static void _aesd_queue_start_dma(struct _aesd_desc* desc)
+{
+	struct _aesd_job* job = desc->queue.head;
+	struct _dma_transfer_cfg tx[AESD_QUEUE_BATCH_MAX];
+	struct _dma_transfer_cfg rx[AESD_QUEUE_BATCH_MAX];
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+	uint8_t count = 0, width;
+	int err;
+
+	_aesd_queue_load(desc, job);
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.data_width = _aesd_get_dma_data_width(desc);
+	cfg_dma.chunk_size = _aesd_get_dma_chunk_size(desc);
+	width = DMA_DATA_WIDTH_IN_BYTE(cfg_dma.data_width);
+
+	for (;;) {
+		cache_clean_region((uint32_t*)job->bufin->data, job->bufin->size);
+
+		memset(&tx[count], 0, sizeof(tx[count]));
+		tx[count].saddr = (void *)job->bufin->data;
+		tx[count].daddr = (void *)AES->AES_IDATAR;
+		tx[count].len = job->bufin->size / width;
+
+		memset(&rx[count], 0, sizeof(rx[count]));
+		rx[count].saddr = (void *)AES->AES_ODATAR;
+		rx[count].daddr = (void *)job->bufout->data;
+		rx[count].len = job->bufout->size / width;
+
+		desc->queue.batch_last = job;
+		count++;
+		job = job->next;
+		if (!job || count == AESD_QUEUE_BATCH_MAX
+		    || job->ctx != desc->queue.ctx || job->vector)
+			break;
+	}
+
+	err = _aesd_queue_configure_dma(desc, &cfg_dma, tx, rx, count);
+	if (err < 0 && count > 1) {
+		/* No linked list items left in the DMA pool: transfer the
+		 * first job alone, which needs none */
+		desc->queue.batch_last = desc->queue.head;
+		err = _aesd_queue_configure_dma(desc, &cfg_dma, tx, rx, 1);
+	}
+	assert(err == 0);
+	dma_set_callback(desc->xfer.dma.tx.channel, NULL);
+	callback_set(&_cb, _aesd_queue_dma_callback, (void*)desc);
+	dma_set_callback(desc->xfer.dma.rx.channel, &_cb);
+
+	dma_start_transfer(desc->xfer.dma.tx.channel);
+	dma_start_transfer(desc->xfer.dma.rx.channel);
+}
+
+static void _aesd_queue_run_polling(struct _aesd_desc* desc)
+{
+	struct _aesd_job* job;
+	bool more;
+
+	do {
+		job = desc->queue.head;
+		_aesd_queue_load(desc, job);
+		_aesd_process_polling(desc, job->bufin, job->bufout);
+		more = _aesd_queue_pop(desc, job);
+		callback_call(&job->callback, job);
+	} while (more);
+}
+
+#ifdef CONFIG_HAVE_AES_GCM
+
+static void _aesd_wait_data_ready(void)
+{
+	while ((aes_get_status() & AES_ISR_DATRDY) != AES_ISR_DATRDY);
+}
+
+/* Process one GCM block with the CPU. A block shorter than 16 bytes is padded
+ * with zeros, the peripheral ignores the padding as it knows the lengths of the
+ * message. */
+static void _aesd_gcm_process_block(const uint8_t* in, uint8_t* out, uint32_t len)
+{
+	uint32_t block[4];
+
+	memset(block, 0, sizeof(block));
+	memcpy(block, in, len);
+	aes_set_input(block);
+	_aesd_wait_data_ready();
+	if (out) {
+		aes_get_output(block);
+		memcpy(out, block, len);
+	}
+}
+
+/* Process whole GCM blocks by DMA, the session keeping the driver locked. */
+static void _aesd_gcm_process_dma(struct _aesd_desc* desc,
+				  const uint8_t* in, uint8_t* out, uint32_t len)
+{
+	struct _buffer buf_in = {
+		.data = (uint8_t*)in,
+		.size = len,
+	};
+	struct _buffer buf_out = {
+		.data = out,
+		.size = len,
+	};
+
+	desc->xfer.bufin = &buf_in;
+	desc->xfer.bufout = &buf_out;
+	aes_set_start_mode(AESD_TRANS_DMA);
+	_aesd_transfer_buffer_dma(desc);
+	aes_set_start_mode(AESD_TRANS_POLLING_AUTO);
+}
+
+/* End the GCM session and release the driver. */
+static void _aesd_gcm_end(struct _aesd_desc* desc)
+{
+	desc->gcm.active = false;
+	mutex_unlock(&desc->mutex);
+}
+
+#endif /* CONFIG_HAVE_AES_GCM */
+
 /*----------------------------------------------------------------------------
  *        Public functions
 
@@ -188,20 +447,26 @@ static void _aesd_transfer_buffer_polling(struct _aesd_desc* desc)
 uint32_t aesd_transfer(struct _aesd_desc* desc, struct _buffer* buffer_in,
 	struct _buffer* buffer_out, struct _callback* cb)
 {
-	aes_encrypt_enable(desc->cfg.encrypt);
-	aes_set_start_mode(desc->cfg.transfer_mode);
-	desc->xfer.bufin = buffer_in;
-	desc->xfer.bufout = buffer_out;
-	callback_copy(&desc->xfer.callback, cb);
-
-	assert(!(desc->xfer.bufin->size % _aesd_get_size_per_trans(desc)));
-	assert(!(desc->xfer.bufout->size % _aesd_get_size_per_trans(desc)));
+	assert(!(buffer_in->size % _aesd_get_size_per_trans(desc)));
+	assert(!(buffer_out->size % _aesd_get_size_per_trans(desc)));
 
+	/* Leave the peripheral alone while another transfer or a GCM message
+	 * owns it */
 	if (!mutex_try_lock(&desc->mutex)) {
 		trace_error("AESD mutex already locked!\r\n");
 		return ADES_ERROR_LOCK;
 	}
 
+	/* Load the configuration again after a queue of jobs */
+	if (desc->queue.reload)
+		aesd_configure_mode(desc);
+
+	aes_encrypt_enable(desc->cfg.encrypt);
+	aes_set_start_mode(desc->cfg.transfer_mode);
+	desc->xfer.bufin = buffer_in;
+	desc->xfer.bufout = buffer_out;
+	callback_copy(&desc->xfer.callback, cb);
+
 	switch (desc->cfg.transfer_mode) {
 	case AESD_TRANS_POLLING_MANUAL:
 	case AESD_TRANS_POLLING_AUTO:
@@ -210,6 +475,8 @@ uint32_t aesd_transfer(struct _aesd_desc* desc, struct _buffer* buffer_in,
 
 	case AESD_TRANS_DMA:
 		_aesd_transfer_buffer_dma(desc);
+		mutex_unlock(&desc->mutex);
+		callback_call(&desc->xfer.callback, NULL);
 		break;
 
 	default:
@@ -233,13 +500,58 @@ void aesd_wait_transfer(struct _aesd_desc* desc)
 	}
 }
 
+uint32_t aesd_submit(struct _aesd_desc* desc,
+		     struct _aesd_job* jobs, uint32_t count)
+{
+	uint32_t i, flags;
+
+	if (count == 0)
+		return AESD_SUCCESS;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].ctx->mode == AESD_MODE_GCM)
+			return AESD_ERROR_PARAM;
+		jobs[i].next = (i + 1 < count) ? &jobs[i + 1] : NULL;
+	}
+
+	flags = arch_irq_save();
+	if (desc->queue.head) {
+		/* Queue running, append the jobs */
+		desc->queue.tail->next = jobs;
+		desc->queue.tail = &jobs[count - 1];
+		arch_irq_restore(flags);
+		return AESD_SUCCESS;
+	}
+	if (!mutex_try_lock(&desc->mutex)) {
+		arch_irq_restore(flags);
+		trace_error("AESD mutex already locked!\r\n");
+		return ADES_ERROR_LOCK;
+	}
+	desc->queue.head = jobs;
+	desc->queue.tail = &jobs[count - 1];
+	arch_irq_restore(flags);
+
+	_aesd_queue_save_cfg(desc);
+	if (desc->cfg.transfer_mode == AESD_TRANS_DMA)
+		_aesd_queue_start_dma(desc);
+	else
+		_aesd_queue_run_polling(desc);
+
+	return AESD_SUCCESS;
+}
+
 void aesd_configure_mode(struct _aesd_desc* desc)
 {
+	desc->queue.reload = false;
 	aes_soft_reset();
 
 	aes_set_op_mode(desc->cfg.mode);
 	aes_set_key_size(desc->cfg.key_size);
 	aes_set_cfbs(desc->cfg.cfbs);
+#ifdef CONFIG_HAVE_AES_GCM
+	if (desc->cfg.mode == AESD_MODE_GCM)
+		aes_gcm_tag_enable(true);
+#endif
 
 	/* Write the 128-bit/192-bit/256-bit key in the Key Word Registers */
 	if (desc->cfg.key_size == AESD_AES128)
@@ -249,6 +561,16 @@ void aesd_configure_mode(struct _aesd_desc* desc)
 	else
 		aes_write_key(&desc->cfg.key[0], 32);
 
+#ifdef CONFIG_HAVE_AES_GCM
+	if (desc->cfg.mode == AESD_MODE_GCM) {
+		/* Writing the key starts the computation of the hash subkey H,
+		 * which shall complete before any other access. The counter is
+		 * loaded by aesd_gcm_start(). */
+		_aesd_wait_data_ready();
+		return;
+	}
+#endif
+
 	/* The Initialization Vector Registers apply to all modes except
 	 * ECB. */
 	if (desc->cfg.mode != AES_MR_OPMOD_ECB)
@@ -260,6 +582,8 @@ void aesd_init(struct _aesd_desc* desc)
 	/* Enable peripheral clock */
 	pmc_configure_peripheral(ID_AES, NULL, true);
 
+	memset(&desc->queue, 0, sizeof(desc->queue));
+
 	/* Allocate one DMA channel for writing message blocks to AES_IDATARx */
 	desc->xfer.dma.tx.channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_AES);
 	assert(desc->xfer.dma.tx.channel);
@@ -268,3 +592,179 @@ void aesd_init(struct _aesd_desc* desc)
 	desc->xfer.dma.rx.channel = dma_allocate_channel(ID_AES, DMA_PERIPH_MEMORY);
 	assert(desc->xfer.dma.rx.channel);
 }
+
+#ifdef CONFIG_HAVE_AES_GCM
+
+uint32_t aesd_gcm_start(struct _aesd_desc* desc,
+			const uint8_t* iv, uint32_t iv_len,
+			uint32_t aad_len, uint32_t data_len)
+{
+	uint8_t counter[16];
+	uint32_t vector[4];
+
+	if (desc->cfg.mode != AESD_MODE_GCM || iv_len != AESD_GCM_IV_SIZE)
+		return AESD_ERROR_PARAM;
+	if (!mutex_try_lock(&desc->mutex)) {
+		trace_error("AESD mutex already locked!\r\n");
+		return ADES_ERROR_LOCK;
+	}
+	desc->gcm.active = true;
+
+	aesd_configure_mode(desc);
+
+	/* With a 96-bit IV, J0 = IV || 0^31 || 1. The peripheral expects
+	 * inc32(J0), the counter of the first text block. */
+	memcpy(counter, iv, AESD_GCM_IV_SIZE);
+	counter[12] = 0;
+	counter[13] = 0;
+	counter[14] = 0;
+	counter[15] = 2;
+	memcpy(vector, counter, sizeof(vector));
+	aes_set_vector(vector);
+
+	aes_set_aad_len(aad_len);
+	aes_set_data_len(data_len);
+	aes_encrypt_enable(desc->cfg.encrypt);
+	aes_set_start_mode(AESD_TRANS_POLLING_AUTO);
+
+	desc->gcm.aad_left = aad_len;
+	desc->gcm.data_left = data_len;
+
+	return AESD_SUCCESS;
+}
+
+uint32_t aesd_gcm_update_aad(struct _aesd_desc* desc,
+			     const uint8_t* aad, uint32_t len)
+{
+	uint32_t chunk;
+
+	if (!desc->gcm.active)
+		return AESD_ERROR_PARAM;
+	if (len > desc->gcm.aad_left
+	    || ((len % 16) && len != desc->gcm.aad_left)) {
+		_aesd_gcm_end(desc);
+		return AESD_ERROR_PARAM;
+	}
+
+	desc->gcm.aad_left -= len;
+	for (; len; aad += chunk, len -= chunk) {
+		chunk = min_u32(len, 16);
+		_aesd_gcm_process_block(aad, NULL, chunk);
+	}
+
+	return AESD_SUCCESS;
+}
+
+uint32_t aesd_gcm_update(struct _aesd_desc* desc,
+			 const uint8_t* in, uint8_t* out, uint32_t len)
+{
+	uint32_t chunk;
+
+	if (!desc->gcm.active)
+		return AESD_ERROR_PARAM;
+	if (desc->gcm.aad_left || len > desc->gcm.data_left
+	    || ((len % 16) && len != desc->gcm.data_left)) {
+		_aesd_gcm_end(desc);
+		return AESD_ERROR_PARAM;
+	}
+
+	desc->gcm.data_left -= len;
+	chunk = len & ~15u;
+	if (desc->cfg.transfer_mode == AESD_TRANS_DMA && chunk) {
+		_aesd_gcm_process_dma(desc, in, out, chunk);
+		in += chunk;
+		out += chunk;
+		len -= chunk;
+	}
+	for (; len; in += chunk, out += chunk, len -= chunk) {
+		chunk = min_u32(len, 16);
+		_aesd_gcm_process_block(in, out, chunk);
+	}
+
+	return AESD_SUCCESS;
+}
+
+uint32_t aesd_gcm_finish(struct _aesd_desc* desc,
+			 uint8_t* tag, uint32_t tag_len)
+{
+	uint32_t words[4];
+
+	if (!desc->gcm.active)
+		return AESD_ERROR_PARAM;
+	if (desc->gcm.aad_left || desc->gcm.data_left
+	    || tag_len == 0 || tag_len > AESD_GCM_TAG_SIZE) {
+		_aesd_gcm_end(desc);
+		return AESD_ERROR_PARAM;
+	}
+
+	while ((aes_get_status() & AES_ISR_TAGRDY) != AES_ISR_TAGRDY);
+	aes_get_gcm_tag(words);
+	memcpy(tag, words, tag_len);
+	_aesd_gcm_end(desc);
+
+	return AESD_SUCCESS;
+}
+
+uint32_t aesd_gcm_verify(struct _aesd_desc* desc,
+			 const uint8_t* tag, uint32_t tag_len)
+{
+	uint8_t computed[AESD_GCM_TAG_SIZE];
+	uint8_t diff = 0;
+	uint32_t i, rc;
+
+	rc = aesd_gcm_finish(desc, computed, tag_len);
+	if (rc != AESD_SUCCESS)
+		return rc;
+
+	/* Compare all bytes, so that the time taken does not depend on the
+	 * position of the first mismatch */
+	for (i = 0; i < tag_len; i++)
+		diff |= computed[i] ^ tag[i];
+
+	return diff ? AESD_ERROR_AUTH : AESD_SUCCESS;
+}
+
+uint32_t aesd_gcm_encrypt(struct _aesd_desc* desc,
+			  const uint8_t* iv, uint32_t iv_len,
+			  const uint8_t* aad, uint32_t aad_len,
+			  const uint8_t* in, uint8_t* out, uint32_t len,
+			  uint8_t* tag, uint32_t tag_len)
+{
+	uint32_t rc;
+
+	desc->cfg.encrypt = true;
+	rc = aesd_gcm_start(desc, iv, iv_len, aad_len, len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_update_aad(desc, aad, aad_len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_update(desc, in, out, len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_finish(desc, tag, tag_len);
+
+	return rc;
+}
+
+uint32_t aesd_gcm_decrypt(struct _aesd_desc* desc,
+			  const uint8_t* iv, uint32_t iv_len,
+			  const uint8_t* aad, uint32_t aad_len,
+			  const uint8_t* in, uint8_t* out, uint32_t len,
+			  const uint8_t* tag, uint32_t tag_len)
+{
+	uint32_t rc;
+
+	desc->cfg.encrypt = false;
+	rc = aesd_gcm_start(desc, iv, iv_len, aad_len, len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_update_aad(desc, aad, aad_len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_update(desc, in, out, len);
+	if (rc == AESD_SUCCESS)
+		rc = aesd_gcm_verify(desc, tag, tag_len);
+	/* Never release unauthenticated plaintext */
+	if (rc != AESD_SUCCESS)
+		memset(out, 0, len);
+
+	return rc;
+}
+
+#endif /* CONFIG_HAVE_AES_GCM */
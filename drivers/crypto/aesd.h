@@ -49,6 +49,13 @@
 #define AESD_SUCCESS         (0)
 #define ADES_ERROR_LOCK      (1)
 #define AESD_ERROR_TRANSFER  (2)
+#define AESD_ERROR_PARAM     (3)
+#define AESD_ERROR_AUTH      (4)
+
+/** Size of the GCM initialization vector supported by the driver */
+#define AESD_GCM_IV_SIZE     (12)
+/** Size of the full GCM authentication tag */
+#define AESD_GCM_TAG_SIZE    (16)
 
 enum _aesd_trans_mode
 {
@@ -80,6 +87,28 @@ enum _aesd_cipher_size {
 	AESD_CFBS_8
 };
 
+/** Key context of the jobs processed by aesd_submit() */
+struct _aesd_ctx {
+	bool encrypt;
+	enum _aesd_mode mode;
+	enum _aesd_key_size key_size;
+	enum _aesd_cipher_size cfbs;
+	uint32_t key[8];
+};
+
+/** Job processed by aesd_submit() */
+struct _aesd_job {
+	const struct _aesd_ctx *ctx;   /*< key context */
+	const uint32_t *vector;        /*< IV to load before the job, or NULL to
+	                                   chain with the previous job */
+	struct _buffer *bufin;         /*< buffer input */
+	struct _buffer *bufout;        /*< buffer output */
+	struct _callback callback;     /*< called with the job as 2nd argument */
+
+	/* following fields are used internally */
+	struct _aesd_job *next;
+};
+
 struct _aesd_desc {
 	/* structure to define AES parameter */
 
@@ -100,6 +129,7 @@ struct _aesd_desc {
 		struct _buffer *bufin;         /*< buffer input */
 		struct _buffer *bufout;        /*< buffer output */
 		struct _callback callback;
+		volatile bool dma_done;        /*< DMA transfer complete */
 
 		struct {
 			struct {
@@ -107,6 +137,31 @@ struct _aesd_desc {
 			} rx, tx;
 		} dma;
 	} xfer;
+
+	/* structure to hold the jobs queued by aesd_submit() */
+	struct {
+		struct _aesd_job *head;        /*< job being processed */
+		struct _aesd_job *tail;        /*< last job queued */
+		struct _aesd_job *batch_last;  /*< last job of the DMA batch */
+		const struct _aesd_ctx *ctx;   /*< context loaded in the peripheral */
+		bool reload;                   /*< peripheral to configure with cfg
+		                                   before the next transfer */
+
+		/* cfg of the descriptor, restored when the queue drains */
+		struct {
+			struct _aesd_ctx ctx;
+			uint32_t vector[4];
+		} saved;
+	} queue;
+
+#ifdef CONFIG_HAVE_AES_GCM
+	/* structure to hold the state of the current GCM message */
+	struct {
+		bool active;                   /*< session holding the mutex */
+		uint32_t aad_left;             /*< AAD bytes still expected */
+		uint32_t data_left;            /*< text bytes still expected */
+	} gcm;
+#endif
 };
 
 /*------------------------------------------------------------------------------
@@ -124,4 +179,96 @@ extern bool aesd_is_busy(struct _aesd_desc* desc);
 
 extern void aesd_wait_transfer(struct _aesd_desc* desc);
 
+/**
+ * \brief Queue jobs for processing. Jobs are processed in order; in DMA mode
+ * consecutive jobs sharing the same context and not loading an IV are chained
+ * into a single DMA transfer. The key is only reloaded when the context
+ * differs from the one of the previous job, and the IV when job->vector is
+ * set, which it shall be for the first job of a context in modes other than
+ * ECB. GCM is not supported.
+ * Jobs, contexts and buffers shall remain untouched until the callback of the
+ * job has been invoked. Jobs may be submitted while the queue is running,
+ * including from a job callback. aesd_wait_transfer() waits for the queue to
+ * drain. desc->cfg is left untouched: once the queue drains, the peripheral
+ * is configured again with it by the next aesd_transfer(), as by
+ * aesd_configure_mode().
+ * \param jobs   Array of jobs to append to the queue.
+ * \param count  Number of jobs in the array.
+ * \return AESD_SUCCESS, or ADES_ERROR_LOCK if aesd_transfer() or a GCM
+ * message is in progress.
+ */
+extern uint32_t aesd_submit(struct _aesd_desc* desc,
+			    struct _aesd_job* jobs, uint32_t count);
+
+#ifdef CONFIG_HAVE_AES_GCM
+
+/**
+ * \brief Start processing a GCM message: reset the peripheral, load the key,
+ * the counter derived from the IV and the lengths of the message.
+ * cfg.mode shall be AESD_MODE_GCM, cfg.encrypt selects the direction.
+ * Only 96-bit IVs are supported.
+ * The driver stays locked until aesd_gcm_finish() or aesd_gcm_verify(), or
+ * until any of the functions below fails.
+ * \param iv        Initialization vector.
+ * \param iv_len    Length of the IV, in bytes (AESD_GCM_IV_SIZE).
+ * \param aad_len   Total length of the additional authenticated data.
+ * \param data_len  Total length of the plaintext/ciphertext.
+ */
+extern uint32_t aesd_gcm_start(struct _aesd_desc* desc,
+			       const uint8_t* iv, uint32_t iv_len,
+			       uint32_t aad_len, uint32_t data_len);
+
+/**
+ * \brief Feed additional authenticated data. May be called several times;
+ * all chunks but the last one shall be a multiple of 16 bytes long.
+ */
+extern uint32_t aesd_gcm_update_aad(struct _aesd_desc* desc,
+				    const uint8_t* aad, uint32_t len);
+
+/**
+ * \brief Encrypt or decrypt text, once all AAD has been fed. May be called
+ * several times; all chunks but the last one shall be a multiple of 16 bytes
+ * long. In DMA mode, the whole blocks are transferred by DMA and the buffers
+ * shall be cache line aligned.
+ */
+extern uint32_t aesd_gcm_update(struct _aesd_desc* desc,
+				const uint8_t* in, uint8_t* out, uint32_t len);
+
+/**
+ * \brief Wait for the end of the message and read its authentication tag.
+ * \param tag_len  Length of the tag to output, up to AESD_GCM_TAG_SIZE.
+ */
+extern uint32_t aesd_gcm_finish(struct _aesd_desc* desc,
+				uint8_t* tag, uint32_t tag_len);
+
+/**
+ * \brief Wait for the end of the message and compare its authentication tag,
+ * in constant time, with the expected one.
+ * \return AESD_SUCCESS if the tags match, AESD_ERROR_AUTH otherwise.
+ */
+extern uint32_t aesd_gcm_verify(struct _aesd_desc* desc,
+				const uint8_t* tag, uint32_t tag_len);
+
+/**
+ * \brief Encrypt a complete message and compute its tag.
+ */
+extern uint32_t aesd_gcm_encrypt(struct _aesd_desc* desc,
+				 const uint8_t* iv, uint32_t iv_len,
+				 const uint8_t* aad, uint32_t aad_len,
+				 const uint8_t* in, uint8_t* out, uint32_t len,
+				 uint8_t* tag, uint32_t tag_len);
+
+/**
+ * \brief Decrypt a complete message and check its tag. The output is wiped
+ * if authentication fails.
+ * \return AESD_SUCCESS, or AESD_ERROR_AUTH if the tags do not match.
+ */
+extern uint32_t aesd_gcm_decrypt(struct _aesd_desc* desc,
+				 const uint8_t* iv, uint32_t iv_len,
+				 const uint8_t* aad, uint32_t aad_len,
+				 const uint8_t* in, uint8_t* out, uint32_t len,
+				 const uint8_t* tag, uint32_t tag_len);
+
+#endif /* CONFIG_HAVE_AES_GCM */
+
 #endif /* AESD_HEADER__ */
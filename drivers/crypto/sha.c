@@ -143,3 +143,20 @@ void sha_get_output(uint8_t* data, int len)
 		memcpy(&data[i * 4], &value, 4);
 	}
 }
+
+#ifdef SHA_CR_WUIHV
+void sha_set_initial_hash(const uint8_t* data, int len)
+{
+	int i;
+	int32_t value;
+
+	/* While WUIHV is set, SHA_IDATARx accesses are routed to the User
+	 * Initial Hash Value registers */
+	SHA->SHA_CR = SHA_CR_WUIHV;
+	for (i = 0; i < (len / 4) && i < 8; i++) {
+		memcpy(&value, &data[i * 4], 4);
+		SHA->SHA_IDATAR[i] = value;
+	}
+	SHA->SHA_CR = 0;
+}
+#endif
@@ -97,6 +97,16 @@ extern void sha_set_input(const uint8_t* data, int len);
  */
 extern void sha_get_output(uint8_t* data, int len);
 
+#ifdef SHA_CR_WUIHV
+/**
+ * \brief Load the User Initial Hash Value registers, used instead of the
+ * standard initial hash value when SHA_MR.UIHV is set.
+ * \param data pointer to the hash words, in the format of sha_get_output()
+ * \param len hash size in bytes, must be a multiple of 4
+ */
+extern void sha_set_initial_hash(const uint8_t* data, int len);
+#endif
+
 #endif /* CONFIG_HAVE_SHA */
 
 #endif /* SHA_H_ */
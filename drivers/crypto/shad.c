@@ -38,6 +38,7 @@
 #include "errno.h"
 #include "intmath.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "serial/console.h"
@@ -327,39 +328,7 @@ static void _shad_update_polling(struct _shad_desc* desc, const uint8_t* data, u
 	callback_call(&desc->xfer.callback, NULL);
 }
 
-/*----------------------------------------------------------------------------
- *        Public functions
- *----------------------------------------------------------------------------*/
-
-void shad_init(struct _shad_desc* desc)
-{
-	/* Enable peripheral clock */
-	pmc_configure_peripheral(ID_SHA, NULL, true);
-
-	/* Allocate one DMA channel for writing message blocks to SHA_IDATARx */
-	desc->dma_channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_SHA);
-	assert(desc->dma_channel);
-}
-
-int shad_get_output_size(enum _shad_algo algo)
-{
-	switch (algo) {
-	case ALGO_SHA_1:
-		return 20;
-	case ALGO_SHA_224:
-		return 28;
-	case ALGO_SHA_256:
-		return 32;
-	case ALGO_SHA_384:
-		return 48;
-	case ALGO_SHA_512:
-		return 64;
-	default:
-		return -EINVAL;
-	}
-}
-
-int shad_start(struct _shad_desc* desc)
+static int _shad_start(struct _shad_desc* desc)
 {
 	uint32_t algo, mode;
 
@@ -406,6 +375,146 @@ int shad_start(struct _shad_desc* desc)
 	return 0;
 }
 
+static int _shad_queue_update_callback(void* arg, void* arg2);
+static int _shad_queue_finish_callback(void* arg, void* arg2);
+
+/* Start hashing the message of the job at the head of the queue */
+static void _shad_queue_start(struct _shad_desc* desc)
+{
+	struct _shad_job* job = desc->queue.head;
+	struct _callback _cb;
+
+	desc->cfg.algo = job->algo;
+	_shad_start(desc);
+	callback_set(&_cb, _shad_queue_update_callback, (void*)desc);
+	shad_update(desc, job->buffer, &_cb);
+}
+
+static int _shad_queue_update_callback(void* arg, void* arg2)
+{
+	struct _shad_desc* desc = (struct _shad_desc*)arg;
+	struct _callback _cb;
+
+	callback_set(&_cb, _shad_queue_finish_callback, (void*)desc);
+	shad_finish(desc, desc->queue.head->digest, &_cb);
+	return 0;
+}
+
+static int _shad_queue_finish_callback(void* arg, void* arg2)
+{
+	struct _shad_desc* desc = (struct _shad_desc*)arg;
+	struct _shad_job* job = desc->queue.head;
+	uint32_t flags;
+	bool more;
+
+	flags = arch_irq_save();
+	desc->queue.head = job->next;
+	more = desc->queue.head != NULL;
+	if (!more) {
+		desc->queue.tail = NULL;
+		desc->cfg.algo = desc->queue.algo;
+	}
+	arch_irq_restore(flags);
+
+	/* In polling mode, shad_submit() loops over the jobs */
+	if (more && desc->cfg.transfer_mode == SHAD_TRANS_DMA)
+		_shad_queue_start(desc);
+
+	callback_call(&job->callback, job);
+	return 0;
+}
+
+static bool _shad_ctx_is_supported(enum _shad_algo algo)
+{
+#ifdef SHA_CR_WUIHV
+	/* The User Initial Hash Value registers only apply to the algorithms
+	 * with a 256-bit internal state */
+	return algo == ALGO_SHA_1 || algo == ALGO_SHA_256;
+#else
+	return false;
+#endif
+}
+
+static int _shad_ctx_lock(struct _shad_desc* desc)
+{
+	if (desc->queue.head || !mutex_try_lock(&desc->mutex))
+		return -EAGAIN;
+	return 0;
+}
+
+/* Clear a buffer holding key material. The stores go through a volatile
+ * pointer, so that the compiler does not drop them as dead stores to a
+ * buffer that is not read again */
+static void _shad_wipe(void* buffer, uint32_t len)
+{
+	volatile uint8_t* p = (volatile uint8_t*)buffer;
+
+	while (len--)
+		*p++ = 0;
+}
+
+/* Configure the peripheral to continue the computation of a context */
+static void _shad_ctx_load(struct _shad_ctx* ctx)
+{
+#ifdef SHA_CR_WUIHV
+	uint32_t algo;
+
+	algo = ctx->algo == ALGO_SHA_1 ? SHA_MR_ALGO_SHA1 : SHA_MR_ALGO_SHA256;
+	sha_soft_reset();
+	if (ctx->processed) {
+		sha_configure(algo | SHA_MR_SMOD_AUTO_START
+			      | SHA_MR_PROCDLY_LONGEST | SHA_MR_UIHV);
+		sha_set_initial_hash(ctx->hash, shad_get_output_size(ctx->algo));
+	} else {
+		sha_configure(algo | SHA_MR_SMOD_AUTO_START
+			      | SHA_MR_PROCDLY_LONGEST);
+	}
+	sha_first_block();
+#endif
+}
+
+/*----------------------------------------------------------------------------
+ *        Public functions
+ *----------------------------------------------------------------------------*/
+
+void shad_init(struct _shad_desc* desc)
+{
+	/* Enable peripheral clock */
+	pmc_configure_peripheral(ID_SHA, NULL, true);
+
+	memset(&desc->queue, 0, sizeof(desc->queue));
+
+	/* Allocate one DMA channel for writing message blocks to SHA_IDATARx */
+	desc->dma_channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_SHA);
+	assert(desc->dma_channel);
+}
+
+int shad_get_output_size(enum _shad_algo algo)
+{
+	switch (algo) {
+	case ALGO_SHA_1:
+		return 20;
+	case ALGO_SHA_224:
+		return 28;
+	case ALGO_SHA_256:
+		return 32;
+	case ALGO_SHA_384:
+		return 48;
+	case ALGO_SHA_512:
+		return 64;
+	default:
+		return -EINVAL;
+	}
+}
+
+int shad_start(struct _shad_desc* desc)
+{
+	if (desc->queue.head)
+		return -EBUSY;
+
+	return _shad_start(desc);
+}
+
 int shad_update(struct _shad_desc* desc, struct _buffer* buffer,
                      struct _callback* cb)
 {
@@ -481,7 +590,7 @@ int shad_finish(struct _shad_desc* desc, struct _buffer* buffer,
 
 bool shad_is_busy(struct _shad_desc* desc)
 {
-	return mutex_is_locked(&desc->mutex);
+	return mutex_is_locked(&desc->mutex) || desc->queue.head;
 }
 
 void shad_wait_completion(struct _shad_desc* desc)
@@ -491,3 +600,207 @@ void shad_wait_completion(struct _shad_desc* desc)
 			dma_poll();
 	}
 }
+
+int shad_submit(struct _shad_desc* desc, struct _shad_job* jobs, uint32_t count)
+{
+	uint32_t i, flags;
+
+	if (count == 0)
+		return 0;
+
+	for (i = 0; i < count; i++) {
+		if (jobs[i].digest->size != shad_get_output_size(jobs[i].algo))
+			return -EINVAL;
+		if (desc->cfg.transfer_mode == SHAD_TRANS_DMA)
+			assert((((uint32_t)jobs[i].buffer->data) & (L1_CACHE_BYTES - 1)) == 0);
+		jobs[i].next = (i + 1 < count) ? &jobs[i + 1] : NULL;
+	}
+
+	flags = arch_irq_save();
+	if (desc->queue.head) {
+		/* Queue running, append the jobs */
+		desc->queue.tail->next = jobs;
+		desc->queue.tail = &jobs[count - 1];
+		arch_irq_restore(flags);
+		return 0;
+	}
+	if (mutex_is_locked(&desc->mutex)) {
+		arch_irq_restore(flags);
+		trace_error("SHAD mutex already locked!\r\n");
+		return -EAGAIN;
+	}
+	desc->queue.head = jobs;
+	desc->queue.tail = &jobs[count - 1];
+	desc->queue.algo = desc->cfg.algo;
+	arch_irq_restore(flags);
+
+	if (desc->cfg.transfer_mode == SHAD_TRANS_DMA) {
+		_shad_queue_start(desc);
+	} else {
+		while (desc->queue.head)
+			_shad_queue_start(desc);
+	}
+
+	return 0;
+}
+
+int shad_ctx_init(struct _shad_ctx* ctx, enum _shad_algo algo)
+{
+	if (!_shad_ctx_is_supported(algo))
+		return -ENOTSUP;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->algo = algo;
+
+	return 0;
+}
+
+int shad_ctx_update(struct _shad_desc* desc, struct _shad_ctx* ctx,
+		    const uint8_t* data, uint32_t len)
+{
+	uint32_t complement = 0, blocks;
+	int err;
+
+	err = _shad_ctx_lock(desc);
+	if (err < 0)
+		return err;
+
+	/* Complete the pending partial block, if any */
+	if (ctx->remaining) {
+		complement = min_u32(len, SHAD_CTX_BLOCK_SIZE - ctx->remaining);
+		memcpy(&ctx->block[ctx->remaining], data, complement);
+		ctx->remaining += complement;
+		data += complement;
+		len -= complement;
+	}
+	blocks = len & ~(SHAD_CTX_BLOCK_SIZE - 1);
+
+	if (ctx->remaining == SHAD_CTX_BLOCK_SIZE || blocks) {
+		/* Restore the intermediate hash value, process the whole
+		 * blocks in place and save the new intermediate hash value */
+		_shad_ctx_load(ctx);
+		if (ctx->remaining == SHAD_CTX_BLOCK_SIZE) {
+			_shad_process_blocks_polling(ctx->block,
+					SHAD_CTX_BLOCK_SIZE, SHAD_CTX_BLOCK_SIZE);
+			ctx->processed += SHAD_CTX_BLOCK_SIZE;
+			ctx->remaining = 0;
+		}
+		_shad_process_blocks_polling(data, blocks, SHAD_CTX_BLOCK_SIZE);
+		ctx->processed += blocks;
+		sha_get_output(ctx->hash, shad_get_output_size(ctx->algo));
+	}
+
+	/* Keep the trailing partial block for later processing */
+	memcpy(&ctx->block[ctx->remaining], &data[blocks], len - blocks);
+	ctx->remaining += len - blocks;
+
+	mutex_unlock(&desc->mutex);
+
+	return 0;
+}
+
+int shad_ctx_finish(struct _shad_desc* desc, struct _shad_ctx* ctx,
+		    struct _buffer* digest)
+{
+	uint8_t last[2 * SHAD_CTX_BLOCK_SIZE];
+	uint32_t padding_len;
+	int err;
+
+	if (digest->size != shad_get_output_size(ctx->algo))
+		return -EINVAL;
+
+	err = _shad_ctx_lock(desc);
+	if (err < 0)
+		return err;
+
+	memcpy(last, ctx->block, ctx->remaining);
+	padding_len = _shad_fill_padding(ctx->algo,
+					 ctx->processed + ctx->remaining,
+					 &last[ctx->remaining],
+					 sizeof(last) - ctx->remaining);
+
+	_shad_ctx_load(ctx);
+	_shad_process_blocks_polling(last, ctx->remaining + padding_len,
+				     SHAD_CTX_BLOCK_SIZE);
+	sha_get_output(digest->data, digest->size);
+
+	mutex_unlock(&desc->mutex);
+
+	return 0;
+}
+
+int shad_hmac_init(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+		   enum _shad_algo algo, const uint8_t* key, uint32_t key_len)
+{
+	uint8_t pad[SHAD_CTX_BLOCK_SIZE];
+	struct _buffer digest = {
+		.data = pad,
+		.size = shad_get_output_size(algo),
+	};
+	uint32_t i;
+	int err;
+
+	err = shad_ctx_init(&ctx->inner, algo);
+	if (err < 0)
+		return err;
+	shad_ctx_init(&ctx->outer, algo);
+
+	/* Keys longer than a block are hashed first */
+	memset(pad, 0, sizeof(pad));
+	if (key_len > SHAD_CTX_BLOCK_SIZE) {
+		err = shad_ctx_update(desc, &ctx->inner, key, key_len);
+		if (err == 0)
+			err = shad_ctx_finish(desc, &ctx->inner, &digest);
+		shad_ctx_init(&ctx->inner, algo);
+		if (err < 0)
+			goto out;
+	} else {
+		memcpy(pad, key, key_len);
+	}
+
+	for (i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36;
+	err = shad_ctx_update(desc, &ctx->inner, pad, sizeof(pad));
+	if (err < 0)
+		goto out;
+
+	for (i = 0; i < sizeof(pad); i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+	err = shad_ctx_update(desc, &ctx->outer, pad, sizeof(pad));
+
+out:
+	/* Do not leave the key on the stack */
+	_shad_wipe(pad, sizeof(pad));
+
+	return err;
+}
+
+int shad_hmac_update(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+		     const uint8_t* data, uint32_t len)
+{
+	return shad_ctx_update(desc, &ctx->inner, data, len);
+}
+
+int shad_hmac_finish(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+		     struct _buffer* mac)
+{
+	uint8_t hash[SHAD_CTX_HASH_SIZE];
+	struct _buffer digest = {
+		.data = hash,
+		.size = shad_get_output_size(ctx->inner.algo),
+	};
+	int err;
+
+	if (mac->size == 0 || mac->size > digest.size)
+		return -EINVAL;
+
+	err = shad_ctx_finish(desc, &ctx->inner, &digest);
+	if (err == 0)
+		err = shad_ctx_update(desc, &ctx->outer, hash, digest.size);
+	if (err == 0)
+		err = shad_ctx_finish(desc, &ctx->outer, &digest);
+	if (err == 0)
+		memcpy(mac->data, hash, mac->size);
+
+	return err;
+}
@@ -61,6 +61,39 @@ enum _shad_transfer_mode
 	SHAD_TRANS_DMA
 };
 
+/** Block size of the algorithms supported by the shad_ctx_*() functions */
+#define SHAD_CTX_BLOCK_SIZE 64
+
+/** Size of the intermediate hash value saved in a SHA context */
+#define SHAD_CTX_HASH_SIZE 32
+
+/** State of an incremental SHA computation, saved between updates so that
+ * several computations can be interleaved on the peripheral */
+struct _shad_ctx {
+	enum _shad_algo algo;
+	uint32_t processed;                   /* bytes hashed so far */
+	uint32_t remaining;                   /* bytes pending in block */
+	uint8_t hash[SHAD_CTX_HASH_SIZE];     /* intermediate hash value */
+	uint8_t block[SHAD_CTX_BLOCK_SIZE];   /* pending partial block */
+};
+
+/** State of an incremental HMAC computation */
+struct _shad_hmac_ctx {
+	struct _shad_ctx inner;
+	struct _shad_ctx outer;
+};
+
+/** Job processed by shad_submit(): compute the digest of a message */
+struct _shad_job {
+	enum _shad_algo algo;          /*< digest algorithm */
+	struct _buffer *buffer;        /*< message */
+	struct _buffer *digest;        /*< resulting digest */
+	struct _callback callback;     /*< called with the job as 2nd argument */
+
+	/* following fields are used internally */
+	struct _shad_job *next;
+};
+
 struct _shad_desc {
 	/* structure to define SHA configuration */
 	struct {
@@ -80,6 +113,13 @@ struct _shad_desc {
 		uint32_t processed; /* cumulated data processed, value is included in padding data */
 		struct _buffer* buffer;
 	} xfer;
+
+	/* jobs queued by shad_submit() */
+	struct {
+		struct _shad_job* head; /* job being processed */
+		struct _shad_job* tail; /* last job queued */
+		enum _shad_algo algo;   /* cfg.algo, restored when the queue drains */
+	} queue;
 };
 
 /*------------------------------------------------------------------------------
@@ -102,7 +142,7 @@ extern int shad_get_output_size(enum _shad_algo algo);
 /**
  * \brief Start a new SHA computation.
  * \param desc a SHA driver descriptor
- * \return 0 on success, <0 on error
+ * \return 0 on success, <0 on error (-EBUSY while jobs are queued)
  */
 extern int shad_start(struct _shad_desc* desc);
 
@@ -140,4 +180,86 @@ extern bool shad_is_busy(struct _shad_desc* desc);
  */
 extern void shad_wait_completion(struct _shad_desc* desc);
 
+/**
+ * \brief Initialize a SHA context. The context is saved in RAM between calls,
+ * so any number of contexts can be interleaved.
+ * \param ctx the SHA context
+ * \param algo SHA algorithm: ALGO_SHA_1 or ALGO_SHA_256
+ * \return 0 on success, -ENOTSUP if the algorithm or the saving of the
+ * intermediate hash value is not supported
+ */
+extern int shad_ctx_init(struct _shad_ctx* ctx, enum _shad_algo algo);
+
+/**
+ * \brief Update a SHA context with some data. The whole blocks are hashed
+ * directly from the data buffer, only a trailing partial block is copied into
+ * the context.
+ * \param desc a SHA driver descriptor
+ * \param ctx the SHA context
+ * \param data data to process
+ * \param len size of the data
+ * \return 0 on success, -EAGAIN if the driver is busy
+ */
+extern int shad_ctx_update(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			   const uint8_t* data, uint32_t len);
+
+/**
+ * \brief Finish the computation of a SHA context and get resulting digest.
+ * The context shall be initialized again before being reused.
+ * \param desc a SHA driver descriptor
+ * \param ctx the SHA context
+ * \param digest data buffer to store the resulting digest
+ * \return 0 on success, <0 on error
+ */
+extern int shad_ctx_finish(struct _shad_desc* desc, struct _shad_ctx* ctx,
+			   struct _buffer* digest);
+
+/**
+ * \brief Initialize a HMAC context with its key. A copy of the initialized
+ * context can be kept to authenticate several messages without hashing the
+ * key again.
+ * \param desc a SHA driver descriptor
+ * \param ctx the HMAC context
+ * \param algo SHA algorithm: ALGO_SHA_1 or ALGO_SHA_256
+ * \param key the key
+ * \param key_len size of the key
+ * \return 0 on success, <0 on error
+ */
+extern int shad_hmac_init(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+			  enum _shad_algo algo, const uint8_t* key, uint32_t key_len);
+
+/**
+ * \brief Update a HMAC context with some data.
+ * \return 0 on success, -EAGAIN if the driver is busy
+ */
+extern int shad_hmac_update(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+			    const uint8_t* data, uint32_t len);
+
+/**
+ * \brief Finish the computation of a HMAC context and get the resulting MAC.
+ * \param mac data buffer to store the MAC, possibly truncated to mac->size
+ * bytes
+ * \return 0 on success, <0 on error
+ */
+extern int shad_hmac_finish(struct _shad_desc* desc, struct _shad_hmac_ctx* ctx,
+			    struct _buffer* mac);
+
+/**
+ * \brief Queue jobs, each computing the digest of a whole message. The jobs
+ * are processed in order, each one starting from the callback of the
+ * previous one, so that the peripheral does not wait for the application.
+ * Jobs may be submitted while the queue is running, including from a job
+ * callback. shad_wait_completion() waits for the queue to drain.
+ * desc->cfg.algo is restored once the queue drains; a computation started
+ * with shad_start() shall be started again after the queue has run.
+ * \param desc a SHA driver descriptor
+ * \param jobs array of jobs to append to the queue
+ * \param count number of jobs in the array
+ * \return 0 on success, <0 on error
+ * \note When using DMA, the message buffers must be aligned to a cache line.
+ * Jobs and buffers shall remain untouched until the callback of the job has
+ * been invoked.
+ */
+extern int shad_submit(struct _shad_desc* desc, struct _shad_job* jobs, uint32_t count);
+
 #endif /* SHAD_H */
@@ -41,10 +41,20 @@
 #include "crypto/tdesd.h"
 #include "dma/dma.h"
 #include "irq/irq.h"
+#include "irqflags.h"
 #include "mm/cache.h"
 #include "peripherals/pmc.h"
 #include "trace.h"
 
+/*----------------------------------------------------------------------------
+ *        Local constants
+ *----------------------------------------------------------------------------*/
+
+#ifndef TDESD_QUEUE_BATCH_MAX
+/** Maximum number of queued jobs chained into a single DMA transfer */
+#define TDESD_QUEUE_BATCH_MAX 8
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -124,7 +134,8 @@ static void _tdesd_transfer_buffer_dma(struct _tdesd_desc* desc)
 	tdesd_wait_transfer(desc);
 }
 
-static void _tdesd_transfer_buffer_polling(struct _tdesd_desc* desc)
+static void _tdesd_process_polling(struct _tdesd_desc* desc,
+		struct _buffer* bufin, struct _buffer* bufout)
 {
 	uint32_t i;
 	uint8_t size = 8;
@@ -139,14 +150,14 @@ static void _tdesd_transfer_buffer_polling(struct _tdesd_desc* desc)
 	}
 
 	/* Iterate per 64-bit data block */
-	for (i = 0; i < desc->xfer.bufin->size; i+= size) {
+	for (i = 0; i < bufin->size; i+= size) {
 		/* Write one 64/32-bit input data block to the authorized
 		Input Data Registers */
 		if (size == 8)
-			tdes_set_input((uint32_t *)((desc->xfer.bufin->data) + i),
-							(uint32_t *)((desc->xfer.bufin->data) + i + 4));
+			tdes_set_input((uint32_t *)((bufin->data) + i),
+							(uint32_t *)((bufin->data) + i + 4));
 		else
-			tdes_set_input((uint32_t *)((desc->xfer.bufin->data) + i), NULL);
+			tdes_set_input((uint32_t *)((bufin->data) + i), NULL);
 
 		if (desc->cfg.transfer_mode == TDES_MR_SMOD_MANUAL_START)
 			/* Set the START bit in the TDES Control
@@ -157,15 +168,208 @@ static void _tdesd_transfer_buffer_polling(struct _tdesd_desc* desc)
 		while ((tdes_get_status() & TDES_ISR_DATRDY) != TDES_ISR_DATRDY);
 
 		if (size == 8)
-			tdes_get_output((uint32_t *)((desc->xfer.bufout->data) + i),
-							(uint32_t *)((desc->xfer.bufout->data) + i + 4));
+			tdes_get_output((uint32_t *)((bufout->data) + i),
+							(uint32_t *)((bufout->data) + i + 4));
 		else
-			tdes_get_output((uint32_t *)((desc->xfer.bufout->data) + i), NULL);
+			tdes_get_output((uint32_t *)((bufout->data) + i), NULL);
 	}
+}
+
+static void _tdesd_transfer_buffer_polling(struct _tdesd_desc* desc)
+{
+	_tdesd_process_polling(desc, desc->xfer.bufin, desc->xfer.bufout);
 	mutex_unlock(&desc->mutex);
 	callback_call(&desc->xfer.callback, NULL);
 }
 
+/* Load the context of a queued job in the peripheral, unless it is loaded
+ * already, then its IV if any. */
+static void _tdesd_queue_load(struct _tdesd_desc* desc, const struct _tdesd_job* job)
+{
+	const struct _tdesd_ctx* ctx = job->ctx;
+
+	if (ctx != desc->queue.ctx) {
+		desc->cfg.encrypt = ctx->encrypt;
+		desc->cfg.algo = ctx->algo;
+		desc->cfg.mode = ctx->mode;
+		desc->cfg.key_mode = ctx->key_mode;
+		desc->cfg.cfbs = ctx->cfbs;
+		memcpy(desc->cfg.key, ctx->key, sizeof(desc->cfg.key));
+		if (job->vector)
+			memcpy(desc->cfg.vector, job->vector, sizeof(desc->cfg.vector));
+		tdesd_configure_mode(desc);
+		desc->queue.ctx = ctx;
+	} else if (job->vector) {
+		tdes_set_vector(job->vector[0], job->vector[1]);
+	}
+}
+
+/* Save the configuration of the descriptor, that the jobs overwrite */
+static void _tdesd_queue_save_cfg(struct _tdesd_desc* desc)
+{
+	desc->queue.saved.ctx.encrypt = desc->cfg.encrypt;
+	desc->queue.saved.ctx.algo = desc->cfg.algo;
+	desc->queue.saved.ctx.mode = desc->cfg.mode;
+	desc->queue.saved.ctx.key_mode = desc->cfg.key_mode;
+	desc->queue.saved.ctx.cfbs = desc->cfg.cfbs;
+	memcpy(desc->queue.saved.ctx.key, desc->cfg.key, sizeof(desc->cfg.key));
+	memcpy(desc->queue.saved.vector, desc->cfg.vector, sizeof(desc->cfg.vector));
+}
+
+/* Restore the configuration of the descriptor. The peripheral is only
+ * configured with it by the next transfer, out of the DMA interrupt. */
+static void _tdesd_queue_restore_cfg(struct _tdesd_desc* desc)
+{
+	desc->cfg.encrypt = desc->queue.saved.ctx.encrypt;
+	desc->cfg.algo = desc->queue.saved.ctx.algo;
+	desc->cfg.mode = desc->queue.saved.ctx.mode;
+	desc->cfg.key_mode = desc->queue.saved.ctx.key_mode;
+	desc->cfg.cfbs = desc->queue.saved.ctx.cfbs;
+	memcpy(desc->cfg.key, desc->queue.saved.ctx.key, sizeof(desc->cfg.key));
+	memcpy(desc->cfg.vector, desc->queue.saved.vector, sizeof(desc->cfg.vector));
+	desc->queue.reload = true;
+}
+
+/* Remove the jobs up to last from the queue. Return true if jobs remain,
+ * restore the configuration and release the driver otherwise. */
+static bool _tdesd_queue_pop(struct _tdesd_desc* desc, struct _tdesd_job* last)
+{
+	uint32_t flags;
+	bool more;
+
+	flags = arch_irq_save();
+	desc->queue.head = last->next;
+	more = desc->queue.head != NULL;
+	if (!more) {
+		desc->queue.tail = NULL;
+		desc->queue.ctx = NULL;
+		_tdesd_queue_restore_cfg(desc);
+		mutex_unlock(&desc->mutex);
+	}
+	arch_irq_restore(flags);
+	return more;
+}
+
+static void _tdesd_queue_start_dma(struct _tdesd_desc* desc);
+
+/* Configure both DMA channels for a batch of count jobs */
+static int _tdesd_queue_configure_dma(struct _tdesd_desc* desc,
+				    struct _dma_cfg* cfg_dma,
+				    struct _dma_transfer_cfg* tx,
+				    struct _dma_transfer_cfg* rx, uint8_t count)
+{
+	int err;
+
+	cfg_dma->incr_saddr = true;
+	cfg_dma->incr_daddr = false;
+	err = dma_configure_transfer(desc->xfer.dma.tx.channel, cfg_dma, tx, count);
+	if (err < 0)
+		return err;
+
+	cfg_dma->incr_saddr = false;
+	cfg_dma->incr_daddr = true;
+	return dma_configure_transfer(desc->xfer.dma.rx.channel, cfg_dma, rx, count);
+}
+
+static int _tdesd_queue_dma_callback(void* arg, void* arg2)
+{
+	struct _tdesd_desc* desc = (struct _tdesd_desc*)arg;
+	struct _tdesd_job *job, *next, *last = desc->queue.batch_last;
+
+	dma_reset_channel(desc->xfer.dma.tx.channel);
+	dma_reset_channel(desc->xfer.dma.rx.channel);
+
+	job = desc->queue.head;
+	for (next = job; ; next = next->next) {
+		cache_invalidate_region((uint32_t*)next->bufout->data,
+					next->bufout->size);
+		if (next == last)
+			break;
+	}
+
+	/* Keep the peripheral busy while the callbacks run */
+	if (_tdesd_queue_pop(desc, last))
+		_tdesd_queue_start_dma(desc);
+
+	for (;; job = next) {
+		next = job->next;
+		callback_call(&job->callback, job);
+		if (job == last)
+			break;
+	}
+	return 0;
+}
+
+/* Start a DMA transfer for the job at the head of the queue, chained with the
+ * following jobs of the same context that do not load an IV. */
+static void _tdesd_queue_start_dma(struct _tdesd_desc* desc)
+{
+	struct _tdesd_job* job = desc->queue.head;
+	struct _dma_transfer_cfg tx[TDESD_QUEUE_BATCH_MAX];
+	struct _dma_transfer_cfg rx[TDESD_QUEUE_BATCH_MAX];
+	struct _dma_cfg cfg_dma;
+	struct _callback _cb;
+	uint8_t count = 0, width;
+	int err;
+
+	_tdesd_queue_load(desc, job);
+
+	memset(&cfg_dma, 0, sizeof(cfg_dma));
+	cfg_dma.data_width = _tdesd_get_dma_data_width(desc);
+	cfg_dma.chunk_size = DMA_CHUNK_SIZE_1;
+	width = DMA_DATA_WIDTH_IN_BYTE(cfg_dma.data_width);
+
+	for (;;) {
+		cache_clean_region((uint32_t*)job->bufin->data, job->bufin->size);
+
+		memset(&tx[count], 0, sizeof(tx[count]));
+		tx[count].saddr = (void*)job->bufin->data;
+		tx[count].daddr = (void*)TDES->TDES_IDATAR;
+		tx[count].len = job->bufin->size / width;
+
+		memset(&rx[count], 0, sizeof(rx[count]));
+		rx[count].saddr = (void*)TDES->TDES_ODATAR;
+		rx[count].daddr = (void*)job->bufout->data;
+		rx[count].len = job->bufout->size / width;
+
+		desc->queue.batch_last = job;
+		count++;
+		job = job->next;
+		if (!job || count == TDESD_QUEUE_BATCH_MAX
+		    || job->ctx != desc->queue.ctx || job->vector)
+			break;
+	}
+
+	err = _tdesd_queue_configure_dma(desc, &cfg_dma, tx, rx, count);
+	if (err < 0 && count > 1) {
+		/* No linked list items left in the DMA pool: transfer the
+		 * first job alone, which needs none */
+		desc->queue.batch_last = desc->queue.head;
+		err = _tdesd_queue_configure_dma(desc, &cfg_dma, tx, rx, 1);
+	}
+	assert(err == 0);
+	dma_set_callback(desc->xfer.dma.tx.channel, NULL);
+	callback_set(&_cb, _tdesd_queue_dma_callback, (void*)desc);
+	dma_set_callback(desc->xfer.dma.rx.channel, &_cb);
+
+	dma_start_transfer(desc->xfer.dma.tx.channel);
+	dma_start_transfer(desc->xfer.dma.rx.channel);
+}
+
+static void _tdesd_queue_run_polling(struct _tdesd_desc* desc)
+{
+	struct _tdesd_job* job;
+	bool more;
+
+	do {
+		job = desc->queue.head;
+		_tdesd_queue_load(desc, job);
+		_tdesd_process_polling(desc, job->bufin, job->bufout);
+		more = _tdesd_queue_pop(desc, job);
+		callback_call(&job->callback, job);
+	} while (more);
+}
+
 /*----------------------------------------------------------------------------
  *        Public functions
  *----------------------------------------------------------------------------*/
@@ -185,6 +389,10 @@ uint32_t tdesd_transfer(struct _tdesd_desc* desc, struct _buffer* buffer_in,
 		return ADES_ERROR_LOCK;
 	}
 
+	/* Load the configuration again after a queue of jobs */
+	if (desc->queue.reload)
+		tdesd_configure_mode(desc);
+
 	switch (desc->cfg.transfer_mode) {
 	case TDESD_TRANS_POLLING_MANUAL:
 	case TDESD_TRANS_POLLING_AUTO:
@@ -221,6 +429,8 @@ void tdesd_init(struct _tdesd_desc* desc)
 	/* Enable peripheral clock */
 	pmc_configure_peripheral(ID_TDES, NULL, true);
 
+	memset(&desc->queue, 0, sizeof(desc->queue));
+
 	/* Allocate one DMA channel for writing message blocks to TDESx`_IDATAR */
 	desc->xfer.dma.tx.channel = dma_allocate_channel(DMA_PERIPH_MEMORY, ID_TDES);
 	assert(desc->xfer.dma.tx.channel);
@@ -232,6 +442,8 @@ void tdesd_init(struct _tdesd_desc* desc)
 
 void tdesd_configure_mode(struct _tdesd_desc* desc)
 {
+	desc->queue.reload = false;
+
 	/* Perform a software-triggered hardware reset of the TDES interface */
 	tdes_soft_reset();
 
@@ -257,3 +469,40 @@ void tdesd_configure_mode(struct _tdesd_desc* desc)
 	if (desc->cfg.algo == TDESD_ALGO_XTEA)
 		tdes_set_xtea_rounds(32);
 }
+
+uint32_t tdesd_submit(struct _tdesd_desc* desc,
+		      struct _tdesd_job* jobs, uint32_t count)
+{
+	uint32_t i, flags;
+
+	if (count == 0)
+		return TDESD_SUCCESS;
+
+	for (i = 0; i < count; i++)
+		jobs[i].next = (i + 1 < count) ? &jobs[i + 1] : NULL;
+
+	flags = arch_irq_save();
+	if (desc->queue.head) {
+		/* Queue running, append the jobs */
+		desc->queue.tail->next = jobs;
+		desc->queue.tail = &jobs[count - 1];
+		arch_irq_restore(flags);
+		return TDESD_SUCCESS;
+	}
+	if (!mutex_try_lock(&desc->mutex)) {
+		arch_irq_restore(flags);
+		trace_error("TDESD mutex already locked!\r\n");
+		return ADES_ERROR_LOCK;
+	}
+	desc->queue.head = jobs;
+	desc->queue.tail = &jobs[count - 1];
+	arch_irq_restore(flags);
+
+	_tdesd_queue_save_cfg(desc);
+	if (desc->cfg.transfer_mode == TDESD_TRANS_DMA)
+		_tdesd_queue_start_dma(desc);
+	else
+		_tdesd_queue_run_polling(desc);
+
+	return TDESD_SUCCESS;
+}
@@ -82,6 +82,29 @@ enum _tdesd_cipher_size {
 	TDESD_CFBS_8
 };
 
+/** Key context of the jobs processed by tdesd_submit() */
+struct _tdesd_ctx {
+	bool encrypt;
+	enum _tdesd_algo algo;
+	enum _tdesd_mode mode;
+	enum _tdesd_key_mode key_mode;
+	enum _tdesd_cipher_size cfbs;
+	uint32_t key[6];
+};
+
+/** Job processed by tdesd_submit() */
+struct _tdesd_job {
+	const struct _tdesd_ctx *ctx;  /*< key context */
+	const uint32_t *vector;        /*< IV to load before the job, or NULL to
+	                                   chain with the previous job */
+	struct _buffer *bufin;         /*< buffer input */
+	struct _buffer *bufout;        /*< buffer output */
+	struct _callback callback;     /*< called with the job as 2nd argument */
+
+	/* following fields are used internally */
+	struct _tdesd_job *next;
+};
+
 struct _tdesd_desc {
 	/* structure to define TDES parameter */
 
@@ -110,6 +133,22 @@ struct _tdesd_desc {
 			} rx, tx;
 		} dma;
 	} xfer;
+
+	/* structure to hold the jobs queued by tdesd_submit() */
+	struct {
+		struct _tdesd_job *head;       /*< job being processed */
+		struct _tdesd_job *tail;       /*< last job queued */
+		struct _tdesd_job *batch_last; /*< last job of the DMA batch */
+		const struct _tdesd_ctx *ctx;  /*< context loaded in the peripheral */
+		bool reload;                   /*< peripheral to configure with cfg
+		                                   before the next transfer */
+
+		/* cfg of the descriptor, restored when the queue drains */
+		struct {
+			struct _tdesd_ctx ctx;
+			uint32_t vector[2];
+		} saved;
+	} queue;
 };
 
 /*------------------------------------------------------------------------------
@@ -128,4 +167,20 @@ extern void tdesd_wait_transfer(struct _tdesd_desc* desc);
 
 extern void tdesd_configure_mode(struct _tdesd_desc* desc);
 
+/**
+ * \brief Queue jobs for processing, see aesd_submit(). The key is only
+ * reloaded when the context differs from the one of the previous job, and the
+ * IV when job->vector is set. In DMA mode, consecutive jobs sharing the same
+ * context and not loading an IV are chained into a single DMA transfer.
+ * desc->cfg is left untouched: once the queue drains, the peripheral is
+ * configured again with it by the next tdesd_transfer(), as by
+ * tdesd_configure_mode().
+ * \param jobs   Array of jobs to append to the queue.
+ * \param count  Number of jobs in the array.
+ * \return TDESD_SUCCESS, or ADES_ERROR_LOCK if tdesd_transfer() is in
+ * progress.
+ */
+extern uint32_t tdesd_submit(struct _tdesd_desc* desc,
+			     struct _tdesd_job* jobs, uint32_t count);
+
 #endif /* TDESD_H */
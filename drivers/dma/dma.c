@@ -45,8 +45,10 @@
 #include "callback.h"
 #include "compiler.h"
 #include "dma/dma.h"
+#include "dma/dma_plan.h"
 #include "irq/irq.h"
 #include "errno.h"
+#include "intmath.h"
 #include "mm/cache.h"
 #include "mutex.h"
 #include "peripherals/pmc.h"
@@ -78,6 +80,13 @@
 #define DMA_DESC_SET_DADDR(d, addr) (d)->daddr = (void*)(addr)
 #endif
 
+/** Number of slabs in the pool of linked list items */
+#define DMA_SG_SLABS (DMA_SG_ITEM_POOL_SIZE / DMA_SG_SLAB_SIZE)
+
+#if (DMA_SG_ITEM_POOL_SIZE % DMA_SG_SLAB_SIZE) != 0
+#error "DMA_SG_ITEM_POOL_SIZE shall be a multiple of DMA_SG_SLAB_SIZE"
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local constants
  *----------------------------------------------------------------------------*/
@@ -117,16 +126,29 @@ struct _dma_sg_desc {
 #endif
 };
 
+/** Pool of linked list items, allocated by slabs of DMA_SG_SLAB_SIZE
+ * contiguous items. The slabs of a list are chained through 'next', as are
+ * the free slabs of the pool and of each channel reserve, so that a list is
+ * allocated by unlinking as many slabs as needed from the head of a free list,
+ * and freed by linking them back at once.
+ * A channel holds a single list at a time: single-item lists use the item
+ * of their channel in 'single', and never take a slab. */
 struct _dma_sg_pool {
 	struct _dma_sg_desc desc[DMA_SG_ITEM_POOL_SIZE];
-	struct _dma_sg_desc* head;
-	struct _dma_sg_desc* tail;
-
-	uint16_t count; /* Count elements in list  */
+	struct _dma_sg_desc single[DMA_CONTROLLERS][DMA_CHANNELS];
+	uint16_t next[DMA_SG_SLABS];   /* Next slab, or DMA_SG_SLAB_NONE */
+	uint16_t last[DMA_SG_SLABS];   /* Last slab of the list (list heads) */
+	uint16_t length[DMA_SG_SLABS]; /* Slabs in the list (list heads) */
+
+	uint16_t head;     /* First free slab */
+	uint16_t count;    /* Count free slabs */
+	uint16_t reserved; /* Count free slabs in the reserves of channels */
+	uint16_t used;     /* Count slabs of allocated lists */
+	uint16_t high_watermark;
+	uint32_t failures;
 	mutex_t mutex;
 };
 
-
 /** DMA driver instance */
 struct _dma_ctrl {
 	struct _dma_controller controllers[DMA_CONTROLLERS];
@@ -157,7 +179,7 @@ static inline bool is_dest_periph(struct _dma_channel* channel)
 }
 
 /**
- * \brief Preinitialize all descriptors and pool and link them together
+ * \brief Preinitialize the pool and link all slabs together
  */
 static void _dma_sg_init(void)
 {
@@ -167,77 +189,344 @@ static void _dma_sg_init(void)
 
 	mutex_lock(&_dma_sg_pool.mutex);
 
-	for (i = 0; i < ARRAY_SIZE(_dma_sg_pool.desc); i++)
-		DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i], &_dma_sg_pool.desc[i + 1]);
-	DMA_SG_DESC_SET_NEXT(&_dma_sg_pool.desc[i - 1], 0);
+	for (i = 0; i < DMA_SG_SLABS; i++)
+		_dma_sg_pool.next[i] = i + 1;
+	_dma_sg_pool.next[i - 1] = DMA_SG_SLAB_NONE;
 
-	_dma_sg_pool.head = _dma_sg_pool.desc;
-	_dma_sg_pool.tail = &_dma_sg_pool.desc[i - 1];
-	_dma_sg_pool.count = ARRAY_SIZE(_dma_sg_pool.desc);
+	_dma_sg_pool.head = 0;
+	_dma_sg_pool.count = DMA_SG_SLABS;
 
 	mutex_unlock(&_dma_sg_pool.mutex);
 }
 
-static struct _dma_sg_desc* _dma_sg_desc_alloc(uint8_t count)
+/**
+ * \brief Get the item used by the single-item lists of a channel.
+ */
+static struct _dma_sg_desc* _dma_sg_single(struct _dma_channel* channel)
+{
+	uint32_t ctrl;
+
+	for (ctrl = 0; ctrl < DMA_CONTROLLERS - 1; ctrl++)
+		if (channel->hw == _dma_ctrl.controllers[ctrl].hw)
+			break;
+	return &_dma_sg_pool.single[ctrl][channel->id];
+}
+
+/**
+ * \brief Check whether a linked list was allocated from the slabs.
+ */
+static inline bool _dma_sg_in_slabs(struct _dma_sg_desc* list_head)
+{
+	return list_head >= _dma_sg_pool.desc
+	    && list_head < &_dma_sg_pool.desc[DMA_SG_ITEM_POOL_SIZE];
+}
+
+/**
+ * \brief Unlink the first count slabs of a free list, and chain them as a list.
+ * The caller shall hold the pool mutex and check that the free list holds
+ * enough slabs.
+ * \return Index of the first slab of the list.
+ */
+static uint16_t _dma_sg_slab_pop(uint16_t* head, uint16_t* free_count,
+				 uint16_t count)
+{
+	uint16_t first = *head;
+	uint16_t last = first;
+	uint16_t i;
+
+	for (i = 1; i < count; i++)
+		last = _dma_sg_pool.next[last];
+	*head = _dma_sg_pool.next[last];
+	*free_count -= count;
+
+	_dma_sg_pool.next[last] = DMA_SG_SLAB_NONE;
+	_dma_sg_pool.last[first] = last;
+	_dma_sg_pool.length[first] = count;
+	return first;
+}
+
+/**
+ * \brief Link back a list of slabs, obtained from _dma_sg_slab_pop(), at the
+ * head of a free list. The caller shall hold the pool mutex.
+ */
+static void _dma_sg_slab_push(uint16_t* head, uint16_t* free_count,
+			      uint16_t first)
+{
+	_dma_sg_pool.next[_dma_sg_pool.last[first]] = *head;
+	*head = first;
+	*free_count += _dma_sg_pool.length[first];
+}
+
+/**
+ * \brief Allocate a linked list of count items, from the reserve of the
+ * channel if it is large enough, or from the shared pool otherwise.
+ * A single item is the item of the channel, and is always available.
+ * The mutex is held for a constant time when the list fits in a single slab,
+ * the items are chained once it is released.
+ * \return Head of the list, or NULL if not enough items are available.
+ */
+static struct _dma_sg_desc* _dma_sg_desc_alloc(struct _dma_channel* channel,
+					       uint32_t count)
 {
-	struct _dma_sg_desc* list_head;
 	struct _dma_sg_desc* curr;
-	struct _dma_sg_desc* next;
-	uint8_t i;
+	uint16_t slabs, first, slab;
+	uint32_t i;
 
 	if (count == 0)
 		return NULL;
-	if (count > _dma_sg_pool.count)
-		return NULL;
+	if (count == 1) {
+		curr = _dma_sg_single(channel);
+		DMA_SG_DESC_SET_NEXT(curr, 0);
+		return curr;
+	}
+	/* Longer lists cannot be allocated, but are counted as failures */
+	count = min_u32(count, DMA_SG_ITEM_POOL_SIZE + 1);
+	slabs = CEIL_INT_DIV(count, DMA_SG_SLAB_SIZE);
 
 	mutex_lock(&_dma_sg_pool.mutex);
 
-	list_head = _dma_sg_pool.head;
-	curr = list_head;
-	for (i = 0; i < (count - 1); i++) {
-		curr = DMA_SG_DESC_GET_NEXT(curr);
+	if (channel->sg_reserve_count >= slabs) {
+		first = _dma_sg_slab_pop(&channel->sg_reserve,
+					 &channel->sg_reserve_count, slabs);
+		_dma_sg_pool.reserved -= slabs;
+	} else if (_dma_sg_pool.count >= slabs) {
+		first = _dma_sg_slab_pop(&_dma_sg_pool.head,
+					 &_dma_sg_pool.count, slabs);
+	} else {
+		_dma_sg_pool.failures++;
+		mutex_unlock(&_dma_sg_pool.mutex);
+		return NULL;
+	}
+	_dma_sg_pool.used += slabs;
+	if (_dma_sg_pool.used > _dma_sg_pool.high_watermark)
+		_dma_sg_pool.high_watermark = _dma_sg_pool.used;
+
+	mutex_unlock(&_dma_sg_pool.mutex);
+
+	/* Chain the items of the allocated slabs */
+	slab = first;
+	curr = &_dma_sg_pool.desc[slab * DMA_SG_SLAB_SIZE];
+	for (i = 1; i < count; i++) {
+		struct _dma_sg_desc* next;
+		if ((i % DMA_SG_SLAB_SIZE) == 0) {
+			slab = _dma_sg_pool.next[slab];
+			next = &_dma_sg_pool.desc[slab * DMA_SG_SLAB_SIZE];
+		} else {
+			next = curr + 1;
+		}
+		DMA_SG_DESC_SET_NEXT(curr, next);
+		curr = next;
 	}
-		next = DMA_SG_DESC_GET_NEXT(curr);
 	DMA_SG_DESC_SET_NEXT(curr, 0);
 
-	_dma_sg_pool.count -= count;
-	_dma_sg_pool.head = next;
+	return &_dma_sg_pool.desc[first * DMA_SG_SLAB_SIZE];
+}
+
+/**
+ * \brief Free a linked list allocated by _dma_sg_desc_alloc(), in constant
+ * time. Its slabs return to the reserve of the channel as long as it is not
+ * full, and to the shared pool otherwise.
+ */
+static void _dma_sg_desc_free(struct _dma_channel* channel,
+			      struct _dma_sg_desc* list_head)
+{
+	uint16_t first;
+
+	if (list_head == NULL || !_dma_sg_in_slabs(list_head))
+		return;
+
+	first = (list_head - _dma_sg_pool.desc) / DMA_SG_SLAB_SIZE;
+	assert(list_head == &_dma_sg_pool.desc[first * DMA_SG_SLAB_SIZE]);
+
+	mutex_lock(&_dma_sg_pool.mutex);
 
-	if (_dma_sg_pool.count == 0) {
-		_dma_sg_pool.head = NULL;
-		_dma_sg_pool.tail = NULL;
+	_dma_sg_pool.used -= _dma_sg_pool.length[first];
+	if (channel->sg_reserve_count + _dma_sg_pool.length[first]
+	    <= channel->sg_reserve_size) {
+		_dma_sg_slab_push(&channel->sg_reserve,
+				  &channel->sg_reserve_count, first);
+		_dma_sg_pool.reserved += _dma_sg_pool.length[first];
+	} else {
+		_dma_sg_slab_push(&_dma_sg_pool.head, &_dma_sg_pool.count,
+				  first);
 	}
 
 	mutex_unlock(&_dma_sg_pool.mutex);
-
-	return list_head;
 }
 
-static void _dma_sg_desc_free(struct _dma_sg_desc* list_head)
+/**
+ * \brief Clean the data cache lines of the slabs of a linked list, so that the
+ * DMA controller fetches the items from RAM.
+ */
+static void _dma_sg_desc_clean(struct _dma_sg_desc* list_head)
 {
-	struct _dma_sg_desc* curr = list_head;
-	struct _dma_sg_desc* tail;
+	uint16_t slab, count;
 
-	if (list_head == NULL)
+	if (!_dma_sg_in_slabs(list_head)) {
+		cache_clean_region(list_head, sizeof(*list_head));
 		return;
+	}
 
-	do {
-		tail = curr;
-		curr = DMA_SG_DESC_GET_NEXT(curr);
-	} while ((curr != NULL) && (curr != list_head));
-	curr = list_head;
+	slab = (list_head - _dma_sg_pool.desc) / DMA_SG_SLAB_SIZE;
+	count = _dma_sg_pool.length[slab];
+	for (; count > 0; count--) {
+		cache_clean_region(&_dma_sg_pool.desc[slab * DMA_SG_SLAB_SIZE],
+				   DMA_SG_SLAB_SIZE * sizeof(struct _dma_sg_desc));
+		slab = _dma_sg_pool.next[slab];
+	}
+}
 
-	mutex_lock(&_dma_sg_pool.mutex);
+/**
+ * \brief Fill a linked list item with the given addresses and length, and the
+ * channel configuration.
+ */
+static void _dma_sg_desc_setup(struct _dma_sg_desc* desc,
+			       struct _dma_cfg* cfg_dma,
+			       bool src_is_periph, bool dst_is_periph,
+			       const void* saddr, void* daddr, uint32_t len)
+{
+	DMA_SG_DESC_SET_SADDR(desc, saddr);
+	DMA_SG_DESC_SET_DADDR(desc, daddr);
 
-	if (_dma_sg_pool.head == NULL)
-		_dma_sg_pool.head = list_head;
+#if defined(CONFIG_HAVE_XDMAC)
+	desc->desc.mbr_ubc = XDMA_UBC_NVIEW_NDV1
+		| XDMA_UBC_NSEN_UPDATED
+		| XDMA_UBC_NDEN_UPDATED
+		| XDMA_UBC_NDE_FETCH_EN
+		| XDMA_UBC_UBLEN(len);
+#elif defined(CONFIG_HAVE_DMAC)
+	desc->desc.ctrla = (cfg_dma->data_width << DMAC_CTRLA_SRC_WIDTH_Pos)
+		| (cfg_dma->data_width << DMAC_CTRLA_DST_WIDTH_Pos)
+		| (cfg_dma->chunk_size << DMAC_CTRLA_SCSIZE_Pos)
+		| (cfg_dma->chunk_size << DMAC_CTRLA_DCSIZE_Pos)
+		| DMAC_CTRLA_BTSIZE(len);
 
-	if (_dma_sg_pool.tail != NULL)
-		DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, list_head);
-	_dma_sg_pool.tail = tail;
-	DMA_SG_DESC_SET_NEXT(_dma_sg_pool.tail, 0);
+#if defined(CONFIG_SOC_SAMA5D3)
+	desc->desc.ctrlb = src_is_periph ? DMAC_CTRLB_SIF_AHB_IF2 : DMAC_CTRLB_SIF_AHB_IF0;
+	desc->desc.ctrlb |= dst_is_periph ? DMAC_CTRLB_DIF_AHB_IF2 : DMAC_CTRLB_DIF_AHB_IF0;
+#elif defined(CONFIG_SOC_SAM9XX5)
+	desc->desc.ctrlb = src_is_periph ? DMAC_CTRLB_SIF_AHB_IF1 : DMAC_CTRLB_SIF_AHB_IF0;
+	desc->desc.ctrlb |= dst_is_periph ? DMAC_CTRLB_DIF_AHB_IF1 : DMAC_CTRLB_DIF_AHB_IF0;
+#endif
+	if (src_is_periph)
+		desc->desc.ctrlb |= DMAC_CTRLB_FC_PER2MEM_DMA_FC;
+	else if (dst_is_periph)
+		desc->desc.ctrlb |= DMAC_CTRLB_FC_MEM2PER_DMA_FC;
+	else
+		desc->desc.ctrlb |= DMAC_CTRLB_FC_MEM2MEM_DMA_FC;
 
-	mutex_unlock(&_dma_sg_pool.mutex);
+	desc->desc.ctrlb |= cfg_dma->incr_saddr ? DMAC_CTRLB_SRC_INCR_INCREMENTING : DMAC_CTRLB_SRC_INCR_FIXED;
+	desc->desc.ctrlb |= cfg_dma->incr_daddr ? DMAC_CTRLB_DST_INCR_INCREMENTING : DMAC_CTRLB_DST_INCR_FIXED;
+
+	desc->desc.ctrlb |= DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM;
+#endif
+}
+
+/**
+ * \brief Configure the channel to run the linked list starting at sg_head.
+ * \param blocks  Number of microblocks of each descriptor (XDMAC only, each
+ * DMAC descriptor is a single buffer).
+ */
+static int _dma_sg_start(struct _dma_channel* channel,
+			 struct _dma_cfg* cfg_dma,
+			 struct _dma_sg_desc* sg_head, uint32_t blocks)
+{
+	bool src_is_periph, dst_is_periph;
+
+	src_is_periph = is_source_periph(channel);
+	dst_is_periph = is_dest_periph(channel);
+
+	_dma_sg_desc_clean(sg_head);
+
+	/* Update configuration */
+#if defined(CONFIG_HAVE_XDMAC)
+	struct _xdmacd_cfg xdmacd_cfg;
+	uint32_t desc_ctrl;
+
+	xdmacd_cfg.cfg = (src_is_periph | dst_is_periph) ? XDMAC_CC_TYPE_PER_TRAN : XDMAC_CC_TYPE_MEM_TRAN;
+	xdmacd_cfg.cfg |= src_is_periph ? XDMAC_CC_DSYNC_PER2MEM : XDMAC_CC_DSYNC_MEM2PER;
+	xdmacd_cfg.cfg |= XDMAC_CC_CSIZE(cfg_dma->chunk_size);
+	xdmacd_cfg.cfg |= XDMAC_CC_DWIDTH(cfg_dma->data_width);
+	xdmacd_cfg.cfg |= src_is_periph ? XDMAC_CC_SIF_AHB_IF1 : XDMAC_CC_SIF_AHB_IF0;
+	xdmacd_cfg.cfg |= dst_is_periph ? XDMAC_CC_DIF_AHB_IF1 : XDMAC_CC_DIF_AHB_IF0;
+	xdmacd_cfg.cfg |= cfg_dma->incr_saddr ? XDMAC_CC_SAM_INCREMENTED_AM : XDMAC_CC_SAM_FIXED_AM;
+	xdmacd_cfg.cfg |= cfg_dma->incr_daddr ? XDMAC_CC_DAM_INCREMENTED_AM : XDMAC_CC_DAM_FIXED_AM;
+	xdmacd_cfg.cfg |= (src_is_periph | dst_is_periph) ? 0 : XDMAC_CC_SWREQ_SWR_CONNECTED;
+	/* View 1 descriptors do not update the block control: all of them
+	 * use this one */
+	xdmacd_cfg.bc = blocks - 1;
+	xdmacd_cfg.ds = 0;
+	xdmacd_cfg.sus = 0;
+	xdmacd_cfg.dus = 0;
+
+	desc_ctrl = XDMAC_CNDC_NDVIEW_NDV1
+	           | XDMAC_CNDC_NDE_DSCR_FETCH_EN
+	           | XDMAC_CNDC_NDSUP_SRC_PARAMS_UPDATED
+	           | XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED;
+
+	return xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)sg_head);
+#elif defined(CONFIG_HAVE_DMAC)
+	struct _dmacd_cfg dmacd_cfg;
+
+	assert(blocks == 1);
+
+	dmacd_cfg.s_decr_fetch = 0;
+	dmacd_cfg.d_decr_fetch = 0;
+	dmacd_cfg.sa_rep = 0;
+	dmacd_cfg.da_rep = 0;
+	dmacd_cfg.trans_auto = 0;
+	dmacd_cfg.blocks = 0;
+	dmacd_cfg.s_pip = 0;
+	dmacd_cfg.d_pip = 0;
+	dmacd_cfg.cfg = src_is_periph ? DMAC_CFG_SRC_H2SEL_HW : 0;
+	dmacd_cfg.cfg |= dst_is_periph ? DMAC_CFG_DST_H2SEL_HW : 0;
+
+	return dmacd_configure_transfer(channel, &dmacd_cfg, (void*)sg_head);
+#endif
+}
+
+/**
+ * \brief Configure a transfer split as computed by dma_plan_transfer(), using
+ * a linked list of plan->desc_count descriptors.
+ */
+static int _dma_split_configure_transfer(struct _dma_channel* channel,
+					 struct _dma_cfg* cfg_dma,
+					 struct _dma_transfer_cfg* cfg,
+					 const struct _dma_plan* plan)
+{
+	struct _dma_sg_desc* _sg_head;
+	struct _dma_sg_desc* curr;
+	const uint8_t* saddr = cfg->saddr;
+	uint8_t* daddr = cfg->daddr;
+	bool src_is_periph, dst_is_periph;
+	uint32_t idx, ublen, size;
+
+	_sg_head = _dma_sg_desc_alloc(channel, plan->desc_count);
+	if (_sg_head == NULL)
+		return -ENOMEM;
+
+	src_is_periph = is_source_periph(channel);
+	dst_is_periph = is_dest_periph(channel);
+
+	for (idx = 0, curr = _sg_head; curr != NULL; idx++) {
+		ublen = plan->ublen + (idx < plan->longer ? 1 : 0);
+		_dma_sg_desc_setup(curr, cfg_dma, src_is_periph, dst_is_periph,
+				   saddr, daddr, ublen);
+#if defined(CONFIG_HAVE_XDMAC)
+		if (DMA_SG_DESC_GET_NEXT(curr) == 0)
+			curr->desc.mbr_ubc &= ~XDMA_UBC_NDE_FETCH_EN;
+#endif
+
+		size = ublen * plan->blocks * DMA_DATA_WIDTH_IN_BYTE(cfg_dma->data_width);
+		if (cfg_dma->incr_saddr)
+			saddr += size;
+		if (cfg_dma->incr_daddr)
+			daddr += size;
+		curr = DMA_SG_DESC_GET_NEXT(curr);
+	}
+	channel->sg_list = _sg_head;
+
+	return _dma_sg_start(channel, cfg_dma, _sg_head, plan->blocks);
 }
 
 static int _dma_configure_transfer(struct _dma_channel* channel,
@@ -245,7 +534,7 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 				   struct _dma_transfer_cfg *cfg)
 {
 	bool src_is_periph, dst_is_periph;
-	uint32_t divisor;
+	struct _dma_plan plan;
 
 #if defined(CONFIG_HAVE_XDMAC)
 	struct _xdmacd_cfg desc;
@@ -259,6 +548,15 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 	src_is_periph = is_source_periph(channel);
 	dst_is_periph = is_dest_periph(channel);
 
+#if defined(CONFIG_HAVE_DMAC)
+	dma_cfg.s_decr_fetch = 1;
+	dma_cfg.d_decr_fetch = 1;
+	dma_cfg.sa_rep = 0;
+	dma_cfg.da_rep = 0;
+	dma_cfg.trans_auto = 0;
+	dma_cfg.blocks = 0;
+#endif
+
 	if (cfg->len <= DMA_MAX_BT_SIZE) {
 		/* If len is <= 16,777,215, the driver will transfer a
 		   single block, those size will be len data elements. */
@@ -270,27 +568,29 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 #endif
 	} else {
 		/* If len exceeds 16,777,215, split the transfer in
-		   multiple blocks (microblocks), calculating and using the greatest block
-		   size possible for this transfer. */
-		for (divisor = DMA_MAX_BT_SIZE; divisor > 1; divisor--) {
-			if (cfg->len % divisor)
-				continue;
-			if ((cfg->len / divisor) <= DMA_MAX_BLOCK_LEN) {
+		   multiple blocks (microblocks), and use a linked list if
+		   they cannot all have the same size. */
+		dma_plan_transfer(cfg->len, DMA_MAX_BT_SIZE,
+				  DMA_MAX_BLOCK_LEN, &plan);
 #if defined(CONFIG_HAVE_XDMAC)
-				desc.ubc = divisor;
-				desc.bc = (cfg->len / divisor) - 1;
+		if (plan.desc_count > 1)
+			return _dma_split_configure_transfer(channel, cfg_dma,
+							     cfg, &plan);
+		desc.ubc = plan.ublen;
+		desc.bc = plan.blocks - 1;
 #elif defined(CONFIG_HAVE_DMAC)
-				desc.ctrla = divisor;
-				dma_cfg.blocks = (cfg->len / divisor) - 1;
-				dma_cfg.trans_auto = 1;
-				dma_cfg.sa_rep = src_is_periph ? 1 : 0 ;
-				dma_cfg.da_rep = dst_is_periph ? 1 : 0 ;
-#endif
-				break;
-			}
+		if (plan.desc_count > 1) {
+			/* Buffers of a linked list are not repeated */
+			dma_plan_transfer(cfg->len, DMA_MAX_BT_SIZE, 1, &plan);
+			return _dma_split_configure_transfer(channel, cfg_dma,
+							     cfg, &plan);
 		}
-		if (divisor == 1)
-			return -EINVAL;
+		desc.ctrla = plan.ublen;
+		dma_cfg.blocks = plan.blocks - 1;
+		dma_cfg.trans_auto = 1;
+		dma_cfg.sa_rep = src_is_periph ? 1 : 0 ;
+		dma_cfg.da_rep = dst_is_periph ? 1 : 0 ;
+#endif
 	}
 
 	DMA_DESC_SET_SADDR(&desc, cfg->saddr);
@@ -315,13 +615,6 @@ static int _dma_configure_transfer(struct _dma_channel* channel,
 
 	return xdmacd_configure_transfer(channel, &desc, 0, 0);
 #elif defined(CONFIG_HAVE_DMAC)
-	dma_cfg.s_decr_fetch = 1;
-	dma_cfg.d_decr_fetch = 1;
-	dma_cfg.sa_rep = 0;
-	dma_cfg.da_rep = 0;
-	dma_cfg.trans_auto = 0;
-	dma_cfg.blocks = 0;
-
 	dma_cfg.cfg = src_is_periph ? DMAC_CFG_SRC_H2SEL_HW : 0;
 	dma_cfg.cfg |= dst_is_periph ? DMAC_CFG_DST_H2SEL_HW : 0;
 
@@ -364,10 +657,7 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	if ((sg_list == NULL) || (sg_list_size == 0))
 		return -EINVAL;
 
-	src_is_periph = is_source_periph(channel);
-	dst_is_periph = is_dest_periph(channel);
-
-	_sg_head = _dma_sg_desc_alloc(sg_list_size);
+	_sg_head = _dma_sg_desc_alloc(channel, sg_list_size);
 	if (_sg_head == NULL)
 		return -ENOMEM;
 	curr = _sg_head;
@@ -379,47 +669,14 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	for (idx = 0; idx < sg_list_size; idx++) {
 		cfg = &sg_list[idx];
 
-		DMA_SG_DESC_SET_SADDR(curr, cfg->saddr);
-		DMA_SG_DESC_SET_DADDR(curr, cfg->daddr);
+		_dma_sg_desc_setup(curr, cfg_dma, src_is_periph, dst_is_periph,
+				   cfg->saddr, cfg->daddr, cfg->len);
 
 #if defined(CONFIG_HAVE_XDMAC)
-		curr->desc.mbr_ubc = XDMA_UBC_NVIEW_NDV1
-			| XDMA_UBC_NSEN_UPDATED
-			| XDMA_UBC_NDEN_UPDATED
-			| XDMA_UBC_NDE_FETCH_EN
-			| XDMA_UBC_UBLEN(cfg->len);
-
 		if (!cfg_dma->loop) {
 			if (DMA_SG_DESC_GET_NEXT(curr) == 0)
 				curr->desc.mbr_ubc &= ~XDMA_UBC_NDE_FETCH_EN;
 		}
-
-#elif defined(CONFIG_HAVE_DMAC)
-		curr->desc.ctrla = (cfg_dma->data_width << DMAC_CTRLA_SRC_WIDTH_Pos)
-			| (cfg_dma->data_width << DMAC_CTRLA_DST_WIDTH_Pos)
-			| (cfg_dma->chunk_size << DMAC_CTRLA_SCSIZE_Pos)
-			| (cfg_dma->chunk_size << DMAC_CTRLA_DCSIZE_Pos)
-			| DMAC_CTRLA_BTSIZE(cfg->len);
-
-#if defined(CONFIG_SOC_SAMA5D3)
-		curr->desc.ctrlb = src_is_periph ? DMAC_CTRLB_SIF_AHB_IF2 : DMAC_CTRLB_SIF_AHB_IF0;
-		curr->desc.ctrlb |= dst_is_periph ? DMAC_CTRLB_DIF_AHB_IF2 : DMAC_CTRLB_DIF_AHB_IF0;
-#elif defined(CONFIG_SOC_SAM9XX5)
-		curr->desc.ctrlb = src_is_periph ? DMAC_CTRLB_SIF_AHB_IF1 : DMAC_CTRLB_SIF_AHB_IF0;
-		curr->desc.ctrlb |= dst_is_periph ? DMAC_CTRLB_DIF_AHB_IF1 : DMAC_CTRLB_DIF_AHB_IF0;
-#endif
-		if (src_is_periph)
-			curr->desc.ctrlb |= DMAC_CTRLB_FC_PER2MEM_DMA_FC;
-		else if (dst_is_periph)
-			curr->desc.ctrlb |= DMAC_CTRLB_FC_MEM2PER_DMA_FC;
-		else
-			curr->desc.ctrlb |= DMAC_CTRLB_FC_MEM2MEM_DMA_FC;
-
-		curr->desc.ctrlb |= cfg_dma->incr_saddr ? DMAC_CTRLB_SRC_INCR_INCREMENTING : DMAC_CTRLB_SRC_INCR_FIXED;
-		curr->desc.ctrlb |= cfg_dma->incr_daddr ? DMAC_CTRLB_DST_INCR_INCREMENTING : DMAC_CTRLB_DST_INCR_FIXED;
-
-		curr->desc.ctrlb |= DMAC_CTRLB_SRC_DSCR_FETCH_FROM_MEM | DMAC_CTRLB_DST_DSCR_FETCH_FROM_MEM;
-
 #endif
 		if (DMA_SG_DESC_GET_NEXT(curr) == 0)
 			if (cfg_dma->loop)
@@ -428,49 +685,7 @@ static int _dma_sg_configure_transfer(struct _dma_channel* channel,
 	}
 	channel->sg_list = _sg_head;
 
-	cache_clean_region(_dma_sg_pool.desc, sizeof(_dma_sg_pool.desc));
-
-	/* Update configuration */
-#if defined(CONFIG_HAVE_XDMAC)
-	struct _xdmacd_cfg xdmacd_cfg;
-	uint32_t desc_ctrl;
-
-	xdmacd_cfg.cfg = (src_is_periph | dst_is_periph) ? XDMAC_CC_TYPE_PER_TRAN : XDMAC_CC_TYPE_MEM_TRAN;
-	xdmacd_cfg.cfg |= src_is_periph ? XDMAC_CC_DSYNC_PER2MEM : XDMAC_CC_DSYNC_MEM2PER;
-	xdmacd_cfg.cfg |= XDMAC_CC_CSIZE(cfg_dma->chunk_size);
-	xdmacd_cfg.cfg |= XDMAC_CC_DWIDTH(cfg_dma->data_width);
-	xdmacd_cfg.cfg |= src_is_periph ? XDMAC_CC_SIF_AHB_IF1 : XDMAC_CC_SIF_AHB_IF0;
-	xdmacd_cfg.cfg |= dst_is_periph ? XDMAC_CC_DIF_AHB_IF1 : XDMAC_CC_DIF_AHB_IF0;
-	xdmacd_cfg.cfg |= cfg_dma->incr_saddr ? XDMAC_CC_SAM_INCREMENTED_AM : XDMAC_CC_SAM_FIXED_AM;
-	xdmacd_cfg.cfg |= cfg_dma->incr_daddr ? XDMAC_CC_DAM_INCREMENTED_AM : XDMAC_CC_DAM_FIXED_AM;
-	xdmacd_cfg.cfg |= (src_is_periph | dst_is_periph) ? 0 : XDMAC_CC_SWREQ_SWR_CONNECTED;
-	xdmacd_cfg.bc = 0;
-	xdmacd_cfg.ds = 0;
-	xdmacd_cfg.sus = 0;
-	xdmacd_cfg.dus = 0;
-
-	desc_ctrl = XDMAC_CNDC_NDVIEW_NDV1
-	           | XDMAC_CNDC_NDE_DSCR_FETCH_EN
-	           | XDMAC_CNDC_NDSUP_SRC_PARAMS_UPDATED
-	           | XDMAC_CNDC_NDDUP_DST_PARAMS_UPDATED;
-
-	return xdmacd_configure_transfer(channel, &xdmacd_cfg, desc_ctrl, (void *)_sg_head);
-#elif defined(CONFIG_HAVE_DMAC)
-	struct _dmacd_cfg dmacd_cfg;
-
-	dmacd_cfg.s_decr_fetch = 0;
-	dmacd_cfg.d_decr_fetch = 0;
-	dmacd_cfg.sa_rep = 0;
-	dmacd_cfg.da_rep = 0;
-	dmacd_cfg.trans_auto = 0;
-	dmacd_cfg.blocks = 0;
-	dmacd_cfg.s_pip = 0;
-	dmacd_cfg.d_pip = 0;
-	dmacd_cfg.cfg = src_is_periph ? DMAC_CFG_SRC_H2SEL_HW : 0;
-	dmacd_cfg.cfg |= dst_is_periph ? DMAC_CFG_DST_H2SEL_HW : 0;
-
-	return dmacd_configure_transfer(channel, &dmacd_cfg, (void*)_sg_head);
-#endif
+	return _dma_sg_start(channel, cfg_dma, _sg_head, 1);
 }
 
 /*----------------------------------------------------------------------------
@@ -506,6 +721,10 @@ void dma_initialize(bool polling)
 			channel->dest_txif = 0;
 			channel->dest_rxif = 0;
 			channel->state = DMA_STATE_FREE;
+			channel->sg_list = NULL;
+			channel->sg_reserve = DMA_SG_SLAB_NONE;
+			channel->sg_reserve_count = 0;
+			channel->sg_reserve_size = 0;
 		}
 
 		if (!polling) {
@@ -589,7 +808,7 @@ int dma_reset_channel(struct _dma_channel* channel)
 	dmac_disable_channel(channel->hw, channel->id);
 #endif
 
-	_dma_sg_desc_free(channel->sg_list);
+	_dma_sg_desc_free(channel, channel->sg_list);
 	channel->sg_list = NULL;
 
 	/* Change state to 'allocated' */
@@ -606,8 +825,9 @@ int dma_free_channel(struct _dma_channel* channel)
 	case DMA_STATE_ALLOCATED:
 	case DMA_STATE_DONE:
 		channel->state = DMA_STATE_FREE;
-		_dma_sg_desc_free(channel->sg_list);
+		_dma_sg_desc_free(channel, channel->sg_list);
 		channel->sg_list = NULL;
+		dma_sg_reserve(channel, 0);
 		break;
 	}
 	return 0;
@@ -706,6 +926,10 @@ int dma_configure_transfer(struct _dma_channel* channel,
 	if (list_size == 0)
 		return -EINVAL;
 
+	/* Release the linked list of the previous transfer, if any */
+	_dma_sg_desc_free(channel, channel->sg_list);
+	channel->sg_list = NULL;
+
 	if ((list_size == 1) && (!cfg_dma->loop))
 		return _dma_configure_transfer(channel, cfg_dma, list);
 	else
@@ -739,4 +963,57 @@ bool dma_is_transfer_done(struct _dma_channel* channel)
 		&& (channel->state != DMA_STATE_SUSPENDED));
 }
 
+int dma_sg_reserve(struct _dma_channel* channel, uint32_t count)
+{
+	uint16_t slabs, first;
+
+	if (count > DMA_SG_ITEM_POOL_SIZE)
+		return -ENOMEM;
+	/* Single-item lists need no slab */
+	slabs = count > 1 ? CEIL_INT_DIV(count, DMA_SG_SLAB_SIZE) : 0;
+
+	mutex_lock(&_dma_sg_pool.mutex);
+
+	if (slabs > channel->sg_reserve_size) {
+		/* Move slabs from the shared pool to the reserve */
+		if (_dma_sg_pool.count < slabs - channel->sg_reserve_size) {
+			mutex_unlock(&_dma_sg_pool.mutex);
+			return -ENOMEM;
+		}
+		first = _dma_sg_slab_pop(&_dma_sg_pool.head, &_dma_sg_pool.count,
+					 slabs - channel->sg_reserve_size);
+		_dma_sg_slab_push(&channel->sg_reserve,
+				  &channel->sg_reserve_count, first);
+		_dma_sg_pool.reserved += slabs - channel->sg_reserve_size;
+	} else if (channel->sg_reserve_count > slabs) {
+		/* Give the free slabs in excess back to the shared pool; those
+		 * in use will return there when freed */
+		first = _dma_sg_slab_pop(&channel->sg_reserve,
+					 &channel->sg_reserve_count,
+					 channel->sg_reserve_count - slabs);
+		_dma_sg_pool.reserved -= _dma_sg_pool.length[first];
+		_dma_sg_slab_push(&_dma_sg_pool.head, &_dma_sg_pool.count,
+				  first);
+	}
+	channel->sg_reserve_size = slabs;
+
+	mutex_unlock(&_dma_sg_pool.mutex);
+
+	return 0;
+}
+
+void dma_sg_get_stats(struct _dma_sg_stats* stats)
+{
+	mutex_lock(&_dma_sg_pool.mutex);
+
+	stats->size = DMA_SG_ITEM_POOL_SIZE;
+	stats->free = _dma_sg_pool.count * DMA_SG_SLAB_SIZE;
+	stats->reserved = _dma_sg_pool.reserved * DMA_SG_SLAB_SIZE;
+	stats->used = _dma_sg_pool.used * DMA_SG_SLAB_SIZE;
+	stats->high_watermark = _dma_sg_pool.high_watermark * DMA_SG_SLAB_SIZE;
+	stats->failures = _dma_sg_pool.failures;
+
+	mutex_unlock(&_dma_sg_pool.mutex);
+}
+
 /**@}*/
@@ -104,6 +104,15 @@ enum {
 #define DMA_SG_ITEM_POOL_SIZE   64
 #endif
 
+/** Number of contiguous linked list items allocated at once. A linked list
+ * takes as many slabs as needed to hold its items, except single-item lists,
+ * which use an item of their channel outside the pool. */
+#ifndef DMA_SG_SLAB_SIZE
+#define DMA_SG_SLAB_SIZE        4
+#endif
+
+#define DMA_SG_SLAB_NONE        0xFFFF
+
 #define DMA_DATA_WIDTH_IN_BYTE(w)   (1 << w)
 
 /*----------------------------------------------------------------------------
@@ -134,6 +143,9 @@ struct _dma_channel {
 	volatile uint8_t state;		/* Channel State */
 
 	struct _dma_sg_desc* sg_list;
+	uint16_t sg_reserve;		/* First free slab of the reserve */
+	uint16_t sg_reserve_count;	/* Free slabs in the reserve */
+	uint16_t sg_reserve_size;	/* Slabs reserved by dma_sg_reserve */
 };
 
 struct _dma_transfer_cfg {
@@ -150,6 +162,19 @@ struct _dma_cfg {
 	bool loop; /* Used by scatter/gather only */
 };
 
+/** Statistics of the pool of linked list items, counted in items. Each item
+ * is in exactly one of free, reserved and used, which add up to size.
+ * Single-item lists do not use the pool and are not counted. */
+struct _dma_sg_stats {
+	uint16_t size;           /* Items in the pool */
+	uint16_t free;           /* Items of the shared pool, not in use */
+	uint16_t reserved;       /* Items of channel reserves, not in use */
+	uint16_t used;           /* Items of allocated linked lists, whether
+	                            from a reserve or the shared pool */
+	uint16_t high_watermark; /* Greatest number of items used at once */
+	uint32_t failures;       /* Count failed allocations */
+};
+
 struct _dma_controller {
 	uint32_t pid;
 #if defined(CONFIG_HAVE_XDMAC)
@@ -275,6 +300,26 @@ extern void dma_fifo_flush(struct _dma_channel* channel);
  */
 extern uint32_t dma_get_transferred_data_len(struct _dma_channel* channel, uint8_t chunk_size, uint32_t len);
 
+/**
+ * \brief Reserve linked list items for the scatter/gather or long transfers of
+ * a channel, so that streaming drivers do not compete with other users of the
+ * shared pool. The items are allocated from the reserve first, and the pool
+ * when the reserve is not large enough. The reserve is released when the
+ * channel is freed.
+ * \param channel Channel pointer
+ * \param count Number of items, rounded up to a multiple of DMA_SG_SLAB_SIZE.
+ * 0 releases the reserve. 1 reserves nothing: single-item lists never use the
+ * pool.
+ * \return 0 on success, -ENOMEM if the pool has not enough free items.
+ */
+extern int dma_sg_reserve(struct _dma_channel* channel, uint32_t count);
+
+/**
+ * \brief Get the usage statistics of the pool of linked list items.
+ * \param stats Filled with the statistics
+ */
+extern void dma_sg_get_stats(struct _dma_sg_stats* stats);
+
 /**
  * \brief DMA interrupt handler
  * \param source Peripheral ID of DMA controller
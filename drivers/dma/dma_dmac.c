@@ -37,6 +37,7 @@
 #include "dma/dma.h"
 #include "dma/dma_dmac.h"
 #include "errno.h"
+#include "intmath.h"
 #include "irq/irq.h"
 #include "peripherals/pmc.h"
 
@@ -51,6 +52,11 @@
 #define DMAC_CFG_DST_PER_MSB(x) 0
 #endif
 
+/* Position of the channel 0 bit of the BTC, CBTC and ERR fields of EBCISR */
+#define DMAC_EBCISR_BTC_SHIFT  0
+#define DMAC_EBCISR_CBTC_SHIFT 8
+#define DMAC_EBCISR_ERR_SHIFT  16
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -160,7 +166,7 @@ int dmacd_configure_transfer(struct _dma_channel* channel,
 
 void dma_irq_handler(uint32_t source, void* user_arg)
 {
-	uint32_t chan, gis;
+	uint32_t chan, gis, pending;
 	struct _dma_controller* ctrl = (struct _dma_controller*)user_arg;
 	Dmac* dmac = ctrl->hw;
 
@@ -168,11 +174,14 @@ void dma_irq_handler(uint32_t source, void* user_arg)
 	if ((gis & 0xFFFFFFFF) == 0)
 		return;
 
-	for (chan = 0; chan < DMA_CHANNELS; chan++) {
+	/* Only visit the channels with a BTC, CBTC or ERR interrupt pending */
+	pending = (gis >> DMAC_EBCISR_BTC_SHIFT) | (gis >> DMAC_EBCISR_CBTC_SHIFT)
+		| (gis >> DMAC_EBCISR_ERR_SHIFT);
+	pending &= (1u << DMA_CHANNELS) - 1;
+	while (pending) {
+		chan = pop_lsb_u32(&pending);
 		struct _dma_channel* channel = &ctrl->channels[chan];
 		bool exec = false;
-		if (!(gis & ((DMAC_EBCISR_BTC0 | DMAC_EBCISR_CBTC0 | DMAC_EBCISR_ERR0) << chan)))
-			continue;
 		if (channel->state == DMA_STATE_FREE)
 			continue;
 		if (gis & (DMAC_EBCISR_CBTC0 << chan)) {
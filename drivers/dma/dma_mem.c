@@ -0,0 +1,377 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file
+ *
+ * Memory-to-memory DMA service: copies, fills and 2D copies of memory areas
+ * on a few channels reserved on first use, with the data cache maintained
+ * and a callback invoked on completion.
+ */
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "callback.h"
+#include "compiler.h"
+#include "dma/dma.h"
+#include "dma/dma_mem.h"
+#include "errno.h"
+#include "intmath.h"
+#include "mm/cache.h"
+#include "mutex.h"
+
+/*----------------------------------------------------------------------------
+ *        Local definitions
+ *----------------------------------------------------------------------------*/
+
+/** Greatest microblock stride, a signed 24-bit value (XDMAC) */
+#define DMA_MEM_MAX_UBLOCK_STRIDE 0x7FFFFF
+
+/** Channel of the service, and transfer in progress on it */
+struct _dma_mem_slot {
+	mutex_t busy;                 /* Locked while the channel is in use */
+	struct _dma_channel* channel; /* Allocated on first use */
+	struct _callback cb;          /* User callback */
+	void* dst;                    /* Area to invalidate on completion */
+	uint32_t len;
+	uint32_t pattern;             /* Source of memset transfers (DMAC) */
+};
+
+/*----------------------------------------------------------------------------
+ *        Local variables
+ *----------------------------------------------------------------------------*/
+
+static struct _dma_mem_slot _dma_mem_slots[DMA_MEM_CHANNELS];
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Get the widest data width suitable for the given addresses and
+ * lengths, or'ed together.
+ */
+static uint8_t _dma_mem_data_width(uint32_t align)
+{
+#ifdef DMA_DATA_WIDTH_DWORD
+	if ((align & 7) == 0)
+		return DMA_DATA_WIDTH_DWORD;
+#endif
+	if ((align & 3) == 0)
+		return DMA_DATA_WIDTH_WORD;
+	if ((align & 1) == 0)
+		return DMA_DATA_WIDTH_HALF_WORD;
+	return DMA_DATA_WIDTH_BYTE;
+}
+
+/**
+ * \brief Get an idle channel of the service, allocating it if needed.
+ * \return The slot of the channel, or NULL if none is available.
+ */
+static struct _dma_mem_slot* _dma_mem_claim(void)
+{
+	struct _dma_mem_slot* slot;
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(_dma_mem_slots); i++) {
+		slot = &_dma_mem_slots[i];
+		if (!mutex_try_lock(&slot->busy))
+			continue;
+		if (slot->channel == NULL)
+			slot->channel = dma_allocate_channel(DMA_PERIPH_MEMORY,
+							     DMA_PERIPH_MEMORY);
+		if (slot->channel != NULL)
+			return slot;
+		mutex_unlock(&slot->busy);
+		return NULL;
+	}
+	return NULL;
+}
+
+static void _dma_mem_release(struct _dma_mem_slot* slot)
+{
+	dma_reset_channel(slot->channel);
+	mutex_unlock(&slot->busy);
+}
+
+static int _dma_mem_done(void* arg, void* arg2)
+{
+	struct _dma_mem_slot* slot = (struct _dma_mem_slot*)arg;
+	struct _callback cb;
+
+	cache_invalidate_region(slot->dst, slot->len);
+
+	/* Release the channel first, so that the callback may start another
+	 * transfer */
+	callback_copy(&cb, &slot->cb);
+	_dma_mem_release(slot);
+	callback_call(&cb, NULL);
+
+	return 0;
+}
+
+/**
+ * \brief Start the transfer configured on the channel of the slot, or release
+ * the slot if the configuration or the start failed.
+ */
+static int _dma_mem_start(struct _dma_mem_slot* slot, int err,
+			  void* dst, uint32_t len, struct _callback* cb)
+{
+	struct _callback _cb;
+
+	if (err < 0) {
+		_dma_mem_release(slot);
+		return err;
+	}
+
+	slot->dst = dst;
+	slot->len = len;
+	if (cb)
+		callback_copy(&slot->cb, cb);
+	else
+		callback_set(&slot->cb, NULL, NULL);
+
+	callback_set(&_cb, _dma_mem_done, slot);
+	dma_set_callback(slot->channel, &_cb);
+	err = dma_start_transfer(slot->channel);
+	if (err < 0)
+		_dma_mem_release(slot);
+	return err;
+}
+
+/**
+ * \brief Configure a transfer of contiguous data with the generic DMA API.
+ */
+static int _dma_mem_configure(struct _dma_mem_slot* slot, uint8_t width,
+			      const void* src, bool incr_src,
+			      void* dst, uint32_t len)
+{
+	struct _dma_cfg cfg_dma = {
+		.data_width = width,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.incr_saddr = incr_src,
+		.incr_daddr = true,
+		.loop = false,
+	};
+	struct _dma_transfer_cfg cfg = {
+		.saddr = src,
+		.daddr = dst,
+		.len = len >> width,
+	};
+
+	return dma_configure_transfer(slot->channel, &cfg_dma, &cfg, 1);
+}
+
+#if defined(CONFIG_HAVE_XDMAC)
+/**
+ * \brief Configure a memory-to-memory transfer of the XDMAC, with memory
+ * bursts of sixteen data.
+ * \param cfg Transfer, cfg->cfg holding the addressing modes
+ */
+static int _dma_mem_xdmac_configure(struct _dma_mem_slot* slot,
+				    struct _xdmacd_cfg* cfg, uint8_t width)
+{
+	cfg->cfg |= XDMAC_CC_TYPE_MEM_TRAN
+		| XDMAC_CC_MBSIZE_SIXTEEN
+		| XDMAC_CC_DSYNC_MEM2PER
+		| XDMAC_CC_SWREQ_SWR_CONNECTED
+		| XDMAC_CC_SIF_AHB_IF0
+		| XDMAC_CC_DIF_AHB_IF0
+		| XDMAC_CC_DWIDTH(width);
+
+	return xdmacd_configure_transfer(slot->channel, cfg, 0, 0);
+}
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+int dma_memcpy_async(void* dst, const void* src, uint32_t len,
+		     struct _callback* cb)
+{
+	struct _dma_mem_slot* slot = NULL;
+	uint8_t width;
+	int err;
+
+	if (len >= DMA_MEM_CPU_THRESHOLD)
+		slot = _dma_mem_claim();
+	if (slot == NULL) {
+		memcpy(dst, src, len);
+		callback_call(cb, NULL);
+		return 0;
+	}
+
+	width = _dma_mem_data_width((uint32_t)dst | (uint32_t)src | len);
+	cache_clean_region(src, len);
+	cache_clean_region(dst, len);
+
+#if defined(CONFIG_HAVE_XDMAC)
+	if ((len >> width) <= DMA_MAX_BT_SIZE) {
+		struct _xdmacd_cfg cfg = {
+			.ubc = len >> width,
+			.sa = (void*)src,
+			.da = dst,
+			.cfg = XDMAC_CC_SAM_INCREMENTED_AM
+			     | XDMAC_CC_DAM_INCREMENTED_AM,
+		};
+		err = _dma_mem_xdmac_configure(slot, &cfg, width);
+	} else {
+		err = _dma_mem_configure(slot, width, src, true, dst, len);
+	}
+#else
+	err = _dma_mem_configure(slot, width, src, true, dst, len);
+#endif
+
+	return _dma_mem_start(slot, err, dst, len, cb);
+}
+
+int dma_memset_async(void* dst, uint8_t value, uint32_t len,
+		     struct _callback* cb)
+{
+	struct _dma_mem_slot* slot = NULL;
+	uint8_t width;
+	int err;
+
+	if (len >= DMA_MEM_CPU_THRESHOLD)
+		slot = _dma_mem_claim();
+	if (slot == NULL) {
+		memset(dst, value, len);
+		callback_call(cb, NULL);
+		return 0;
+	}
+
+	/* The pattern is a word at most */
+	width = _dma_mem_data_width((uint32_t)dst | len);
+	width = min_u32(width, DMA_DATA_WIDTH_WORD);
+	slot->pattern = value * 0x01010101u;
+	cache_clean_region(dst, len);
+
+#if defined(CONFIG_HAVE_XDMAC)
+	if ((len >> width) <= DMA_MAX_BT_SIZE) {
+		/* In memset mode, the pattern is held by the data stride
+		 * register and the source is not read */
+		struct _xdmacd_cfg cfg = {
+			.ubc = len >> width,
+			.ds = slot->pattern,
+			.da = dst,
+			.cfg = XDMAC_CC_MEMSET_HW_MODE
+			     | XDMAC_CC_SAM_FIXED_AM
+			     | XDMAC_CC_DAM_INCREMENTED_AM,
+		};
+		err = _dma_mem_xdmac_configure(slot, &cfg, width);
+		return _dma_mem_start(slot, err, dst, len, cb);
+	}
+#endif
+
+	/* Repeat the pattern read from a fixed source address */
+	cache_clean_region(&slot->pattern, sizeof(slot->pattern));
+	err = _dma_mem_configure(slot, width, &slot->pattern, false, dst, len);
+
+	return _dma_mem_start(slot, err, dst, len, cb);
+}
+
+int dma_blit_2d(void* dst, uint32_t dst_pitch,
+		const void* src, uint32_t src_pitch,
+		uint32_t width, uint32_t height,
+		struct _callback* cb)
+{
+	uint8_t* d = (uint8_t*)dst;
+	const uint8_t* s = (const uint8_t*)src;
+	uint32_t i;
+
+	if (dst_pitch < width || src_pitch < width)
+		return -EINVAL;
+
+#if defined(CONFIG_HAVE_XDMAC)
+	/* One microblock per line, the gaps between lines being skipped with
+	 * the microblock strides */
+	if (height > 0 && width * height >= DMA_MEM_CPU_THRESHOLD
+	    && height <= DMA_MAX_BLOCK_LEN + 1
+	    && (src_pitch - width) <= DMA_MEM_MAX_UBLOCK_STRIDE
+	    && (dst_pitch - width) <= DMA_MEM_MAX_UBLOCK_STRIDE) {
+		uint8_t dwidth = _dma_mem_data_width((uint32_t)dst
+				| (uint32_t)src | width | src_pitch | dst_pitch);
+		uint32_t src_len = src_pitch * (height - 1) + width;
+		uint32_t dst_len = dst_pitch * (height - 1) + width;
+		struct _dma_mem_slot* slot = NULL;
+
+		if ((width >> dwidth) <= DMA_MAX_BT_SIZE)
+			slot = _dma_mem_claim();
+		if (slot != NULL) {
+			struct _xdmacd_cfg cfg = {
+				.ubc = width >> dwidth,
+				.bc = height - 1,
+				.sus = src_pitch - width,
+				.dus = dst_pitch - width,
+				.sa = (void*)src,
+				.da = dst,
+				.cfg = XDMAC_CC_SAM_UBS_AM
+				     | XDMAC_CC_DAM_UBS_AM,
+			};
+			int err;
+
+			cache_clean_region(src, src_len);
+			cache_clean_region(dst, dst_len);
+			err = _dma_mem_xdmac_configure(slot, &cfg, dwidth);
+			return _dma_mem_start(slot, err, dst, dst_len, cb);
+		}
+	}
+#endif
+
+	for (i = 0; i < height; i++) {
+		memcpy(d, s, width);
+		d += dst_pitch;
+		s += src_pitch;
+	}
+	callback_call(cb, NULL);
+	return 0;
+}
+
+bool dma_mem_is_idle(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(_dma_mem_slots); i++)
+		if (mutex_is_locked(&_dma_mem_slots[i].busy))
+			return false;
+	return true;
+}
+
+void dma_mem_wait(void)
+{
+	while (!dma_mem_is_idle()) {
+		/* always call dma_poll, it will do nothing if polling mode
+		 * is disabled */
+		dma_poll();
+	}
+}
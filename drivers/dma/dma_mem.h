@@ -0,0 +1,122 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _DMA_MEM_H_
+#define _DMA_MEM_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "callback.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Transfers shorter than this number of bytes are done by the CPU, as setting
+ * up the DMA and maintaining the cache would cost more than the copy. */
+#ifndef DMA_MEM_CPU_THRESHOLD
+#define DMA_MEM_CPU_THRESHOLD   256
+#endif
+
+/** Number of memory-to-memory DMA channels reserved by the service. They are
+ * allocated on first use. */
+#ifndef DMA_MEM_CHANNELS
+#define DMA_MEM_CHANNELS        2
+#endif
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Copy len bytes from src to dst. The data cache is cleaned for src and
+ * dst, and invalidated for dst on completion. Until the callback is invoked,
+ * the CPU shall not access dst nor the variables cached in the same lines.
+ * If len is shorter than DMA_MEM_CPU_THRESHOLD, or if no channel is available,
+ * the copy is done by the CPU and the callback is invoked before returning.
+ * \param dst Destination buffer
+ * \param src Source buffer
+ * \param len Number of bytes to copy
+ * \param cb Callback invoked on completion, or NULL
+ * \return 0 on success, or a negative error code
+ */
+extern int dma_memcpy_async(void* dst, const void* src, uint32_t len,
+			    struct _callback* cb);
+
+/**
+ * \brief Fill len bytes at dst with value, as dma_memcpy_async() copies.
+ * \param dst Destination buffer
+ * \param value Value of the bytes
+ * \param len Number of bytes to fill
+ * \param cb Callback invoked on completion, or NULL
+ * \return 0 on success, or a negative error code
+ */
+extern int dma_memset_async(void* dst, uint8_t value, uint32_t len,
+			    struct _callback* cb);
+
+/**
+ * \brief Copy a rectangle of height lines of width bytes, the lines being
+ * src_pitch bytes apart in the source and dst_pitch bytes apart in the
+ * destination, as dma_memcpy_async() copies. The DMA only accesses the
+ * lines, but the cache is maintained for the whole area from the first to the
+ * last line, that the CPU shall not access until completion.
+ * The XDMAC copies the whole rectangle with a single transfer of one
+ * microblock per line; the DMAC copies it with the CPU.
+ * \param dst Destination of the first line
+ * \param dst_pitch Distance between the start of two destination lines
+ * \param src Source of the first line
+ * \param src_pitch Distance between the start of two source lines
+ * \param width Number of bytes of a line
+ * \param height Number of lines
+ * \param cb Callback invoked on completion, or NULL
+ * \return 0 on success, -EINVAL if a pitch is less than width, or another
+ * negative error code
+ */
+extern int dma_blit_2d(void* dst, uint32_t dst_pitch,
+		       const void* src, uint32_t src_pitch,
+		       uint32_t width, uint32_t height,
+		       struct _callback* cb);
+
+/**
+ * \brief Check if all the transfers started by the service are complete.
+ */
+extern bool dma_mem_is_idle(void);
+
+/**
+ * \brief Wait until all the transfers started by the service are complete.
+ * Transfer completion is polled when the DMA driver is in polling mode.
+ */
+extern void dma_mem_wait(void);
+
+#endif /* _DMA_MEM_H_ */
@@ -0,0 +1,110 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _DMA_PLAN_H_
+#define _DMA_PLAN_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "intmath.h"
+
+/*------------------------------------------------------------------------------
+ *         Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Number of block counts tried, from the smallest one that fits, for a split
+ * of a long transfer in a single descriptor */
+#ifndef DMA_PLAN_CANDIDATES
+#define DMA_PLAN_CANDIDATES 32
+#endif
+
+/*------------------------------------------------------------------------------
+ *         Types
+ *----------------------------------------------------------------------------*/
+
+/** Split of a transfer too long for a single microblock (XDMAC) or buffer
+ * (DMAC): desc_count descriptors of 'blocks' microblocks/buffers each, the
+ * microblocks of the first 'longer' descriptors being one data element
+ * longer than 'ublen'. */
+struct _dma_plan {
+	uint32_t blocks;
+	uint32_t desc_count;
+	uint32_t ublen;
+	uint32_t longer;
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Compute how to split a transfer of len data elements, which does not
+ * fit in a single microblock (XDMAC) or buffer (DMAC), in bounded time.
+ * A single descriptor is used when one of the DMA_PLAN_CANDIDATES block
+ * counts following len / max_ublen divides len. Otherwise the number of
+ * blocks is the greatest power of two dividing len, up to max_blocks, and the
+ * remainder is spread over the smallest number of descriptors, whose
+ * microblock lengths differ by one data element at most.
+ * \param len  Transfer length, in data elements, greater than max_ublen.
+ * \param max_ublen  Maximum microblock length.
+ * \param max_blocks  Maximum number of blocks of a descriptor.
+ * \param plan  Computed split.
+ */
+static inline void dma_plan_transfer(uint32_t len, uint32_t max_ublen,
+				     uint32_t max_blocks,
+				     struct _dma_plan* plan)
+{
+	uint32_t blocks = len / max_ublen + (len % max_ublen ? 1 : 0);
+	uint32_t last = min_u32(blocks + DMA_PLAN_CANDIDATES - 1, max_blocks);
+	uint32_t pow2 = max_blocks;
+
+	for (; blocks <= last; blocks++) {
+		if (len % blocks == 0) {
+			plan->blocks = blocks;
+			plan->desc_count = 1;
+			plan->ublen = len / blocks;
+			plan->longer = 0;
+			return;
+		}
+	}
+
+	while (pow2 & (pow2 - 1))
+		pow2 &= pow2 - 1;
+	plan->blocks = min_u32(len & -len, pow2);
+	len /= plan->blocks;
+	plan->desc_count = len / max_ublen + (len % max_ublen ? 1 : 0);
+	plan->ublen = len / plan->desc_count;
+	plan->longer = len % plan->desc_count;
+}
+
+#endif /* _DMA_PLAN_H_ */
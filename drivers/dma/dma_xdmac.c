@@ -38,6 +38,7 @@
 #include "dma/dma.h"
 #include "dma/dma_xdmac.h"
 #include "errno.h"
+#include "intmath.h"
 #include "irq/irq.h"
 #include "peripherals/pmc.h"
 
@@ -167,16 +168,17 @@ void dma_irq_handler(uint32_t source, void* user_arg)
 	Xdmac* xdmac = ctrl->hw;
 
 	gis = xdmac_get_global_isr(xdmac);
-	if ((gis & ((1ull << DMA_CHANNELS) - 1)) == 0)
+	gis &= (1ull << DMA_CHANNELS) - 1;
+	if (gis == 0)
 		return;
 
 	gcs = xdmac_get_global_channel_status(xdmac);
-	for (chan = 0; chan < DMA_CHANNELS; chan++) {
+	/* Only visit the channels with an interrupt pending */
+	while (gis) {
+		chan = pop_lsb_u32(&gis);
 		struct _dma_channel* channel = &ctrl->channels[chan];
 		bool exec = false;
 
-		if (!(gis & (1 << chan)))
-			continue;
 		if (channel->state == DMA_STATE_FREE)
 			continue;
 
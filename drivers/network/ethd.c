@@ -48,6 +48,7 @@
 
 #include "ethd.h"
 
+#include <assert.h>
 #include <string.h>
 
 /*---------------------------------------------------------------------------
@@ -58,6 +59,18 @@
  *        Local functions
  *----------------------------------------------------------------------------*/
 
+/**
+ * \brief Give back to the hardware the RX descriptors from rx_head up to
+ * (but not including) idx.
+ */
+static void _ethd_rx_skip(struct _ethd_queue* q, uint32_t idx)
+{
+	while (q->rx_head != idx) {
+		q->rx_desc[q->rx_head].addr &= ~ETH_RX_ADDR_OWN;
+		RING_INC(q->rx_head, q->rx_size);
+	}
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -76,6 +89,7 @@ bool ethd_configure(struct _ethd * ethd, enum _eth_type eth_type, void * addr, u
 {
 	ethd->addr = addr;
 	ethd->op = NULL;
+	ethd->checksum_offload = 0;
 
 #ifdef CONFIG_HAVE_EMAC
 	if (ETH_TYPE_EMAC == eth_type)
@@ -98,16 +112,29 @@ uint8_t ethd_setup_queue(struct _ethd* ethd, uint8_t queue,
 			 uint16_t tx_size, uint8_t* tx_buffer, struct _eth_desc* tx_desc,
 			 ethd_callback_t *tx_callbacks)
 {
+	/* A new RX ring invalidates any previous RX pool */
+	ethd->queues[queue].rx_pool = NULL;
+	ethd->queues[queue].rx_pool_size = 0;
+	ethd->queues[queue].rx_pool_count = 0;
+
 	return ethd->op->setup_queue(ethd, queue, rx_size, rx_buffer, rx_desc,
 		tx_size, tx_buffer, tx_desc,
 		tx_callbacks);
 }
 
-uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback)
+/**
+ * \brief Queue a frame described by a scatter-gather list.
+ * In copy mode the buffers are copied into the queue TX buffers, otherwise
+ * the descriptors point directly at the caller buffers.
+ */
+static uint8_t _ethd_queue_frame(struct _ethd* ethd, uint8_t queue,
+		const struct _eth_sg_list* sgl, ethd_callback_t callback,
+		bool zero_copy)
 {
 	void* eth = ethd->addr;
 	struct _ethd_queue* q = &ethd->queues[queue];
 	struct _eth_desc* desc;
+	uint32_t max_size = zero_copy ? ETH_MAX_FRAME_LENGTH : ETH_TX_UNITSIZE;
 	uint16_t idx, tx_head;
 	int i;
 
@@ -124,6 +151,20 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 		trace_error("ethd_send_sg: ethernet frame has too many buffers.\r\n");
 		return ETH_PARAM;
 	}
+	if (zero_copy && (!callback || !q->tx_callbacks)) {
+		trace_error("ethd_send_sg: zero-copy send requires a TX callback.\r\n");
+		return ETH_PARAM;
+	}
+	for (i = 0; i < sgl->size; i++) {
+		if (sgl->entries[i].size > max_size) {
+			trace_error("ethd_send_sg: buffer size is too big.\r\n");
+			return ETH_PARAM;
+		}
+		if (zero_copy && !IS_CACHE_ALIGNED(sgl->entries[i].buffer)) {
+			trace_error("ethd_send_sg: buffer is not cache aligned.\r\n");
+			return ETH_PARAM;
+		}
+	}
 
 	/* Check available space */
 	if (RING_SPACE(q->tx_head, q->tx_tail, q->tx_size) < sgl->size) {
@@ -146,11 +187,6 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 		const struct _eth_sg *sg = &sgl->entries[i];
 		uint32_t status;
 
-		if (sg->size > ETH_TX_UNITSIZE) {
-			trace_error("ethd_send_sg: buffer size is too big.\r\n");
-			return ETH_PARAM;
-		}
-
 		RING_DEC(idx, q->tx_size);
 
 		/* Reset TX callback */
@@ -159,10 +195,21 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 
 		desc = &q->tx_desc[idx];
 
-		/* Copy data into transmittion buffer */
-		if (sg->buffer && sg->size) {
-			memcpy((void*)desc->addr, sg->buffer, sg->size);
-			cache_clean_region((void*)desc->addr, sg->size);
+		if (zero_copy) {
+			/* Point the descriptor at the caller buffer */
+			desc->addr = (uint32_t)sg->buffer;
+			if (sg->buffer && sg->size)
+				cache_clean_region(sg->buffer, sg->size);
+		} else {
+			/* A previous zero-copy frame may have moved the
+			 * descriptor away from its transmission buffer */
+			desc->addr = (uint32_t)q->tx_buffer + idx * ETH_TX_UNITSIZE;
+
+			/* Copy data into transmittion buffer */
+			if (sg->buffer && sg->size) {
+				memcpy((void*)desc->addr, sg->buffer, sg->size);
+				cache_clean_region((void*)desc->addr, sg->size);
+			}
 		}
 
 		/* Compute buffer descriptor status word */
@@ -190,6 +237,16 @@ uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_lis
 	return ETH_OK;
 }
 
+uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _ethd_queue_frame(ethd, queue, sgl, callback, false);
+}
+
+uint8_t ethd_send_sg_zero_copy(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback)
+{
+	return _ethd_queue_frame(ethd, queue, sgl, callback, true);
+}
+
 void ethd_start(struct _ethd* ethd)
 {
 	ethd->op->start(ethd);
@@ -281,6 +338,7 @@ uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint32_t b
 			if (desc->status & ETH_RX_STATUS_EOF) {
 				/* Frame size from the ETH */
 				*recv_size = desc->status & ETH_RX_STATUS_LENGTH_MASK;
+				q->rx_status = desc->status;
 
 				/* Application frame buffer is too small all
 				 * data have not been copied */
@@ -312,6 +370,135 @@ uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint32_t b
 	return ETH_RX_NULL;
 }
 
+uint8_t ethd_setup_rx_pool(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint8_t** slots, uint16_t count)
+{
+	struct _ethd_queue* q = &ethd->queues[queue];
+	uint16_t i;
+
+	if (!buffer || !slots || !count)
+		return ETH_PARAM;
+
+	if (!IS_CACHE_ALIGNED(buffer))
+		return ETH_PARAM;
+
+	for (i = 0; i < count; i++)
+		slots[i] = buffer + i * ETH_RX_UNITSIZE;
+
+	q->rx_pool = slots;
+	q->rx_pool_size = count;
+	q->rx_pool_count = count;
+
+	return ETH_OK;
+}
+
+uint8_t ethd_poll_zero_copy(struct _ethd* ethd, uint8_t queue,
+		struct _eth_sg* entries, uint32_t max_entries,
+		uint32_t* entry_count, uint32_t* recv_size)
+{
+	struct _ethd_queue* q = &ethd->queues[queue];
+	struct _eth_desc *desc;
+	uint32_t idx, count, remaining, i;
+	bool sof = false;
+
+	if (!entries || !q->rx_pool)
+		return ETH_PARAM;
+
+	/* Set the default return value */
+	*entry_count = 0;
+	*recv_size = 0;
+
+	/* Process RX descriptors */
+	count = 0;
+	idx = q->rx_head;
+	desc = &q->rx_desc[idx];
+	while (desc->addr & ETH_RX_ADDR_OWN) {
+		/* A start of frame has been received, discard previous fragments */
+		if (desc->status & ETH_RX_STATUS_SOF) {
+			_ethd_rx_skip(q, idx);
+			sof = true;
+			count = 0;
+		}
+
+		/* Increment the index */
+		RING_INC(idx, q->rx_size);
+
+		/* SOF has not been detected, skip the fragment */
+		if (!sof) {
+			desc->addr &= ~ETH_RX_ADDR_OWN;
+			q->rx_head = idx;
+			desc = &q->rx_desc[idx];
+			continue;
+		}
+
+		if (idx == q->rx_head) {
+			trace_info("no EOF (buffers probably too small)\r\n");
+			do {
+				q->rx_desc[q->rx_head].addr &= ~ETH_RX_ADDR_OWN;
+				RING_INC(q->rx_head, q->rx_size);
+			} while (idx != q->rx_head);
+			return ETH_RX_NULL;
+		}
+
+		count++;
+
+		/* An end of frame has been received, loan the buffers */
+		if (desc->status & ETH_RX_STATUS_EOF) {
+			*recv_size = desc->status & ETH_RX_STATUS_LENGTH_MASK;
+			q->rx_status = desc->status;
+
+			/* Not enough entries: drop the frame */
+			if (count > max_entries) {
+				_ethd_rx_skip(q, idx);
+				return ETH_SIZE_TOO_SMALL;
+			}
+
+			/* Not enough buffers to re-arm the descriptors: keep
+			 * the frame for ethd_poll() */
+			if (count > q->rx_pool_count)
+				return ETH_RX_POOL_EMPTY;
+
+			remaining = *recv_size;
+			for (i = 0; i < count; i++) {
+				uint8_t* buffer;
+				uint32_t addr;
+
+				desc = &q->rx_desc[q->rx_head];
+				addr = desc->addr;
+
+				entries[i].buffer = (void*)(addr & ETH_RX_ADDR_MASK);
+				entries[i].size = remaining < ETH_RX_UNITSIZE ? remaining : ETH_RX_UNITSIZE;
+				entries[i].next = (i + 1 < count) ? &entries[i + 1] : NULL;
+				remaining -= entries[i].size;
+				cache_invalidate_region(entries[i].buffer, ETH_RX_UNITSIZE);
+
+				/* Re-arm the descriptor with a pool buffer,
+				 * discarding any line the CPU may still hold */
+				buffer = q->rx_pool[--q->rx_pool_count];
+				cache_invalidate_region(buffer, ETH_RX_UNITSIZE);
+				desc->addr = ((uint32_t)buffer & ETH_RX_ADDR_MASK)
+				           | (addr & ETH_RX_ADDR_WRAP);
+
+				RING_INC(q->rx_head, q->rx_size);
+			}
+			*entry_count = count;
+
+			return ETH_OK;
+		}
+
+		/* Process the next buffer */
+		desc = &q->rx_desc[idx];
+	}
+	return ETH_RX_NULL;
+}
+
+void ethd_rx_release_buffer(struct _ethd* ethd, uint8_t queue, void* buffer)
+{
+	struct _ethd_queue* q = &ethd->queues[queue];
+
+	assert(q->rx_pool_count < q->rx_pool_size);
+	q->rx_pool[q->rx_pool_count++] = buffer;
+}
+
 void ethd_set_rx_callback(struct _ethd *ethd, uint8_t queue, ethd_callback_t callback)
 {
 	ethd->op->set_rx_callback(ethd, queue, callback);
@@ -333,3 +520,22 @@ uint8_t ethd_set_tx_wakeup_callback(struct _ethd* ethd, uint8_t queue, ethd_wake
 
 	return ETH_OK;
 }
+
+uint8_t ethd_set_checksum_offload(struct _ethd* ethd, uint32_t flags)
+{
+	if (!ethd->op->set_checksum_offload)
+		return flags ? ETH_NOT_SUPPORTED : ETH_OK;
+
+	ethd->op->set_checksum_offload(ethd, flags);
+	ethd->checksum_offload = flags;
+	return ETH_OK;
+}
+
+uint32_t ethd_get_rx_checksum(struct _ethd* ethd, uint8_t queue)
+{
+	/* The status bits have another meaning without RX offload */
+	if (!(ethd->checksum_offload & ETH_CHECKSUM_OFFLOAD_RX))
+		return ETH_RX_STATUS_CHECKSUM_NONE;
+
+	return ethd->queues[queue].rx_status & ETH_RX_STATUS_CHECKSUM_MASK;
+}
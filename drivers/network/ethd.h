@@ -89,11 +89,23 @@ enum _eth_speed {
 #define ETH_RX_STATUS_SOF         (1u << 14)
 #define ETH_RX_STATUS_EOF         (1u << 15)
 
+/* Checksum offload result of a frame, in its last RX descriptor status
+ * (GMAC only, when RX checksum offload is enabled) */
+#define ETH_RX_STATUS_CHECKSUM_MASK (3u << 22)
+#define ETH_RX_STATUS_CHECKSUM_NONE (0u << 22) /**< Nothing checked */
+#define ETH_RX_STATUS_CHECKSUM_IP   (1u << 22) /**< IPv4 header checked */
+#define ETH_RX_STATUS_CHECKSUM_TCP  (2u << 22) /**< IPv4 header and TCP checked */
+#define ETH_RX_STATUS_CHECKSUM_UDP  (3u << 22) /**< IPv4 header and UDP checked */
+
 /* Bits contained in struct _eth_desc status when used for TX */
 #define ETH_TX_STATUS_LASTBUF (1u << 15)
 #define ETH_TX_STATUS_WRAP    (1u << 30)
 #define ETH_TX_STATUS_USED    (1u << 31)
 
+/* Checksum offload flags */
+#define ETH_CHECKSUM_OFFLOAD_RX (1u << 0) /**< Verify RX checksums */
+#define ETH_CHECKSUM_OFFLOAD_TX (1u << 1) /**< Generate TX checksums */
+
 /**@}*/
 
 /** \addtogroup eth_buf_size ETH(EMACD/GMACD) Default Buffer Size
@@ -114,6 +126,10 @@ enum _eth_speed {
 #define ETH_PARAM             3
 /** Transter is not initialized */
 #define ETH_NOT_INITIALIZED   4
+/** Not enough buffers in the RX refill pool */
+#define ETH_RX_POOL_EMPTY     5
+/** Feature not supported by the ETH */
+#define ETH_NOT_SUPPORTED     6
 
 enum _eth_type {
 	ETH_TYPE_EMAC,
@@ -188,6 +204,8 @@ typedef void (*_ethd_set_rx_callback)(void *ethd, uint8_t queue, ethd_callback_t
 
 typedef uint8_t (*_ethd_set_tx_wakeup_callback)(void *ethd, uint8_t queue, ethd_wakeup_cb_t wakeup_callback, uint16_t threshold);
 
+typedef void (*_ethd_set_checksum_offload)(void *ethd, uint32_t flags);
+
 /** @}*/
 
 /** \addtogroup ethd_structs
@@ -206,6 +224,7 @@ struct _ethd_op {
 	_ethd_poll poll;
 	_ethd_set_rx_callback set_rx_callback;
 	_ethd_set_tx_wakeup_callback set_tx_wakeup_callback;
+	_ethd_set_checksum_offload set_checksum_offload; /**< NULL if not supported */
 };
 
 struct _ethd_queue {
@@ -213,8 +232,13 @@ struct _ethd_queue {
 	struct _eth_desc *rx_desc;
 	uint16_t          rx_size;
 	uint16_t          rx_head;
+	uint32_t          rx_status;   /**< Last frame EOF descriptor status */
 	ethd_callback_t   rx_callback;
 
+	uint8_t         **rx_pool;
+	uint16_t          rx_pool_size;
+	uint16_t          rx_pool_count;
+
 	uint8_t          *tx_buffer;
 	struct _eth_desc *tx_desc;
 	uint16_t          tx_size;
@@ -241,6 +265,7 @@ struct _ethd {
 	};
 	struct _ethd_queue queues[ETH_QUEUE_COUNT];
 	const struct _ethd_op *op;
+	uint32_t checksum_offload;  /**< ETH_CHECKSUM_OFFLOAD_xxx flags */
 };
 
 /** @}*/
@@ -276,6 +301,21 @@ extern uint8_t ethd_setup_queue(struct _ethd* ethd, uint8_t queue,
  */
 extern uint8_t ethd_send_sg(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback);
 
+/**
+ * \brief Send a frame splitted into buffers without copying them. The TX
+ * descriptors point directly at the buffers of the scatter-gather list,
+ * which remain owned by the driver until the callback is invoked for the
+ * frame. Frames complete in submission order, so the caller can release
+ * its oldest pending frame on each callback.
+ * The buffers must start on a cache line, and must not be modified before
+ * the callback is invoked.
+ *  \param ethd Pointer to ETH Driver instance.
+ *  \param sgl Pointer to a scatter-gather list describing the buffers of the ethernet frame.
+ *  \param callback Pointer to callback function (mandatory, the queue must
+ *  have been configured with a tx_callbacks buffer).
+ */
+extern uint8_t ethd_send_sg_zero_copy(struct _ethd* ethd, uint8_t queue, const struct _eth_sg_list* sgl, ethd_callback_t callback);
+
 extern void ethd_start(struct _ethd* ethd);
 
 /**
@@ -303,6 +343,45 @@ extern uint32_t ethd_get_tx_load(struct _ethd* ethd, uint8_t queue);
  */
 extern uint8_t ethd_poll(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint32_t buffer_size, uint32_t* recv_size);
 
+/**
+ * \brief Configure the pool of RX buffers used to re-arm the RX descriptors
+ * whose buffers are loaned by ethd_poll_zero_copy().
+ * The RX queue must not be reset while buffers are loaned.
+ *  \param ethd     Pointer to ETH Driver instance.
+ *  \param buffer   Pool buffers, cache line aligned, of size
+ *                  ETH_RX_UNITSIZE * count
+ *  \param slots    Free list storage, count entries
+ *  \param count    Number of buffers in the pool
+ *  \return         OK or invalid parameter
+ */
+extern uint8_t ethd_setup_rx_pool(struct _ethd* ethd, uint8_t queue, uint8_t* buffer, uint8_t** slots, uint16_t count);
+
+/**
+ * \brief Receive a packet with ETH without copying it.
+ * The RX buffers holding the frame are handed over to the caller and their
+ * descriptors are re-armed with buffers from the RX pool. Each loaned buffer
+ * must be given back with ethd_rx_release_buffer() once processed.
+ *  \param ethd        Pointer to ETH Driver instance.
+ *  \param entries     Filled with the loaned buffers (ETH_RX_UNITSIZE bytes
+ *                     each, except for the last one)
+ *  \param max_entries Number of entries available
+ *  \param entry_count Number of loaned buffers
+ *  \param recv_size   Received size
+ *  \return            OK, no data, frame too big for entries (frame
+ *                     dropped) or pool empty (frame kept, ethd_poll() can
+ *                     still copy it)
+ */
+extern uint8_t ethd_poll_zero_copy(struct _ethd* ethd, uint8_t queue,
+		struct _eth_sg* entries, uint32_t max_entries,
+		uint32_t* entry_count, uint32_t* recv_size);
+
+/**
+ * \brief Give back a RX buffer loaned by ethd_poll_zero_copy() to the RX pool.
+ *  \param ethd     Pointer to ETH Driver instance.
+ *  \param buffer   Loaned buffer
+ */
+extern void ethd_rx_release_buffer(struct _ethd* ethd, uint8_t queue, void* buffer);
+
 extern void ethd_set_rx_callback(struct _ethd *ethd, uint8_t queue, ethd_callback_t callback);
 
 /**
@@ -325,6 +404,28 @@ extern void ethd_set_rx_callback(struct _ethd *ethd, uint8_t queue, ethd_callbac
  */
 extern uint8_t ethd_set_tx_wakeup_callback(struct _ethd* ethd, uint8_t queue, ethd_wakeup_cb_t callback, uint16_t threshold);
 
+/**
+ * \brief Enable/Disable hardware checksum offload.
+ * The setting applies to all the queues of the ETH. With TX offload, the
+ * IPv4 header, TCP and UDP checksum fields of the frames to send must be
+ * zeroed. ICMP checksums are never offloaded.
+ *  \param ethd   Pointer to ETH Driver instance.
+ *  \param flags  ETH_CHECKSUM_OFFLOAD_RX and/or ETH_CHECKSUM_OFFLOAD_TX,
+ *                0 to disable
+ *  \return       OK, or not supported (EMAC)
+ */
+extern uint8_t ethd_set_checksum_offload(struct _ethd* ethd, uint32_t flags);
+
+/**
+ * \brief Return the checksums verified by the ETH for the last frame
+ * received by ethd_poll() or ethd_poll_zero_copy().
+ * Frames with a bad checksum are dropped by the ETH, so any checksum not
+ * reported here still has to be verified by software.
+ *  \param ethd   Pointer to ETH Driver instance.
+ *  \return       ETH_RX_STATUS_CHECKSUM_xxx, NONE if RX offload is disabled
+ */
+extern uint32_t ethd_get_rx_checksum(struct _ethd* ethd, uint8_t queue);
+
 /** @}*/
 
 #ifdef __cplusplus
@@ -56,6 +56,11 @@
 #define GMAC_TSR_UND 0
 #endif
 
+/* some device headers don't describe this flag, it is the same on all IPs */
+#ifndef GMAC_DCFGR_TXCOEN
+#define GMAC_DCFGR_TXCOEN (0x1u << 11)
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -202,6 +207,22 @@ uint32_t gmac_get_network_config_register(Gmac* gmac)
 	return gmac->GMAC_NCFGR;
 }
 
+void gmac_enable_rx_checksum_offload(Gmac* gmac, bool enable)
+{
+	if (enable)
+		gmac->GMAC_NCFGR |= GMAC_NCFGR_RXCOEN;
+	else
+		gmac->GMAC_NCFGR &= ~GMAC_NCFGR_RXCOEN;
+}
+
+void gmac_enable_tx_checksum_offload(Gmac* gmac, bool enable)
+{
+	if (enable)
+		gmac->GMAC_DCFGR |= GMAC_DCFGR_TXCOEN;
+	else
+		gmac->GMAC_DCFGR &= ~GMAC_DCFGR_TXCOEN;
+}
+
 void gmac_enable_mdio(Gmac* gmac)
 {
 	/* Disable RX/TX */
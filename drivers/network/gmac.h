@@ -136,6 +136,22 @@ extern void gmac_set_network_config_register(Gmac* gmac, uint32_t ncfgr);
 
 extern uint32_t gmac_get_network_config_register(Gmac* gmac);
 
+/**
+ *  \brief Enable/Disable RX checksum offload.
+ *  IPv4 header, TCP and UDP checksums of the received frames are verified,
+ *  frames with a bad checksum are discarded and the result is reported in
+ *  the RX descriptor status (see ETH_RX_STATUS_CHECKSUM_MASK).
+ */
+extern void gmac_enable_rx_checksum_offload(Gmac* gmac, bool enable);
+
+/**
+ *  \brief Enable/Disable TX checksum generation offload.
+ *  IPv4 header, TCP and UDP checksums of the transmitted frames are
+ *  generated, their checksum fields must be zeroed by software.
+ *  Requires the full TX packet buffer mode (DCFGR.TXPBMS, reset value).
+ */
+extern void gmac_enable_tx_checksum_offload(Gmac* gmac, bool enable);
+
 /**
  *  \brief Enable MDI with PHY
  *  \param gmac Pointer to an Gmac instance.
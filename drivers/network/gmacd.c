@@ -541,6 +541,20 @@ void gmacd_set_rx_callback(struct _ethd* gmacd, uint8_t queue, ethd_callback_t c
 	}
 }
 
+/**
+ * \brief Enable/Disable checksum offload.
+ * The GMAC has a single setting shared by all the queues.
+ *  \param gmacd Pointer to GMAC Driver instance.
+ *  \param flags ETH_CHECKSUM_OFFLOAD_RX and/or ETH_CHECKSUM_OFFLOAD_TX
+ */
+void gmacd_set_checksum_offload(struct _ethd* gmacd, uint32_t flags)
+{
+	gmac_enable_rx_checksum_offload(gmacd->gmac,
+			(flags & ETH_CHECKSUM_OFFLOAD_RX) != 0);
+	gmac_enable_tx_checksum_offload(gmacd->gmac,
+			(flags & ETH_CHECKSUM_OFFLOAD_TX) != 0);
+}
+
 const struct _ethd_op _gmac_op = {
 	.configure = (_ethd_configure)gmacd_configure,
 	.setup_queue = (_ethd_setup_queue)gmacd_setup_queue,
@@ -554,4 +568,5 @@ const struct _ethd_op _gmac_op = {
 	.poll = (_ethd_poll)ethd_poll,
 	.set_rx_callback = (_ethd_set_rx_callback)gmacd_set_rx_callback,
 	.set_tx_wakeup_callback = (_ethd_set_tx_wakeup_callback)ethd_set_tx_wakeup_callback,
+	.set_checksum_offload = (_ethd_set_checksum_offload)gmacd_set_checksum_offload,
 };
@@ -122,6 +122,8 @@ extern uint8_t gmacd_poll(struct _ethd* gmacd, uint8_t queue,
 extern void gmacd_set_rx_callback(struct _ethd *gmacd, uint8_t queue,
 		ethd_callback_t callback);
 
+extern void gmacd_set_checksum_offload(struct _ethd* gmacd, uint32_t flags);
+
 /** @}*/
 
 #ifdef __cplusplus
@@ -0,0 +1,476 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "chip.h"
+#include "intmath.h"
+#include "trace.h"
+
+#include "nand_flash_bbt.h"
+#include "nand_flash_ecc.h"
+#include "nand_flash_raw.h"
+#include "nand_flash_skip_block.h"
+#include "mm/cache.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/** Marker of a copy of the table ("BBT1") */
+#define BBT_MAGIC 0x31544242u
+
+/** Header of a copy of the table */
+struct _bbt_header {
+	uint32_t magic;
+	uint32_t version;
+	uint16_t num_blocks;
+	uint16_t num_pages;  /**< Pages used by this copy */
+	uint32_t ext_size;
+	uint32_t crc;        /**< CRC-32 of the whole copy, with crc set to 0 */
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+CACHE_ALIGNED static uint8_t page_buf[NAND_MAX_PAGE_DATA_SIZE];
+
+CACHE_ALIGNED static uint8_t spare_buf[NAND_MAX_PAGE_SPARE_SIZE];
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static uint32_t _bbt_crc32(uint32_t crc, const uint8_t *data, uint32_t len)
+{
+	int i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static bool _bbt_test(const struct _nand_bbt *bbt, uint16_t block)
+{
+	return (bbt->bitmap[block / 32] & (1u << (block % 32))) != 0;
+}
+
+static void _bbt_set_bad(struct _nand_bbt *bbt, uint16_t block)
+{
+	bbt->bitmap[block / 32] |= 1u << (block % 32);
+}
+
+static void _bbt_write_marker(struct _nand_bbt *bbt, uint16_t block)
+{
+	memset(spare_buf, 0xff, sizeof(spare_buf));
+	spare_buf[bbt->nand->badblock_marker_pos] = NANDBLOCK_STATUS_BAD;
+	nand_raw_write_page(bbt->nand, block, 0, NULL, spare_buf);
+}
+
+static uint32_t _bbt_bitmap_size(uint16_t num_blocks)
+{
+	return ROUND_UP_MULT(num_blocks, 32) / 8;
+}
+
+static uint16_t _bbt_num_pages(const struct _nand_bbt *bbt, uint32_t ext_size)
+{
+	uint32_t page_size = nand_model_get_page_data_size(&bbt->nand->model);
+	uint32_t size = sizeof(struct _bbt_header) +
+		_bbt_bitmap_size(bbt->num_blocks) + ext_size;
+
+	return (size + page_size - 1) / page_size;
+}
+
+/**
+ * \brief Copy the given range of the bitmap and extension (stored one after
+ * the other in a copy of the table) to the table.
+ */
+static void _bbt_load_range(struct _nand_bbt *bbt,
+		const struct _bbt_header *hdr, uint32_t offset,
+		const uint8_t *data, uint32_t len)
+{
+	uint32_t bitmap_size = _bbt_bitmap_size(hdr->num_blocks);
+	uint32_t count;
+
+	if (offset < bitmap_size) {
+		count = min_u32(len, bitmap_size - offset);
+		memcpy((uint8_t*)bbt->bitmap + offset, data, count);
+		offset += count;
+		data += count;
+		len -= count;
+	}
+	if (len && bbt->ext && hdr->ext_size == bbt->ext_size)
+		memcpy((uint8_t*)bbt->ext + offset - bitmap_size, data, len);
+}
+
+/**
+ * \brief Check a copy of the table, whose first page is in page_buf, and
+ * optionally load it.
+ * \return true if the copy is valid.
+ */
+static bool _bbt_read_copy(struct _nand_bbt *bbt, uint16_t block,
+		uint16_t page, bool load)
+{
+	uint32_t page_size = nand_model_get_page_data_size(&bbt->nand->model);
+	uint32_t hdr_size = sizeof(struct _bbt_header);
+	struct _bbt_header hdr;
+	uint32_t crc, stored_crc, total, offset, start, end;
+	uint16_t i;
+
+	memcpy(&hdr, page_buf, hdr_size);
+	total = hdr_size + _bbt_bitmap_size(hdr.num_blocks) + hdr.ext_size;
+	stored_crc = hdr.crc;
+	hdr.crc = 0;
+	crc = _bbt_crc32(0, (const uint8_t*)&hdr, hdr_size);
+
+	for (i = 0, offset = 0; offset < total; i++, offset += page_size) {
+		if (i > 0 && nand_ecc_read_page(bbt->nand, block, page + i,
+					page_buf, NULL))
+			return false;
+		start = max_u32(offset, hdr_size);
+		end = min_u32(offset + page_size, total);
+		if (start >= end)
+			continue;
+		crc = _bbt_crc32(crc, page_buf + start - offset, end - start);
+		if (load)
+			_bbt_load_range(bbt, &hdr, start - hdr_size,
+					page_buf + start - offset, end - start);
+	}
+
+	return crc == stored_crc;
+}
+
+/**
+ * \brief Check the header of a copy of the table, read in page_buf.
+ */
+static bool _bbt_check_header(const struct _nand_bbt *bbt, uint16_t page,
+		struct _bbt_header *hdr)
+{
+	uint16_t pages_per_block =
+		nand_model_get_block_size_in_pages(&bbt->nand->model);
+
+	memcpy(hdr, page_buf, sizeof(*hdr));
+	return hdr->magic == BBT_MAGIC &&
+		hdr->num_blocks == bbt->num_blocks &&
+		hdr->num_pages == _bbt_num_pages(bbt, hdr->ext_size) &&
+		hdr->num_pages <= pages_per_block - page;
+}
+
+/**
+ * \brief Check that a page has not been programmed since the block was
+ * erased, data and spare area.
+ */
+static bool _bbt_page_is_erased(const struct _nand_bbt *bbt, uint16_t block,
+		uint16_t page)
+{
+	const struct _nand_flash_model *model = &bbt->nand->model;
+	uint32_t page_size = nand_model_get_page_data_size(model);
+	uint32_t spare_size = nand_model_get_page_spare_size(model);
+	uint32_t i;
+
+	if (nand_raw_read_page(bbt->nand, block, page, page_buf, spare_buf))
+		return false;
+	for (i = 0; i < page_size; i++)
+		if (page_buf[i] != 0xff)
+			return false;
+	for (i = 0; i < spare_size; i++)
+		if (spare_buf[i] != 0xff)
+			return false;
+	return true;
+}
+
+/**
+ * \brief Look for the most recent valid copy of the table in the reserved
+ * blocks, and load it.
+ * \return true if a valid copy was found.
+ */
+static bool _bbt_load(struct _nand_bbt *bbt)
+{
+	const struct _nand_flash *nand = bbt->nand;
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	struct _bbt_header hdr;
+	uint16_t block, page;
+	uint16_t best_block = 0, best_page = 0, best_end = 0;
+	uint32_t best_version = 0;
+	bool found = false;
+
+	for (block = bbt->num_blocks - NAND_BBT_RESERVED_BLOCKS;
+	     block < bbt->num_blocks; block++) {
+		if (nand_skipblock_check_block_marker(nand, block) != GOODBLOCK)
+			continue;
+
+		/* Copies are appended one after the other */
+		for (page = 0; page < pages_per_block; page += hdr.num_pages) {
+			if (nand_ecc_read_page(nand, block, page, page_buf, NULL))
+				break;
+			if (!_bbt_check_header(bbt, page, &hdr))
+				break;
+			if (_bbt_read_copy(bbt, block, page, false) &&
+			    (!found || hdr.version > best_version)) {
+				found = true;
+				best_version = hdr.version;
+				best_block = block;
+				best_page = page;
+			}
+		}
+		if (found && best_block == block)
+			best_end = page;
+	}
+
+	if (!found)
+		return false;
+
+	/* A save torn in its first page leaves a partly programmed page after
+	 * the last valid copy, which can't be programmed again: have the next
+	 * save move to another block */
+	if (best_end < pages_per_block &&
+	    !_bbt_page_is_erased(bbt, best_block, best_end))
+		best_end = pages_per_block;
+
+	if (nand_ecc_read_page(nand, best_block, best_page, page_buf, NULL))
+		return false;
+	_bbt_check_header(bbt, best_page, &hdr);
+	if (!_bbt_read_copy(bbt, best_block, best_page, true))
+		return false;
+
+	bbt->table_block = best_block;
+	bbt->table_page = best_end;
+	bbt->version = best_version;
+	bbt->ext_loaded = bbt->ext && hdr.ext_size == bbt->ext_size;
+
+	trace_info("nand_bbt: loaded table v%u from block %u page %u\r\n",
+			(unsigned)best_version, best_block, best_page);
+	return true;
+}
+
+/**
+ * \brief Build the table from the bad block markers of the device.
+ */
+static void _bbt_scan(struct _nand_bbt *bbt)
+{
+	uint16_t block;
+
+	memset(bbt->bitmap, 0, sizeof(bbt->bitmap));
+	for (block = 0; block < bbt->num_blocks; block++) {
+		if (nand_skipblock_check_block_marker(bbt->nand, block) != GOODBLOCK) {
+			trace_info("nand_bbt: block %u is bad\r\n", block);
+			_bbt_set_bad(bbt, block);
+		}
+	}
+}
+
+/**
+ * \brief Write a copy of the table, starting at the given page.
+ */
+static uint8_t _bbt_write_copy(struct _nand_bbt *bbt, uint16_t block,
+		uint16_t page, const struct _bbt_header *hdr)
+{
+	uint32_t page_size = nand_model_get_page_data_size(&bbt->nand->model);
+	const struct {
+		const uint8_t *data;
+		uint32_t size;
+	} seg[] = {
+		{ (const uint8_t*)hdr, sizeof(*hdr) },
+		{ (const uint8_t*)bbt->bitmap, _bbt_bitmap_size(bbt->num_blocks) },
+		{ (const uint8_t*)bbt->ext, hdr->ext_size },
+	};
+	uint32_t s = 0, pos = 0, fill, count;
+	uint16_t i;
+	uint8_t error;
+
+	for (i = 0; i < hdr->num_pages; i++) {
+		memset(page_buf, 0xff, page_size);
+		for (fill = 0; fill < page_size && s < ARRAY_SIZE(seg); fill += count) {
+			count = min_u32(page_size - fill, seg[s].size - pos);
+			if (count)
+				memcpy(page_buf + fill, seg[s].data + pos, count);
+			pos += count;
+			if (pos == seg[s].size) {
+				s++;
+				pos = 0;
+			}
+		}
+		error = nand_ecc_write_page(bbt->nand, block, page + i,
+				page_buf, NULL);
+		if (error)
+			return error;
+	}
+
+	return 0;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the bad block table of a device: load it from the
+ * reserved blocks or, if no valid copy is found, build it from the bad block
+ * markers and store it.
+ * \param bbt  Pointer to a _nand_bbt instance.
+ * \param nand  Pointer to an initialized _nand_flash instance.
+ * \param ext  Optional data stored along with the table (may be NULL).
+ * \param ext_size  Size of the optional data.
+ * \return 0 if successful; otherwise returns an error code. bbt->ext_loaded
+ * tells if the optional data was restored from the device.
+ */
+uint8_t nand_bbt_initialize(struct _nand_bbt *bbt,
+		const struct _nand_flash *nand, void *ext, uint32_t ext_size)
+{
+	uint16_t num_blocks = nand_model_get_device_size_in_blocks(&nand->model);
+
+	if (num_blocks > NAND_BBT_MAX_BLOCKS ||
+	    num_blocks <= NAND_BBT_RESERVED_BLOCKS)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	memset(bbt, 0, sizeof(*bbt));
+	bbt->nand = nand;
+	bbt->num_blocks = num_blocks;
+	bbt->ext = ext;
+	bbt->ext_size = ext ? ext_size : 0;
+
+	/* No table yet: the next copy goes to the first reserved block */
+	bbt->table_block = num_blocks - 1;
+	bbt->table_page = nand_model_get_block_size_in_pages(&nand->model);
+
+	if (_bbt_load(bbt))
+		return 0;
+
+	trace_info("nand_bbt: no valid table, scanning device\r\n");
+	_bbt_scan(bbt);
+	return nand_bbt_save(bbt);
+}
+
+/**
+ * \brief Store a new copy of the table (and of its optional data) after the
+ * last one. Reserved blocks that fail are marked bad and skipped.
+ * \param bbt  Pointer to a _nand_bbt instance.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_bbt_save(struct _nand_bbt *bbt)
+{
+	const struct _nand_flash *nand = bbt->nand;
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint16_t first = bbt->num_blocks - NAND_BBT_RESERVED_BLOCKS;
+	struct _bbt_header hdr;
+	uint16_t block, i;
+	uint8_t error;
+
+	hdr.magic = BBT_MAGIC;
+	hdr.version = bbt->version + 1;
+	hdr.num_blocks = bbt->num_blocks;
+	hdr.ext_size = bbt->ext_size;
+	hdr.num_pages = _bbt_num_pages(bbt, hdr.ext_size);
+	if (hdr.num_pages > pages_per_block)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	for (;;) {
+		if (bbt->table_page + hdr.num_pages > pages_per_block) {
+			/* Move to the next good reserved block */
+			block = bbt->table_block;
+			for (i = 0; i < NAND_BBT_RESERVED_BLOCKS; i++) {
+				block = block + 1 < bbt->num_blocks ? block + 1 : first;
+				if (!_bbt_test(bbt, block))
+					break;
+			}
+			if (i == NAND_BBT_RESERVED_BLOCKS) {
+				trace_error("nand_bbt: no good reserved block left\r\n");
+				return NAND_ERROR_NOMOREBLOCKS;
+			}
+			bbt->table_block = block;
+			bbt->table_page = 0;
+			if (nand_raw_erase_block(nand, block)) {
+				_bbt_write_marker(bbt, block);
+				_bbt_set_bad(bbt, block);
+				bbt->table_page = pages_per_block;
+				continue;
+			}
+		}
+
+		hdr.crc = 0;
+		hdr.crc = _bbt_crc32(0, (const uint8_t*)&hdr, sizeof(hdr));
+		hdr.crc = _bbt_crc32(hdr.crc, (const uint8_t*)bbt->bitmap,
+				_bbt_bitmap_size(bbt->num_blocks));
+		hdr.crc = _bbt_crc32(hdr.crc, (const uint8_t*)bbt->ext,
+				hdr.ext_size);
+
+		error = _bbt_write_copy(bbt, bbt->table_block, bbt->table_page,
+				&hdr);
+		if (!error)
+			break;
+
+		trace_error("nand_bbt: cannot write table in block %u\r\n",
+				bbt->table_block);
+		_bbt_write_marker(bbt, bbt->table_block);
+		_bbt_set_bad(bbt, bbt->table_block);
+		bbt->table_page = pages_per_block;
+	}
+
+	bbt->table_page += hdr.num_pages;
+	bbt->version = hdr.version;
+	return 0;
+}
+
+/**
+ * \brief Mark a block bad, on the device and in the table, then store the
+ * updated table.
+ * \param bbt  Pointer to a _nand_bbt instance.
+ * \param block  Number of the block to mark.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_bbt_mark_bad(struct _nand_bbt *bbt, uint16_t block)
+{
+	if (block >= bbt->num_blocks)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	_bbt_write_marker(bbt, block);
+	_bbt_set_bad(bbt, block);
+	return nand_bbt_save(bbt);
+}
+
+/**
+ * \brief Returns the number of blocks available for data, i.e. the blocks
+ * preceding the ones reserved for the table.
+ * \param bbt  Pointer to a _nand_bbt instance.
+ */
+uint16_t nand_bbt_get_data_blocks(const struct _nand_bbt *bbt)
+{
+	return bbt->num_blocks - NAND_BBT_RESERVED_BLOCKS;
+}
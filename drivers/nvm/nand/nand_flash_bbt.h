@@ -0,0 +1,136 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \page bbt_nand_page NandFlash Bad Block Table
+ *
+ * \section Purpose
+ *
+ * The bad block table keeps the status of every block of the device in RAM,
+ * one bit per block, so that checking a block does not require reading its
+ * bad block markers. The table is built once by scanning the markers, then
+ * stored in blocks reserved at the end of the device and loaded from there at
+ * the next initialization.
+ *
+ * \section Usage
+ * -# nand_bbt_initialize() loads the most recent valid copy of the table, or
+ *      scans the device and stores a new one.
+ * -# nand_bbt_is_bad() returns the status of a block.
+ * -# nand_bbt_mark_bad() marks a block bad, both on the device and in the
+ *      table.
+ * -# nand_skipblock_set_bbt() makes the \ref skip_nand_page layer use the
+ *      table instead of the bad block markers.
+ *
+ * Each copy of the table starts on a page boundary and holds a header, the
+ * bitmap and an optional extension supplied by an upper layer (see
+ * \ref l2p_nand_page), protected by a CRC-32. New copies are appended after
+ * the previous one in the same block, the next reserved block being erased
+ * when the current one is full. The copy with the highest version wins.
+ */
+
+#ifndef NAND_FLASH_BBT_H
+#define NAND_FLASH_BBT_H
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nand_flash.h"
+
+/*---------------------------------------------------------------------- */
+/*         Definitions                                                   */
+/*---------------------------------------------------------------------- */
+
+/** Number of blocks reserved at the end of the device to store the table */
+#ifndef NAND_BBT_RESERVED_BLOCKS
+#define NAND_BBT_RESERVED_BLOCKS 4
+#endif
+
+/** Maximum number of blocks handled by the table */
+#define NAND_BBT_MAX_BLOCKS NAND_MAXNUM_BLOCKS
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+struct _nand_bbt {
+	const struct _nand_flash *nand;
+
+	/** Number of blocks of the device */
+	uint16_t num_blocks;
+
+	/** Block holding the last copy of the table */
+	uint16_t table_block;
+
+	/** First free page after the last copy of the table */
+	uint16_t table_page;
+
+	/** Version of the last copy of the table */
+	uint32_t version;
+
+	/** Optional data stored along with the table */
+	void *ext;
+	uint32_t ext_size;
+
+	/** True if the extension was restored from the device */
+	bool ext_loaded;
+
+	/** Block status, one bit per block, set if the block is bad */
+	uint32_t bitmap[NAND_BBT_MAX_BLOCKS / 32];
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+extern uint8_t nand_bbt_initialize(struct _nand_bbt *bbt,
+		const struct _nand_flash *nand, void *ext, uint32_t ext_size);
+
+extern uint8_t nand_bbt_save(struct _nand_bbt *bbt);
+
+extern uint8_t nand_bbt_mark_bad(struct _nand_bbt *bbt, uint16_t block);
+
+extern uint16_t nand_bbt_get_data_blocks(const struct _nand_bbt *bbt);
+
+/**
+ * \brief Returns true if the given block is bad, or reserved for the table.
+ * \param bbt  Pointer to a _nand_bbt instance.
+ * \param block  Number of the block to check.
+ */
+static inline bool nand_bbt_is_bad(const struct _nand_bbt *bbt, uint16_t block)
+{
+	if (block >= bbt->num_blocks - NAND_BBT_RESERVED_BLOCKS)
+		return true;
+	return (bbt->bitmap[block / 32] & (1u << (block % 32))) != 0;
+}
+
+#endif /* NAND_FLASH_BBT_H */
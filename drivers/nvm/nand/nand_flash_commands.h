@@ -44,6 +44,8 @@
 
 #define NAND_CMD_READ_1             0x00
 #define NAND_CMD_READ_2             0x30
+#define NAND_CMD_READ_CACHE_SEQ     0x31
+#define NAND_CMD_READ_CACHE_END     0x3F
 #define NAND_CMD_READ_A             0x00
 #define NAND_CMD_READ_C             0x50
 #define NAND_CMD_COPYBACK_READ_1    0x00
@@ -56,6 +58,8 @@
 #define NAND_CMD_READID             0x90
 #define NAND_CMD_WRITE_1            0x80
 #define NAND_CMD_WRITE_2            0x10
+#define NAND_CMD_WRITE_MULTIPLANE   0x11
+#define NAND_CMD_WRITE_CACHE        0x15
 #define NAND_CMD_ERASE_1            0x60
 #define NAND_CMD_ERASE_2            0xD0
 #define NAND_CMD_STATUS             0x70
@@ -137,6 +137,50 @@ static uint8_t ecc_write_page_with_pmecc(const struct _nand_flash *nand,
 	return 0;
 }
 
+/**
+ * \brief Verifies, and corrects if needed, a page which has just been read
+ * with the PMECC module during a sequential cache read. The spare area cannot
+ * be read again in the middle of the sequence, so an erased page is
+ * recognized from its redundancy, read along with the data.
+ * \param nand  Pointer to an EccNandFlash instance.
+ * \param block  Number of block the page was read from.
+ * \param page  Number of page inside given block.
+ * \param data  Data area buffer.
+ * \param spare  Spare area, up to the end of the PMECC redundancy.
+ * \return 0 if the data is valid; otherwise returns NAND_ERROR_CORRUPTEDDATA.
+ */
+static uint8_t ecc_check_cached_page_with_pmecc(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, uint8_t *data, const uint8_t *spare)
+{
+	volatile uint32_t pmecc_status;
+	uint32_t i;
+
+	pmecc_status = pmecc_error_status();
+	if (pmecc_status) {
+		/* Check if the redundancy was erased */
+		for (i = pmecc_get_ecc_start_address();
+		     i < pmecc_get_ecc_end_address(); i++) {
+			if (spare[i] != 0xff)
+				break;
+		}
+		if (i == pmecc_get_ecc_end_address())
+			pmecc_status = 0;
+	}
+
+	/* bit correction will be done directly in destination buffer. */
+	if (pmecc_status && pmecc_correction(pmecc_status, (uint32_t)data)) {
+		pmecc_auto_disable();
+		pmecc_disable();
+		trace_error("ecc_check_cached_page_with_pmecc: at B%d.P%d Unrecoverable data\r\n",
+				block, page);
+		return NAND_ERROR_CORRUPTEDDATA;
+	}
+
+	pmecc_auto_disable();
+	pmecc_disable();
+	return 0;
+}
+
 /*------------------------------------------------------------------------------ */
 /*         Exported functions */
 /*------------------------------------------------------------------------------ */
@@ -201,3 +245,98 @@ uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
+
+/**
+ * \brief Reads the data area of all the pages of a block, and verify that the
+ * data is valid. Pages are read with a sequential cache read when supported
+ * by the device, so that the array read of a page overlaps the transfer and
+ * check of the previous one.
+ * \param nand  Pointer to an EccNandFlash instance.
+ * \param block  Number of block to read from.
+ * \param data  Data area buffer.
+ * \return 0 if the data has been read and is valid; otherwise returns either
+ * NAND_ERROR_CORRUPTEDDATA or ...
+ */
+uint8_t nand_ecc_read_block(const struct _nand_flash *nand,
+		uint16_t block, void *data)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint8_t *buf = data;
+	uint8_t error, status = 0;
+	uint16_t page;
+
+	NAND_TRACE("nand_ecc_read_block(B#%d)\r\n", block);
+
+	if (!nand_raw_has_cache_read(nand)) {
+		for (page = 0; page < pages_per_block; page++) {
+			error = nand_ecc_read_page(nand, block, page, buf, NULL);
+			if (error)
+				return error;
+			buf += data_size;
+		}
+		return 0;
+	}
+
+	if (nand_is_using_no_ecc())
+		return nand_raw_read_block(nand, block, data);
+
+	if (!nand_is_using_pmecc())
+		return NAND_ERROR_ECC_NOT_COMPATIBLE;
+
+	error = nand_raw_cache_read_start(nand, block, 0);
+	if (error)
+		return error;
+
+	for (page = 0; page < pages_per_block; page++) {
+		error = nand_raw_cache_read_page(nand, buf, spare_buf,
+				page == pages_per_block - 1);
+		if (error)
+			return error;
+
+		/* Keep on reading after a corrupted page, the sequence has to
+		 * be ended */
+		error = ecc_check_cached_page_with_pmecc(nand, block, page,
+				buf, spare_buf);
+		if (error && !status)
+			status = error;
+		buf += data_size;
+	}
+
+	return status;
+}
+
+/**
+ * \brief Writes the data area of all the pages of consecutive blocks, with
+ * ECC redundancy. Cache and multi-plane program are used when supported by
+ * the device.
+ * \param nand Pointer to an EccNandFlash instance.
+ * \param block  Number of the first block to write in.
+ * \param num_blocks  Number of blocks to write.
+ * \param data  Data area buffer.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_ecc_write_blocks(const struct _nand_flash *nand,
+	uint16_t block, uint16_t num_blocks, void *data)
+{
+	NAND_TRACE("nand_ecc_write_blocks(B#%d, %d)\r\n", block, num_blocks);
+
+	if (nand_is_using_pmecc() || nand_is_using_no_ecc())
+		return nand_raw_write_blocks(nand, block, num_blocks, data);
+
+	return NAND_ERROR_ECC_NOT_COMPATIBLE;
+}
+
+/**
+ * \brief Writes the data area of all the pages of a block, with ECC
+ * redundancy.
+ * \param nand Pointer to an EccNandFlash instance.
+ * \param block  Number of the block to write in.
+ * \param data  Data area buffer.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_ecc_write_block(const struct _nand_flash *nand,
+	uint16_t block, void *data)
+{
+	return nand_ecc_write_blocks(nand, block, 1, data);
+}
@@ -45,6 +45,9 @@
  * -# nand_ecc_read_page() is used to read a NANDFLASH page with ECC check, the function
  *      will read out data and spare first, then it calculates ECC with data and then compare with
  *      the readout ECC, and feedback the ECC check result to PMECC driver.
+ * -# nand_ecc_read_block(), nand_ecc_write_block() and nand_ecc_write_blocks()
+ *      do the same for whole blocks, using the cache and multi-plane
+ *      operations of the device when available.
 */
 
 #ifndef NAND_FLASH_ECC_H
@@ -70,4 +73,13 @@ extern uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
 		uint16_t block, uint16_t page,
 		void *data, void *spare);
 
+extern uint8_t nand_ecc_read_block(const struct _nand_flash *nand,
+		uint16_t block, void *data);
+
+extern uint8_t nand_ecc_write_blocks(const struct _nand_flash *nand,
+		uint16_t block, uint16_t num_blocks, void *data);
+
+extern uint8_t nand_ecc_write_block(const struct _nand_flash *nand,
+		uint16_t block, void *data);
+
 #endif /* NAND_FLASH_ECC_H */
@@ -0,0 +1,374 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/*----------------------------------------------------------------------------
+ *        Headers
+ *----------------------------------------------------------------------------*/
+
+#include "chip.h"
+#include "trace.h"
+
+#include "nand_flash_l2p.h"
+#include "nand_flash_ecc.h"
+#include "nand_flash_raw.h"
+#include "mm/cache.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+CACHE_ALIGNED static uint8_t page_buf[NAND_MAX_PAGE_DATA_SIZE];
+
+/*----------------------------------------------------------------------------
+ *        Local functions
+ *----------------------------------------------------------------------------*/
+
+static bool _l2p_is_used(const struct _nand_l2p *l2p, uint16_t block)
+{
+	return (l2p->used[block / 32] & (1u << (block % 32))) != 0;
+}
+
+static void _l2p_set_used(struct _nand_l2p *l2p, uint16_t block, bool used)
+{
+	if (used)
+		l2p->used[block / 32] |= 1u << (block % 32);
+	else
+		l2p->used[block / 32] &= ~(1u << (block % 32));
+}
+
+static void _l2p_remap(struct _nand_l2p *l2p, uint16_t block, uint16_t phys)
+{
+	if (l2p->table.map[block] != NAND_L2P_UNMAPPED)
+		_l2p_set_used(l2p, l2p->table.map[block], false);
+	l2p->table.map[block] = phys;
+	_l2p_set_used(l2p, phys, true);
+}
+
+/**
+ * \brief Returns the least worn good block not used by the mapping, or
+ * NAND_L2P_UNMAPPED if there is none left.
+ */
+static uint16_t _l2p_find_free(const struct _nand_l2p *l2p)
+{
+	uint16_t data_blocks = nand_bbt_get_data_blocks(&l2p->bbt);
+	uint16_t block, best = NAND_L2P_UNMAPPED;
+
+	for (block = 0; block < data_blocks; block++) {
+		if (nand_bbt_is_bad(&l2p->bbt, block) || _l2p_is_used(l2p, block))
+			continue;
+		if (best == NAND_L2P_UNMAPPED ||
+		    l2p->table.erase_count[block] < l2p->table.erase_count[best])
+			best = block;
+	}
+
+	return best;
+}
+
+/**
+ * \brief Map a logical block to a freshly erased spare block. Spare blocks
+ * that fail to erase are marked bad.
+ */
+static uint8_t _l2p_replace(struct _nand_l2p *l2p, uint16_t block)
+{
+	uint16_t phys;
+	uint8_t error;
+
+	for (;;) {
+		phys = _l2p_find_free(l2p);
+		if (phys == NAND_L2P_UNMAPPED) {
+			trace_error("nand_l2p: no spare block left\r\n");
+			return NAND_ERROR_NOMOREBLOCKS;
+		}
+		l2p->table.erase_count[phys]++;
+		if (!nand_raw_erase_block(l2p->bbt.nand, phys))
+			break;
+		error = nand_bbt_mark_bad(&l2p->bbt, phys);
+		if (error)
+			return error;
+	}
+
+	_l2p_remap(l2p, block, phys);
+	return 0;
+}
+
+/**
+ * \brief Copy the written pages of a block to another one, replacing the
+ * given page by new data. Pages that cannot be read are lost.
+ * \return 0 or NAND_ERROR_CANNOTWRITE if the destination block failed.
+ */
+static uint8_t _l2p_copy_block(struct _nand_l2p *l2p, uint16_t src,
+		uint16_t dest, uint16_t page, void *data)
+{
+	const struct _nand_flash *nand = l2p->bbt.nand;
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint32_t page_size = nand_model_get_page_data_size(&nand->model);
+	uint32_t j;
+	uint16_t i;
+
+	for (i = 0; i < pages_per_block; i++) {
+		if (i == page) {
+			if (nand_ecc_write_page(nand, dest, i, data, NULL))
+				return NAND_ERROR_CANNOTWRITE;
+			continue;
+		}
+		if (nand_ecc_read_page(nand, src, i, page_buf, NULL)) {
+			trace_error("nand_l2p: lost page %u of block %u\r\n",
+					i, src);
+			continue;
+		}
+		/* Skip erased pages, they must stay programmable */
+		for (j = 0; j < page_size && page_buf[j] == 0xff; j++);
+		if (j == page_size)
+			continue;
+		if (nand_ecc_write_page(nand, dest, i, page_buf, NULL))
+			return NAND_ERROR_CANNOTWRITE;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Create a mapping of the good blocks, keeping spare_blocks of them
+ * unmapped.
+ */
+static uint8_t _l2p_build(struct _nand_l2p *l2p, uint16_t spare_blocks)
+{
+	uint16_t data_blocks = nand_bbt_get_data_blocks(&l2p->bbt);
+	uint16_t block, good = 0;
+
+	for (block = 0; block < data_blocks; block++)
+		if (!nand_bbt_is_bad(&l2p->bbt, block))
+			good++;
+	if (good <= spare_blocks)
+		return NAND_ERROR_NOMOREBLOCKS;
+
+	memset(&l2p->table, 0, sizeof(l2p->table));
+	memset(l2p->table.map, 0xff, sizeof(l2p->table.map));
+	memset(l2p->used, 0, sizeof(l2p->used));
+	l2p->table.num_logical = good - spare_blocks;
+
+	for (block = 0, good = 0; good < l2p->table.num_logical; block++)
+		if (!nand_bbt_is_bad(&l2p->bbt, block))
+			_l2p_remap(l2p, good++, block);
+
+	return 0;
+}
+
+/**
+ * \brief Check a mapping loaded from the device and rebuild the list of used
+ * blocks.
+ */
+static bool _l2p_check(struct _nand_l2p *l2p)
+{
+	uint16_t data_blocks = nand_bbt_get_data_blocks(&l2p->bbt);
+	uint16_t block, phys;
+
+	memset(l2p->used, 0, sizeof(l2p->used));
+	if (l2p->table.num_logical == 0 || l2p->table.num_logical > data_blocks)
+		return false;
+
+	for (block = 0; block < l2p->table.num_logical; block++) {
+		phys = l2p->table.map[block];
+		if (phys >= data_blocks || _l2p_is_used(l2p, phys))
+			return false;
+		_l2p_set_used(l2p, phys, true);
+	}
+
+	return true;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize the logical block mapping of a device.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ * \param nand  Pointer to an initialized _nand_flash instance.
+ * \param spare_blocks  Number of good blocks kept to replace failing blocks
+ * and for wear levelling, when creating the mapping.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_l2p_initialize(struct _nand_l2p *l2p,
+		const struct _nand_flash *nand, uint16_t spare_blocks)
+{
+	uint16_t block;
+	bool changed = false;
+	uint8_t error;
+
+	l2p->pending = 0;
+	error = nand_bbt_initialize(&l2p->bbt, nand, &l2p->table,
+			sizeof(l2p->table));
+	if (error)
+		return error;
+
+	if (!l2p->bbt.ext_loaded || !_l2p_check(l2p)) {
+		trace_info("nand_l2p: no valid mapping, creating it\r\n");
+		error = _l2p_build(l2p, spare_blocks);
+		if (error)
+			return error;
+		return nand_bbt_save(&l2p->bbt);
+	}
+
+	/* Replace the blocks marked bad without updating the mapping */
+	for (block = 0; block < l2p->table.num_logical; block++) {
+		if (!nand_bbt_is_bad(&l2p->bbt, l2p->table.map[block]))
+			continue;
+		trace_warning("nand_l2p: block %u lost\r\n", block);
+		error = _l2p_replace(l2p, block);
+		if (error)
+			return error;
+		changed = true;
+	}
+
+	return changed ? nand_bbt_save(&l2p->bbt) : 0;
+}
+
+/**
+ * \brief Returns the number of logical blocks.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ */
+uint16_t nand_l2p_get_num_blocks(const struct _nand_l2p *l2p)
+{
+	return l2p->table.num_logical;
+}
+
+/**
+ * \brief Read the data of a page, with ECC verification.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ * \param block  Number of the logical block.
+ * \param page  Number of the page in the block.
+ * \param data  Buffer for the page data.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_l2p_read_page(struct _nand_l2p *l2p,
+		uint16_t block, uint16_t page, void *data)
+{
+	if (block >= l2p->table.num_logical)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	return nand_ecc_read_page(l2p->bbt.nand, l2p->table.map[block], page,
+			data, NULL);
+}
+
+/**
+ * \brief Write the data of a page, with ECC calculation. If the write fails,
+ * the block is replaced by a spare block and marked bad.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ * \param block  Number of the logical block.
+ * \param page  Number of the page in the block.
+ * \param data  Page data.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_l2p_write_page(struct _nand_l2p *l2p,
+		uint16_t block, uint16_t page, void *data)
+{
+	uint16_t old, phys;
+	uint8_t error;
+
+	if (block >= l2p->table.num_logical)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	old = l2p->table.map[block];
+	if (!nand_ecc_write_page(l2p->bbt.nand, old, page, data, NULL))
+		return 0;
+
+	trace_warning("nand_l2p: write failed in block %u, relocating\r\n", old);
+	for (;;) {
+		error = _l2p_replace(l2p, block);
+		if (error)
+			return error;
+		phys = l2p->table.map[block];
+		if (!_l2p_copy_block(l2p, old, phys, page, data))
+			break;
+		error = nand_bbt_mark_bad(&l2p->bbt, phys);
+		if (error)
+			return error;
+	}
+
+	/* Also stores the new mapping */
+	return nand_bbt_mark_bad(&l2p->bbt, old);
+}
+
+/**
+ * \brief Erase a logical block, moving it to a less worn block if needed.
+ * If the erasure fails, the block is replaced by a spare block and marked bad.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ * \param block  Number of the logical block.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_l2p_erase_block(struct _nand_l2p *l2p, uint16_t block)
+{
+	uint16_t phys, spare;
+	bool remapped = false;
+	uint8_t error;
+
+	if (block >= l2p->table.num_logical)
+		return NAND_ERROR_OUTOFBOUNDS;
+
+	/* Dynamic wear levelling: the previous content is discarded anyway */
+	phys = l2p->table.map[block];
+	spare = _l2p_find_free(l2p);
+	if (spare != NAND_L2P_UNMAPPED &&
+	    l2p->table.erase_count[phys] >=
+	    l2p->table.erase_count[spare] + NAND_L2P_WEAR_THRESHOLD) {
+		_l2p_remap(l2p, block, spare);
+		phys = spare;
+		remapped = true;
+	}
+
+	l2p->table.erase_count[phys]++;
+	if (nand_raw_erase_block(l2p->bbt.nand, phys)) {
+		trace_warning("nand_l2p: erase failed in block %u\r\n", phys);
+		error = _l2p_replace(l2p, block);
+		if (error)
+			return error;
+		/* Also stores the new mapping */
+		return nand_bbt_mark_bad(&l2p->bbt, phys);
+	}
+
+	if (remapped || ++l2p->pending >= NAND_L2P_FLUSH_PERIOD)
+		return nand_l2p_flush(l2p);
+	return 0;
+}
+
+/**
+ * \brief Store the mapping and the erase counters.
+ * \param l2p  Pointer to a _nand_l2p instance.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_l2p_flush(struct _nand_l2p *l2p)
+{
+	l2p->pending = 0;
+	return nand_bbt_save(&l2p->bbt);
+}
@@ -0,0 +1,132 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \page l2p_nand_page NandFlash Logical Block Mapping
+ *
+ * \section Purpose
+ *
+ * The logical block mapping layer maps logical blocks to good physical
+ * blocks, so that upper layers see a contiguous range of blocks without
+ * having to skip bad ones. It also spreads erasures over the device: when a
+ * logical block is erased, it is moved to the least worn spare block if its
+ * current block has been erased NAND_L2P_WEAR_THRESHOLD times more.
+ *
+ * \section Usage
+ * -# nand_l2p_initialize() loads the \ref bbt_nand_page and the mapping
+ *      stored with it, or creates a mapping keeping the given number of good
+ *      blocks as spares.
+ * -# nand_l2p_read_page(), nand_l2p_write_page() and nand_l2p_erase_block()
+ *      access the device using logical block numbers. A block that fails to
+ *      be written or erased is marked bad and replaced by a spare block, the
+ *      pages already written being copied.
+ * -# nand_l2p_flush() stores the erase counters, which are otherwise only
+ *      stored when the mapping changes or every NAND_L2P_FLUSH_PERIOD
+ *      erasures.
+ */
+
+#ifndef NAND_FLASH_L2P_H
+#define NAND_FLASH_L2P_H
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+
+#include "nand_flash.h"
+#include "nand_flash_bbt.h"
+
+/*---------------------------------------------------------------------- */
+/*         Definitions                                                   */
+/*---------------------------------------------------------------------- */
+
+/** Difference of erase counts from which a logical block is moved to a
+ * spare block when erased */
+#ifndef NAND_L2P_WEAR_THRESHOLD
+#define NAND_L2P_WEAR_THRESHOLD 16
+#endif
+
+/** Number of erasures after which the erase counters are stored */
+#ifndef NAND_L2P_FLUSH_PERIOD
+#define NAND_L2P_FLUSH_PERIOD 64
+#endif
+
+/** Value of a map entry without physical block */
+#define NAND_L2P_UNMAPPED 0xffff
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+/** Mapping stored along with the bad block table */
+struct _nand_l2p_table {
+	/** Number of logical blocks */
+	uint16_t num_logical;
+	uint16_t reserved;
+
+	/** Physical block of each logical block */
+	uint16_t map[NAND_BBT_MAX_BLOCKS];
+
+	/** Number of erasures of each physical block */
+	uint32_t erase_count[NAND_BBT_MAX_BLOCKS];
+};
+
+struct _nand_l2p {
+	struct _nand_bbt bbt;
+
+	struct _nand_l2p_table table;
+
+	/** Physical blocks in use, one bit per block */
+	uint32_t used[NAND_BBT_MAX_BLOCKS / 32];
+
+	/** Erasures counted since the table was last stored */
+	uint16_t pending;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+extern uint8_t nand_l2p_initialize(struct _nand_l2p *l2p,
+		const struct _nand_flash *nand, uint16_t spare_blocks);
+
+extern uint16_t nand_l2p_get_num_blocks(const struct _nand_l2p *l2p);
+
+extern uint8_t nand_l2p_read_page(struct _nand_l2p *l2p,
+		uint16_t block, uint16_t page, void *data);
+
+extern uint8_t nand_l2p_write_page(struct _nand_l2p *l2p,
+		uint16_t block, uint16_t page, void *data);
+
+extern uint8_t nand_l2p_erase_block(struct _nand_l2p *l2p, uint16_t block);
+
+extern uint8_t nand_l2p_flush(struct _nand_l2p *l2p);
+
+#endif /* NAND_FLASH_L2P_H */
@@ -155,3 +155,25 @@ bool nand_model_has_small_blocks(const struct _nand_flash_model *model)
 {
 	return model->page_size <= 512 ? 1 : 0;
 }
+
+/**
+ * \brief Returns true if the given NandFlash model supports the given optional
+ * operation.
+ * \param model  Pointer to a _nand_flash_model instance.
+ * \param option  One of the NAND_OPT_xxx values.
+*/
+bool nand_model_has_option(const struct _nand_flash_model *model,
+		uint8_t option)
+{
+	return (model->options & option) == option;
+}
+
+/**
+ * \brief Returns the number of planes of a NandFlash device, which can be
+ * accessed together by multi-plane operations.
+ * \param model  Pointer to a _nand_flash_model instance.
+*/
+uint8_t nand_model_get_num_planes(const struct _nand_flash_model *model)
+{
+	return model->num_planes ? model->num_planes : 1;
+}
@@ -49,6 +49,8 @@
  *    - nand_model_get_page_spare_size
  *    - nand_model_get_data_bus_width
  *    - nand_model_has_small_blocks
+ *    - nand_model_has_option
+ *    - nand_model_get_num_planes
  */
 
 #ifndef NAND_FLASH_MODEL_H
@@ -61,6 +63,16 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/*---------------------------------------------------------------------- */
+/*         Definitions                                                   */
+/*---------------------------------------------------------------------- */
+
+/** Optional operations supported by a NandFlash model */
+#define NAND_OPT_CACHE_READ          (1 << 0)
+#define NAND_OPT_CACHE_PROGRAM       (1 << 1)
+#define NAND_OPT_MULTIPLANE_PROGRAM  (1 << 2)
+#define NAND_OPT_MULTIPLANE_CACHE    (1 << 3)
+
 /*---------------------------------------------------------------------- */
 /*         Types                                                         */
 /*---------------------------------------------------------------------- */
@@ -84,6 +96,13 @@ struct _nand_flash_model {
 
 	/** Size of one block, in bytes. */
 	uint32_t block_size;
+
+	/** Optional operations supported by the device (NAND_OPT_xxx). */
+	uint8_t options;
+
+	/** Number of planes, 0 or 1 if multi-plane operations are not
+	 * supported. */
+	uint8_t num_planes;
 };
 
 /*---------------------------------------------------------------------- */
@@ -123,6 +142,12 @@ extern uint8_t nand_model_get_data_bus_width(
 extern bool nand_model_has_small_blocks(
 		const struct _nand_flash_model *model);
 
+extern bool nand_model_has_option(const struct _nand_flash_model *model,
+		uint8_t option);
+
+extern uint8_t nand_model_get_num_planes(
+		const struct _nand_flash_model *model);
+
 /**@}*/
 
 #endif /* NAND_FLASH_MODEL_H */
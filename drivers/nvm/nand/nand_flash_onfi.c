@@ -134,6 +134,9 @@ static bool nand_onfi_retrieve_param(const struct _nand_flash *nand)
 		onfi_parameter.onfi_compatible = true;
 		/* Bus width */
 		onfi_parameter.bus_width = (onfi_param_table[6] & 0x01) ? 16 : 8;
+		/* Features supported and optional commands supported */
+		memcpy(&onfi_parameter.features, &onfi_param_table[6], 2);
+		memcpy(&onfi_parameter.opt_commands, &onfi_param_table[8], 2);
 		/* Manufacturer */
 		memcpy(onfi_parameter.manufacturer, &onfi_param_table[32], 12);
 		onfi_parameter.manufacturer[12] = 0;
@@ -154,6 +157,9 @@ static bool nand_onfi_retrieve_param(const struct _nand_flash *nand)
 		onfi_parameter.logical_units = onfi_param_table[100];
 		/* Number of bits of ECC correction */
 		onfi_parameter.ecc_correctability = onfi_param_table[112];
+		/* Multi-plane addressing and operation attributes */
+		onfi_parameter.plane_addr_bits = onfi_param_table[113] & 0x0f;
+		onfi_parameter.multiplane_attr = onfi_param_table[114];
 
 		trace_info_wp("ONFI manuf_id 0x%02x\r\n",
 				onfi_parameter.manuf_id);
@@ -173,6 +179,11 @@ static bool nand_onfi_retrieve_param(const struct _nand_flash *nand)
 				(unsigned)onfi_parameter.logical_units);
 		trace_info_wp("ONFI ecc_correctability %d\r\n",
 				onfi_parameter.ecc_correctability);
+		trace_info_wp("ONFI features 0x%04x opt_commands 0x%04x\r\n",
+				(unsigned)onfi_parameter.features,
+				(unsigned)onfi_parameter.opt_commands);
+		trace_info_wp("ONFI planes %d\r\n",
+				(unsigned)nand_onfi_get_num_planes());
 		return true;
 	}
 
@@ -243,6 +254,23 @@ uint8_t nand_onfi_get_ecc_correctability(void)
 	return onfi_parameter.ecc_correctability;
 }
 
+bool nand_onfi_has_cache_read(void)
+{
+	return (onfi_parameter.opt_commands & ONFI_OPT_CMD_CACHE_READ) != 0;
+}
+
+bool nand_onfi_has_cache_program(void)
+{
+	return (onfi_parameter.opt_commands & ONFI_OPT_CMD_CACHE_PROGRAM) != 0;
+}
+
+uint8_t nand_onfi_get_num_planes(void)
+{
+	if (!(onfi_parameter.features & ONFI_FEATURE_MULTIPLANE))
+		return 1;
+	return 1 << onfi_parameter.plane_addr_bits;
+}
+
 /**
  * \brief This function check if the NANDFLASH has an embedded ECC controller.
  * \return false if ONFI not compliant or internal ECC not supported, true if Internal ECC enabled.
@@ -332,6 +360,17 @@ bool nand_onfi_get_model(struct _nand_flash_model *model)
 		model->spare_size = nand_onfi_get_spare_size();
 		model->block_size = nand_onfi_get_pages_per_block() * nand_onfi_get_page_size();
 		model->device_size = ((model->block_size / 1024) * nand_onfi_get_blocks_per_lun()) / 1024;
+		model->options = 0;
+		if (nand_onfi_has_cache_read())
+			model->options |= NAND_OPT_CACHE_READ;
+		if (nand_onfi_has_cache_program())
+			model->options |= NAND_OPT_CACHE_PROGRAM;
+		model->num_planes = nand_onfi_get_num_planes();
+		if (model->num_planes > 1) {
+			model->options |= NAND_OPT_MULTIPLANE_PROGRAM;
+			if (onfi_parameter.multiplane_attr & ONFI_MULTIPLANE_CACHE_PROGRAM)
+				model->options |= NAND_OPT_MULTIPLANE_CACHE;
+		}
 		return true;
 	}
 	return false;
@@ -46,6 +46,18 @@
 #define NAND_IO_RC_FAIL    1
 #define NAND_IO_RC_TIMEOUT 2
 
+/** ONFI features supported (parameter page bytes 6-7) */
+#define ONFI_FEATURE_16BIT          (1 << 0)
+#define ONFI_FEATURE_MULTI_LUN      (1 << 1)
+#define ONFI_FEATURE_MULTIPLANE     (1 << 3)
+
+/** ONFI optional commands supported (parameter page bytes 8-9) */
+#define ONFI_OPT_CMD_CACHE_PROGRAM  (1 << 0)
+#define ONFI_OPT_CMD_CACHE_READ     (1 << 1)
+
+/** ONFI multi-plane operation attributes (parameter page byte 114) */
+#define ONFI_MULTIPLANE_CACHE_PROGRAM (1 << 2)
+
 /** Describes memory organization block information in ONFI parameter page */
 struct _onfi_page_param {
 	/** ONFI compatible */
@@ -63,6 +75,12 @@ struct _onfi_page_param {
 	/** Bus width */
 	uint8_t bus_width;
 
+	/** Features supported (ONFI_FEATURE_xxx) */
+	uint16_t features;
+
+	/** Optional commands supported (ONFI_OPT_CMD_xxx) */
+	uint16_t opt_commands;
+
 	/** Number of data bytes per page. */
 	uint32_t page_size;
 
@@ -80,6 +98,12 @@ struct _onfi_page_param {
 
 	/** Number of bits of ECC correction */
 	uint8_t ecc_correctability;
+
+	/** Number of plane address bits */
+	uint8_t plane_addr_bits;
+
+	/** Multi-plane operation attributes (ONFI_MULTIPLANE_xxx) */
+	uint8_t multiplane_attr;
 };
 
 /*--------------------------------------------------------------------- */
@@ -110,6 +134,12 @@ extern uint16_t nand_onfi_get_blocks_per_lun(void);
 
 extern uint8_t nand_onfi_get_ecc_correctability(void);
 
+extern bool nand_onfi_has_cache_read(void);
+
+extern bool nand_onfi_has_cache_program(void);
+
+extern uint8_t nand_onfi_get_num_planes(void);
+
 extern bool nand_onfi_get_model(struct _nand_flash_model *model);
 
 #endif /* NAND_FLASH_ONFI_H */
@@ -76,6 +76,9 @@
 
 CACHE_ALIGNED static uint8_t ecc_table[NAND_MAX_PMECC_BYTE_SIZE];
 
+/* Spare area read along with the data of a page checked by the PMECC */
+CACHE_ALIGNED static uint8_t spare_buf[NAND_MAX_PAGE_SPARE_SIZE];
+
 /*------------------------------------------------------------------------*/
 /*        Local Functions                                                 */
 /*------------------------------------------------------------------------*/
@@ -335,11 +338,17 @@ static void _data_array_out(const struct _nand_flash *nand, bool nfc_sram,
 }
 
 /**
- * \brief Use STATUS command to determine if the last issued command was successful.
+ * \brief Use STATUS command to wait until the given ready bits are set, then
+ * check the given failure bits.
  * \param nand  Pointer to a struct _nand_flash instance.
- * \return 0 if the last command issued was successful, NAND_ERROR_STATUS otherwise
+ * \param ready_mask  Status bits to wait for (NAND_STATUS_RDY and/or
+ * NAND_STATUS_ARDY).
+ * \param fail_mask  Status bits reporting a failure (NAND_STATUS_FAIL and/or
+ * NAND_STATUS_FAILC), 0 to only wait.
+ * \return 0 if none of the failure bits is set, NAND_ERROR_STATUS otherwise
  */
-static uint8_t _status_ready_pass(const struct _nand_flash *nand)
+static uint8_t _status_ready_check(const struct _nand_flash *nand,
+		uint8_t ready_mask, uint8_t fail_mask)
 {
 	int i;
 
@@ -351,11 +360,11 @@ static uint8_t _status_ready_pass(const struct _nand_flash *nand)
 		uint8_t status = nand_read_data(nand);
 
 		/* Check if device is ready */
-		if ((status & NAND_STATUS_RDY) == 0)
+		if ((status & ready_mask) != ready_mask)
 			continue;
 
-		/* Check if last command was successful */
-		if ((status & NAND_STATUS_FAIL) == 0)
+		/* Check if last command(s) were successful */
+		if ((status & fail_mask) == 0)
 			return 0;
 		else
 			return NAND_ERROR_STATUS;
@@ -364,6 +373,16 @@ static uint8_t _status_ready_pass(const struct _nand_flash *nand)
 	return NAND_ERROR_STATUS;
 }
 
+/**
+ * \brief Use STATUS command to determine if the last issued command was successful.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \return 0 if the last command issued was successful, NAND_ERROR_STATUS otherwise
+ */
+static uint8_t _status_ready_pass(const struct _nand_flash *nand)
+{
+	return _status_ready_check(nand, NAND_STATUS_RDY, NAND_STATUS_FAIL);
+}
+
 /**
  * \brief Waiting for the completion of a page program, erase and random read completion.
  * \param nand  Pointer to a struct _nand_flash instance.
@@ -542,12 +561,19 @@ static uint8_t _read_page_with_pmecc(const struct _nand_flash *nand,
 	/* Start a Data Phase */
 	pmecc_start_data_phase();
 #ifdef CONFIG_HAVE_NFC
-	_data_array_in(nand, nand_is_nfc_sram_enabled(),
-	               data, data_size + pmecc_get_ecc_end_address());
-#else
-	_data_array_in(nand, false,
-	               data, data_size + pmecc_get_ecc_end_address());
+	if (nand_is_nfc_sram_enabled()) {
+		/* The whole page went through the PMECC on its way to the
+		 * SRAM, only the data area is needed */
+		_data_array_in(nand, true, data, data_size);
+	} else
 #endif
+	{
+		/* The PMECC also needs the redundancy, keep it out of the
+		 * caller buffer */
+		_data_array_in(nand, false, data, data_size);
+		_data_array_in(nand, false, spare_buf,
+		               pmecc_get_ecc_end_address());
+	}
 
 	/* Wait until the kernel of the PMECC is not busy */
 	pmecc_wait_ready();
@@ -632,6 +658,30 @@ static uint8_t _write_page(const struct _nand_flash *nand,
 	return error;
 }
 
+/**
+ * \brief Waits for the PMECC to complete the redundancy of the page which has
+ * just been transferred to the NANDFLASH, and transfers the redundancy.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ */
+static void _pmecc_write_ecc(const struct _nand_flash *nand)
+{
+	uint32_t ecc_bytes_per_sector;
+	uint8_t nb_sectors_per_page;
+	uint32_t i, j;
+
+	/* Wait until the kernel of the PMECC is not busy */
+	pmecc_wait_ready();
+	nb_sectors_per_page = pmecc_get_sectors_per_page();
+	ecc_bytes_per_sector = pmecc_get_ecc_bytes_per_page() / nb_sectors_per_page;
+
+	/* Read all ECC registers */
+	for (i = 0; i < nb_sectors_per_page; i++)
+		for (j = 0; j < ecc_bytes_per_sector; j++)
+			ecc_table[i * ecc_bytes_per_sector + j] = pmecc_value(i, j);
+
+	_data_array_out(nand, false, ecc_table, pmecc_get_ecc_bytes_per_page(), 0);
+}
+
 /**
  * \brief Writes the data and/or the spare area of a page on a NandFlash chip. If one
  * of the buffer pointer is 0, the corresponding area is not written.
@@ -648,9 +698,6 @@ static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
 	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
 	uint32_t row_address;
 	uint32_t ecc_start_addr;
-	uint32_t ecc_bytes_per_sector;
-	uint8_t nb_sectors_per_page;
-	uint32_t i, j;
 
 	NAND_TRACE("_write_page_with_pmecc(B#%d:P#%d)\r\n", block, page);
 
@@ -695,17 +742,7 @@ static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
 	_send_cle_ale(nand, CLE_WRITE_EN | ALE_COL_EN,
 	              NAND_CMD_RANDOM_IN, 0, ecc_start_addr, 0);
 
-	/* Wait until the kernel of the PMECC is not busy */
-	pmecc_wait_ready();
-	nb_sectors_per_page = pmecc_get_sectors_per_page();
-	ecc_bytes_per_sector = pmecc_get_ecc_bytes_per_page() / nb_sectors_per_page;
-
-	/* Read all ECC registers */
-	for (i = 0; i < nb_sectors_per_page; i++)
-		for (j = 0; j < ecc_bytes_per_sector; j++)
-			ecc_table[i * ecc_bytes_per_sector + j] = pmecc_value(i, j);
-
-	_data_array_out(nand, false, ecc_table, pmecc_get_ecc_bytes_per_page(), 0);
+	_pmecc_write_ecc(nand);
 	_send_cle_ale(nand, CLE_WRITE_EN, NAND_CMD_WRITE_2, 0, 0, 0);
 
 #ifdef CONFIG_HAVE_NFC
@@ -725,6 +762,118 @@ static uint8_t _write_page_with_pmecc(const struct _nand_flash *nand,
 	return error;
 }
 
+/**
+ * \brief Returns true if command sequences spanning several pages (cache and
+ * multi-plane operations) can be issued, i.e. if data is not transferred
+ * through the NFC SRAM, whose transfers are tied to single page commands.
+ */
+static bool _multi_page_cmd_allowed(const struct _nand_flash *nand)
+{
+	if (nand_model_has_small_blocks(&nand->model))
+		return false;
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_sram_enabled())
+		return false;
+#endif
+	return true;
+}
+
+/**
+ * \brief Loads the data area of a page in the page register of the device,
+ * followed by its PMECC redundancy if the PMECC is in use, then issues the
+ * given program confirm command.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block where the page to write resides.
+ * \param page  Number of the page to write inside the given block.
+ * \param data  Buffer containing the data area.
+ * \param cmd2  NAND_CMD_WRITE_2, NAND_CMD_WRITE_CACHE or
+ * NAND_CMD_WRITE_MULTIPLANE.
+ */
+static void _program_page(const struct _nand_flash *nand,
+	uint16_t block, uint16_t page, uint8_t *data, uint8_t cmd2)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+	uint32_t row_address;
+
+	NAND_TRACE("_program_page(B#%d:P#%d, 0x%02x)\r\n", block, page, cmd2);
+
+	row_address = block * nand_model_get_block_size_in_pages(&nand->model) + page;
+
+	if (nand_is_using_pmecc()) {
+		pmecc_reset();
+		pmecc_enable_write();
+		pmecc_start_data_phase();
+	}
+
+	_send_cle_ale(nand, CLE_WRITE_EN | ALE_COL_EN | ALE_ROW_EN,
+	              NAND_CMD_WRITE_1, 0, 0, row_address);
+	_data_array_out(nand, false, data, data_size, 0);
+
+	if (nand_is_using_pmecc()) {
+		_send_cle_ale(nand, CLE_WRITE_EN | ALE_COL_EN, NAND_CMD_RANDOM_IN,
+		              0, data_size + pmecc_get_ecc_start_address(), 0);
+		_pmecc_write_ecc(nand);
+		pmecc_disable();
+	}
+
+	_send_cle_ale(nand, CLE_WRITE_EN, cmd2, 0, 0, 0);
+}
+
+/**
+ * \brief Writes the data area of all the pages of consecutive blocks,
+ * issuing one multi-plane program for the same page of every block, and
+ * using cache program between pages if supported.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the first block, in the first plane if more than
+ * one block is written.
+ * \param num_blocks  Number of blocks, either one or the number of planes.
+ * \param data  Buffer containing the data of the blocks, one after the other.
+ * \param cache  True to use cache program.
+ * \return 0 if successful; otherwise returns NAND_ERROR_CANNOTWRITE.
+ */
+static uint8_t _program_blocks(const struct _nand_flash *nand,
+	uint16_t block, uint16_t num_blocks, uint8_t *data, bool cache)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint32_t block_size = pages_per_block * data_size;
+	uint16_t page, i;
+	bool last;
+
+	for (page = 0; page < pages_per_block; page++) {
+		/* All planes but the last one: wait for the short tDBSY busy
+		 * time, the page register being programmed with the others */
+		for (i = 0; i < num_blocks - 1; i++) {
+			_program_page(nand, block + i, page,
+			              data + i * block_size + page * data_size,
+			              NAND_CMD_WRITE_MULTIPLANE);
+			_status_ready_check(nand, NAND_STATUS_RDY, 0);
+		}
+
+		/* Last plane: with cache program, only wait until the cache
+		 * register is available again, the previous page being
+		 * programmed while the next one is transferred */
+		last = page == pages_per_block - 1;
+		_program_page(nand, block + i, page,
+		              data + i * block_size + page * data_size,
+		              cache && !last ? NAND_CMD_WRITE_CACHE : NAND_CMD_WRITE_2);
+		if (_status_ready_check(nand, NAND_STATUS_RDY, cache ?
+				NAND_STATUS_FAIL | NAND_STATUS_FAILC :
+				NAND_STATUS_FAIL)) {
+			trace_error("_program_blocks: Failed writing B#%d:P#%d.\r\n",
+					block, page);
+			/* Let a cache program in progress complete, then
+			 * reset so that the next cache program does not
+			 * report this failure through FAILC */
+			_status_ready_check(nand, NAND_STATUS_ARDY, 0);
+			nand_raw_reset(nand);
+			return NAND_ERROR_CANNOTWRITE;
+		}
+	}
+
+	return 0;
+}
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
@@ -881,3 +1030,225 @@ uint8_t nand_raw_write_page(const struct _nand_flash *nand,
 
 	return NAND_ERROR_ECC_NOT_COMPATIBLE;
 }
+
+/**
+ * \brief Returns true if sequential cache read can be used with the current
+ * model and configuration, i.e. if nand_raw_cache_read_start() and
+ * nand_raw_cache_read_page() can be called.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ */
+bool nand_raw_has_cache_read(const struct _nand_flash *nand)
+{
+	return nand_model_has_option(&nand->model, NAND_OPT_CACHE_READ) &&
+		_multi_page_cmd_allowed(nand);
+}
+
+/**
+ * \brief Starts a sequential cache read: the given page is loaded in the data
+ * register of the device. Each call to nand_raw_cache_read_page() then moves
+ * the current page to the cache register and transfers it, while the device
+ * loads the next page from the array.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block where the first page resides.
+ * \param page  Number of the first page inside the given block.
+ * \return 0 if successful; otherwise returns NAND_ERROR_CANNOTREAD.
+ */
+uint8_t nand_raw_cache_read_start(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page)
+{
+	uint32_t row_address;
+
+	NAND_TRACE("nand_raw_cache_read_start(B#%d:P#%d)\r\n", block, page);
+
+	assert(nand_raw_has_cache_read(nand));
+
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_enabled())
+		nfc_configure(nand_model_get_page_data_size(&nand->model),
+		              nand_model_get_page_spare_size(&nand->model),
+		              false, false);
+#endif
+
+	row_address = block * nand_model_get_block_size_in_pages(&nand->model) + page;
+	_send_cle_ale(nand, ALE_COL_EN | ALE_ROW_EN | CLE_VCMD2_EN,
+	              NAND_CMD_READ_1, NAND_CMD_READ_2, 0, row_address);
+
+	/* Wait tR */
+	if (_status_ready_check(nand, NAND_STATUS_RDY, 0)) {
+		trace_error("nand_raw_cache_read_start: Device not ready.\r\n");
+		nand_raw_reset(nand);
+		return NAND_ERROR_CANNOTREAD;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Transfers the next page of a sequential cache read, started with
+ * nand_raw_cache_read_start(). If the PMECC is in use, the spare area up to
+ * the end of the redundancy is transferred to the spare buffer and the PMECC
+ * status is left for the caller to check, as for nand_raw_read_page().
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param data  Buffer where the data area will be stored.
+ * \param spare  Buffer of NAND_MAX_PAGE_SPARE_SIZE bytes where the spare
+ * area is stored if the PMECC is in use, can be 0 otherwise.
+ * \param last  True for the last page of the sequence, in which case no
+ * further page is loaded from the array.
+ * \return 0 if successful; otherwise returns NAND_ERROR_CANNOTREAD.
+ */
+uint8_t nand_raw_cache_read_page(const struct _nand_flash *nand,
+		void *data, void *spare, bool last)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+
+	_send_cle_ale(nand, 0, last ? NAND_CMD_READ_CACHE_END :
+	              NAND_CMD_READ_CACHE_SEQ, 0, 0, 0);
+
+	/* Wait tRCBSY, only the copy to the cache register */
+	if (_status_ready_check(nand, NAND_STATUS_RDY, 0)) {
+		trace_error("nand_raw_cache_read_page: Device not ready.\r\n");
+		nand_raw_reset(nand);
+		return NAND_ERROR_CANNOTREAD;
+	}
+
+	/* Re-enable data output mode required after Read Status command */
+	_send_cle_ale(nand, 0, NAND_CMD_READ_1, 0, 0, 0);
+
+	if (nand_is_using_pmecc()) {
+		pmecc_reset();
+		pmecc_enable_read();
+		if (!pmecc_auto_spare_en())
+			pmecc_auto_enable();
+		pmecc_start_data_phase();
+		_data_array_in(nand, false, data, data_size);
+		_data_array_in(nand, false, spare, pmecc_get_ecc_end_address());
+		pmecc_wait_ready();
+		pmecc_auto_disable();
+	} else {
+		_data_array_in(nand, false, data, data_size);
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Reads the data area of all the pages of a block, using sequential
+ * cache read if supported by the device.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block to read.
+ * \param data  Buffer where the data of the block will be stored.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_raw_read_block(const struct _nand_flash *nand,
+		uint16_t block, void *data)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint8_t *buf = data;
+	uint8_t error;
+	uint16_t page;
+
+	NAND_TRACE("nand_raw_read_block(B#%d)\r\n", block);
+
+	if (!nand_raw_has_cache_read(nand)) {
+		for (page = 0; page < pages_per_block; page++) {
+			error = nand_raw_read_page(nand, block, page, buf, NULL);
+			if (error)
+				return error;
+			buf += data_size;
+		}
+		return 0;
+	}
+
+	error = nand_raw_cache_read_start(nand, block, 0);
+	for (page = 0; !error && page < pages_per_block; page++) {
+		error = nand_raw_cache_read_page(nand, buf, spare_buf,
+				page == pages_per_block - 1);
+		buf += data_size;
+	}
+
+	return error;
+}
+
+/**
+ * \brief Writes the data area of all the pages of consecutive blocks. Blocks
+ * are programmed by groups of one block per plane with multi-plane program,
+ * and pages are chained with cache program, when supported by the device.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the first block to write.
+ * \param num_blocks  Number of blocks to write.
+ * \param data  Buffer containing the data of the blocks, one after the other.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_raw_write_blocks(const struct _nand_flash *nand,
+		uint16_t block, uint16_t num_blocks, void *data)
+{
+	uint32_t data_size = nand_model_get_page_data_size(&nand->model);
+	uint16_t pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
+	uint8_t num_planes = nand_model_get_num_planes(&nand->model);
+	bool multiplane = nand_model_has_option(&nand->model,
+			NAND_OPT_MULTIPLANE_PROGRAM) && num_planes > 1;
+	uint8_t *buf = data;
+	uint16_t count, page;
+	uint8_t error;
+
+	NAND_TRACE("nand_raw_write_blocks(B#%d, %d)\r\n", block, num_blocks);
+
+	if (!_multi_page_cmd_allowed(nand) || (!multiplane &&
+	    !nand_model_has_option(&nand->model, NAND_OPT_CACHE_PROGRAM))) {
+		for (; num_blocks; block++, num_blocks--) {
+			for (page = 0; page < pages_per_block; page++) {
+				error = nand_raw_write_page(nand, block, page,
+						buf, NULL);
+				if (error)
+					return error;
+				buf += data_size;
+			}
+		}
+		return 0;
+	}
+
+#ifdef CONFIG_HAVE_NFC
+	if (nand_is_nfc_enabled())
+		nfc_configure(data_size,
+		              nand_model_get_page_spare_size(&nand->model),
+		              false, false);
+#endif
+
+	while (num_blocks) {
+		/* One block per plane, as long as the blocks are aligned on
+		 * the planes */
+		if (multiplane && (block % num_planes) == 0 &&
+		    num_blocks >= num_planes)
+			count = num_planes;
+		else
+			count = 1;
+
+		error = _program_blocks(nand, block, count, buf,
+				nand_model_has_option(&nand->model, count > 1 ?
+					NAND_OPT_CACHE_PROGRAM | NAND_OPT_MULTIPLANE_CACHE :
+					NAND_OPT_CACHE_PROGRAM));
+		if (error)
+			return error;
+
+		block += count;
+		num_blocks -= count;
+		buf += count * pages_per_block * data_size;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Writes the data area of all the pages of a block, using cache
+ * program if supported by the device.
+ * \param nand  Pointer to a struct _nand_flash instance.
+ * \param block  Number of the block to write.
+ * \param data  Buffer containing the data of the block.
+ * \return 0 if successful; otherwise returns an error code.
+ */
+uint8_t nand_raw_write_block(const struct _nand_flash *nand,
+		uint16_t block, void *data)
+{
+	return nand_raw_write_blocks(nand, block, 1, data);
+}
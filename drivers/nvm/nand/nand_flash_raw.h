@@ -46,6 +46,12 @@
  * -# nand_raw_read_page() and nand_raw_write_page is used to do read/write operation.
  * -# nand_raw_copy_page() is used to issue copy-page command to NANDFLASH device.
  * -# nand_raw_copy_block() calls nand_raw_copy_page to do a NANDFLASH block copy.
+ * -# nand_raw_read_block(), nand_raw_write_block() and nand_raw_write_blocks()
+ *      transfer whole blocks, using the ONFI cache read, cache program and
+ *      multi-plane program operations when the model supports them.
+ * -# nand_raw_cache_read_start() and nand_raw_cache_read_page() give access to
+ *      the pages of a sequential cache read one at a time, for instance to
+ *      check the ECC of each page.
 */
 
 
@@ -57,6 +63,7 @@
 /*------------------------------------------------------------------------------ */
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "gpio/pio.h"
 
@@ -91,4 +98,21 @@ extern uint8_t nand_raw_copy_page(const struct _nand_flash *nand,
 extern uint8_t nand_raw_copy_block(const struct _nand_flash *nand,
 		uint16_t source_block, uint16_t dest_block);
 
+extern bool nand_raw_has_cache_read(const struct _nand_flash *nand);
+
+extern uint8_t nand_raw_cache_read_start(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page);
+
+extern uint8_t nand_raw_cache_read_page(const struct _nand_flash *nand,
+		void *data, void *spare, bool last);
+
+extern uint8_t nand_raw_read_block(const struct _nand_flash *nand,
+		uint16_t block, void *data);
+
+extern uint8_t nand_raw_write_blocks(const struct _nand_flash *nand,
+		uint16_t block, uint16_t num_blocks, void *data);
+
+extern uint8_t nand_raw_write_block(const struct _nand_flash *nand,
+		uint16_t block, void *data);
+
 #endif /* NAND_FLASH_RAW_H */
@@ -37,6 +37,7 @@
 #include "trace.h"
 
 #include "nand_flash_skip_block.h"
+#include "nand_flash_bbt.h"
 #include "nand_flash_raw.h"
 #include "nand_flash_ecc.h"
 #include "mm/cache.h"
@@ -50,19 +51,23 @@
 
 CACHE_ALIGNED static uint8_t spare_buf[NAND_MAX_PAGE_SPARE_SIZE];
 
+/** Bad block table used instead of the bad block markers, if set */
+static struct _nand_bbt *skipblock_bbt;
+
 /*----------------------------------------------------------------------------
  *        Exported functions
  *----------------------------------------------------------------------------*/
 
 /**
- * \brief Returns BADBLOCK if the given block of a NANDFLASH device is bad; returns
- * GOODBLOCK if the block is good; or returns a NandCommon_ERROR code.
+ * \brief Returns BADBLOCK if the bad block markers of the given block of a
+ * NANDFLASH device are set; returns GOODBLOCK if the block is good; or returns
+ * a NandCommon_ERROR code.
  *
  * \param nand  Pointer to a _raw_nand_flash instance.
  * \param block  Number of block to check.
  */
 
-uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
+uint8_t nand_skipblock_check_block_marker(const struct _nand_flash *nand,
 		uint16_t block)
 {
 	uint8_t error;
@@ -71,7 +76,7 @@ uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
 	/* Read spare area of first page of block */
 	error = nand_raw_read_page(nand, block, 0, NULL, spare_buf);
 	if (error) {
-		trace_error("nand_skipblock_check_block: "
+		trace_error("nand_skipblock_check_block_marker: "
 				"Cannot read page #0 of block #%d\r\n", block);
 		return error;
 	}
@@ -82,7 +87,7 @@ uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
 	/* Read spare area of second page of block */
 	error = nand_raw_read_page(nand, block, 1, NULL, spare_buf);
 	if (error) {
-		trace_error("nand_skipblock_check_block: "
+		trace_error("nand_skipblock_check_block_marker: "
 				"Cannot read page #1 of block #%d\r\n", block);
 		return error;
 	}
@@ -93,6 +98,36 @@ uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
 	return GOODBLOCK;
 }
 
+/**
+ * \brief Use a bad block table to check the status of the blocks, instead of
+ * reading their bad block markers.
+ *
+ * \param bbt  Pointer to an initialized _nand_bbt instance, or NULL to read
+ * the markers again.
+ */
+void nand_skipblock_set_bbt(struct _nand_bbt *bbt)
+{
+	skipblock_bbt = bbt;
+}
+
+/**
+ * \brief Returns BADBLOCK if the given block of a NANDFLASH device is bad; returns
+ * GOODBLOCK if the block is good; or returns a NandCommon_ERROR code.
+ * When a bad block table is set, the blocks reserved for it are reported bad.
+ *
+ * \param nand  Pointer to a _raw_nand_flash instance.
+ * \param block  Number of block to check.
+ */
+
+uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
+		uint16_t block)
+{
+	if (skipblock_bbt)
+		return nand_bbt_is_bad(skipblock_bbt, block) ? BADBLOCK : GOODBLOCK;
+
+	return nand_skipblock_check_block_marker(nand, block);
+}
+
 /**
  * \brief Erases a block of a SkipBlock NandFlash.
  * \param nand  Pointer to a _raw_nand_flash instance.
@@ -119,6 +154,9 @@ uint8_t nand_skipblock_erase_block(struct _nand_flash *nand,
 		/* Try to mark the block as BAD */
 		trace_error("nand_skipblock_erase_block: Cannot erase block, try to mark it BAD\r\n");
 
+		if (skipblock_bbt)
+			return nand_bbt_mark_bad(skipblock_bbt, block);
+
 		memset(spare_buf, 0xff, sizeof(spare_buf));
 		spare_buf[nand->badblock_marker_pos] = NANDBLOCK_STATUS_BAD;
 		return nand_raw_write_page(nand, block, 0, 0, spare_buf);
@@ -156,22 +194,16 @@ uint8_t nand_skipblock_read_page(const struct _nand_flash *nand,
  * \brief Reads the data of a whole block on a SkipBlock nandflash.
  * \param nand  Pointer to a _raw_nand_flash instance.
  * \param block  Number of block to read page from.
- * \param data  Data area buffer, can be 0.
+ * \param data  Data area buffer, of the size of a block.
  * \return NAND_ERROR_BADBLOCK if the block is BAD; Otherwise, returns
- * nand_ecc_read_page().
+ * nand_ecc_read_block().
 */
 
 uint8_t nand_skipblock_read_block(const struct _nand_flash *nand,
 	uint16_t block, void *data)
 {
-	uint32_t num_pages_per_block, page_size;
-	uint16_t i;
 	uint8_t error = 0;
 
-	/* Retrieve model information */
-	page_size = nand_model_get_page_data_size(&nand->model);
-	num_pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
-
 	/* Check that the block is not BAD if data is requested */
 	if (nand_skipblock_check_block(nand, block) != GOODBLOCK) {
 
@@ -180,13 +212,10 @@ uint8_t nand_skipblock_read_block(const struct _nand_flash *nand,
 	}
 
 	/* Read all the pages of the block */
-	for (i = 0; i < num_pages_per_block; i++) {
-		error = nand_ecc_read_page(nand, block, i, data, 0);
-		if (error) {
-			trace_error("nand_skipblock_read_block: Cannot read page %d of block %d.\r\n", i, block);
-			return error;
-		}
-		data = (void*)((uint8_t*)data + page_size);
+	error = nand_ecc_read_block(nand, block, data);
+	if (error) {
+		trace_error("nand_skipblock_read_block: Cannot read block %d.\r\n", block);
+		return error;
 	}
 
 	return 0;
@@ -228,27 +257,18 @@ uint8_t nand_skipblock_write_page(const struct _nand_flash *nand,
 uint8_t nand_skipblock_write_block(const struct _nand_flash *nand,
 	uint16_t block, void *data)
 {
-	uint32_t num_pages_per_block, page_size;
-	uint16_t i;
 	uint8_t error = 0;
 
-	/* Retrieve model information */
-	page_size = nand_model_get_page_data_size(&nand->model);
-	num_pages_per_block = nand_model_get_block_size_in_pages(&nand->model);
-
 	/* Check that the block is LIVE */
 	if (nand_skipblock_check_block(nand, block) != GOODBLOCK) {
 		trace_error("nand_skipblock_write_block: Block is BAD.\r\n");
 		return NAND_ERROR_BADBLOCK;
 	}
 
-	for (i = 0; i < num_pages_per_block; i++) {
-		error = nand_ecc_write_page(nand, block, i, data, 0);
-		if (error) {
-			trace_error("nand_skipblock_write_block: Cannot write page %d of block %d.\r\n", i, block);
-			return NAND_ERROR_CANNOTWRITE;
-		}
-		data = (void*)((uint8_t*)data + page_size);
+	error = nand_ecc_write_block(nand, block, data);
+	if (error) {
+		trace_error("nand_skipblock_write_block: Cannot write block %d.\r\n", block);
+		return NAND_ERROR_CANNOTWRITE;
 	}
 
 	return 0;
@@ -76,7 +76,8 @@
 /** Do NOT check the block status before erasing it */
 #define SCRUB_ERASE  0x0000EA11
 
-/** Values returned by the nand_skipblock_check_block() function */
+/** Values returned by the nand_skipblock_check_block() and
+ * nand_skipblock_check_block_marker() functions */
 #define BADBLOCK     0xFF
 #define GOODBLOCK    0XFE
 
@@ -84,6 +85,13 @@
 /*         Exported functions                                            */
 /*---------------------------------------------------------------------- */
 
+struct _nand_bbt;
+
+extern uint8_t nand_skipblock_check_block_marker(const struct _nand_flash *nand,
+		uint16_t block);
+
+extern void nand_skipblock_set_bbt(struct _nand_bbt *bbt);
+
 extern uint8_t nand_skipblock_check_block(const struct _nand_flash *nand,
 		uint16_t block);
 
@@ -46,8 +46,18 @@
 /*         Local definitions                                                  */
 /*--------------------------------------------------------------------------- */
 
+/** Use the PMERRLOC peripheral for the Chien search unless the software
+ * search is forced (CONFIG_PMECC_SW_ERROR_LOCATION) */
+#if defined(PMERRLOC) && !defined(CONFIG_PMECC_SW_ERROR_LOCATION)
+#define PMECC_HW_ERROR_LOCATION
+#endif
+
 /** defines the maximum value of the error correcting capability */
+#ifdef PMERRLOC
 #define PMECC_NB_ERROR_MAX (ARRAY_SIZE(PMERRLOC->PMERRLOC_EL) + 1)
+#else
+#define PMECC_NB_ERROR_MAX (32 + 1)
+#endif
 
 /*--------------------------------------------------------------------------- */
 /*         Local types                                                        */
@@ -90,6 +100,9 @@ struct _pmecc_desc {
 
 	/** polynom order */
 	int16_t lmu[PMECC_NB_ERROR_MAX + 1];
+
+	/** error positions (1-based bit index) of the sector being corrected */
+	uint32_t err_pos[PMECC_NB_ERROR_MAX];
 };
 
 /*--------------------------------------------------------------------------- */
@@ -119,6 +132,17 @@ static void gen_partial_syndromes(uint32_t sector)
 		pmecc_desc.partial_syn[1 + (2 * i)] = remainder[i];
 }
 
+/**
+ * \brief Add two Galois field indexes modulo nn.
+ * Both indexes must be in the range [0, nn), so a single conditional
+ * subtraction replaces the division of the % operator.
+ */
+static inline int32_t gf_index_add(int32_t a, int32_t b)
+{
+	int32_t sum = a + b;
+	return sum >= pmecc_desc.nn ? sum - pmecc_desc.nn : sum;
+}
+
 /**
  * \brief The substitute function evaluates the polynomial remainder,
  * with different values of the field primitive elements.
@@ -126,23 +150,21 @@ static void gen_partial_syndromes(uint32_t sector)
 static uint32_t substitute(void)
 {
 	int32_t i, j;
-	int16_t *si;
+	int16_t *si = pmecc_desc.si;
 	int16_t *partial_syn = pmecc_desc.partial_syn;
 	const int16_t *alpha_to = pmecc_desc.alpha_to;
 	const int16_t *index_of = pmecc_desc.index_of;
 
-	/* si[] is a table that holds the current syndrome value, an element of that table belongs to the field.*/
-	memset(pmecc_desc.si, 0, sizeof(pmecc_desc.si));
-	si = pmecc_desc.si;
-
 	/* Computation 2t syndromes based on S(x) */
-	/* Odd syndromes */
+	/* Odd syndromes: i * j never exceeds (2 * tt - 1) * (mm - 1) < nn */
 	for (i = 1; i <= 2 * pmecc_desc.tt - 1; i = i + 2) {
-		si[i] = 0;
-		for (j = 0; j < pmecc_desc.mm; j++) {
-			if (partial_syn[i] & ((uint16_t)0x1 << j))
-				si[i] = alpha_to[(i * j)] ^ si[i];
+		uint16_t syn = partial_syn[i];
+		int16_t value = 0;
+		for (j = 0; syn; j++, syn >>= 1) {
+			if (syn & 1)
+				value ^= alpha_to[i * j];
 		}
+		si[i] = value;
 	}
 	/* Even syndrome = (Odd syndrome) ** 2 */
 	for (i = 2; i <= 2 * pmecc_desc.tt; i = i + 2) {
@@ -150,7 +172,7 @@ static uint32_t substitute(void)
 		if (si[j] == 0) {
 			si[i] = 0;
 		} else {
-			si[i] = alpha_to[(2 * index_of[si[j]]) % pmecc_desc.nn];
+			si[i] = alpha_to[gf_index_add(index_of[si[j]], index_of[si[j]])];
 		}
 	}
 	return 0;
@@ -159,6 +181,8 @@ static uint32_t substitute(void)
 /**
  * \brief The substitute function finding the value of the error
  * location polynomial.
+ * Only the live coefficients (up to the current polynom order) of each
+ * smu[] row are written and read.
  */
 static uint32_t get_sigma(void)
 {
@@ -167,6 +191,9 @@ static uint32_t get_sigma(void)
 	int16_t *lmu = pmecc_desc.lmu;
 	int16_t *si = pmecc_desc.si;
 	int16_t tt = pmecc_desc.tt;
+	int32_t nn = pmecc_desc.nn;
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+	const int16_t *index_of = pmecc_desc.index_of;
 
 	int32_t mu[PMECC_NB_ERROR_MAX + 1]; /* mu */
 	int32_t dmu[PMECC_NB_ERROR_MAX + 1]; /* discrepancy */
@@ -174,6 +201,7 @@ static uint32_t get_sigma(void)
 	int32_t ro; /* index of largest delta */
 	int32_t largest;
 	int32_t diff;
+	int32_t scale;
 
 	dmu_0_count = 0;
 
@@ -183,9 +211,6 @@ static uint32_t get_sigma(void)
 	mu[0]  = -1;
 	/* Actually -1/2 */
 	/* Sigma(x) set to 1 */
-
-	for (i = 0; i < (2 * PMECC_NB_ERROR_MAX + 1); i++)
-		pmecc_desc.smu[0][i] = 0;
 	pmecc_desc.smu[0][0] = 1;
 
 	/* discrepancy set to 1 */
@@ -203,8 +228,6 @@ static uint32_t get_sigma(void)
 	mu[1] = 0;
 
 	/* Sigma(x) set to 1 */
-	for (i = 0; i < (2 * PMECC_NB_ERROR_MAX + 1); i++)
-		pmecc_desc.smu[1][i] = 0;
 	pmecc_desc.smu[1][0] = 1;
 
 	/* discrepancy set to S1 */
@@ -216,10 +239,6 @@ static uint32_t get_sigma(void)
 	/* delta set to 0 */
 	delta[1]  = (mu[1] * 2 - lmu[1]) >> 1;
 
-	/* Init the Sigma(x) last row */
-	for (i = 0; i < (2 * PMECC_NB_ERROR_MAX + 1); i++)
-		pmecc_desc.smu[tt + 1][i] = 0;
-
 	for (i = 1; i <= tt; i++) {
 		mu[i+1] = i << 1;
 
@@ -230,14 +249,14 @@ static uint32_t get_sigma(void)
 			dmu_0_count++;
 			if ((tt - (lmu[i] >> 1) - 1) & 0x1) {
 				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 2) {
-					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+					for (j = 0; j <= (lmu[i] >> 1); j++)
 						pmecc_desc.smu[tt+1][j] = pmecc_desc.smu[i][j];
 					lmu[tt + 1] = lmu[i];
 					return 0;
 				}
 			} else {
 				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 1) {
-					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+					for (j = 0; j <= (lmu[i] >> 1); j++)
 						pmecc_desc.smu[tt + 1][j] = pmecc_desc.smu[i][j];
 					lmu[tt + 1] = lmu[i];
 					return 0;
@@ -272,16 +291,20 @@ static uint32_t get_sigma(void)
 			else
 				lmu[i + 1] = ((lmu[ro] >> 1) + diff) * 2;
 
-			/* Init smu[i+1] with 0 */
-			for (k = 0; k < (2 * PMECC_NB_ERROR_MAX + 1); k++)
+			/* Init the live coefficients of smu[i+1] with 0 */
+			for (k = 0; k <= (lmu[i + 1] >> 1); k++)
 				pmecc_desc.smu[i+1][k] = 0;
 
+			/* dmu[i] / dmu[ro] does not depend on k */
+			scale = index_of[dmu[i]] - index_of[dmu[ro]];
+			if (scale < 0)
+				scale += nn;
+
 			/* Compute smu[i+1] */
 			for (k = 0; k <= (lmu[ro] >> 1); k++) {
-				if (pmecc_desc.smu[ro][k] && dmu[i])
-					pmecc_desc.smu[i + 1][k + diff] = pmecc_desc.alpha_to[(pmecc_desc.index_of[dmu[i]] +
-							(pmecc_desc.nn - pmecc_desc.index_of[dmu[ro]]) +
-							pmecc_desc.index_of[pmecc_desc.smu[ro][k]]) % pmecc_desc.nn];
+				if (pmecc_desc.smu[ro][k])
+					pmecc_desc.smu[i + 1][k + diff] = alpha_to[gf_index_add(scale,
+							index_of[pmecc_desc.smu[ro][k]])];
 			}
 			for (k = 0; k <= (lmu[i] >> 1); k++)
 				pmecc_desc.smu[i+1][k] ^= pmecc_desc.smu[i][k];
@@ -296,19 +319,20 @@ static uint32_t get_sigma(void)
 
 		/* Do not compute discrepancy for the last iteration */
 		if (i < tt) {
-			for (k = 0 ; k <= (lmu[i + 1] >> 1); k++) {
-				if (k == 0)
-					dmu[i + 1] = si[2 * (i - 1) + 3];
+			dmu[i + 1] = si[2 * (i - 1) + 3];
+			for (k = 1 ; k <= (lmu[i + 1] >> 1); k++) {
 				/* check if one operand of the multiplier is null, its index is -1 */
-				else if (pmecc_desc.smu[i+1][k] && si[2 * (i - 1) + 3 - k])
-					dmu[i + 1] = pmecc_desc.alpha_to[(pmecc_desc.index_of[pmecc_desc.smu[i + 1][k]] +
-							pmecc_desc.index_of[si[2 * (i - 1) + 3 - k]]) % pmecc_desc.nn] ^ dmu[i + 1];
+				if (pmecc_desc.smu[i+1][k] && si[2 * (i - 1) + 3 - k])
+					dmu[i + 1] ^= alpha_to[gf_index_add(index_of[pmecc_desc.smu[i + 1][k]],
+							index_of[si[2 * (i - 1) + 3 - k]])];
 			}
 		}
 	}
 	return 0;
 }
 
+#ifdef PMECC_HW_ERROR_LOCATION
+
 /**
  * \brief Init the PMECC Error Location peripheral and start the error
  *        location processing
@@ -337,15 +361,75 @@ static int32_t error_location(uint32_t sector_size_in_bits)
 
 	nbr_of_roots = (PMERRLOC->PMERRLOC_ISR & PMERRLOC_ISR_ERR_CNT_Msk) >> PMERRLOC_ISR_ERR_CNT_Pos;
 	/* Number of roots == degree of smu hence <= tt */
-	if (nbr_of_roots == (uint32_t)(pmecc_desc.lmu[pmecc_desc.tt + 1] >> 1))
-		return error_number;
+	if (nbr_of_roots != error_number)
+		/* Number of roots not match the degree of smu ==> unable to correct error */
+		return -1;
+
+	for (i = 0; i < error_number; i++)
+		pmecc_desc.err_pos[i] = PMERRLOC->PMERRLOC_EL[i];
+
+	return error_number;
+}
+
+#else /* !PMECC_HW_ERROR_LOCATION */
+
+/**
+ * \brief Software Chien search of the error location polynomial roots.
+ * An error on bit position p (1-based, same numbering as the PMERRLOC_EL
+ * registers) is a root of sigma(x) at x = alpha^-(p-1). The terms of
+ * sigma are kept in logarithmic form and stepped by -k for each
+ * position, so no multiplication or modulo is done in the search loop.
+ * \param sector_size_in_bits Size of the sector in bits.
+ * \return Number of errors
+ */
+static int32_t error_location(uint32_t sector_size_in_bits)
+{
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+	const int16_t *index_of = pmecc_desc.index_of;
+	const int16_t *sigma = pmecc_desc.smu[pmecc_desc.tt + 1];
+	int32_t nn = pmecc_desc.nn;
+	int32_t log_term[PMECC_NB_ERROR_MAX + 1];
+	int32_t error_number, nbr_of_roots, k;
+	uint32_t pos;
+
+	error_number = pmecc_desc.lmu[pmecc_desc.tt + 1] >> 1;
+	if (error_number == 0)
+		return 0;
+
+	for (k = 1; k <= error_number; k++)
+		log_term[k] = sigma[k] ? index_of[sigma[k]] : -1;
+
+	nbr_of_roots = 0;
+	for (pos = 1; pos <= sector_size_in_bits; pos++) {
+		int16_t value = sigma[0];
+
+		for (k = 1; k <= error_number; k++) {
+			if (log_term[k] < 0)
+				continue;
+			value ^= alpha_to[log_term[k]];
+			log_term[k] -= k;
+			if (log_term[k] < 0)
+				log_term[k] += nn;
+		}
+
+		if (value == 0) {
+			pmecc_desc.err_pos[nbr_of_roots++] = pos;
+			if (nbr_of_roots == error_number)
+				break;
+		}
+	}
 
 	/* Number of roots not match the degree of smu ==> unable to correct error */
-	return -1;
+	if (nbr_of_roots != error_number)
+		return -1;
+
+	return error_number;
 }
 
+#endif /* !PMECC_HW_ERROR_LOCATION */
+
 /**
- * \brief Correct errors indicated in the PMECCEL error location registers.
+ * \brief Correct errors found by error_location().
  * \param sector_base_address Base address of the sector.
  * \param error_nbr Number of error to correct
  * \return Number of errors
@@ -358,7 +442,7 @@ static void error_correction(uint32_t sector_base_address, uint32_t error_nbr)
 	sector_size = pmecc_get_sector_size();
 
 	for (i = 0; i < error_nbr; i++) {
-		uint32_t error_pos = PMERRLOC->PMERRLOC_EL[i];
+		uint32_t error_pos = pmecc_desc.err_pos[i];
 		uint32_t byte_pos = (error_pos - 1) >> 3;
 		uint32_t bit_pos = (error_pos - 1) & 7;
 
@@ -369,10 +453,7 @@ static void error_correction(uint32_t sector_base_address, uint32_t error_nbr)
 			trace_debug("Fixing incorrect bit @[Byte %u, Bit %u]\n\r",
 					(unsigned)byte_pos, (unsigned)bit_pos);
 
-			if (*data_ptr & (1 << bit_pos))
-				*data_ptr &= (0xff ^ (1 << bit_pos));
-			else
-				*data_ptr |= (1 << bit_pos);
+			*data_ptr ^= (1 << bit_pos);
 		}
 	}
 }
@@ -763,8 +844,10 @@ uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
 	sector_size = pmecc_get_sector_size();
 	sector_count = pmecc_get_sectors_per_page();
 
+#ifdef PMECC_HW_ERROR_LOCATION
 	/* Set the sector size (512 or 1024 bytes) */
 	PMERRLOC->PMERRLOC_CFG = sector_size == 1024 ? PMERRLOC_CFG_SECTORSZ : 0;
+#endif
 
 	for (sector = 0; sector < sector_count; sector++) {
 		if (pmecc_status & 1) {
@@ -69,6 +69,7 @@ struct sfdp_parameter_header {
 
 
 #define SFDP_BFPT_ID		0xff00u	/* Basic Flash Parameter Table */
+#define SFDP_SMPT_ID		0xff81u	/* Sector Map Parameter Table */
 #define SFDP_4BAIT_ID		0xff84u	/* 4-byte Address Instruction Table */
 
 #define SFDP_SIGNATURE		0x50444653u
@@ -428,6 +429,267 @@ static int spi_flash_parse_bfpt(struct spi_flash *flash,
 	return 0;
 }
 
+/* 4-byte Address Instruction Table */
+
+#define SFDP_4BAIT_DWORD_MAX	2
+
+/* 1st DWORD: Erase Type n is supported with a 4-byte address instruction. */
+#define SFDP_4BAIT_ERASE_TYPE(n)	(0x1UL << (9 + (n)))
+
+struct sfdp_4bait {
+	/* The hardware capability. */
+	uint32_t hwcaps;
+
+	/*
+	 * The <supported_bit> bit in the 1st DWORD of the 4BAIT tells us
+	 * whether the associated 4-byte address instruction is supported.
+	 */
+	uint32_t supported_bit;
+
+	/* The 4-byte address instruction. */
+	uint8_t inst;
+};
+
+/*
+ * The x-x-x protocols have no bit of their own in the 4BAIT: they use the
+ * 4-byte address instruction of their 1-x-x (1-1-1 for Page Program 4-4-4)
+ * counterpart, since their 3-byte address instruction is the same.
+ */
+static const struct sfdp_4bait sfdp_4bait_reads[] = {
+	{ SFLASH_HWCAPS_READ,       (0x1UL << 0), SFLASH_INST_READ_4B },
+	{ SFLASH_HWCAPS_READ_FAST,  (0x1UL << 1), SFLASH_INST_FAST_READ_4B },
+	{ SFLASH_HWCAPS_READ_1_1_2, (0x1UL << 2), SFLASH_INST_FAST_READ_1_1_2_4B },
+	{ SFLASH_HWCAPS_READ_1_2_2, (0x1UL << 3), SFLASH_INST_FAST_READ_1_2_2_4B },
+	{ SFLASH_HWCAPS_READ_2_2_2, (0x1UL << 3), SFLASH_INST_FAST_READ_1_2_2_4B },
+	{ SFLASH_HWCAPS_READ_1_1_4, (0x1UL << 4), SFLASH_INST_FAST_READ_1_1_4_4B },
+	{ SFLASH_HWCAPS_READ_1_4_4, (0x1UL << 5), SFLASH_INST_FAST_READ_1_4_4_4B },
+	{ SFLASH_HWCAPS_READ_4_4_4, (0x1UL << 5), SFLASH_INST_FAST_READ_1_4_4_4B },
+};
+
+static const struct sfdp_4bait sfdp_4bait_pps[] = {
+	{ SFLASH_HWCAPS_PP,         (0x1UL << 6), SFLASH_INST_PAGE_PROGRAM_4B },
+	{ SFLASH_HWCAPS_PP_1_1_4,   (0x1UL << 7), SFLASH_INST_PAGE_PROGRAM_1_1_4_4B },
+	{ SFLASH_HWCAPS_PP_1_4_4,   (0x1UL << 8), SFLASH_INST_PAGE_PROGRAM_1_4_4_4B },
+	{ SFLASH_HWCAPS_PP_4_4_4,   (0x1UL << 6), SFLASH_INST_PAGE_PROGRAM_4B },
+};
+
+/*
+ * Look up the capabilities of @mask in the 4BAIT: @insts receives the 4-byte
+ * address instructions of the supported ones, indexed like params->reads[]
+ * or params->page_programs[], and the unsupported ones are returned.
+ */
+static uint32_t spi_flash_4bait_filter(const struct sfdp_4bait *table, size_t size, uint32_t dword1, uint32_t mask, uint8_t *insts)
+{
+	uint32_t discard = 0;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (!(mask & table[i].hwcaps))
+			continue;
+
+		if (dword1 & table[i].supported_bit)
+			insts[spi_flash_hwcaps2cmd(table[i].hwcaps)] = table[i].inst;
+		else
+			discard |= table[i].hwcaps;
+	}
+
+	return discard;
+}
+
+static int spi_flash_parse_4bait(struct spi_flash *flash,
+				 const struct sfdp_parameter_header *header,
+				 struct spi_flash_parameters *params)
+{
+	struct spi_flash_erase_map *map = &flash->erase_map;
+	uint32_t dwords[SFDP_4BAIT_DWORD_MAX];
+	uint8_t read_insts[SFLASH_CMD_READ_MAX];
+	uint8_t pp_insts[SFLASH_CMD_PP_MAX];
+	uint32_t reads, pps, discard, erase_mask;
+	int i, rc;
+
+	if (header->length < SFDP_4BAIT_DWORD_MAX)
+		return -EINVAL;
+
+	rc = spi_flash_read_sfdp(flash, SFDP_PARAM_HEADER_PTP(header),
+				 sizeof(dwords), dwords);
+	if (rc < 0)
+		return rc;
+
+	for (i = 0; i < SFLASH_CMD_READ_MAX; i++)
+		read_insts[i] = params->reads[i].inst;
+	for (i = 0; i < SFLASH_CMD_PP_MAX; i++)
+		pp_insts[i] = params->page_programs[i].inst;
+
+	/*
+	 * Discard the Read and Page Program protocols without a 4-byte address
+	 * instruction, but only if at least one of each remains.
+	 */
+	reads = params->hwcaps.mask & SFLASH_HWCAPS_READ_MASK;
+	pps = params->hwcaps.mask & SFLASH_HWCAPS_PP_MASK;
+	discard = spi_flash_4bait_filter(sfdp_4bait_reads, ARRAY_SIZE(sfdp_4bait_reads),
+					 dwords[0], reads, read_insts);
+	discard |= spi_flash_4bait_filter(sfdp_4bait_pps, ARRAY_SIZE(sfdp_4bait_pps),
+					  dwords[0], pps, pp_insts);
+	if (!(reads & ~discard) || !(pps & ~discard))
+		return 0;
+
+	params->hwcaps.mask &= ~discard;
+	for (i = 0; i < SFLASH_CMD_READ_MAX; i++)
+		params->reads[i].inst = read_insts[i];
+	for (i = 0; i < SFLASH_CMD_PP_MAX; i++)
+		params->page_programs[i].inst = pp_insts[i];
+
+	/* Erase Types: the 2nd DWORD holds one instruction per type. */
+	erase_mask = 0;
+	for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
+		struct spi_flash_erase_command *cmd = &map->commands[i];
+
+		if (!cmd->size)
+			continue;
+
+		if (dwords[0] & SFDP_4BAIT_ERASE_TYPE(i)) {
+			cmd->inst = (dwords[1] >> (8 * i)) & 0xffu;
+			erase_mask |= (0x1UL << i);
+		} else {
+			spi_flash_set_erase_command(cmd, 0, 0);
+		}
+	}
+	map->uniform_region.cmd_mask &= erase_mask;
+
+	params->addr_4b_inst = true;
+	return 0;
+}
+
+/* Sector Map Parameter Table */
+
+#define SFDP_SMPT_DWORD_MAX			64
+
+#define SMPT_DESC_END				(0x1UL << 0)
+#define SMPT_DESC_TYPE_MAP			(0x1UL << 1)
+
+/* Configuration Detection Command Descriptor, 1st DWORD. */
+#define SMPT_CMD_OPCODE(dw)			(((dw) >> 8) & 0xffu)
+#define SMPT_CMD_READ_DUMMY(dw)			(((dw) >> 16) & 0xfu)
+#define SMPT_CMD_READ_DUMMY_IS_VARIABLE		0xfu
+#define SMPT_CMD_ADDRESS_LEN_MASK		(0x3UL << 22)
+#define SMPT_CMD_ADDRESS_LEN_0			(0x0UL << 22)
+#define SMPT_CMD_ADDRESS_LEN_3			(0x1UL << 22)
+#define SMPT_CMD_ADDRESS_LEN_4			(0x2UL << 22)
+#define SMPT_CMD_ADDRESS_LEN_USE_CURRENT	(0x3UL << 22)
+#define SMPT_CMD_READ_DATA(dw)			(((dw) >> 24) & 0xffu)
+
+/* Sector Map Descriptor: header DWORD then one DWORD per region. */
+#define SMPT_MAP_ID(dw)				(((dw) >> 8) & 0xffu)
+#define SMPT_MAP_REGION_COUNT(dw)		((((dw) >> 16) & 0xffu) + 1)
+#define SMPT_MAP_REGION_ERASE_TYPE(dw)		((dw) & 0xfu)
+#define SMPT_MAP_REGION_SIZE(dw)		((((dw) >> 8) + 1) * 256)
+
+static uint32_t smpt[SFDP_SMPT_DWORD_MAX];
+
+/*
+ * Run a Configuration Detection Command and return the byte read.
+ */
+static int spi_flash_smpt_read_config(struct spi_flash *flash, uint32_t desc, uint32_t addr, uint8_t *data)
+{
+	struct spi_flash_command cmd;
+	uint8_t addr_len, dummy;
+
+	switch (desc & SMPT_CMD_ADDRESS_LEN_MASK) {
+	case SMPT_CMD_ADDRESS_LEN_0:
+		addr_len = 0;
+		break;
+	case SMPT_CMD_ADDRESS_LEN_4:
+		addr_len = 4;
+		break;
+	case SMPT_CMD_ADDRESS_LEN_3:
+	case SMPT_CMD_ADDRESS_LEN_USE_CURRENT:
+	default:
+		/* The memory is still in 3-byte address mode while probing. */
+		addr_len = 3;
+		break;
+	}
+
+	dummy = SMPT_CMD_READ_DUMMY(desc);
+	if (dummy == SMPT_CMD_READ_DUMMY_IS_VARIABLE)
+		dummy = 8;
+
+	spi_flash_command_init(&cmd, SMPT_CMD_OPCODE(desc), addr_len, SFLASH_TYPE_READ);
+	cmd.proto = flash->read_proto;
+	cmd.addr = addr;
+	cmd.num_wait_states = dummy;
+	cmd.data_len = 1;
+	cmd.rx_data = data;
+	return spi_flash_exec(flash, &cmd);
+}
+
+static int spi_flash_parse_smpt(struct spi_flash *flash,
+				const struct sfdp_parameter_header *header,
+				const struct spi_flash_parameters *params)
+{
+	struct spi_flash_erase_map *map = &flash->erase_map;
+	const uint32_t *desc = NULL;
+	uint32_t i, j, len, count, offset, map_id;
+	uint8_t data;
+	int rc;
+
+	len = header->length;
+	if (len == 0 || len > ARRAY_SIZE(smpt))
+		return -EINVAL;
+
+	rc = spi_flash_read_sfdp(flash, SFDP_PARAM_HEADER_PTP(header),
+				 len * sizeof(uint32_t), smpt);
+	if (rc < 0)
+		return rc;
+
+	/*
+	 * The Configuration Detection Commands come first: each one gives one
+	 * bit of the ID of the sector map currently in use, MSB first.
+	 */
+	map_id = 0;
+	for (i = 0; i + 1 < len && !(smpt[i] & SMPT_DESC_TYPE_MAP); i += 2) {
+		rc = spi_flash_smpt_read_config(flash, smpt[i], smpt[i + 1], &data);
+		if (rc < 0)
+			return rc;
+
+		map_id = (map_id << 1) | ((data & SMPT_CMD_READ_DATA(smpt[i])) ? 1 : 0);
+	}
+
+	/* Find the matching Sector Map Descriptor. */
+	while (i < len) {
+		if (SMPT_MAP_ID(smpt[i]) == map_id) {
+			desc = &smpt[i];
+			break;
+		}
+		if (smpt[i] & SMPT_DESC_END)
+			break;
+		i += SMPT_MAP_REGION_COUNT(smpt[i]) + 1;
+	}
+	if (!desc)
+		return -EINVAL;
+
+	count = SMPT_MAP_REGION_COUNT(desc[0]);
+	if (i + count >= len || count > SFLASH_ERASE_REGION_MAX)
+		return -EINVAL;
+
+	offset = 0;
+	for (j = 0; j < count; j++) {
+		struct spi_flash_erase_region *region = &map->region_table[j];
+
+		region->offset = offset;
+		region->size = SMPT_MAP_REGION_SIZE(desc[j + 1]);
+		region->cmd_mask = SMPT_MAP_REGION_ERASE_TYPE(desc[j + 1]);
+		offset += region->size;
+	}
+
+	/* The regions must cover the whole memory. */
+	if (offset != params->size)
+		return -EINVAL;
+
+	map->regions = map->region_table;
+	map->num_regions = count;
+	return 0;
+}
+
 static struct sfdp_header header;
 static struct sfdp_parameter_header param_header;
 
@@ -494,6 +756,18 @@ int spi_flash_parse_sfdp(struct spi_flash *flash, struct spi_flash_parameters *p
 			goto exit;
 
 		switch (SFDP_PARAM_HEADER_ID(&param_header)) {
+		case SFDP_4BAIT_ID:
+			/* 4-byte address instructions are only needed above 16MiB. */
+			/* Not fatal: 3-byte instructions get converted. */
+			if (params->size > 0x01000000u)
+				spi_flash_parse_4bait(flash, &param_header, params);
+			break;
+
+		case SFDP_SMPT_ID:
+			/* Not fatal: keep the uniform erase map. */
+			spi_flash_parse_smpt(flash, &param_header, params);
+			break;
+
 		default:
 			break;
 		}
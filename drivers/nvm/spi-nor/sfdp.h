@@ -87,6 +87,9 @@ struct spi_flash_parameters {
 	struct spi_flash_read_command reads[SFLASH_CMD_READ_MAX];
 	struct spi_flash_pp_command page_programs[SFLASH_CMD_PP_MAX];
 
+	/* Read/Program/Erase instructions are 4-byte address ones (4BAIT). */
+	bool addr_4b_inst;
+
 	int (*quad_enable)(struct spi_flash *flash);
 };
 
@@ -73,7 +73,7 @@ int spi_flash_write_reg(struct spi_flash *flash, uint8_t inst, const uint8_t *bu
 	return spi_flash_exec(flash, &cmd);
 }
 
-static int spi_flash_is_ready(struct spi_flash *flash)
+int spi_flash_is_ready(struct spi_flash *flash)
 {
 	uint8_t sr, fsr;
 	int rc;
@@ -283,6 +283,63 @@ uint32_t spi_flash_div_by_erase_size(const struct spi_flash_erase_command *cmd,
 	return q.quot;
 }
 
+/*
+ * Find the erase region containing the given offset.
+ */
+const struct spi_flash_erase_region *spi_flash_find_erase_region(const struct spi_flash_erase_map *map, uint32_t offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < map->num_regions; i++) {
+		const struct spi_flash_erase_region *region = &map->regions[i];
+
+		if (offset >= region->offset && offset - region->offset < region->size)
+			return region;
+	}
+
+	return NULL;
+}
+
+/*
+ * Select the largest erase command that can be issued at @offset: it must be
+ * supported by the region containing @offset, be aligned on @offset, and
+ * erase neither beyond @offset + @len nor beyond the end of the region.
+ * Erase sizes being powers of two multiples of each other, picking the
+ * largest command at each step covers a range with the fewest commands.
+ */
+const struct spi_flash_erase_command *spi_flash_select_erase(const struct spi_flash_erase_map *map, uint32_t offset, uint32_t len)
+{
+	const struct spi_flash_erase_region *region;
+	const struct spi_flash_erase_command *erase = NULL;
+	uint64_t limit;
+	uint32_t i;
+
+	region = spi_flash_find_erase_region(map, offset);
+	if (!region)
+		return NULL;
+
+	limit = region->offset + region->size - offset;
+	if (limit > len)
+		limit = len;
+
+	for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
+		const struct spi_flash_erase_command *e = &map->commands[i];
+		uint32_t rem;
+
+		if (!(region->cmd_mask & (0x1UL << i)) || !e->size)
+			continue;
+
+		spi_flash_div_by_erase_size(e, offset, &rem);
+		if (rem || e->size > limit)
+			continue;
+
+		if (!erase || erase->size < e->size)
+			erase = e;
+	}
+
+	return erase;
+}
+
 void spi_flash_init_uniform_erase_map(struct spi_flash_erase_map *map, uint32_t cmd_mask, uint64_t flash_size)
 {
 	map->num_regions = 1;
@@ -362,14 +419,22 @@ bool spi_flash_has_uniform_erase(const struct spi_flash *flash)
 
 uint32_t spi_flash_get_uniform_erase_map(const struct spi_flash *flash)
 {
+	const struct spi_flash_erase_map *map = &flash->erase_map;
+	uint32_t cmd_mask = 0;
 	uint32_t erase_map = 0;
+	int i;
+
+	/*
+	 * With a non uniform sector map, report every erase size used by
+	 * some region: spi_nor_erase() splits requests into the commands
+	 * supported by each region.
+	 */
+	for (i = 0; i < map->num_regions; i++)
+		cmd_mask |= map->regions[i].cmd_mask;
 
-	if (spi_flash_has_uniform_erase(flash)) {
-		int i;
-		for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
-			if (flash->erase_map.uniform_region.cmd_mask & (1u << i)) {
-				erase_map |= flash->erase_map.commands[i].size / flash->page_size;
-			}
+	for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
+		if (cmd_mask & (1u << i)) {
+			erase_map |= map->commands[i].size / flash->page_size;
 		}
 	}
 
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "callback.h"
 #include "compiler.h"
 #include "intmath.h"
 #include "peripherals/bus.h"
@@ -99,6 +100,7 @@
 #define SFLASH_INST_ERASE_4K  0x20
 #define SFLASH_INST_ERASE_32K 0x52
 #define SFLASH_INST_ERASE_64K 0xD8
+#define SFLASH_INST_ERASE_CHIP 0xC7
 
 /**
  * 4-byte address instruction set.
@@ -176,6 +178,7 @@
 	 SFLASH_PROTO_DATA(data_nbits))
 
 #define SFLASH_CMD_ERASE_MAX	4
+#define SFLASH_ERASE_REGION_MAX	8
 #define SFLASH_CMD_ERASE_MASK	0xFULL
 #define SFLASH_CMD_ERASE_OFFSET(_cmd_mask, _offset)		\
 	((((uint64_t)(_offset)) & ~SFLASH_CMD_ERASE_MASK) |	\
@@ -237,6 +240,7 @@ enum spi_flash_protocol {
 #define SFLASH_TYPE_WRITE_REG	(0x4UL << 0)
 
 #define SFLASH_FLG_HAS_FSR (0x1UL << 0)
+#define SFLASH_FLG_NO_CHIP_ERASE (0x1UL << 1)
 
 /*----------------------------------------------------------------------------
  *        Exported Typedefs
@@ -310,6 +314,8 @@ struct spi_flash_erase_region {
  * @commands:		an array of erase commands shared by all the regions.
  * @uniform_region:	a pre-allocated erase region for SPI FLASH with a uniform
  *			sector size (legacy implementation).
+ * @region_table:	storage for the erase regions of SPI FLASH with a non
+ *			uniform sector map (SFDP Sector Map Parameter Table).
  * @regions:		point to an array describing the boundaries of the erase
  *			regions.
  * @num_regions:	the number of elements in the @regions array.
@@ -317,6 +323,7 @@ struct spi_flash_erase_region {
 struct spi_flash_erase_map {
 	struct spi_flash_erase_command commands[SFLASH_CMD_ERASE_MAX];
 	struct spi_flash_erase_region uniform_region;
+	struct spi_flash_erase_region region_table[SFLASH_ERASE_REGION_MAX];
 	struct spi_flash_erase_region *regions;
 	uint32_t num_regions;
 };
@@ -357,6 +364,26 @@ struct spi_flash_hwcaps {
 	uint32_t mask;
 };
 
+/**
+ * struct spi_flash_write_req - State of an asynchronous write
+ * @to:		Address of the next page to program.
+ * @buf:	Data of the next page to program.
+ * @len:	Number of bytes left to program, page in progress excluded.
+ * @start:	Timer tick at which the page in progress was sent.
+ * @rc:		Completion status of the last write.
+ * @busy:	A write is in progress.
+ * @callback:	Invoked on completion, with a pointer to @rc as argument.
+ */
+struct spi_flash_write_req {
+	size_t to;
+	const uint8_t *buf;
+	size_t len;
+	uint64_t start;
+	int rc;
+	volatile bool busy;
+	struct _callback callback;
+};
+
 /**
  * struct spi_flash - Structure to describe some SPI flash memory
  * @priv:		The private data.
@@ -373,6 +400,7 @@ struct spi_flash_hwcaps {
  * @size:		The total SPI flash size (in bytes).
  * @page_size:		The page size (in bytes).
  * @erase_map:		The erase map of the SPI flash.
+ * @write_req:		The asynchronous write in progress, if any.
  * @ops:		[DRIVER-SPECIFIC] The SPI controller interface.
  * @read:		[FLASH-SPECIFIC] Read data from the SPI flash.
  * @write:		[FLASH-SPECIFIC] Write data into the SPI flash.
@@ -401,6 +429,7 @@ struct spi_flash {
 	size_t size;
 	size_t page_size;
 	struct spi_flash_erase_map erase_map;
+	struct spi_flash_write_req write_req;
 
 	const struct spi_ops *ops;
 
@@ -462,6 +491,7 @@ extern uint8_t spi_flash_protocol_get_data_nbits(enum spi_flash_protocol proto);
 extern int spi_flash_hwcaps2cmd(uint32_t hwcaps);
 extern int spi_flash_read_reg(struct spi_flash *flash, uint8_t inst, uint8_t *buf, size_t len);
 extern int spi_flash_write_reg(struct spi_flash *flash, uint8_t inst, const uint8_t *buf, size_t len);
+extern int spi_flash_is_ready(struct spi_flash *flash);
 extern int spi_flash_wait_till_ready_timeout(struct spi_flash *flash, unsigned long timeout);
 
 extern int spi_flash_setup(struct spi_flash *flash, const struct spi_flash_parameters *params);
@@ -484,6 +514,10 @@ extern void spi_flash_set_erase_command(struct spi_flash_erase_command *cmd, siz
 
 extern uint32_t spi_flash_div_by_erase_size(const struct spi_flash_erase_command *cmd, uint32_t dividend, uint32_t *remainder);
 
+extern const struct spi_flash_erase_region *spi_flash_find_erase_region(const struct spi_flash_erase_map *map, uint32_t offset);
+
+extern const struct spi_flash_erase_command *spi_flash_select_erase(const struct spi_flash_erase_map *map, uint32_t offset, uint32_t len);
+
 extern int spi_flash_set_protection(struct spi_flash *flash, bool protect);
 
 #endif /* _SPI_FLASH_H */
@@ -70,6 +70,15 @@
 	.page_size = 256,			\
 	.flags = SNOR_HAS_FSR | SNOR_SECT_4K | SNOR_NO_4BAIS
 
+/* Stacked die parts: Chip Erase is not supported, only Die Erase. */
+#define N25Q_STACKED(_name, _jedec_id, _n_sectors)	\
+	.name = _name,					\
+	ID5(_jedec_id, 0),				\
+	.sector_size = 65536U,				\
+	.n_sectors = (_n_sectors),			\
+	.page_size = 256,				\
+	.flags = SNOR_HAS_FSR | SNOR_SECT_4K | SNOR_NO_4BAIS | SNOR_NO_CHIP_ERASE
+
 #define AT25(_name, _jedec_id, _n_sectors)	\
 	.name = _name,				\
 	ID5(_jedec_id, 0),			\
@@ -162,10 +171,10 @@ const struct spi_nor_info spi_nor_ids[] = {
 	{ N25Q("n25q128ax3", 0x20ba18,  256), },
 	{ N25Q("n25q256ax1", 0x20bb19,  512), },
 	{ N25Q("n25q256ax3", 0x20ba19,  512), },
-	{ N25Q("n25q512ax1", 0x20bb20, 1024), },
-	{ N25Q("n25q512ax3", 0x20ba20, 1024), },
-	{ N25Q("n25q00ax1",  0x20bb21, 2048), },
-	{ N25Q("n25q00ax3",  0x20ba21, 2048), },
+	{ N25Q_STACKED("n25q512ax1", 0x20bb20, 1024), },
+	{ N25Q_STACKED("n25q512ax3", 0x20ba20, 1024), },
+	{ N25Q_STACKED("n25q00ax1",  0x20bb21, 2048), },
+	{ N25Q_STACKED("n25q00ax3",  0x20ba21, 2048), },
 
 	/* Winbond */
 	{ W25("w25x10",  0xef3011,   1), },
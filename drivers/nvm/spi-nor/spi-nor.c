@@ -45,6 +45,13 @@
 
 //#define SPI_NOR_VERBOSE_DEBUG
 
+/*----------------------------------------------------------------------------
+ *        Local Definitions
+ *----------------------------------------------------------------------------*/
+
+/* Page Program timeout (in timer ticks, for 1000 Hz timer) */
+#define TIMEOUT_PAGE_PROGRAM 800 /* 0.8s */
+
 /*----------------------------------------------------------------------------
  *        Local Variables
  *----------------------------------------------------------------------------*/
@@ -310,6 +317,9 @@ static int spi_nor_probe(struct spi_flash *flash)
 	if (info->flags & SNOR_HAS_FSR)
 		flash->flags |= SFLASH_FLG_HAS_FSR;
 
+	if (info->flags & SNOR_NO_CHIP_ERASE)
+		flash->flags |= SFLASH_FLG_NO_CHIP_ERASE;
+
 	if (info->flags & SNOR_SST_ULBPR)
 		if (sst26_unlock_block_protection(flash))
 			trace_info("SF: WARNING: SST26 - can't unlock block protection\r\n");
@@ -344,7 +354,9 @@ init_params:
 	} else {
 		flash->addr_len = 3;
 		if (flash->size > 0x01000000u) {
-			if (!info || !(info->flags & SNOR_NO_4BAIS))
+			if (params.addr_4b_inst)
+				flash->addr_len = 4;
+			else if (!info || !(info->flags & SNOR_NO_4BAIS))
 				spi_nor_set_4bais(flash);
 			else
 				trace_info("SF: WARNING: can't read above 16MiB\r\n");
@@ -354,6 +366,50 @@ init_params:
 	return 0;
 }
 
+/*
+ * Send the Page Program command for the next page of the write in progress.
+ */
+static int spi_nor_program_page(struct spi_flash *flash)
+{
+	struct spi_flash_write_req *req = &flash->write_req;
+	struct spi_flash_command cmd;
+	size_t page_offset, page_remain;
+	int rc;
+
+	page_offset = req->to & (flash->page_size - 1);
+	page_remain = min_u32(flash->page_size - page_offset, req->len);
+
+	spi_flash_command_init(&cmd, flash->write_inst, flash->addr_len, SFLASH_TYPE_WRITE);
+	cmd.proto = flash->write_proto;
+	cmd.addr = req->to;
+	cmd.data_len = page_remain;
+	cmd.tx_data = req->buf;
+#ifdef CONFIG_HAVE_AESB
+	cmd.use_aesb = flash->use_aesb;
+#endif
+
+	rc = spi_flash_write_enable(flash);
+	rc = rc < 0 ? rc : spi_flash_exec(flash, &cmd);
+	if (rc < 0)
+		return rc;
+
+	req->start = timer_get_tick();
+	req->buf += page_remain;
+	req->to += page_remain;
+	req->len -= page_remain;
+
+	return 0;
+}
+
+static void spi_nor_write_complete(struct spi_flash *flash, int rc)
+{
+	struct spi_flash_write_req *req = &flash->write_req;
+
+	req->rc = rc;
+	req->busy = false;
+	callback_call(&req->callback, &req->rc);
+}
+
 static int _bus_init(union spi_flash_priv* priv)
 {
 	return 0;
@@ -739,92 +795,115 @@ int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len)
 
 int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len)
 {
-	struct spi_flash_command cmd;
-	int rc = 0;
+	int rc;
 
-	rc = spi_flash_set_protection(flash, false);
+	rc = spi_nor_write_async(flash, to, buf, len, NULL);
 	if (rc < 0)
 		return rc;
 
-	spi_flash_command_init(&cmd, flash->write_inst, flash->addr_len, SFLASH_TYPE_WRITE);
-	cmd.proto = flash->write_proto;
-#ifdef CONFIG_HAVE_AESB
-	cmd.use_aesb = flash->use_aesb;
-#endif
-	while (len) {
-		size_t page_offset, page_remain;
+	/* Poll the status register back-to-back to start each page ASAP. */
+	do {
+		rc = spi_nor_write_poll(flash);
+	} while (rc == -EAGAIN);
 
-		page_offset = to & (flash->page_size - 1);
-		page_remain = min_u32(flash->page_size - page_offset, len);
+	return rc;
+}
 
-		cmd.addr = to;
-		cmd.data_len = page_remain;
-		cmd.tx_data = buf;
+int spi_nor_write_async(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len, struct _callback* cb)
+{
+	struct spi_flash_write_req *req = &flash->write_req;
+	int rc;
 
-		rc = spi_flash_write_enable(flash);
-		if (rc < 0)
-			break;
+	if (req->busy)
+		return -EBUSY;
 
-		rc = spi_flash_exec(flash, &cmd);
-		if (rc < 0)
-			break;
+	rc = spi_flash_set_protection(flash, false);
+	if (rc < 0)
+		return rc;
 
-		rc = spi_flash_wait_till_ready(flash);
-		if (rc < 0)
-			break;
+	req->to = to;
+	req->buf = buf;
+	req->len = len;
+	req->rc = 0;
+	callback_copy(&req->callback, cb);
+
+	if (!len) {
+		spi_nor_write_complete(flash, 0);
+		return 0;
+	}
 
-		buf += page_remain;
-		to += page_remain;
-		len -= page_remain;
+	req->busy = true;
+	rc = spi_nor_program_page(flash);
+	if (rc < 0) {
+		req->busy = false;
+		req->rc = rc;
+	}
+
+	return rc;
+}
+
+int spi_nor_write_poll(struct spi_flash *flash)
+{
+	struct spi_flash_write_req *req = &flash->write_req;
+	int rc;
+
+	if (!req->busy)
+		return req->rc;
+
+	rc = spi_flash_is_ready(flash);
+	if (rc == 0) {
+		if (timer_get_interval(req->start, timer_get_tick()) < TIMEOUT_PAGE_PROGRAM)
+			return -EAGAIN;
+		rc = -ETIMEDOUT;
+	} else if (rc > 0) {
+		if (!req->len)
+			rc = 0;
+		else if ((rc = spi_nor_program_page(flash)) == 0)
+			return -EAGAIN;
 	}
 
+	spi_nor_write_complete(flash, rc);
 	return rc;
 }
 
 int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len)
 {
 	const struct spi_flash_erase_map *map = &flash->erase_map;
+	const struct spi_flash_erase_command *erase;
 	struct spi_flash_command cmd;
+	size_t pos, rem;
 	int rc = 0;
 
-	rc = spi_flash_set_protection(flash, false);
-	if (rc < 0)
-		return rc;
+	if (offset + len > flash->size)
+		return -EINVAL;
 
-	if (!spi_flash_has_uniform_erase(flash)) {
-		/* @TODO: add support to non uniform erase map. */
-		return -ENOTSUP;
+	/* Check that the whole range can be erased before erasing anything. */
+	for (pos = offset, rem = len; rem; pos += erase->size, rem -= erase->size) {
+		erase = spi_flash_select_erase(map, pos, rem);
+		if (!erase)
+			return -EINVAL;
 	}
 
 	rc = spi_flash_set_protection(flash, false);
 	if (rc < 0)
 		return rc;
 
+	/* Whole memory: a single Chip Erase is faster than any sector erase,
+	 * except on stacked die parts which only accept Die Erase. */
+	if (offset == 0 && len == flash->size &&
+	    !(flash->flags & SFLASH_FLG_NO_CHIP_ERASE)) {
+		rc = spi_flash_write_enable(flash);
+		rc = rc < 0 ? rc : spi_flash_write_reg(flash, SFLASH_INST_ERASE_CHIP, NULL, 0);
+		return rc < 0 ? rc : spi_flash_wait_till_ready(flash);
+	}
+
 	spi_flash_command_init(&cmd, 0, flash->addr_len, SFLASH_TYPE_ERASE);
 	cmd.proto = flash->reg_proto;
 #ifdef CONFIG_HAVE_AESB
 	cmd.use_aesb = flash->use_aesb;
 #endif
 	while (len) {
-		const struct spi_flash_erase_command *erase = NULL;
-		size_t i;
-
-		for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
-			const struct spi_flash_erase_command *e;
-			uint32_t rem;
-
-			if ((map->uniform_region.cmd_mask & (0x1UL << i))) {
-				e = &map->commands[i];
-				spi_flash_div_by_erase_size(e, offset, &rem);
-				if (rem)
-					continue;
-
-				if (e->size <= len && (!erase || erase->size < e->size))
-					erase = e;
-			}
-		}
-		if (!erase)
-			return -1;
+		erase = spi_flash_select_erase(map, offset, len);
 
 #ifdef SPI_NOR_VERBOSE_DEBUG
 		trace_info("spi-nor: erase params: inst=0x%x\r\n", erase->inst);
@@ -49,6 +49,7 @@
 #define SNOR_SECT_4K_ONLY	(0x1UL << 5)
 #define SNOR_SST_ULBPR		(0x1UL << 6)
 #define SNOR_SECT_32K		(0x1UL << 7)
+#define SNOR_NO_CHIP_ERASE	(0x1UL << 8)
 
 /*----------------------------------------------------------------------------
  *        Exported Types
@@ -114,6 +115,43 @@ extern const struct spi_nor_info spi_nor_ids[];
 int spi_nor_configure(struct spi_flash *flash, const struct spi_flash_cfg *cfg);
 int spi_nor_read(struct spi_flash *flash, size_t from, uint8_t* buf, size_t len);
 int spi_nor_write(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len);
+
+/**
+ * Start writing data without waiting for the Page Program operations.
+ *
+ * The first page is sent immediately; the following ones are sent by
+ * spi_nor_write_poll() once the memory has completed the previous one. No
+ * other access to the memory is allowed until the write completes.
+ *
+ * @flash:	The SPI flash memory.
+ * @to:		Address of the first byte to write.
+ * @buf:	Data to write, must stay valid until completion.
+ * @len:	Number of bytes to write.
+ * @cb:		Optional callback invoked on completion, with a pointer to the
+ *		(int) completion status as argument.
+ * Return: 0 if the write was started, -EBUSY if a write is already in
+ * progress, or another negative error code.
+ */
+int spi_nor_write_async(struct spi_flash *flash, size_t to, const uint8_t* buf, size_t len, struct _callback* cb);
+
+/**
+ * Advance the asynchronous write in progress.
+ *
+ * Reads the status register once and, if the memory is ready, sends the next
+ * page. Meant to be called periodically, e.g. from a timer interrupt or the
+ * main loop.
+ *
+ * Each call is a bus transaction: spi_flash_is_ready() reads the status
+ * register, and the Write Enable and Page Program commands follow when the
+ * memory is ready. It must not run while the same SPI or QSPI bus is owned
+ * by another context, e.g. from a timer interrupt preempting a transfer to
+ * another device of the bus; poll from that context instead.
+ *
+ * @flash:	The SPI flash memory.
+ * Return: -EAGAIN while the write is in progress, then its completion status.
+ */
+int spi_nor_write_poll(struct spi_flash *flash);
+
 int spi_nor_erase(struct spi_flash *flash, size_t offset, size_t len);
 
 int spansion_new_quad_enable(struct spi_flash *flash);
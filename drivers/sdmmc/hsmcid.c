@@ -642,6 +642,12 @@ static uint32_t hsmci_control(void *_set, uint32_t bCtl, uint32_t param)
 		*param_u32 = 0;
 		break;
 
+	case SDMMC_IOCTL_GET_SG:
+		if (!param)
+			return SDMMC_ERROR_PARAM;
+		*param_u32 = 0;
+		break;
+
 	case SDMMC_IOCTL_BUSY_CHECK:
 		if (!param)
 			return SDMMC_ERROR_PARAM;
@@ -708,6 +714,10 @@ static uint32_t hsmci_send_command(void *_set, sSdmmcCommand *cmd)
 		|| cmd->pData == NULL))
 		return SDMMC_ERROR_PARAM;
 
+	/* Scatter-gather transfers are not implemented by this driver */
+	if (has_data && cmd->pIoVec)
+		return SDMMC_ERROR_NOT_SUPPORT;
+
 	if (hsmci_is_busy(set))
 		return SDMMC_ERROR_BUSY;
 
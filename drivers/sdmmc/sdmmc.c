@@ -73,6 +73,7 @@
 #include "peripherals/pmc.h"
 #include "peripherals/tc.h"
 #include "sdmmc/sdmmc.h"
+#include "sdmmc/sdmmc_adma.h"
 
 #include "libsdmmc/sdmmc_hal.h"
 #include "libsdmmc/sdmmc_api.h"   /* Included for debug functions only */
@@ -550,6 +551,89 @@ static void sdmmc_set_device_clock(struct sdmmc_set *set, uint32_t freq)
 	regs->SDMMC_CCR |= SDMMC_CCR_SDCLKEN;
 }
 
+/**
+ * \brief Get the address of a data block of the command.
+ * \param cmd  Command with data.
+ * \param index  Index of the block, counted from the start of the transfer.
+ * \return Address of the block, or NULL if the command data is shorter.
+ */
+static uint8_t * sdmmc_get_block(const sSdmmcCommand *cmd, uint32_t index)
+{
+	const sSdmmcIoVec *seg = cmd->pIoVec, *bound;
+
+	if (!seg)
+		return cmd->pData + index * (uint32_t)cmd->wBlockSize;
+	for (bound = seg + cmd->wIoVecCount; seg < bound; seg++) {
+		if (index < seg->wNbBlocks)
+			return seg->pData + index * (uint32_t)cmd->wBlockSize;
+		index -= seg->wNbBlocks;
+	}
+	return NULL;
+}
+
+/**
+ * \brief Verify that the scatter-gather list of the command, if any, is
+ * consistent with the count of blocks to transfer.
+ */
+static bool sdmmc_check_iovec(const sSdmmcCommand *cmd)
+{
+	const sSdmmcIoVec *seg, *bound;
+	uint32_t count = 0;
+
+	if (!cmd->pIoVec)
+		return true;
+	if (cmd->wIoVecCount == 0 || cmd->pIoVec[0].pData != cmd->pData)
+		return false;
+	for (seg = cmd->pIoVec, bound = seg + cmd->wIoVecCount;
+	    seg < bound && count < cmd->wNbBlocks; seg++) {
+		if (seg->wNbBlocks && seg->pData == NULL)
+			return false;
+		count += seg->wNbBlocks;
+	}
+	return count >= cmd->wNbBlocks;
+}
+
+/**
+ * \brief Clean or invalidate the data cache lines covering the data buffers
+ * of the command, depending on the direction of the transfer.
+ */
+static void sdmmc_prepare_data_cache(const sSdmmcCommand *cmd)
+{
+	const sSdmmcIoVec single = {
+		.pData = cmd->pData,
+		.wNbBlocks = cmd->wNbBlocks,
+	};
+	const sSdmmcIoVec *seg = cmd->pIoVec ? cmd->pIoVec : &single;
+	uint32_t left, count, len;
+
+	for (left = cmd->wNbBlocks; left; seg++, left -= count) {
+		count = min_u32(seg->wNbBlocks, left);
+		len = count * (uint32_t)cmd->wBlockSize;
+		if (cmd->cmdOp.bmBits.xfrData == SDMMC_CMD_TX)
+			/* Ensure the outgoing data can be fetched directly from
+			 * RAM */
+			cache_clean_region(seg->pData, len);
+		else if (cmd->cmdOp.bmBits.xfrData == SDMMC_CMD_RX)
+			/* Invalidate the corresponding data cache lines now, so
+			 * this buffer is protected against a global cache clean
+			 * operation, that concurrent code may trigger.
+			 * Warning: until the command is reported as complete,
+			 * no code should read from this buffer, nor from
+			 * variables cached in the same lines. If such
+			 * anticipated reading had to be supported, the data
+			 * cache lines would need to be invalidated twice: both
+			 * now and upon Transfer Complete. */
+			cache_invalidate_region(seg->pData, len);
+	}
+}
+
+/**
+ * \brief Build the ADMA2 descriptor table of a data transfer.
+ * \return SDMMC_OK if the whole transfer is described, SDMMC_CHANGED if the
+ * table is too small and cmd->wNbBlocks has been reduced accordingly, or an
+ * error code.
+ * \sa sdmmc_adma_fill_table
+ */
 static uint8_t sdmmc_build_dma_table(struct sdmmc_set *set, sSdmmcCommand *cmd)
 {
 	assert(set);
@@ -559,67 +643,17 @@ static uint8_t sdmmc_build_dma_table(struct sdmmc_set *set, sSdmmcCommand *cmd)
 	assert(cmd->wBlockSize);
 	assert(cmd->wNbBlocks);
 
-	uint32_t *line = NULL;
-	uint32_t data_len = (uint32_t)cmd->wNbBlocks
-	    * (uint32_t)cmd->wBlockSize;
-	uint32_t ram_addr = (uint32_t)cmd->pData;
-	uint32_t ram_bound = ram_addr + data_len;
-	uint32_t line_ix, line_cnt;
-	uint8_t rc = SDMMC_OK;
+	uint32_t lines;
+	uint8_t rc;
 
-#if 0
-	trace_debug("Configuring DMA for a %luB transfer %s %p\n\r",
-	    data_len, cmd->cmdOp.bmBits.xfrData == SDMMC_CMD_TX ? "from" : "to",
-	    cmd->pData);
-#endif
-	/* Verify that cmd->pData is word-aligned */
-	if ((uint32_t)cmd->pData & 0x3)
-		return SDMMC_PARAM;
-	/* Compute the size of the descriptor table for this transfer */
-	line_cnt = (data_len - 1 + SDMMC_DMADL_TRAN_LEN_MAX)
-	    / SDMMC_DMADL_TRAN_LEN_MAX;
-	/* If it won't fit into the allocated buffer, resize the transfer */
-	if (line_cnt > set->table_size) {
-		line_cnt = set->table_size;
-		data_len = line_cnt * SDMMC_DMADL_TRAN_LEN_MAX;
-		data_len /= cmd->wBlockSize;
-		if (data_len == 0)
-			return SDMMC_NOT_SUPPORTED;
-		cmd->wNbBlocks = (uint16_t)data_len;
-		data_len *= cmd->wBlockSize;
-		ram_bound = ram_addr + data_len;
-		rc = SDMMC_CHANGED;
-	}
-	/* Fill the table */
-	for (line_ix = 0, line = set->table; line_ix < line_cnt;
-	    line_ix++, line += SDMMC_DMADL_SIZE) {
-		if (line_ix + 1 < line_cnt) {
-			line[0] = SDMMC_DMA0DL_LEN_MAX
-			    | SDMMC_DMA0DL_ATTR_ACT_TRAN
-			    | SDMMC_DMA0DL_ATTR_VALID;
-			line[1] = SDMMC_DMA1DL_ADDR(ram_addr);
-			ram_addr += SDMMC_DMADL_TRAN_LEN_MAX;
-		}
-		else {
-			line[0] = ram_bound - ram_addr
-			    < SDMMC_DMADL_TRAN_LEN_MAX
-			    ? SDMMC_DMA0DL_LEN(ram_bound - ram_addr)
-			    : SDMMC_DMA0DL_LEN_MAX;
-			line[0] |= SDMMC_DMA0DL_ATTR_ACT_TRAN
-			    | SDMMC_DMA0DL_ATTR_END | SDMMC_DMA0DL_ATTR_VALID;
-			line[1] = SDMMC_DMA1DL_ADDR(ram_addr);
-		}
-#if 0
-		trace_debug("DMA descriptor: %luB @ 0x%lx%c\n\r",
-		    (line[0] & SDMMC_DMA0DL_LEN_Msk) >> SDMMC_DMA0DL_LEN_Pos,
-		    line[1], line[0] & SDMMC_DMA0DL_ATTR_END ? '.' : ' ');
-#endif
-	}
+	rc = sdmmc_adma_fill_table(set->table, set->table_size, cmd, &lines);
+	if (rc != SDMMC_OK && rc != SDMMC_CHANGED)
+		return rc;
 	/* Clean the underlying cache lines, to ensure the DMA gets our table
 	 * when it reads from RAM.
 	 * CPU access to the table is write-only, peripheral/DMA access is read-
 	 * only, hence there is no need to invalidate. */
-	cache_clean_region(set->table, (uint32_t)line - (uint32_t)set->table);
+	cache_clean_region(set->table, lines * SDMMC_DMADL_SIZE * sizeof(uint32_t));
 
 	return rc;
 }
@@ -858,7 +892,7 @@ Fetch:
 			set->state = MCID_ERROR;
 			goto End;
 		}
-		out = cmd->pData + set->blk_index * (uint32_t)cmd->wBlockSize;
+		out = sdmmc_get_block(cmd, set->blk_index);
 		count = cmd->wBlockSize & ~0x3;
 		for (bound = out + count; out < bound; out += 4) {
 #ifndef NDEBUG
@@ -903,7 +937,7 @@ Fetch:
 		regs->SDMMC_NISTR = SDMMC_NISTR_BWRRDY;
 		events &= ~SDMMC_NISTR_BWRRDY;
 
-		in = cmd->pData + set->blk_index * (uint32_t)cmd->wBlockSize;
+		in = sdmmc_get_block(cmd, set->blk_index);
 		count = cmd->wBlockSize & ~0x3;
 		for (bound = in + count; in < bound; in += 4) {
 			val.bytes[0] = in[0];
@@ -1422,6 +1456,12 @@ static uint32_t sdmmc_control(void *_set, uint32_t bCtl, uint32_t param)
 		*param_u32 = 1;
 		break;
 
+	case SDMMC_IOCTL_GET_SG:
+		if (!param)
+			return SDMMC_ERROR_PARAM;
+		*param_u32 = 1;
+		break;
+
 	case SDMMC_IOCTL_BUSY_CHECK:
 		if (!param)
 			return SDMMC_ERROR_PARAM;
@@ -1464,10 +1504,12 @@ static uint32_t sdmmc_control(void *_set, uint32_t bCtl, uint32_t param)
  * external data buffer shall meet. Especially when DMA is used to read from the
  * device, in which case the buffer shall be aligned on entire cache lines.
  * \return Return code, from the eSDMMC_RC enumeration. If SDMMC_OK, the command
- * has been issued and the caller should:
+ * has been issued and the caller should either:
  *   1. poll on sdmmc_is_busy(),
- *   2. once finished, check the result of the command in cmd->bStatus.
- * TODO in future when libsdmmc will set it: call sSdmmcCommand::fCallback.
+ *   2. once finished, check the result of the command in cmd->bStatus;
+ * or, if cmd->fCallback is set, wait for it to be invoked with cmd->bStatus.
+ * The callback is invoked once the command has been released, hence it may
+ * issue the next command.
  */
 static uint32_t sdmmc_send_command(void *_set, sSdmmcCommand *cmd)
 {
@@ -1490,7 +1532,7 @@ static uint32_t sdmmc_send_command(void *_set, sSdmmcCommand *cmd)
 	    && set->use_set_blk_cnt;
 	const bool stop_xfer_suffix = (cmd->bCmd == 18 || cmd->bCmd == 25)
 	    && !set->use_set_blk_cnt;
-	uint32_t eister, mask, len, cycles;
+	uint32_t eister, mask, cycles;
 	uint16_t cr, tmr;
 	uint8_t rc = SDMMC_OK, mc1r;
 
@@ -1521,6 +1563,10 @@ static uint32_t sdmmc_send_command(void *_set, sSdmmcCommand *cmd)
 		trace_error("Invalid data\n\r");
 		return SDMMC_ERROR_PARAM;
 	}
+	if (has_data && !sdmmc_check_iovec(cmd)) {
+		trace_error("Inconsistent scatter-gather list\n\r");
+		return SDMMC_ERROR_PARAM;
+	}
 	if (has_data && cmd->wBlockSize > set->blk_size) {
 		trace_error("%u-byte data block size not supported\n\r", cmd->wBlockSize);
 		return SDMMC_ERROR_PARAM;
@@ -1530,22 +1576,7 @@ static uint32_t sdmmc_send_command(void *_set, sSdmmcCommand *cmd)
 		rc = sdmmc_build_dma_table(set, cmd);
 		if (rc != SDMMC_OK && rc != SDMMC_CHANGED)
 			return rc;
-		len = (uint32_t)cmd->wNbBlocks * (uint32_t)cmd->wBlockSize;
-		if (cmd->cmdOp.bmBits.xfrData == SDMMC_CMD_TX)
-			/* Ensure the outgoing data can be fetched directly from
-			 * RAM */
-			cache_clean_region(cmd->pData, len);
-		else if (cmd->cmdOp.bmBits.xfrData == SDMMC_CMD_RX)
-			/* Invalidate the corresponding data cache lines now, so
-			 * this buffer is protected against a global cache clean
-			 * operation, that concurrent code may trigger.
-			 * Warning: until the command is reported as complete,
-			 * no code should read from this buffer, nor from
-			 * variables cached in the same lines. If such
-			 * anticipated reading had to be supported, the data
-			 * cache lines would need to be invalidated twice: both
-			 * now and upon Transfer Complete. */
-			cache_invalidate_region(cmd->pData, len);
+		sdmmc_prepare_data_cache(cmd);
 	}
 	if (multiple_xfer && !has_data)
 		trace_warning("Inconsistent data\n\r");
@@ -0,0 +1,128 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _SDMMC_ADMA_H_
+#define _SDMMC_ADMA_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stdint.h>
+
+#include "chip.h"
+#include "intmath.h"
+
+#include "libsdmmc/sdmmc_cmd.h"
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Fill the ADMA2 descriptor table of a data transfer.
+ * The table describes either the single cmd->pData buffer, or every segment
+ * of the cmd->pIoVec scatter-gather list, so that the whole transfer is
+ * serviced by a single command. Segments are split into descriptor lines of
+ * at most SDMMC_DMADL_TRAN_LEN_MAX bytes.
+ * The scatter-gather list, if any, shall hold at least cmd->wNbBlocks blocks.
+ * \param table  Descriptor table, of SDMMC_DMADL_SIZE words per line.
+ * \param table_size  Size of the table, in lines.
+ * \param cmd  Command. cmd->wNbBlocks is reduced if the table is too small.
+ * \param lines  Number of lines filled.
+ * \return SDMMC_OK if the whole transfer is described, SDMMC_CHANGED if the
+ * table is too small and cmd->wNbBlocks has been reduced accordingly,
+ * SDMMC_PARAM if a buffer is not word-aligned, or SDMMC_NOT_SUPPORTED if not
+ * even one block could be described.
+ */
+static inline uint8_t sdmmc_adma_fill_table(uint32_t *table,
+					    uint32_t table_size,
+					    sSdmmcCommand *cmd,
+					    uint32_t *lines)
+{
+	const sSdmmcIoVec single = {
+		.pData = cmd->pData,
+		.wNbBlocks = cmd->wNbBlocks,
+	};
+	const sSdmmcIoVec *seg = cmd->pIoVec ? cmd->pIoVec : &single;
+	const uint32_t blk_size = cmd->wBlockSize;
+	uint32_t *line = table, *last = NULL;
+	uint32_t lines_left = table_size;
+	uint32_t blocks_left = cmd->wNbBlocks, blocks_done = 0;
+	uint32_t ram_addr, ram_bound, count, line_cnt, len;
+	uint8_t rc = SDMMC_OK;
+
+	*lines = 0;
+	for (; blocks_left != 0 && rc == SDMMC_OK; seg++) {
+		count = min_u32(seg->wNbBlocks, blocks_left);
+		if (count == 0)
+			continue;
+		/* Verify that the buffer is word-aligned */
+		if ((uint32_t)seg->pData & 0x3)
+			return SDMMC_PARAM;
+		/* Compute the size of the descriptor table for this segment */
+		line_cnt = (count * blk_size - 1 + SDMMC_DMADL_TRAN_LEN_MAX)
+		    / SDMMC_DMADL_TRAN_LEN_MAX;
+		/* If it won't fit into the allocated buffer, resize the
+		 * transfer */
+		if (line_cnt > lines_left) {
+			count = lines_left * SDMMC_DMADL_TRAN_LEN_MAX / blk_size;
+			rc = SDMMC_CHANGED;
+		}
+		ram_addr = (uint32_t)seg->pData;
+		ram_bound = ram_addr + count * blk_size;
+		/* Fill the table */
+		for (; ram_addr < ram_bound;
+		    line += SDMMC_DMADL_SIZE, lines_left--) {
+			len = min_u32(ram_bound - ram_addr,
+			    SDMMC_DMADL_TRAN_LEN_MAX);
+			line[0] = (len < SDMMC_DMADL_TRAN_LEN_MAX
+			    ? SDMMC_DMA0DL_LEN(len) : SDMMC_DMA0DL_LEN_MAX)
+			    | SDMMC_DMA0DL_ATTR_ACT_TRAN
+			    | SDMMC_DMA0DL_ATTR_VALID;
+			line[1] = SDMMC_DMA1DL_ADDR(ram_addr);
+			ram_addr += len;
+			last = line;
+		}
+		blocks_done += count;
+		blocks_left -= count;
+	}
+	if (blocks_done == 0)
+		return SDMMC_NOT_SUPPORTED;
+	last[0] |= SDMMC_DMA0DL_ATTR_END;
+	if (blocks_done < cmd->wNbBlocks) {
+		cmd->wNbBlocks = (uint16_t)blocks_done;
+		rc = SDMMC_CHANGED;
+	}
+	*lines = table_size - lines_left;
+
+	return rc;
+}
+
+#endif /* _SDMMC_ADMA_H_ */
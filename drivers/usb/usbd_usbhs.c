@@ -57,6 +57,7 @@
 #include "peripherals/pmc.h"
 #include "trace.h"
 #include "usb/device/usbd_hal.h"
+#include "usb/usbhs_dma.h"
 
 /*---------------------------------------------------------------------------
  *      Definitions
@@ -71,7 +72,10 @@
 #endif
 
 /** Max size of the DMA FIFO */
-#define DMA_MAX_FIFO_SIZE     (32768)
+#define DMA_MAX_FIFO_SIZE     USBHS_DMA_BUFF_MAX_SIZE
+
+/** Number of DMA descriptors chained to send a single buffer */
+#define DMA_CHAIN_SIZE        (8)
 
 /** FIFO space size in bytes */
 #define EPT_VIRTUAL_SIZE      (32768)
@@ -203,16 +207,6 @@ struct _endpoint {
 	uint32_t send_zlp;
 };
 
-/**
- * DMA Descriptor.
- */
-struct _usb_dma_desc {
-	void     *next;
-	void     *addr;
-	uint32_t  ctrl;
-	uint32_t  reserved; /** reverved (padding) */
-};
-
 /*---------------------------------------------------------------------------
  *      Internal constants
  *---------------------------------------------------------------------------*/
@@ -241,6 +235,10 @@ static bool force_full_speed = false;
 /** DMA link list */
 CACHE_ALIGNED static struct _usb_dma_desc dma_desc[4];
 
+/** DMA link lists of the single buffer transfers, one per DMA channel */
+CACHE_ALIGNED static struct _usb_dma_desc
+	dma_chain[FIELD_ARRAY_SIZE(Usbhs, USBHS_DEVDMA)][DMA_CHAIN_SIZE];
+
 /*---------------------------------------------------------------------------
  *      Internal Functions
  *---------------------------------------------------------------------------*/
@@ -908,6 +906,37 @@ static void _usbd_hal_dma_single(uint8_t ep, struct _single_xfer *xfer, uint32_t
 	_usbd_hal_endpoint_dma_interrupt_enable(ep);
 }
 
+/**
+ * DMA chained transfer: sends up to DMA_CHAIN_SIZE * DMA_MAX_FIFO_SIZE bytes
+ * with a single interrupt.
+ * Only used for IN transfers: for OUT transfers, a short packet closes the
+ * current descriptor and the next one would be loaded, losing the size of the
+ * received data.
+ * \param ep EP number
+ * \param xfer Pointer to transfer instance
+ * \param cfg DMA Control configuration (excluding length)
+ */
+static void _usbd_hal_dma_chain(uint8_t ep, struct _single_xfer *xfer, uint32_t cfg)
+{
+	struct _usb_dma_desc *chain = dma_chain[ep - 1];
+
+	xfer->buffered = usbhs_dma_build_chain(chain, DMA_CHAIN_SIZE,
+			&xfer->data[xfer->transferred], xfer->remaining, cfg);
+
+	/* Flush DMA descriptors */
+	cache_clean_region(chain, sizeof(dma_chain[0]));
+
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMASTATUS = USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMASTATUS;
+
+	/* Interrupt enable */
+	_usbd_hal_endpoint_dma_interrupt_enable(ep);
+
+	/* Start transfer with LLI */
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMANXTDSC = (uint32_t)chain;
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = 0;
+	USBHS->USBHS_DEVDMA[ep - 1].USBHS_DEVDMACONTROL = USBHS_DEVDMACONTROL_LDNXT_DSC;
+}
+
 /**
  * Endpoint DMA interrupt handler.
  * This function handles DMA interrupts.
@@ -954,6 +983,15 @@ static void _usbd_hal_dma_handler(uint8_t ep)
 
 		/* There is still data */
 		if (xfer->remaining + xfer->buffered > 0) {
+			if (endpoint->state == USB_HAL_ENDPOINT_SENDING &&
+					xfer->remaining > DMA_MAX_FIFO_SIZE) {
+				/* Chained transfer again */
+				_usbd_hal_dma_chain(ep, xfer,
+						USBHS_DEVDMACONTROL_END_B_EN |
+						USBHS_DEVDMACONTROL_END_BUFFIT |
+						USBHS_DEVDMACONTROL_CHANN_ENB);
+				return;
+			}
 			if (xfer->remaining > DMA_MAX_FIFO_SIZE) {
 				xfer->buffered = DMA_MAX_FIFO_SIZE;
 			} else {
@@ -1040,16 +1078,20 @@ static uint8_t _usbd_hal_write(uint8_t ep,
 		_usbd_auto_switch_bank_enable(ep, true);
 
 		if (xfer->remaining > DMA_MAX_FIFO_SIZE) {
-			xfer->buffered = DMA_MAX_FIFO_SIZE;
+			/* Chained transfer */
+			_usbd_hal_dma_chain(ep, xfer,
+					USBHS_DEVDMACONTROL_END_B_EN |
+					USBHS_DEVDMACONTROL_END_BUFFIT |
+					USBHS_DEVDMACONTROL_CHANN_ENB);
 		} else {
 			xfer->buffered = xfer->remaining;
-		}
 
-		/* Single transfer */
-		_usbd_hal_dma_single(ep, xfer,
-				USBHS_DEVDMACONTROL_END_B_EN |
-				USBHS_DEVDMACONTROL_END_BUFFIT |
-				USBHS_DEVDMACONTROL_CHANN_ENB);
+			/* Single transfer */
+			_usbd_hal_dma_single(ep, xfer,
+					USBHS_DEVDMACONTROL_END_B_EN |
+					USBHS_DEVDMACONTROL_END_BUFFIT |
+					USBHS_DEVDMACONTROL_CHANN_ENB);
+		}
 	} else {
 		/* Wait for the bank to be free before disabling the automatic bank switch in order
 		 * to transfer data in FIFO mode correctly when the last is done with DMA.
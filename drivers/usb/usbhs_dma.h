@@ -0,0 +1,105 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _USBHS_DMA_H_
+#define _USBHS_DMA_H_
+
+/*----------------------------------------------------------------------------
+ *        Includes
+ *----------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip.h"
+
+/*----------------------------------------------------------------------------
+ *        Definitions
+ *----------------------------------------------------------------------------*/
+
+/** Max size of the buffer of a DMA descriptor */
+#define USBHS_DMA_BUFF_MAX_SIZE (32768)
+
+/**
+ * DMA Descriptor.
+ */
+struct _usb_dma_desc {
+	void     *next;
+	void     *addr;
+	uint32_t  ctrl;
+	uint32_t  reserved; /** reverved (padding) */
+};
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Build a DMA descriptor list for a buffer. The buffer is split in
+ * USBHS_DMA_BUFF_MAX_SIZE chunks, each one loading the next descriptor when
+ * done; only the last descriptor raises the end of buffer/transfer
+ * interrupts. Being a multiple of the endpoint size, the chunks only end the
+ * USB transfer on the last descriptor.
+ * \param desc  Descriptor list to fill.
+ * \param desc_count  Number of descriptors in the list.
+ * \param data  Pointer to the buffer.
+ * \param len  Size of the buffer.
+ * \param cfg  DMA Control configuration of the last descriptor (excluding
+ * length).
+ * \return Number of bytes covered by the list.
+ */
+static inline uint32_t usbhs_dma_build_chain(struct _usb_dma_desc *desc,
+		uint32_t desc_count, uint8_t *data, uint32_t len, uint32_t cfg)
+{
+	const uint32_t cfg_next = (cfg & ~(USBHS_DEVDMACONTROL_END_TR_IT |
+			USBHS_DEVDMACONTROL_END_BUFFIT)) |
+		USBHS_DEVDMACONTROL_LDNXT_DSC;
+	uint32_t i, size, total = 0;
+
+	for (i = 0; i < desc_count && len > 0; i++) {
+		size = len > USBHS_DMA_BUFF_MAX_SIZE ? USBHS_DMA_BUFF_MAX_SIZE : len;
+		desc[i].addr = data;
+		desc[i].reserved = 0;
+		data += size;
+		len -= size;
+		total += size;
+
+		if (len > 0 && i + 1 < desc_count) {
+			desc[i].next = &desc[i + 1];
+			desc[i].ctrl = cfg_next | USBHS_DEVDMACONTROL_BUFF_LENGTH(size);
+		} else {
+			desc[i].next = NULL;
+			desc[i].ctrl = cfg | USBHS_DEVDMACONTROL_BUFF_LENGTH(size);
+		}
+	}
+
+	return total;
+}
+
+#endif /* _USBHS_DMA_H_ */
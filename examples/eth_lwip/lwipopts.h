@@ -11,6 +11,15 @@
 
 #define MEM_ALIGNMENT                   4
 
+/* RX frames are handed to lwIP in the ETH buffers (see ethif.c) */
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+
+/* Checksums are generated and verified by the GMAC when available, the
+ * CHECKSUM_GEN_x/CHECKSUM_CHECK_x defaults keep the software fallback for
+ * the EMAC, for ICMP and for the frames not verified by the GMAC (see
+ * ethif.c) */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+
 #define LWIP_ARP                        1
 #define LWIP_ETHERNET                   LWIP_ARP
 
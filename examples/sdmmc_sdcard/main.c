@@ -92,6 +92,7 @@
  *          i: Display device info
  *	        l: Mount FAT file system and list files
  *          r: Read the file named test_data.bin
+ *          s: Stream records to the file named log_data.bin
  *	        w: Perform a basic RAW read/write test.
  *     \endcode
  * -# Input command according to the menu.
@@ -141,6 +142,11 @@
 
 #include "libsdmmc/libsdmmc.h"
 #include "fatfs/src/ff.h"
+#include "fatfs/src/ff_stream.h"
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_ff.h"
+#include "libstoragemedia/media_private.h"
+#include "libstoragemedia/media_sdcard.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -156,6 +162,14 @@
 #define DMADL_CNT_MAX               512u
 #define BLOCK_CNT                   3u
 
+/* Size of the file written by the streaming test, and of its records */
+#define LOG_FILE_SIZE               (4ul * 1024 * 1024)
+#define LOG_RECORD_SIZE             1000u
+
+/* Size of the cluster link map of the file read back, in DWORDs: room for
+ * (LINK_MAP_SIZE - 1) / 2 fragments */
+#define LINK_MAP_SIZE               64u
+
 /* Allocate 2 Timers/Counters, that are not used already by the libraries and
  * drivers this example depends on. */
 #define TIMER0_MODULE                 ID_TC0
@@ -221,6 +235,8 @@
 
 const char test_file_path[] = "test_data.bin";
 
+const char log_file_path[] = "log_data.bin";
+
 #ifdef CONFIG_HAVE_SDMMC
 
 /* Driver instance data (a.k.a. MCI driver instance) */
@@ -281,6 +297,12 @@ CACHE_ALIGNED_DDR static sSdCard lib0;
 CACHE_ALIGNED_DDR static sSdCard lib1;
 #endif
 
+/* Media instances, through which FatFs accesses the devices */
+static struct _media media0;
+#ifdef SLOT1_ID
+static struct _media media1;
+#endif
+
 /* Read/write data buffer.
  * It may receive data transferred from the device by the DMA. As the L1 data
  * cache won't notice when RAM is updated directly, the driver will invalidate
@@ -294,6 +316,11 @@ CACHE_ALIGNED_DDR static uint8_t data_buf[BLOCK_CNT_MAX * 512ul];
 
 NOT_CACHED static FATFS fs_header;
 NOT_CACHED static FIL f_header;
+NOT_CACHED static struct _ff_stream log_stream;
+
+/* Cluster link map of the file read back: the clusters are then located
+ * without reading the FAT */
+static DWORD link_map[LINK_MAP_SIZE];
 
 #ifdef CONFIG_HAVE_SHA
 static struct _shad_desc shad;
@@ -343,6 +370,8 @@ static void display_menu(void)
 	printf("   i: Display device info\n\r");
 	printf("   l: Mount FAT file system and list files\n\r");
 	printf("   r: Read the file named '%s'\n\r", test_file_path);
+	printf("   s: Stream records to the file named '%s'\n\r",
+	    log_file_path);
 	printf("   w: Perform a basic RAW read/write test.\n\r");
 	printf("\n\r");
 }
@@ -376,6 +405,12 @@ static void initialize(void)
 	SDD_InitializeSdmmcMode(&lib1, &drv1, 0);
 #endif /* SLOT1_ID */
 
+#endif
+
+	/* The medias are set up once the devices are initialized */
+	media_deinit(&media0);
+#ifdef SLOT1_ID
+	media_deinit(&media1);
 #endif
 
 #ifdef CONFIG_HAVE_SHA
@@ -433,6 +468,23 @@ static bool show_device_info(sSdCard *pSd)
 	return true;
 }
 
+/**
+ * \brief Initialize the device in a slot and the media FatFs accesses it
+ * through. Unlike the disk I/O layer of libsdmmc, media_ff leaves the device
+ * initialization to the application.
+ */
+static bool open_volume(uint8_t slot_ix, sSdCard *pSd)
+{
+	struct _media *media = NULL;
+
+	SD_DeInit(pSd);
+	if (!open_device(pSd))
+		return false;
+	media_ff_get_instance(slot_ix, &media);
+	media_sdcard_initialize(media, pSd);
+	return true;
+}
+
 static bool mount_volume(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 {
 	const TCHAR drive_path[] = { '0' + slot_ix, ':', '\0' };
@@ -441,6 +493,8 @@ static bool mount_volume(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 	FRESULT res;
 	bool is_dir, rc = true;
 
+	if (!open_volume(slot_ix, pSd))
+		return false;
 	memset(fs, 0, sizeof(FATFS));
 	res = f_mount(fs, drive_path, 1);
 	if (res != FR_OK) {
@@ -485,6 +539,8 @@ static bool read_file(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 	FRESULT res;
 	bool rc = true;
 
+	if (!open_volume(slot_ix, pSd))
+		return false;
 	memset(fs, 0, sizeof(FATFS));
 	res = f_mount(fs, drive_path, 1);
 	if (res != FR_OK) {
@@ -498,6 +554,18 @@ static bool read_file(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 		printf("Failed to open \"%s\", error %d\n\r", file_path, res);
 		return false;
 	}
+	link_map[0] = LINK_MAP_SIZE;
+	f_header.cltbl = link_map;
+	res = f_lseek(&f_header, CREATE_LINKMAP);
+	if (res == FR_NOT_ENOUGH_CORE) {
+		/* Too fragmented, follow the FAT chain instead */
+		f_header.cltbl = NULL;
+		res = FR_OK;
+	} else if (res != FR_OK) {
+		printf("Failed to map \"%s\", error %d\n\r", file_path, res);
+		f_close(&f_header);
+		return false;
+	}
 #ifdef CONFIG_HAVE_SHA
 	shad_start(&shad);
 #endif
@@ -541,15 +609,76 @@ static bool read_file(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
 	return rc;
 }
 
+/**
+ * \brief Write a log file through the streaming writer: the file is reserved
+ * as a contiguous extent, then filled with records without updating the FAT.
+ */
+static bool write_log_file(uint8_t slot_ix, sSdCard *pSd, FATFS *fs)
+{
+	const TCHAR drive_path[] = { '0' + slot_ix, ':', '\0' };
+	TCHAR file_path[sizeof(drive_path) + sizeof(log_file_path)];
+	uint32_t file_size, record;
+	UINT len;
+	FRESULT res;
+	bool rc = true;
+
+	if (!open_volume(slot_ix, pSd))
+		return false;
+	memset(fs, 0, sizeof(FATFS));
+	res = f_mount(fs, drive_path, 1);
+	if (res != FR_OK) {
+		printf("Failed to mount FAT file system, error %d\n\r", res);
+		return false;
+	}
+	strcpy(file_path, drive_path);
+	strcat(file_path, log_file_path);
+	res = f_open(&f_header, file_path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res != FR_OK) {
+		printf("Failed to create \"%s\", error %d\n\r", file_path, res);
+		return false;
+	}
+	res = ff_stream_open(&log_stream, &f_header, LOG_FILE_SIZE);
+	if (res != FR_OK) {
+		printf("Failed to reserve %lu bytes, error %d\n\r",
+		    LOG_FILE_SIZE, res);
+		f_close(&f_header);
+		return false;
+	}
+	for (file_size = 0, record = 0;
+	    file_size + LOG_RECORD_SIZE <= LOG_FILE_SIZE;
+	    file_size += len, record++) {
+		memset(data_buf, record & 0xff, LOG_RECORD_SIZE);
+		res = ff_stream_write(&log_stream, data_buf, LOG_RECORD_SIZE,
+		    &len);
+		if (res != FR_OK || len != LOG_RECORD_SIZE) {
+			printf("Error %d while writing record %lu\n\r", res,
+			    record);
+			rc = false;
+			break;
+		}
+	}
+	res = ff_stream_close(&log_stream);
+	if (res != FR_OK) {
+		trace_error("Failed to close file, error %d\n\r", res);
+		return false;
+	}
+	if (rc)
+		printf("Wrote %lu records, %lu bytes.\n\r", record, file_size);
+	return rc;
+}
+
 static bool unmount_volume(uint8_t slot_ix, sSdCard *pSd)
 {
 	const TCHAR drive_path[] = { '0' + slot_ix, ':', '\0' };
+	struct _media *media = NULL;
 	FRESULT res;
 	bool rc = true;
 
 	res = f_mount(NULL, drive_path, 0);
 	if (res != FR_OK)
 		rc = false;
+	media_ff_get_instance(slot_ix, &media);
+	media_deinit(media);
 	SD_DeInit(pSd);
 	return rc;
 }
@@ -558,20 +687,18 @@ static bool unmount_volume(uint8_t slot_ix, sSdCard *pSd)
  *        Exported functions
  *----------------------------------------------------------------------------*/
 
-/* Refer to sdmmc_ff.c */
-bool SD_GetInstance(uint8_t index, sSdCard **holder);
-
-bool SD_GetInstance(uint8_t index, sSdCard **holder)
+/* Refer to media_ff.c */
+bool media_ff_get_instance(uint8_t index, struct _media **holder)
 {
 	assert(holder);
 
 	switch (index) {
 	case 0:
-		*holder = &lib0;
+		*holder = &media0;
 		break;
 #ifdef SLOT1_ID
 	case 1:
-		*holder = &lib1;
+		*holder = &media1;
 		break;
 #endif /* SLOT1_ID */
 	default:
@@ -754,6 +881,18 @@ int main(void)
 			read_file(slot, lib, &fs_header);
 			unmount_volume(slot, lib);
 			break;
+		case 's':
+			if (SD_GetStatus(lib) == SDMMC_NOT_SUPPORTED) {
+				printf("Device not detected.\n\r");
+				break;
+			}
+			if (SD_GetWpStatus(lib) == SDMMC_LOCKED) {
+				printf("Device is write protected.\n\r");
+				break;
+			}
+			write_log_file(slot, lib, &fs_header);
+			unmount_volume(slot, lib);
+			break;
 		case 'w':
 			if (SD_GetStatus(lib) == SDMMC_NOT_SUPPORTED) {
 				printf("Device not detected.\n\r");
@@ -0,0 +1,237 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ *         Headers
+ *---------------------------------------------------------------------------*/
+
+#include "ff.h"
+#include "ff_stream.h"
+#include "diskio.h"
+
+#include <string.h>
+
+#if _USE_EXPAND && !_FS_READONLY
+
+#if _FS_MINIMIZE != 0
+#error "ff_stream requires f_truncate() (_FS_MINIMIZE == 0) to release the unused clusters"
+#endif
+
+/*---------------------------------------------------------------------------
+ *         Local definitions
+ *---------------------------------------------------------------------------*/
+
+#if _MAX_SS == _MIN_SS
+#define FF_STREAM_SS(fs) ((UINT)_MAX_SS)
+#else
+#define FF_STREAM_SS(fs) ((UINT)(fs)->ssize)
+#endif
+
+/*---------------------------------------------------------------------------
+ *         Local functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief Get the number of bytes written to the stream so far.
+ */
+static FSIZE_t ff_stream_offset(const struct _ff_stream* stream)
+{
+	return (FSIZE_t)stream->written * FF_STREAM_SS(stream->fp->obj.fs)
+		+ stream->fill;
+}
+
+/**
+ * \brief Write the partially filled sector, if any, to the disk.
+ * The sector stays buffered so that following writes can complete it.
+ */
+static FRESULT ff_stream_flush(struct _ff_stream* stream)
+{
+	FATFS* fs = stream->fp->obj.fs;
+
+	if (stream->fill == 0)
+		return FR_OK;
+	memset(stream->buffer + stream->fill, 0, FF_STREAM_SS(fs) - stream->fill);
+	if (disk_write(fs->drv, stream->buffer,
+			stream->sector + stream->written, 1) != RES_OK)
+		return FR_DISK_ERR;
+	return FR_OK;
+}
+
+/*---------------------------------------------------------------------------
+ *         Exported functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief Reserve a contiguous extent for a file and start streaming to it.
+ * \param stream  Streaming writer to initialize.
+ * \param fp      File opened for writing, with a size of zero.
+ * \param size    Number of bytes to reserve.
+ * \return FR_OK on success, FR_DENIED if no contiguous free area large
+ * enough was found, or any other error code returned by f_expand().
+ */
+FRESULT ff_stream_open(struct _ff_stream* stream, FIL* fp, FSIZE_t size)
+{
+	FATFS* fs;
+	DWORD csz, ncl;
+	FRESULT res;
+
+	res = f_expand(fp, size, 1);
+	if (res != FR_OK)
+		return res;
+
+	fs = fp->obj.fs;
+
+	/* f_expand() does not account for the allocated clusters in the free
+	 * cluster count, while f_truncate() does when releasing them. */
+	csz = (DWORD)fs->csize * FF_STREAM_SS(fs);
+	ncl = (DWORD)((size + csz - 1) / csz);
+	if (fs->free_clst <= fs->n_fatent - 2 && fs->free_clst >= ncl) {
+		fs->free_clst -= ncl;
+		fs->fsi_flag |= 1;
+	}
+
+	stream->fp = fp;
+	stream->size = size;
+	stream->sector = fs->database + (DWORD)fs->csize * (fp->obj.sclust - 2);
+	stream->written = 0;
+	stream->fill = 0;
+	return FR_OK;
+}
+
+/**
+ * \brief Append data to the stream.
+ * Whole sectors are written directly from the caller buffer as a single
+ * multi-sector request, only the trailing partial sector is buffered.
+ * \param stream  Streaming writer.
+ * \param buff    Data to write.
+ * \param btw     Number of bytes to write.
+ * \param bw      Number of bytes accepted, less than btw when the end of the
+ * reserved extent is reached.
+ * \return FR_OK on success, FR_DISK_ERR on I/O error.
+ */
+FRESULT ff_stream_write(struct _ff_stream* stream, const void* buff,
+		UINT btw, UINT* bw)
+{
+	FATFS* fs = stream->fp->obj.fs;
+	const BYTE* p = (const BYTE*)buff;
+	UINT ss = FF_STREAM_SS(fs);
+	FSIZE_t ofs = ff_stream_offset(stream);
+	UINT n;
+
+	*bw = 0;
+	if (btw > stream->size - ofs)
+		btw = (UINT)(stream->size - ofs);
+
+	/* Complete the buffered sector */
+	if (stream->fill) {
+		n = ss - stream->fill;
+		if (n > btw)
+			n = btw;
+		memcpy(stream->buffer + stream->fill, p, n);
+		stream->fill += n;
+		p += n;
+		btw -= n;
+		*bw += n;
+		if (stream->fill < ss)
+			return FR_OK;
+		if (disk_write(fs->drv, stream->buffer,
+				stream->sector + stream->written, 1) != RES_OK)
+			return FR_DISK_ERR;
+		stream->written++;
+		stream->fill = 0;
+	}
+
+	/* Write whole sectors in place */
+	n = btw / ss;
+	if (n) {
+		if (disk_write(fs->drv, p, stream->sector + stream->written, n) != RES_OK)
+			return FR_DISK_ERR;
+		stream->written += n;
+		p += n * ss;
+		btw -= n * ss;
+		*bw += n * ss;
+	}
+
+	/* Keep the remainder for the next call */
+	if (btw) {
+		memcpy(stream->buffer, p, btw);
+		stream->fill = btw;
+		*bw += btw;
+	}
+
+	return FR_OK;
+}
+
+/**
+ * \brief Commit the data written so far.
+ * The directory entry is updated with the current stream size while the
+ * whole extent stays allocated to the file.
+ */
+FRESULT ff_stream_sync(struct _ff_stream* stream)
+{
+	FIL* fp = stream->fp;
+	FRESULT res;
+
+	res = ff_stream_flush(stream);
+	if (res != FR_OK)
+		return res;
+
+	fp->obj.objsize = ff_stream_offset(stream);
+	fp->flag |= _FA_MODIFIED;
+	res = f_sync(fp);
+	fp->obj.objsize = stream->size;
+	return res;
+}
+
+/**
+ * \brief Commit the data written, release the unused part of the extent and
+ * close the file.
+ */
+FRESULT ff_stream_close(struct _ff_stream* stream)
+{
+	FIL* fp = stream->fp;
+	FRESULT res;
+
+	res = ff_stream_flush(stream);
+	if (res != FR_OK)
+		return res;
+
+	res = f_lseek(fp, ff_stream_offset(stream));
+	if (res == FR_OK)
+		res = f_truncate(fp);
+	if (res != FR_OK)
+		return res;
+
+	res = f_close(fp);
+	if (res == FR_OK)
+		stream->fp = NULL;
+	return res;
+}
+
+#endif /* _USE_EXPAND && !_FS_READONLY */
@@ -0,0 +1,81 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ *  \file
+ *
+ *  Streaming writer for FatFs files backed by a contiguous extent.
+ *
+ *  The file is reserved up-front with f_expand() so that its data occupies
+ *  consecutive sectors. Data is then written sector by sector straight to the
+ *  disk I/O layer, without going through the FAT chain nor updating the
+ *  directory entry. The directory entry is only fixed up by ff_stream_sync()
+ *  and ff_stream_close(), the unused part of the extent being released on
+ *  close with f_truncate().
+ *
+ *  Requires _USE_EXPAND to be enabled and _FS_MINIMIZE to be 0 in ffconf.h.
+ */
+
+#ifndef FF_STREAM_H
+#define FF_STREAM_H
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "ff.h"
+
+/*------------------------------------------------------------------------------
+ *      Types
+ *------------------------------------------------------------------------------*/
+
+/** Streaming writer state */
+struct _ff_stream {
+	FIL*    fp;          /**< File being written */
+	FSIZE_t size;        /**< Size of the reserved extent, in bytes */
+	DWORD   sector;      /**< First sector of the extent */
+	DWORD   written;     /**< Number of sectors completely written */
+	UINT    fill;        /**< Number of bytes pending in buffer */
+	BYTE    buffer[_MAX_SS]; /**< Partially written sector */
+};
+
+/*------------------------------------------------------------------------------
+ *      Exported functions
+ *------------------------------------------------------------------------------*/
+
+extern FRESULT ff_stream_open(struct _ff_stream* stream, FIL* fp, FSIZE_t size);
+
+extern FRESULT ff_stream_write(struct _ff_stream* stream, const void* buff,
+		UINT btw, UINT* bw);
+
+extern FRESULT ff_stream_sync(struct _ff_stream* stream);
+
+extern FRESULT ff_stream_close(struct _ff_stream* stream);
+
+#endif /* FF_STREAM_H */
@@ -52,6 +52,7 @@
 #include "compiler.h"
 #include "intmath.h"
 #include "timer.h"
+#include "irqflags.h"
 #include "libsdmmc.h"
 
 #include <assert.h>
@@ -114,6 +115,11 @@ struct stringEntry_s
 #define STATUS_ADDRESS_MISALIGN  (1UL << 30)
 #define STATUS_ADDR_OUT_OR_RANGE (1UL << 31)
 
+/** Maximum number of buffers gathered into a single transfer command */
+#ifndef SDMMC_IOVEC_MAX
+#define SDMMC_IOVEC_MAX 16
+#endif
+
 #define STATUS_STOP ((uint32_t)( STATUS_CARD_IS_LOCKED \
                         | STATUS_COM_CRC_ERROR \
                         | STATUS_ILLEGAL_COMMAND \
@@ -265,6 +271,8 @@ static const struct stringEntry_s sdmmcIOCtrlNames[] = {
 	{ SDMMC_IOCTL_GET_BOOTMODE,	"GET_BOOTMODE",		},
 	{ SDMMC_IOCTL_GET_XFERCOMPL,	"GET_XFERCOMPL",	},
 	{ SDMMC_IOCTL_GET_DEVICE,	"GET_DEVICE",		},
+	{ SDMMC_IOCTL_GET_WP,		"GET_WP",		},
+	{ SDMMC_IOCTL_GET_SG,		"GET_SG",		},
 };
 
 static const struct stringEntry_s sdmmcRCodeNames[] = {
@@ -343,6 +351,11 @@ _SdParamReset(sSdCard * pSd)
 	pSd->bStopMultXfer = 0;
 
 	memset(&pSd->sdCmd, 0, sizeof(pSd->sdCmd));
+	memset(&pSd->reqCmd, 0, sizeof(pSd->reqCmd));
+	pSd->pReqHead = NULL;
+	pSd->pReqTail = NULL;
+	pSd->bReqActive = 0;
+	pSd->bReqHalted = 0;
 
 	/* Clear our device register cache */
 	memset(pSd->CID, 0, 16);
@@ -379,7 +392,9 @@ _SendCmd(sSdCard * pSd, fSdmmcCallback fCallback, void *pCbArg)
 	pCmd->pArg = pCbArg;
 	bRc = pHal->fCommand(pSd->pDrv, pCmd);
 
-	if (fCallback == NULL) {
+	/* Poll command status, unless the driver has rejected the command, in
+	 * which case bRc already tells why and there is nothing to wait for */
+	if (bRc == SDMMC_OK && fCallback == NULL) {
 		/* Poll command status.
 		 * The driver is responsible for detecting and reporting
 		 * timeout conditions. Here we only start a backup timer, in
@@ -1224,6 +1239,9 @@ Cmd19(sSdCard * pSd, uint8_t * pData, uint8_t len, uint32_t * pStatus)
  * \param nbBlocks  Number of blocks to send.
  * \param pData     Pointer to the buffer to be filled.
  * The buffer shall follow the peripheral and DMA alignment requirements.
+ * \param pIoVec    Optional scatter-gather list, whose first segment starts
+ *                  at pData. NULL if all blocks are held by pData.
+ * \param wIoVecCnt Number of segments in pIoVec.
  * \param address   Data Address on SD/MMC card.
  * \param pStatus   Pointer to the response status.
  * \param fCallback Pointer to optional callback invoked on command end.
@@ -1235,6 +1253,8 @@ static uint8_t
 Cmd18(sSdCard * pSd,
       uint16_t * nbBlock,
       uint8_t * pData,
+      const sSdmmcIoVec * pIoVec,
+      uint16_t wIoVecCnt,
       uint32_t address, uint32_t * pStatus, fSdmmcCallback callback)
 {
 	sSdmmcCommand *pCmd = &pSd->sdCmd;
@@ -1250,6 +1270,8 @@ Cmd18(sSdCard * pSd,
 	pCmd->wBlockSize = BLOCK_SIZE(pSd);
 	pCmd->wNbBlocks = *nbBlock;
 	pCmd->pData = pData;
+	pCmd->pIoVec = pIoVec;
+	pCmd->wIoVecCount = wIoVecCnt;
 	pCmd->fCallback = callback;
 	/* Send command */
 	bRc = _SendCmd(pSd, NULL, NULL);
@@ -1331,6 +1353,9 @@ Cmd24(sSdCard * pSd,
  * \param nbBlock   Number of blocks to send.
  * \param pData     Pointer to the buffer to be filled.
  * The buffer shall follow the peripheral and DMA alignment requirements.
+ * \param pIoVec    Optional scatter-gather list, whose first segment starts
+ *                  at pData. NULL if all blocks are held by pData.
+ * \param wIoVecCnt Number of segments in pIoVec.
  * \param address   Data Address on SD/MMC card.
  * \param pStatus   Pointer to the response buffer as status.
  * \param fCallback Pointer to optional callback invoked on command end.
@@ -1342,6 +1367,8 @@ static uint8_t
 Cmd25(sSdCard * pSd,
       uint16_t * nbBlock,
       uint8_t * pData,
+      const sSdmmcIoVec * pIoVec,
+      uint16_t wIoVecCnt,
       uint32_t address, uint32_t * pStatus, fSdmmcCallback callback)
 {
 	sSdmmcCommand *pCmd = &pSd->sdCmd;
@@ -1357,6 +1384,8 @@ Cmd25(sSdCard * pSd,
 	pCmd->wBlockSize = BLOCK_SIZE(pSd);
 	pCmd->wNbBlocks = *nbBlock;
 	pCmd->pData = pData;
+	pCmd->pIoVec = pIoVec;
+	pCmd->wIoVecCount = wIoVecCnt;
 	pCmd->fCallback = callback;
 	/* Send command */
 	bRc = _SendCmd(pSd, NULL, NULL);
@@ -1893,12 +1922,17 @@ PerformSingleTransfer(sSdCard * pSd,
  * for infinite transfer. Upon return, points to the count of blocks actually
  * transferred.
  * \param pData    Data buffer whose size is at least the block size.
+ * \param pIoVec   Optional scatter-gather list, whose first segment starts at
+ * pData. NULL if all blocks are held by pData.
+ * \param wIoVecCnt Number of segments in pIoVec.
  * \param isRead   1 for read data and 0 for write data.
  */
 static uint8_t
 MoveToTransferState(sSdCard * pSd,
 		    uint32_t address,
-		    uint16_t * nbBlocks, uint8_t * pData, uint8_t isRead)
+		    uint16_t * nbBlocks, uint8_t * pData,
+		    const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt,
+		    uint8_t isRead)
 {
 	uint8_t result = SDMMC_OK, error;
 	uint32_t sdmmc_address, state, status;
@@ -1920,12 +1954,12 @@ MoveToTransferState(sSdCard * pSd,
 	}
 	if (isRead)
 		/* Move to Receiving data state */
-		error = Cmd18(pSd, nbBlocks, pData, sdmmc_address, &status,
-		    NULL);
+		error = Cmd18(pSd, nbBlocks, pData, pIoVec, wIoVecCnt,
+		    sdmmc_address, &status, NULL);
 	else
 		/* Move to Sending data state */
-		error = Cmd25(pSd, nbBlocks, pData, sdmmc_address, &status,
-		    NULL);
+		error = Cmd25(pSd, nbBlocks, pData, pIoVec, wIoVecCnt,
+		    sdmmc_address, &status, NULL);
 	if (error == SDMMC_CHANGED)
 		error = SDMMC_OK;
 	if (!error) {
@@ -1994,6 +2028,217 @@ MoveToTransferState(sSdCard * pSd,
 	return result;
 }
 
+/**
+ * Transfer blocks of data from or to a list of buffers. Consecutive segments
+ * of the list are gathered into a single multiple block command, as long as
+ * the driver supports scatter-gather transfers; otherwise one command is
+ * issued per segment.
+ * Returns 0 if successful; otherwise returns an code describing the error.
+ * \param pSd       Pointer to a SD card driver instance.
+ * \param address   Address of the first block to transfer.
+ * \param pIoVec    List of buffers.
+ * \param wIoVecCnt Number of buffers in the list.
+ * \param isRead    1 for read data and 0 for write data.
+ */
+static uint8_t
+PerformVectorTransfer(sSdCard * pSd,
+		      uint32_t address,
+		      const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt,
+		      uint8_t isRead)
+{
+	sSdmmcIoVec vec[SDMMC_IOVEC_MAX];
+	const uint32_t blk_size = BLOCK_SIZE(pSd);
+	uint32_t skip = 0, total, done;
+	uint32_t drv_param = 0;
+	uint16_t max_seg = SDMMC_IOVEC_MAX, ix, limited;
+	uint8_t error = SDMMC_OK;
+
+	assert(pIoVec != NULL || wIoVecCnt == 0);
+
+	/* Gather segments only if the driver supports it, so that no block
+	 * count is announced to the device for a command that can't be sent */
+	if (pSd->pHalf->fIOCtrl(pSd->pDrv, SDMMC_IOCTL_GET_SG,
+	    (uint32_t)&drv_param) != SDMMC_OK || !drv_param)
+		max_seg = 1;
+
+	while (wIoVecCnt != 0) {
+		/* Skip the segments completely transferred, and empty ones */
+		if (skip >= pIoVec->wNbBlocks) {
+			pIoVec++;
+			wIoVecCnt--;
+			skip = 0;
+			continue;
+		}
+		/* Gather the following segments, up to the 65535-block limit
+		 * of a single command */
+		for (ix = 0, total = 0; ix < max_seg && ix < wIoVecCnt
+		    && total < 65535; ix++) {
+			vec[ix].pData = pIoVec[ix].pData
+			    + (ix == 0 ? skip * blk_size : 0);
+			vec[ix].wNbBlocks = (uint16_t)min_u32(
+			    pIoVec[ix].wNbBlocks - (ix == 0 ? skip : 0),
+			    65535 - total);
+			total += vec[ix].wNbBlocks;
+		}
+		limited = (uint16_t)total;
+		error = MoveToTransferState(pSd, address, &limited,
+		    vec[0].pData, ix > 1 ? vec : NULL, ix > 1 ? ix : 0,
+		    isRead);
+		if (error == SDMMC_NOT_SUPPORTED && ix > 1) {
+			/* Fall back on one command per segment */
+			max_seg = 1;
+			continue;
+		}
+		if (error)
+			break;
+		/* Move past the blocks actually transferred */
+		address += limited;
+		for (done = limited; done != 0; ) {
+			total = min_u32(done, pIoVec->wNbBlocks - skip);
+			skip += total;
+			done -= total;
+			if (skip >= pIoVec->wNbBlocks) {
+				pIoVec++;
+				wIoVecCnt--;
+				skip = 0;
+			}
+		}
+	}
+	return error;
+}
+
+static void _CompleteRequest(sSdCard * pSd, uint8_t bStatus);
+static void _RequestCallback(uint32_t status, void *pArg);
+
+/**
+ * Issue the next READ_MULTIPLE_BLOCK or WRITE_MULTIPLE_BLOCK command of the
+ * request at the head of the queue. The command completes asynchronously,
+ * see _RequestCallback().
+ * \param pSd  Pointer to a SD card driver instance.
+ */
+static void
+_StartRequest(sSdCard * pSd)
+{
+	sSdmmcRequest *pReq = pSd->pReqHead;
+	sSdmmcCommand *pCmd = &pSd->reqCmd;
+	uint32_t address = pReq->dwAddr + pReq->dwDone;
+	uint8_t bRc;
+
+	/* Convert block address into device-expected unit. The range has
+	 * been verified upon submission. */
+	if (!(pSd->bCardType & CARD_TYPE_bmHC))
+		address *= BLOCK_SIZE(pSd);
+
+	_ResetCmd(pCmd);
+	pCmd->cmdOp.wVal = pReq->bRead ? SDMMC_CMD_CDATARX(1)
+	    : SDMMC_CMD_CDATATX(1);
+	pCmd->bCmd = pReq->bRead ? 18 : 25;
+	pCmd->dwArg = address;
+	pCmd->pResp = &pSd->dwReqResp;
+	pCmd->wBlockSize = BLOCK_SIZE(pSd);
+	pCmd->wNbBlocks = (uint16_t)min_u32(pReq->dwNbBlocks - pReq->dwDone,
+	    65535);
+	pCmd->pData = pReq->pData
+	    + pReq->dwDone * (uint32_t)BLOCK_SIZE(pSd);
+	pCmd->fCallback = _RequestCallback;
+	pCmd->pArg = pSd;
+	bRc = pSd->pHalf->fCommand(pSd->pDrv, pCmd);
+	if (bRc != SDMMC_OK && bRc != SDMMC_CHANGED)
+		_CompleteRequest(pSd, bRc);
+}
+
+/**
+ * Remove the request at the head of the queue, chain the next request and
+ * notify the caller.
+ * \param pSd      Pointer to a SD card driver instance.
+ * \param bStatus  Completion status of the request.
+ */
+static void
+_CompleteRequest(sSdCard * pSd, uint8_t bStatus)
+{
+	sSdmmcRequest *pReq;
+	uint32_t flags;
+	bool next;
+
+	flags = arch_irq_save();
+	pReq = pSd->pReqHead;
+	pSd->pReqHead = pReq->pNext;
+	if (pSd->pReqHead == NULL)
+		pSd->pReqTail = NULL;
+	/* Upon error, the device needs to be recovered before processing the
+	 * following requests, refer to SD_PollRequests() */
+	if (bStatus != SDMMC_OK)
+		pSd->bReqHalted = 1;
+	next = !pSd->bReqHalted && pSd->pReqHead != NULL;
+	pSd->bReqActive = next ? 1 : 0;
+	arch_irq_restore(flags);
+
+	pReq->bStatus = bStatus;
+	/* Keep the device busy while the caller handles the completion */
+	if (next)
+		_StartRequest(pSd);
+	if (pReq->fCallback)
+		pReq->fCallback(bStatus, pReq->pArg);
+}
+
+/**
+ * End-of-command callback of the queued request commands. Invoked by the
+ * driver, from the completion interrupt if the driver is not polling.
+ * \param status  Command status.
+ * \param pArg    Pointer to a SD card driver instance.
+ */
+static void
+_RequestCallback(uint32_t status, void *pArg)
+{
+	sSdCard *pSd = (sSdCard *)pArg;
+	sSdmmcRequest *pReq = pSd->pReqHead;
+	uint32_t dev_status;
+
+	if (status == SDMMC_CHANGED)
+		status = SDMMC_OK;
+	if (status == SDMMC_OK) {
+		dev_status = pSd->dwReqResp
+		    & (pReq->bRead ? STATUS_READ : STATUS_WRITE)
+		    & ~STATUS_READY_FOR_DATA & ~STATUS_STATE;
+		if (dev_status) {
+			trace_error("st %lx\n\r", dev_status);
+			status = SDMMC_ERROR;
+		}
+	}
+	if (status == SDMMC_OK) {
+		/* The driver may have transferred less blocks than requested */
+		pReq->dwDone += pSd->reqCmd.wNbBlocks;
+		if (pReq->dwDone < pReq->dwNbBlocks) {
+			_StartRequest(pSd);
+			return;
+		}
+	}
+	_CompleteRequest(pSd, (uint8_t)status);
+}
+
+/**
+ * Bring the device back to the Transfer State after a failed request.
+ * \param pSd  Pointer to a SD card driver instance.
+ * \return a \ref sdmmc_rc result code.
+ */
+static uint8_t
+_RecoverRequestState(sSdCard * pSd)
+{
+	uint32_t status, state;
+	uint8_t error;
+
+	error = Cmd13(pSd, &status);
+	if (error)
+		return error;
+	state = status & STATUS_STATE;
+	if (state == STATUS_DATA || state == STATUS_RCV) {
+		error = Cmd12(pSd, &status);
+		if (error)
+			return error;
+	}
+	return _WaitUntilReady(pSd, status);
+}
+
 /**
  * Switch card state between STBY and TRAN (or CMD and TRAN)
  * \param pSd       Pointer to a SD card driver instance.
@@ -3203,7 +3448,8 @@ SD_Read(sSdCard * pSd,
 	    blk_no += limited, remaining -= limited,
 	    out += (uint32_t)limited * (uint32_t)BLOCK_SIZE(pSd)) {
 		limited = (uint16_t)min_u32(remaining, 65535);
-		error = MoveToTransferState(pSd, blk_no, &limited, out, 1);
+		error = MoveToTransferState(pSd, blk_no, &limited, out, NULL, 0,
+		    1);
 	}
 	trace_debug("SDrd(%lu,%lu) %s\n\r", address, length,
 	    SD_StringifyRetCode(error));
@@ -3243,13 +3489,177 @@ SD_Write(sSdCard * pSd,
 	    blk_no += limited, remaining -= limited,
 	    in += (uint32_t)limited * (uint32_t)BLOCK_SIZE(pSd)) {
 		limited = (uint16_t)min_u32(remaining, 65535);
-		error = MoveToTransferState(pSd, blk_no, &limited, in, 0);
+		error = MoveToTransferState(pSd, blk_no, &limited, in, NULL, 0,
+		    0);
 	}
 	trace_debug("SDwr(%lu,%lu) %s\n\r", address, length,
 	    SD_StringifyRetCode(error));
 	return error;
 }
 
+/**
+ * Read blocks of data into a list of buffers. Consecutive blocks are read
+ * by as few READ_MULTIPLE_BLOCK commands as the driver allows, regardless of
+ * the buffers being contiguous in memory or not.
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd      Pointer to a SD card driver instance.
+ * \param address  Address of the first block to read.
+ * \param pIoVec   List of buffers to be filled. Each buffer shall follow the
+ * peripheral and DMA alignment requirements.
+ * \param wIoVecCnt Number of buffers in the list.
+ */
+uint8_t
+SD_ReadV(sSdCard * pSd,
+	 uint32_t address, const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt)
+{
+	uint8_t error;
+
+	assert(pSd != NULL);
+
+	error = PerformVectorTransfer(pSd, address, pIoVec, wIoVecCnt, 1);
+	trace_debug("SDrdv(%lu,%u) %s\n\r", address, wIoVecCnt,
+	    SD_StringifyRetCode(error));
+	return error;
+}
+
+/**
+ * Write blocks of data from a list of buffers. Consecutive blocks are
+ * written by as few WRITE_MULTIPLE_BLOCK commands as the driver allows,
+ * regardless of the buffers being contiguous in memory or not.
+ * \return 0 if successful; otherwise returns an \ref sdmmc_rc "error code".
+ * \param pSd      Pointer to a SD card driver instance.
+ * \param address  Address of the first block to write.
+ * \param pIoVec   List of buffers to be written. Each buffer shall follow the
+ * peripheral and DMA alignment requirements.
+ * \param wIoVecCnt Number of buffers in the list.
+ */
+uint8_t
+SD_WriteV(sSdCard * pSd,
+	  uint32_t address, const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt)
+{
+	uint8_t error;
+
+	assert(pSd != NULL);
+
+	error = PerformVectorTransfer(pSd, address, pIoVec, wIoVecCnt, 0);
+	trace_debug("SDwrv(%lu,%u) %s\n\r", address, wIoVecCnt,
+	    SD_StringifyRetCode(error));
+	return error;
+}
+
+/**
+ * Queue an asynchronous block transfer request. The request is processed
+ * once the requests submitted before are complete. Successive READ_MULTIPLE_
+ * BLOCK and WRITE_MULTIPLE_BLOCK commands are chained from the completion
+ * interrupt, so that the CPU remains available while the queue is processed.
+ * Upon completion, pReq->bStatus is updated and pReq->fCallback is invoked,
+ * possibly from interrupt context. Callbacks may submit further requests.
+ *
+ * Devices which require the SET_BLOCK_COUNT or STOP_TRANSMISSION commands to
+ * be issued by the library are served synchronously: the request completes
+ * before this function returns.
+ *
+ * While requests are pending, no other function of this library shall be
+ * called for the same device, except SD_SubmitRequest() and
+ * SD_PollRequests().
+ * \return SDMMC_OK if the request has been queued; otherwise returns an
+ * \ref sdmmc_rc "error code" and the request is dropped.
+ * \param pSd   Pointer to a SD card driver instance.
+ * \param pReq  Request to queue. It shall remain valid until completion.
+ */
+uint8_t
+SD_SubmitRequest(sSdCard * pSd, sSdmmcRequest * pReq)
+{
+	uint32_t flags;
+	uint8_t error;
+	bool start;
+
+	assert(pSd != NULL);
+	assert(pReq != NULL);
+
+	if (pReq->pData == NULL || pReq->dwNbBlocks == 0)
+		return SDMMC_PARAM;
+	if (pReq->dwAddr + pReq->dwNbBlocks < pReq->dwAddr
+	    || (!(pSd->bCardType & CARD_TYPE_bmHC) && pReq->dwAddr
+	    + pReq->dwNbBlocks - 1 > 0xfffffffful / BLOCK_SIZE(pSd)))
+		return SDMMC_PARAM;
+
+	pReq->dwDone = 0;
+	pReq->pNext = NULL;
+	pReq->bStatus = SDMMC_BUSY;
+
+	if (pSd->bSetBlkCnt || pSd->bStopMultXfer) {
+		if (pReq->bRead)
+			error = SD_Read(pSd, pReq->dwAddr, pReq->pData,
+			    pReq->dwNbBlocks, NULL, NULL);
+		else
+			error = SD_Write(pSd, pReq->dwAddr, pReq->pData,
+			    pReq->dwNbBlocks, NULL, NULL);
+		pReq->bStatus = error;
+		if (pReq->fCallback)
+			pReq->fCallback(error, pReq->pArg);
+		return SDMMC_OK;
+	}
+
+	flags = arch_irq_save();
+	if (pSd->pReqTail)
+		pSd->pReqTail->pNext = pReq;
+	else
+		pSd->pReqHead = pReq;
+	pSd->pReqTail = pReq;
+	start = !pSd->bReqActive && !pSd->bReqHalted;
+	if (start)
+		pSd->bReqActive = 1;
+	arch_irq_restore(flags);
+
+	if (start)
+		_StartRequest(pSd);
+	return SDMMC_OK;
+}
+
+/**
+ * Process the request queue from thread context. Shall be called
+ * periodically when the driver is configured for polling, so that commands
+ * complete. Also shall be called after a request failed: the device is then
+ * recovered and the processing of the queue resumes.
+ * \return SDMMC_OK if the queue is empty, SDMMC_BUSY if requests are
+ * pending; otherwise returns an \ref sdmmc_rc "error code" if the device
+ * could not be recovered.
+ * \param pSd  Pointer to a SD card driver instance.
+ */
+uint8_t
+SD_PollRequests(sSdCard * pSd)
+{
+	uint32_t flags, busy;
+	uint8_t error;
+	bool start;
+
+	assert(pSd != NULL);
+
+	if (pSd->bReqActive) {
+		/* Let the driver detect the end of the current command */
+		busy = 1;
+		pSd->pHalf->fIOCtrl(pSd->pDrv, SDMMC_IOCTL_BUSY_CHECK,
+		    (uint32_t)&busy);
+	}
+	if (pSd->bReqHalted) {
+		error = _RecoverRequestState(pSd);
+		if (error) {
+			pSd->bStatus = error;
+			return error;
+		}
+		flags = arch_irq_save();
+		pSd->bReqHalted = 0;
+		start = !pSd->bReqActive && pSd->pReqHead != NULL;
+		if (start)
+			pSd->bReqActive = 1;
+		arch_irq_restore(flags);
+		if (start)
+			_StartRequest(pSd);
+	}
+	return pSd->pReqHead ? SDMMC_BUSY : SDMMC_OK;
+}
+
 /**
  * Read Blocks of data in a buffer pointed by pData. The buffer size must be at
  * least 512 byte long. This function checks the SD card status register and
@@ -660,6 +660,16 @@ extern uint8_t SD_Write(sSdCard * pSd,
 			uint32_t dwNbBlocks,
 			fSdmmcCallback fCallback, void *pArg);
 
+extern uint8_t SD_ReadV(sSdCard * pSd,
+			uint32_t dwAddr,
+			const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt);
+extern uint8_t SD_WriteV(sSdCard * pSd,
+			 uint32_t dwAddr,
+			 const sSdmmcIoVec * pIoVec, uint16_t wIoVecCnt);
+
+extern uint8_t SD_SubmitRequest(sSdCard * pSd, sSdmmcRequest * pReq);
+extern uint8_t SD_PollRequests(sSdCard * pSd);
+
 extern uint8_t SDIO_ReadDirect(sSdCard * pSd,
 			       uint8_t bFunctionNum,
 			       uint32_t dwAddress,
@@ -268,6 +268,10 @@ typedef enum {
 /** SD/MMC Low Level IO Control: Query whether the card is writeprotected
 or not by mechanical write protect switch */
 #define SDMMC_IOCTL_GET_WP        0x27
+/** SD/MMC Low Level IO Control: Query driver capability, whether the driver
+    supports scatter-gather data transfers (sSdmmcCommand::pIoVec).
+    IOCtrl(pSd, SDMMC_IOCTL_GET_SG, (uint32_t*)pOSupported) */
+#define SDMMC_IOCTL_GET_SG        0x28
 /**     @}*/
 
 /** \ingroup sdmmc_hal_def
@@ -345,6 +349,17 @@ typedef union _SdmmcCmdOperation {
 		 checkBsy:1;	    /**< Busy check is ON */
 	} bmBits;
 } uSdmmcCmdOp;
+/**
+ * Sdmmc scatter-gather data segment.
+ */
+typedef struct _SdmmcIoVec {
+	/** Data buffer. It shall follow the peripheral and DMA alignment
+	 * requirements, which are peripheral and driver dependent. */
+	uint8_t *pData;
+	/** Number of blocks held in the buffer */
+	uint16_t wNbBlocks;
+} sSdmmcIoVec;
+
 /**
  * Sdmmc command instance.
  */
@@ -362,6 +377,12 @@ typedef struct _SdmmcCommand {
 	uint16_t wBlockSize;
 	/** Number of blocks to be transfered */
 	uint16_t wNbBlocks;
+	/** Optional scatter-gather list. When set, the wNbBlocks blocks are
+	 * spread over the wIoVecCount segments of this list, and pData shall
+	 * point to the buffer of the first segment. */
+	const sSdmmcIoVec *pIoVec;
+	/** Number of segments in pIoVec */
+	uint16_t wIoVecCount;
 	/** Response buffer. */
 	uint32_t *pResp;
 
@@ -404,6 +425,33 @@ typedef struct _SdHalFunctions {
 	fSdmmcIOCtrl fIOCtrl;	    /**< Pointer to IO control function */
 } sSdHalFunctions;
 
+/**
+ * Asynchronous block transfer request, see SD_SubmitRequest().
+ */
+typedef struct _SdmmcRequest {
+	/** Address of the first block to transfer */
+	uint32_t dwAddr;
+	/** Data buffer. It shall follow the peripheral and DMA alignment
+	 * requirements, which are peripheral and driver dependent. */
+	uint8_t *pData;
+	/** Number of blocks to be transfered */
+	uint32_t dwNbBlocks;
+	/** 1 to read from the device, 0 to write to the device */
+	uint8_t bRead;
+	/** Request status, SDMMC_BUSY until the request completes */
+	volatile uint8_t bStatus;
+	/** Optional callback invoked upon completion, possibly in interrupt
+	 * context. */
+	fSdmmcCallback fCallback;
+	/** Optional argument to the callback function. */
+	void *pArg;
+
+	/** Count of blocks transferred already. Private to the library. */
+	uint32_t dwDone;
+	/** Next queued request. Private to the library. */
+	struct _SdmmcRequest *pNext;
+} sSdmmcRequest;
+
 /**
  * \brief SD/MMC card driver structure.
  * It holds the current command being processed and the SD/MMC card address.
@@ -461,6 +509,13 @@ typedef struct _SdCard {
 	uint8_t bStatus;	/**< Unrecovered error */
 	uint8_t bSetBlkCnt;	/**< Explicit SET_BLOCK_COUNT command used */
 	uint8_t bStopMultXfer;	/**< Explicit STOP_TRANSMISSION command used */
+
+	sSdmmcCommand reqCmd;	/**< Command instance for queued requests */
+	uint32_t dwReqResp;	/**< Response to the queued request command */
+	sSdmmcRequest *pReqHead;	/**< Request being processed */
+	sSdmmcRequest *pReqTail;	/**< Last queued request */
+	volatile uint8_t bReqActive;	/**< A queued request is in progress */
+	volatile uint8_t bReqHalted;	/**< Queue stopped upon error */
 } sSdCard;
 
 /** \addtogroup sdmmc_struct_cmdarg SD/MMC command arguments
@@ -0,0 +1,497 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/** \file */
+
+/*---------------------------------------------------------------------------
+ *         Headers
+ *---------------------------------------------------------------------------*/
+
+#include "media.h"
+#include "media_cache.h"
+#include "media_private.h"
+
+#include "intmath.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ *      Internal Functions
+ *---------------------------------------------------------------------------*/
+
+static inline uint8_t* _media_cache_line_data(struct _media_cache *cache,
+		uint32_t line)
+{
+	return cache->buffer + line * cache->backend->block_size;
+}
+
+static inline void _media_cache_touch(struct _media_cache *cache,
+		uint32_t line)
+{
+	cache->lines[line].stamp = ++cache->clock;
+}
+
+/**
+ * \brief Look up the line holding a block
+ * \return Index of the line, or -1 if the block is not cached
+ */
+static int32_t _media_cache_find(struct _media_cache *cache, uint32_t block)
+{
+	uint32_t i;
+
+	for (i = 0; i < cache->line_count; i++) {
+		if (cache->lines[i].valid && cache->lines[i].block == block)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * \brief Count the consecutive blocks, starting at block, that are not cached
+ * \param max Maximum number of blocks to consider
+ */
+static uint32_t _media_cache_missing_run(struct _media_cache *cache,
+		uint32_t block, uint32_t max)
+{
+	uint32_t count = 0;
+
+	while (count < max && _media_cache_find(cache, block + count) < 0)
+		count++;
+	return count;
+}
+
+/**
+ * \brief Write the dirty lines of a range of lines to the media.
+ * Lines holding consecutive blocks are written with a single request.
+ */
+static uint8_t _media_cache_write_back(struct _media_cache *cache,
+		uint32_t first, uint32_t count)
+{
+	struct _media_cache_line *lines = cache->lines;
+	uint32_t end = first + count;
+	uint32_t i = first, j, n;
+	uint8_t status;
+
+	while (i < end) {
+		if (!lines[i].valid || !lines[i].dirty) {
+			i++;
+			continue;
+		}
+
+		n = 1;
+		while (i + n < end && lines[i + n].valid && lines[i + n].dirty &&
+		       lines[i + n].block == lines[i].block + n)
+			n++;
+
+		status = media_write(cache->backend, lines[i].block,
+				_media_cache_line_data(cache, i), n, NULL, NULL);
+		if (status != MEDIA_STATUS_SUCCESS)
+			return status;
+
+		for (j = 0; j < n; j++)
+			lines[i + j].dirty = false;
+		cache->stats.write_backs += n;
+		i += n;
+	}
+
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/**
+ * \brief Select count adjacent lines to evict.
+ * The window whose most recently used line is the oldest is chosen, so that
+ * single line allocations follow a strict LRU order while multi-block fills
+ * can still be issued as one media request.
+ * \return Index of the first line of the window
+ */
+static uint32_t _media_cache_select(struct _media_cache *cache, uint32_t count)
+{
+	uint32_t first, i, age;
+	uint32_t best = 0, best_age = UINT32_MAX;
+
+	for (first = 0; first + count <= cache->line_count; first++) {
+		age = 0;
+		for (i = first; i < first + count; i++) {
+			if (cache->lines[i].valid && cache->lines[i].stamp > age)
+				age = cache->lines[i].stamp;
+		}
+		if (age < best_age) {
+			best = first;
+			best_age = age;
+			if (age == 0)
+				break;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * \brief Allocate count adjacent lines for blocks [block, block + count),
+ * writing back the dirty lines they held.
+ * \param line Filled with the index of the first allocated line
+ */
+static uint8_t _media_cache_alloc(struct _media_cache *cache,
+		uint32_t block, uint32_t count, uint32_t *line)
+{
+	uint32_t first, i;
+	uint8_t status;
+
+	first = _media_cache_select(cache, count);
+	status = _media_cache_write_back(cache, first, count);
+	if (status != MEDIA_STATUS_SUCCESS)
+		return status;
+
+	for (i = 0; i < count; i++) {
+		cache->lines[first + i].block = block + i;
+		cache->lines[first + i].valid = true;
+		cache->lines[first + i].dirty = false;
+		_media_cache_touch(cache, first + i);
+	}
+
+	*line = first;
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/**
+ * \brief Reads a specified amount of data through the cache
+ * \param media Pointer to a Media instance
+ * \param address Address of the first block to read
+ * \param data Pointer to the buffer in which to store the retrieved data
+ * \param length Number of blocks to read
+ * \param callback Optional pointer to a callback function to invoke when
+ *                 the operation is finished
+ * \param callback_arg Optional pointer to an argument for the callback
+ * \return Operation result code
+ */
+static uint8_t media_cache_read(struct _media *media,
+		uint32_t address, void *data, uint32_t length,
+		media_callback_t callback, void *callback_arg)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+	uint32_t block_size = media->block_size;
+	uint8_t *dest = (uint8_t*)data;
+	uint8_t status = MEDIA_STATUS_SUCCESS;
+	uint32_t count, ahead, first, i;
+	int32_t line;
+
+	// Check that the media is ready
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	// Check that the data to read is not too big
+	if ((address + length) > media->size)
+		return MEDIA_STATUS_ERROR;
+
+	// Enter Busy state
+	media->state = MEDIA_STATE_BUSY;
+
+	while (length > 0) {
+		line = _media_cache_find(cache, address);
+		if (line >= 0) {
+			memcpy(dest, _media_cache_line_data(cache, line), block_size);
+			_media_cache_touch(cache, line);
+			cache->stats.hits++;
+			count = 1;
+		} else {
+			count = _media_cache_missing_run(cache, address, length);
+			cache->stats.misses += count;
+
+			if (count > cache->line_count / 2) {
+				// Large transfer, do not thrash the cache
+				status = media_read(cache->backend, address, dest,
+						count, NULL, NULL);
+				cache->stats.bypassed += count;
+			} else {
+				// Fetch the missing blocks and the next ones at once
+				ahead = min_u32(cache->read_ahead,
+						media->size - (address + count));
+				ahead = min_u32(ahead, cache->line_count - count);
+				ahead = _media_cache_missing_run(cache,
+						address + count, ahead);
+
+				status = _media_cache_alloc(cache, address,
+						count + ahead, &first);
+				if (status == MEDIA_STATUS_SUCCESS) {
+					status = media_read(cache->backend, address,
+						_media_cache_line_data(cache, first),
+						count + ahead, NULL, NULL);
+					if (status == MEDIA_STATUS_SUCCESS) {
+						memcpy(dest, _media_cache_line_data(cache, first),
+								count * block_size);
+						cache->stats.read_ahead += ahead;
+					} else {
+						// The lines hold no valid data
+						for (i = 0; i < count + ahead; i++)
+							cache->lines[first + i].valid = false;
+					}
+				}
+			}
+			if (status != MEDIA_STATUS_SUCCESS)
+				break;
+		}
+
+		address += count;
+		dest += count * block_size;
+		length -= count;
+	}
+
+	// Leave the Busy state
+	media->state = MEDIA_STATE_READY;
+
+	// Invoke callback
+	if (callback)
+		callback(callback_arg, status, 0, 0);
+
+	return status;
+}
+
+/**
+ *  \brief Writes data through the cache
+ *  \param media Pointer to a Media instance
+ *  \param address Address of the first block to write
+ *  \param data Pointer to the data to write
+ *  \param length Number of blocks to write
+ *  \param callback Optional pointer to a callback function to invoke when
+ *                  the write operation terminates
+ *  \param callback_arg Optional argument for the callback function
+ *  \return Operation result code
+ */
+static uint8_t media_cache_write(struct _media *media,
+		uint32_t address, void *data, uint32_t length,
+		media_callback_t callback, void *callback_arg)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+	uint32_t block_size = media->block_size;
+	uint8_t *src = (uint8_t*)data;
+	uint8_t status = MEDIA_STATUS_SUCCESS;
+	uint32_t count, first, i;
+	int32_t line;
+
+	// Check that the media is ready
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	// Check that the data to write is not too big
+	if ((address + length) > media->size)
+		return MEDIA_STATUS_ERROR;
+
+	// Writes would only fail later, when written back
+	if (cache->backend->write_protected)
+		return MEDIA_STATUS_PROTECTED;
+
+	// Put the media in Busy state
+	media->state = MEDIA_STATE_BUSY;
+
+	while (length > 0) {
+		line = _media_cache_find(cache, address);
+		if (line >= 0) {
+			memcpy(_media_cache_line_data(cache, line), src, block_size);
+			cache->lines[line].dirty = true;
+			_media_cache_touch(cache, line);
+			cache->stats.hits++;
+			count = 1;
+		} else {
+			count = _media_cache_missing_run(cache, address, length);
+			cache->stats.misses += count;
+
+			if (count > cache->line_count / 2) {
+				// Large transfer, write it through
+				status = media_write(cache->backend, address, src,
+						count, NULL, NULL);
+				cache->stats.bypassed += count;
+			} else {
+				// Whole blocks are written, no need to read them first
+				status = _media_cache_alloc(cache, address, count,
+						&first);
+				if (status == MEDIA_STATUS_SUCCESS) {
+					memcpy(_media_cache_line_data(cache, first), src,
+							count * block_size);
+					for (i = 0; i < count; i++)
+						cache->lines[first + i].dirty = true;
+				}
+			}
+			if (status != MEDIA_STATUS_SUCCESS)
+				break;
+		}
+
+		address += count;
+		src += count * block_size;
+		length -= count;
+	}
+
+	// Leave the Busy state
+	media->state = MEDIA_STATE_READY;
+
+	// Invoke the callback if it exists
+	if (callback)
+		callback(callback_arg, status, 0, 0);
+
+	return status;
+}
+
+/**
+ *  \brief Writes back all the dirty lines and flushes the cached media
+ *  \param media Pointer to a Media instance
+ *  \return Operation result code
+ */
+static uint8_t media_cache_flush(struct _media *media)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+	uint8_t status;
+
+	if (media->state != MEDIA_STATE_READY)
+		return MEDIA_STATUS_BUSY;
+
+	media->state = MEDIA_STATE_BUSY;
+	status = _media_cache_write_back(cache, 0, cache->line_count);
+	media->state = MEDIA_STATE_READY;
+
+	if (status != MEDIA_STATUS_SUCCESS)
+		return status;
+
+	return media_flush(cache->backend);
+}
+
+/**
+ *  \brief Forwards interrupts to the cached media
+ *  \param media Pointer to a Media instance
+ */
+static void media_cache_handler(struct _media *media)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+
+	media_handler(cache->backend);
+}
+
+/*---------------------------------------------------------------------------
+ *      Exported Functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief Initializes a write-back block cache in front of an existing media.
+ *
+ * Lines hold one block of the cached media each. The cache media has the
+ * same block size and size as the cached media.
+ *
+ * \param media Pointer to the Media instance to initialize
+ * \param cache Pointer to the cache state
+ * \param backend Pointer to the initialized media to cache
+ * \param lines Array of line_count line descriptors
+ * \param buffer Line storage, line_count blocks. Must meet the alignment
+ *               requirements of the cached media (e.g. cache line aligned
+ *               for DMA based medias).
+ * \param line_count Number of lines
+ * \param read_ahead Number of blocks to read ahead on a read miss
+ * \return MEDIA_STATUS_SUCCESS, or MEDIA_STATUS_ERROR if the cached media
+ *         is not ready or a parameter is invalid
+ */
+uint8_t media_cache_init(struct _media *media,
+		struct _media_cache *cache, struct _media *backend,
+		struct _media_cache_line *lines, uint8_t *buffer,
+		uint32_t line_count, uint32_t read_ahead)
+{
+	if (!backend || !media_is_initialized(backend))
+		return MEDIA_STATUS_ERROR;
+
+	if (!lines || !buffer || line_count == 0)
+		return MEDIA_STATUS_ERROR;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->backend = backend;
+	cache->lines = lines;
+	cache->buffer = buffer;
+	cache->line_count = line_count;
+	cache->read_ahead = read_ahead;
+	memset(lines, 0, line_count * sizeof(*lines));
+
+	memset(media, 0, sizeof(*media));
+
+	media->write = media_cache_write;
+	media->read = media_cache_read;
+	media->flush = media_cache_flush;
+	media->handler = media_cache_handler;
+
+	media->block_size = backend->block_size;
+	media->base_address = 0;
+	media->size = backend->size;
+	media->interface = cache;
+
+	media->write_protected = backend->write_protected;
+	media->removable = backend->removable;
+	media->state = MEDIA_STATE_READY;
+
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/**
+ * \brief Writes back the dirty lines and drops all the lines of the cache,
+ * e.g. before the cached media is accessed directly or replaced.
+ * \param media Pointer to the cache Media instance
+ * \return Operation result code
+ */
+uint8_t media_cache_invalidate(struct _media *media)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+	uint8_t status;
+	uint32_t i;
+
+	status = media_cache_flush(media);
+	if (status != MEDIA_STATUS_SUCCESS)
+		return status;
+
+	for (i = 0; i < cache->line_count; i++)
+		cache->lines[i].valid = false;
+
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/**
+ * \brief Gets the cache statistics
+ * \param media Pointer to the cache Media instance
+ * \param stats Pointer to the statistics to fill
+ */
+void media_cache_get_stats(struct _media *media,
+		struct _media_cache_stats *stats)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+
+	*stats = cache->stats;
+}
+
+/**
+ * \brief Resets the cache statistics
+ * \param media Pointer to the cache Media instance
+ */
+void media_cache_reset_stats(struct _media *media)
+{
+	struct _media_cache *cache = (struct _media_cache*)media->interface;
+
+	memset(&cache->stats, 0, sizeof(cache->stats));
+}
@@ -0,0 +1,105 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+  *  \file
+  *
+  *  Write-back block cache that can be stacked on top of any media.
+  *
+  *  The cache is itself a media: reads and writes addressed to it are served
+  *  from a set of block-sized lines and only reach the underlying media on a
+  *  miss, on eviction of a dirty line or on media_flush().  Lines are evicted
+  *  in least-recently-used order.  On a read miss, up to \c read_ahead
+  *  following blocks are fetched with the same request.
+  *
+  *  The underlying media is expected to complete its transfers synchronously
+  *  (as the ramdisk and SD/MMC medias do).
+  */
+
+#ifndef MEDIA_CACHE_H
+#define MEDIA_CACHE_H
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "libstoragemedia/media.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *      Types
+ *------------------------------------------------------------------------------*/
+
+/** Cache line descriptor, one per cached block */
+struct _media_cache_line {
+	uint32_t block;  /**< Block number held by the line */
+	uint32_t stamp;  /**< Last access time, for LRU eviction */
+	bool     valid;  /**< Line holds a block */
+	bool     dirty;  /**< Line was modified and not yet written back */
+};
+
+/** Cache statistics */
+struct _media_cache_stats {
+	uint32_t hits;        /**< Blocks served from the cache */
+	uint32_t misses;      /**< Blocks not found in the cache */
+	uint32_t read_ahead;  /**< Blocks fetched ahead of a read miss */
+	uint32_t write_backs; /**< Dirty blocks written to the media */
+	uint32_t bypassed;    /**< Blocks transferred without caching */
+};
+
+/** Cache instance, referenced by the cache media interface */
+struct _media_cache {
+	struct _media *backend;            /**< Cached media */
+	struct _media_cache_line *lines;   /**< Line descriptors */
+	uint8_t *buffer;                   /**< Line storage, line_count blocks */
+	uint32_t line_count;               /**< Number of lines */
+	uint32_t read_ahead;               /**< Blocks to read ahead on a miss */
+	uint32_t clock;                    /**< LRU time base */
+	struct _media_cache_stats stats;
+};
+
+/*------------------------------------------------------------------------------
+ *      Exported functions
+ *------------------------------------------------------------------------------*/
+
+extern uint8_t media_cache_init(struct _media *media,
+		struct _media_cache *cache, struct _media *backend,
+		struct _media_cache_line *lines, uint8_t *buffer,
+		uint32_t line_count, uint32_t read_ahead);
+
+extern uint8_t media_cache_invalidate(struct _media *media);
+
+extern void media_cache_get_stats(struct _media *media,
+		struct _media_cache_stats *stats);
+
+extern void media_cache_reset_stats(struct _media *media);
+
+#endif /* MEDIA_CACHE_H */
@@ -0,0 +1,386 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/* ----------------------------------------------------------------------------
+ * FatFs glue functions for medias of the libstoragemedia library.
+ * Based on the template source file named diskio.c, part of the FatFs
+ * Module R0.12, (C)ChaN, 2016.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ *         Headers
+ *---------------------------------------------------------------------------*/
+
+#include "media.h"
+#include "media_ff.h"
+
+#include "ffconf.h"
+#include "fatfs/src/diskio.h"
+
+#include "intmath.h"
+#include "mm/cache.h"
+
+#include <string.h>
+
+/*---------------------------------------------------------------------------
+ *         Local types
+ *---------------------------------------------------------------------------*/
+
+/** Burst buffer state */
+struct _media_ff_burst {
+	struct _media *media;  /**< Owner of the buffered sectors, or NULL */
+	uint32_t sector;       /**< First buffered sector */
+	uint32_t count;        /**< Number of buffered sectors */
+	bool     dirty;        /**< Sectors are pending write */
+	struct _media *last;   /**< Media accessed by the last read */
+	uint32_t next;         /**< Sector following the last read */
+};
+
+/*---------------------------------------------------------------------------
+ *         Local variables
+ *---------------------------------------------------------------------------*/
+
+CACHE_ALIGNED static uint8_t burst_buffer[MEDIA_FF_BURST_SECTORS * _MAX_SS];
+
+static struct _media_ff_burst burst;
+
+/*---------------------------------------------------------------------------
+ *         Local functions
+ *---------------------------------------------------------------------------*/
+
+/**
+ * \brief Get the sector size used for a media.
+ * Medias with blocks smaller than _MIN_SS are accessed by groups of blocks.
+ */
+static uint32_t _media_ff_sector_size(struct _media *media)
+{
+	uint32_t blk_size = media_get_block_size(media);
+
+	return blk_size >= _MIN_SS ? blk_size : _MIN_SS;
+}
+
+static uint32_t _media_ff_sector_count(struct _media *media)
+{
+	uint32_t blk_size = media_get_block_size(media);
+
+	if (blk_size < _MIN_SS)
+		return media_get_size(media) / (_MIN_SS / blk_size);
+	return media_get_size(media);
+}
+
+/**
+ * \brief Check that the sectors of a media fit in the burst buffer.
+ */
+static inline bool _media_ff_sector_size_valid(uint32_t ss)
+{
+	return ss <= _MAX_SS;
+}
+
+/**
+ * \brief Transfer sectors between a buffer and a media.
+ */
+static DRESULT _media_ff_transfer(struct _media *media, bool write,
+		uint32_t sector, uint8_t *buff, uint32_t count)
+{
+	uint32_t blk_size = media_get_block_size(media);
+	uint32_t addr = sector, len = count;
+	uint8_t rc;
+
+	if (blk_size == 0)
+		return RES_NOTRDY;
+	if (blk_size < _MIN_SS) {
+		if (_MIN_SS % blk_size)
+			return RES_PARERR;
+		addr = sector * (_MIN_SS / blk_size);
+		len = count * (_MIN_SS / blk_size);
+	}
+
+	if (write)
+		rc = media_write(media, addr, buff, len, NULL, NULL);
+	else
+		rc = media_read(media, addr, buff, len, NULL, NULL);
+
+	if (rc == MEDIA_STATUS_SUCCESS)
+		return RES_OK;
+	else if (rc == MEDIA_STATUS_BUSY)
+		return RES_NOTRDY;
+	else if (rc == MEDIA_STATUS_PROTECTED)
+		return RES_WRPRT;
+	else
+		return RES_ERROR;
+}
+
+/**
+ * \brief Write the pending sectors of a media, if any, and empty the burst
+ * buffer.
+ * \param media Media to release the buffer from, or NULL for any media
+ */
+static DRESULT _media_ff_release(struct _media *media)
+{
+	DRESULT res = RES_OK;
+
+	if (!burst.media || (media && burst.media != media))
+		return RES_OK;
+
+	if (burst.dirty)
+		res = _media_ff_transfer(burst.media, true, burst.sector,
+				burst_buffer, burst.count);
+	burst.media = NULL;
+	burst.dirty = false;
+	burst.count = 0;
+	return res;
+}
+
+static bool _media_ff_overlaps(struct _media *media, uint32_t sector,
+		uint32_t count)
+{
+	return burst.media == media &&
+		sector < burst.sector + burst.count &&
+		burst.sector < sector + count;
+}
+
+/*----------------------------------------------------------------------------
+ *        Exported functions
+ *----------------------------------------------------------------------------*/
+
+/**
+ * \brief Initialize a Drive.
+ * The media itself is initialized by the application.
+ * \param pdrv  Physical drive number (0..).
+ * \return Drive status flags; STA_NOINIT if the specified drive does not exist.
+ */
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	struct _media *media = NULL;
+	DSTATUS status;
+
+	status = disk_status(pdrv);
+	if (status & STA_NOINIT)
+		return status;
+
+	/* Sectors larger than _MAX_SS would overflow the burst buffer */
+	media_ff_get_instance(pdrv, &media);
+	if (!_media_ff_sector_size_valid(_media_ff_sector_size(media)))
+		return status | STA_NOINIT;
+	return status;
+}
+
+/**
+ * \brief Get Drive Status.
+ * \param pdrv  Physical drive number (0..).
+ * \return Drive status flags.
+ */
+DSTATUS disk_status(BYTE pdrv)
+{
+	struct _media *media = NULL;
+
+	if (!media_ff_get_instance(pdrv, &media) || !media)
+		return STA_NODISK | STA_NOINIT;
+	if (!media_is_initialized(media))
+		return STA_NOINIT;
+	if (media_is_write_protected(media))
+		return STA_PROTECT;
+	return 0;
+}
+
+/**
+ * \brief Read Sector(s).
+ * \param pdrv  Physical drive number (0..).
+ * \param buff  Data buffer to store read data.
+ * \param sector  Sector address in LBA.
+ * \param count  Number of sectors to read.
+ * \return Result code; RES_OK if successful.
+ */
+DRESULT disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+	struct _media *media = NULL;
+	uint32_t ss, total, ahead;
+	bool sequential;
+	DRESULT res;
+
+	if (!media_ff_get_instance(pdrv, &media) || !media)
+		return RES_PARERR;
+
+	ss = _media_ff_sector_size(media);
+	if (!_media_ff_sector_size_valid(ss))
+		return RES_PARERR;
+	sequential = burst.last == media && burst.next == sector;
+	burst.last = media;
+	burst.next = sector + count;
+
+	if (_media_ff_overlaps(media, sector, count)) {
+		if (sector >= burst.sector &&
+		    sector + count <= burst.sector + burst.count) {
+			memcpy(buff, burst_buffer + (sector - burst.sector) * ss,
+					count * ss);
+			return RES_OK;
+		}
+		res = _media_ff_release(media);
+		if (res != RES_OK)
+			return res;
+	}
+
+	/* Random or large accesses go straight to the media */
+	if (!sequential || count >= MEDIA_FF_BURST_SECTORS)
+		return _media_ff_transfer(media, false, sector, buff, count);
+
+	/* Sequential read: fetch the following sectors as well */
+	total = _media_ff_sector_count(media);
+	if (sector + count > total)
+		return RES_PARERR;
+	ahead = min_u32(MEDIA_FF_BURST_SECTORS, total - sector);
+
+	res = _media_ff_release(NULL);
+	if (res != RES_OK)
+		return res;
+
+	res = _media_ff_transfer(media, false, sector, burst_buffer, ahead);
+	if (res != RES_OK)
+		return res;
+
+	burst.media = media;
+	burst.sector = sector;
+	burst.count = ahead;
+	memcpy(buff, burst_buffer, count * ss);
+	return RES_OK;
+}
+
+#if !_FS_READONLY
+/**
+ * \brief Write Sector(s).
+ *
+ * \param pdrv  Physical drive number (0..).
+ * \param buff  Data to be written.
+ * \param sector  Sector address in LBA.
+ * \param count  Number of sectors to write.
+ * \return Result code; RES_OK if successful.
+ *
+ * \note Writes may be held in the burst buffer until the next CTRL_SYNC
+ * request, which FatFs issues on f_sync() and f_close().
+ */
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+	struct _media *media = NULL;
+	uint32_t ss;
+	DRESULT res;
+
+	if (!media_ff_get_instance(pdrv, &media) || !media)
+		return RES_PARERR;
+	if (media_is_write_protected(media))
+		return RES_WRPRT;
+
+	ss = _media_ff_sector_size(media);
+	if (!_media_ff_sector_size_valid(ss))
+		return RES_PARERR;
+
+	if (burst.media == media && burst.dirty) {
+		/* Rewrite of buffered sectors */
+		if (sector >= burst.sector &&
+		    sector + count <= burst.sector + burst.count) {
+			memcpy(burst_buffer + (sector - burst.sector) * ss, buff,
+					count * ss);
+			return RES_OK;
+		}
+		/* Continuation of the buffered sectors */
+		if (sector == burst.sector + burst.count &&
+		    burst.count + count <= MEDIA_FF_BURST_SECTORS) {
+			memcpy(burst_buffer + burst.count * ss, buff, count * ss);
+			burst.count += count;
+			return RES_OK;
+		}
+	}
+
+	res = _media_ff_release(NULL);
+	if (res != RES_OK)
+		return res;
+
+	if (count >= MEDIA_FF_BURST_SECTORS)
+		return _media_ff_transfer(media, true, sector, (uint8_t*)buff,
+				count);
+
+	memcpy(burst_buffer, buff, count * ss);
+	burst.media = media;
+	burst.sector = sector;
+	burst.count = count;
+	burst.dirty = true;
+	return RES_OK;
+}
+#endif /* _FS_READONLY */
+
+/**
+ * \brief Miscellaneous Functions.
+ * \param pdrv  Physical drive number (0..).
+ * \param cmd  Control code.
+ * \param buff  Buffer to send/receive control data.
+ * \return Result code; RES_OK if successful.
+ */
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+{
+	struct _media *media = NULL;
+	DRESULT res;
+
+	if (!media_ff_get_instance(pdrv, &media) || !media)
+		return RES_PARERR;
+
+	switch (cmd) {
+	case CTRL_SYNC:
+		res = _media_ff_release(media);
+		if (res == RES_OK && media_flush(media) != MEDIA_STATUS_SUCCESS)
+			res = RES_ERROR;
+		break;
+
+	case GET_SECTOR_COUNT:
+		if (!buff)
+			return RES_PARERR;
+		*(DWORD*)buff = _media_ff_sector_count(media);
+		res = RES_OK;
+		break;
+
+	case GET_SECTOR_SIZE:
+		if (!buff)
+			return RES_PARERR;
+		*(WORD*)buff = _media_ff_sector_size(media);
+		res = RES_OK;
+		break;
+
+	case GET_BLOCK_SIZE:
+		if (!buff)
+			return RES_PARERR;
+		/* Erase block size is unknown at this level */
+		*(DWORD*)buff = 1;
+		res = RES_OK;
+		break;
+
+	default:
+		res = RES_PARERR;
+		break;
+	}
+	return res;
+}
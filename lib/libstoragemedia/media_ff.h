@@ -0,0 +1,81 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+  *  \file
+  *
+  *  FatFs disk I/O layer on top of libstoragemedia.
+  *
+  *  Adjacent sector requests issued by FatFs are gathered in a burst buffer
+  *  so that the media sees multi-block transfers:
+  *  - consecutive disk_write() calls are combined until the burst buffer is
+  *    full, a non-adjacent sector is accessed or FatFs syncs the volume;
+  *  - a disk_read() that continues the previous one reads ahead enough
+  *    sectors to fill the burst buffer.
+  *  Requests at least as large as the burst buffer go directly to the media.
+  *
+  *  Built when CONFIG_LIB_STORAGEMEDIA_FATFS is set along with
+  *  CONFIG_LIB_STORAGEMEDIA and CONFIG_LIB_FATFS. The disk I/O functions of
+  *  libsdmmc (sdmmc_ff.c) are then left out.
+  */
+
+#ifndef MEDIA_FF_H
+#define MEDIA_FF_H
+
+/*------------------------------------------------------------------------------
+ *         Headers
+ *------------------------------------------------------------------------------*/
+
+#include "libstoragemedia/media.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*------------------------------------------------------------------------------
+ *      Definitions
+ *------------------------------------------------------------------------------*/
+
+/** Size of the burst buffer, in sectors */
+#ifndef MEDIA_FF_BURST_SECTORS
+#define MEDIA_FF_BURST_SECTORS 16
+#endif
+
+/*------------------------------------------------------------------------------
+ *      Exported functions
+ *------------------------------------------------------------------------------*/
+
+/**
+ *  \brief Access the media instances owned by the application.
+ *  Used upon calls from the FatFs Module.
+ *
+ *  Shall be implemented by the application.
+ */
+extern bool media_ff_get_instance(uint8_t index, struct _media **holder);
+
+#endif /* MEDIA_FF_H */
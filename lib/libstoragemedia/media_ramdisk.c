@@ -73,7 +73,7 @@ static uint8_t media_ramdisk_read(struct _media *media,
 
 	// Copy data
 	source = (uint8_t*)((media->base_address + address) * media->block_size);
-	memcpy(data, source, length);
+	memcpy(data, source, length * media->block_size);
 
 	// Leave the Busy state
 	media->state = MEDIA_STATE_READY;
@@ -115,7 +115,7 @@ static uint8_t media_ramdisk_write(struct _media *media,
 
 	// Copy data
 	dest = (uint8_t*)((media->base_address + address) * media->block_size);
-	memcpy(dest, data, length);
+	memcpy(dest, data, length * media->block_size);
 
 	// Leave the Busy state
 	media->state = MEDIA_STATE_READY;
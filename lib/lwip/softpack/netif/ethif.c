@@ -46,6 +46,7 @@
 #include "chip.h"
 #include "compiler.h"
 #include "gpio/pio.h"
+#include "mm/cache.h"
 #include "lwip/opt.h"
 #include "netif/etharp.h"
 #include "netif/ethif.h"
@@ -56,10 +57,12 @@
 #include "lwip/dhcp.h"
 #endif
 #include "lwip/mem.h"
+#include "lwip/memp.h"
 #include "lwip/pbuf.h"
 #include "lwip/priv/tcp_priv.h"
 #include "lwip/stats.h"
 #include "lwip/sys.h"
+#include "ring.h"
 #include "timer.h"
 
 /*----------------------------------------------------------------------------
@@ -70,6 +73,46 @@
 #define IFNAME0 'e'
 #define IFNAME1 'n'
 
+/* Send pbuf chains without copying them into the ETH TX buffers.
+ * Disabled by default: the owner of a PBUF_RAM pbuf may refill it as soon
+ * as the output function returns, while the ETH still reads it. Only enable
+ * it when the application never modifies the pbufs it has sent. Payloads
+ * that do not start on a cache line are always copied. */
+#ifndef ETHIF_TX_ZERO_COPY
+#define ETHIF_TX_ZERO_COPY 0
+#endif
+
+/* Maximum number of pbufs in a chain sent without copy */
+#define ETHIF_TX_SG_SIZE 8
+
+/* Number of slots for frames sent without copy waiting for completion */
+#define ETHIF_TX_PENDING_SIZE 16
+
+/* Hand the ETH RX buffers to lwIP as custom pbufs instead of copying them.
+ * Requires custom pbufs support and no Ethernet padding. */
+#ifndef ETHIF_RX_ZERO_COPY
+#define ETHIF_RX_ZERO_COPY (LWIP_SUPPORT_CUSTOM_PBUF && (ETH_PAD_SIZE == 0))
+#endif
+
+/* Number of ETH_RX_UNITSIZE buffers used to re-arm the RX descriptors
+ * loaned to lwIP */
+#ifndef ETHIF_RX_POOL_SIZE
+#define ETHIF_RX_POOL_SIZE 32
+#endif
+
+/* Maximum number of RX buffers in a frame */
+#define ETHIF_RX_SG_SIZE CEIL_INT_DIV(ETH_MAX_FRAME_LENGTH, ETH_RX_UNITSIZE)
+
+/* Let the ETH generate and verify the IPv4 header, TCP and UDP checksums,
+ * when it supports it. Requires per-netif checksum control. */
+#ifndef ETHIF_CHECKSUM_OFFLOAD
+#define ETHIF_CHECKSUM_OFFLOAD LWIP_CHECKSUM_CTRL_PER_NETIF
+#endif
+
+/* Checksums left to lwIP with offload, the ETH does not handle ICMP */
+#define ETHIF_CHECKSUM_SW (NETIF_CHECKSUM_GEN_ICMP | NETIF_CHECKSUM_GEN_ICMP6 |\
+		NETIF_CHECKSUM_CHECK_ICMP | NETIF_CHECKSUM_CHECK_ICMP6)
+
 /*----------------------------------------------------------------------------
  *        Types
  *----------------------------------------------------------------------------*/
@@ -81,6 +124,25 @@ typedef struct _timers_info {
 	void (*timer_func)(void);
 } timers_info;
 
+#if ETHIF_TX_ZERO_COPY
+/* Frames sent without copy, released in order once transmitted */
+struct _ethif_tx_pending {
+	struct pbuf *frames[ETHIF_TX_PENDING_SIZE];
+	uint16_t head;          /* next free slot */
+	uint16_t tail;          /* oldest frame not released yet */
+	volatile uint16_t done; /* end of transmitted frames, updated from IRQ */
+};
+#endif
+
+#if ETHIF_RX_ZERO_COPY
+/* Custom pbuf wrapping a RX buffer loaned by the ETH driver */
+struct _ethif_rx_pbuf {
+	struct pbuf_custom pc;
+	uint8_t iface;
+	void *buffer;
+};
+#endif
+
 /*---------------------------------------------------------------------------
  *         Variables
  *---------------------------------------------------------------------------*/
@@ -103,6 +165,29 @@ static timers_info timers_table[] = {
 #endif
 };
 
+#if ETHIF_TX_ZERO_COPY
+static struct _ethif_tx_pending tx_pending[ETH_IFACE_COUNT];
+#endif
+
+#if ETHIF_RX_ZERO_COPY
+/* RX buffers used to re-arm the descriptors */
+CACHE_ALIGNED_DDR
+static uint8_t rx_pool_buffer[ETH_IFACE_COUNT][ETHIF_RX_POOL_SIZE * ETH_RX_UNITSIZE];
+
+/* RX pool free lists */
+static uint8_t *rx_pool_slots[ETH_IFACE_COUNT][ETHIF_RX_POOL_SIZE];
+
+/* At most ETHIF_RX_POOL_SIZE buffers per interface are loaned at a time */
+LWIP_MEMPOOL_DECLARE(ETHIF_RX_PBUF, ETH_IFACE_COUNT * ETHIF_RX_POOL_SIZE,
+		sizeof(struct _ethif_rx_pbuf), "ethif RX pbufs")
+static bool rx_pbuf_pool_ready;
+#endif
+
+#if ETHIF_CHECKSUM_OFFLOAD
+/* Interfaces with checksum offload enabled */
+static bool checksum_offload[ETH_IFACE_COUNT];
+#endif
+
 /*----------------------------------------------------------------------------
  *        Local functions
  *----------------------------------------------------------------------------*/
@@ -138,6 +223,190 @@ static void timers_update(void)
 	}
 }
 
+#if ETHIF_TX_ZERO_COPY
+static void _ethif_tx_complete(uint8_t iface)
+{
+	uint16_t done = tx_pending[iface].done;
+	RING_INC(done, ETHIF_TX_PENDING_SIZE);
+	tx_pending[iface].done = done;
+}
+
+static void _ethif_tx_callback0(uint8_t queue, uint32_t status)
+{
+	_ethif_tx_complete(0);
+}
+
+#if ETH_IFACE_COUNT > 1
+static void _ethif_tx_callback1(uint8_t queue, uint32_t status)
+{
+	_ethif_tx_complete(1);
+}
+#endif
+
+static const ethd_callback_t tx_callbacks[] = {
+	_ethif_tx_callback0,
+#if ETH_IFACE_COUNT > 1
+	_ethif_tx_callback1,
+#endif
+};
+
+/**
+ * Release the pbufs of the frames transmitted since last call
+ */
+static void _ethif_tx_release(uint8_t iface)
+{
+	struct _ethif_tx_pending *pending = &tx_pending[iface];
+
+	while (pending->tail != pending->done) {
+		pbuf_free(pending->frames[pending->tail]);
+		pending->frames[pending->tail] = NULL;
+		RING_INC(pending->tail, ETHIF_TX_PENDING_SIZE);
+	}
+}
+
+/**
+ * Queue a pbuf chain for transmission without copying it. The chain is
+ * referenced until the ETH driver reports its transmission.
+ *
+ * @return ERR_OK if the packet is queued, ERR_BUF if the TX queue is full,
+ *         ERR_MEM if the packet cannot be sent without copy (too many
+ *         segments, payloads referenced by PBUF_REF/PBUF_ROM pbufs or
+ *         not aligned on a cache line)
+ */
+static err_t _ethif_send_zero_copy(struct netif *netif, struct pbuf *p)
+{
+	struct _ethif_tx_pending *pending = &tx_pending[netif->num];
+	struct _eth_sg sg[ETHIF_TX_SG_SIZE];
+	struct _eth_sg_list sgl;
+	struct pbuf *q;
+	uint8_t rc;
+
+	_ethif_tx_release(netif->num);
+	if (RING_SPACE(pending->head, pending->tail, ETHIF_TX_PENDING_SIZE) == 0)
+		return ERR_MEM;
+
+	sgl.size = 0;
+	sgl.entries = sg;
+	for (q = p; q != NULL; q = q->next) {
+		if (q->len == 0)
+			continue;
+		/* The payload of PBUF_REF and PBUF_ROM pbufs belongs to the
+		 * caller, which may reuse it once the output function returns:
+		 * copy the frame */
+		if (q->type == PBUF_REF || q->type == PBUF_ROM)
+			return ERR_MEM;
+		/* The ETH driver only loans cache-aligned buffers */
+		if (!IS_CACHE_ALIGNED(q->payload))
+			return ERR_MEM;
+		if (sgl.size == ETHIF_TX_SG_SIZE)
+			return ERR_MEM;
+		sg[sgl.size].size = q->len;
+		sg[sgl.size].buffer = q->payload;
+		sg[sgl.size].next = NULL;
+		sgl.size++;
+	}
+
+	/* Keep the chain until the TX callback, which may happen before
+	 * ethd_send_sg_zero_copy() returns */
+	pbuf_ref(p);
+	pending->frames[pending->head] = p;
+	rc = ethd_send_sg_zero_copy(board_get_eth(netif->num), 0, &sgl,
+			tx_callbacks[netif->num]);
+	if (rc != ETH_OK) {
+		pending->frames[pending->head] = NULL;
+		pbuf_free(p);
+		return rc == ETH_TX_BUSY ? ERR_BUF : ERR_MEM;
+	}
+	RING_INC(pending->head, ETHIF_TX_PENDING_SIZE);
+
+	return ERR_OK;
+}
+#endif /* ETHIF_TX_ZERO_COPY */
+
+#if ETHIF_RX_ZERO_COPY
+/**
+ * Give back the RX buffer of a custom pbuf to the ETH driver
+ */
+static void _ethif_rx_pbuf_free(struct pbuf *p)
+{
+	struct _ethif_rx_pbuf *rx = (struct _ethif_rx_pbuf*)p;
+
+	ethd_rx_release_buffer(board_get_eth(rx->iface), 0, rx->buffer);
+	LWIP_MEMPOOL_FREE(ETHIF_RX_PBUF, rx);
+}
+
+/**
+ * Wrap the RX buffers of a received frame into a chain of custom pbufs.
+ *
+ * @return the pbuf chain, NULL if no frame was received, or if the frame
+ *         could not be received without copy (rc set to ETH_RX_POOL_EMPTY)
+ */
+static struct pbuf *_ethif_receive_zero_copy(struct netif *netif, uint8_t *rc)
+{
+	struct _ethd *ethd = board_get_eth(netif->num);
+	struct _eth_sg sg[ETHIF_RX_SG_SIZE];
+	struct pbuf *p = NULL, *q;
+	uint32_t count, frmlen, i;
+
+	*rc = ethd_poll_zero_copy(ethd, 0, sg, ARRAY_SIZE(sg), &count, &frmlen);
+	if (*rc != ETH_OK)
+		return NULL;
+
+	for (i = 0; i < count; i++) {
+		struct _ethif_rx_pbuf *rx = (struct _ethif_rx_pbuf*)LWIP_MEMPOOL_ALLOC(ETHIF_RX_PBUF);
+		if (rx == NULL)
+			break;
+		rx->pc.custom_free_function = _ethif_rx_pbuf_free;
+		rx->iface = netif->num;
+		rx->buffer = sg[i].buffer;
+		q = pbuf_alloced_custom(PBUF_RAW, sg[i].size, PBUF_REF, &rx->pc,
+				sg[i].buffer, ETH_RX_UNITSIZE);
+		if (p == NULL)
+			p = q;
+		else
+			pbuf_cat(p, q);
+	}
+
+	if (i < count) {
+		/* drop packet(); */
+		for (; i < count; i++)
+			ethd_rx_release_buffer(ethd, 0, sg[i].buffer);
+		if (p != NULL)
+			pbuf_free(p);
+		LINK_STATS_INC(link.memerr);
+		LINK_STATS_INC(link.drop);
+		return NULL;
+	}
+
+	LINK_STATS_INC(link.recv);
+	return p;
+}
+#endif /* ETHIF_RX_ZERO_COPY */
+
+#if ETHIF_CHECKSUM_OFFLOAD
+/**
+ * Let lwIP verify the checksums of the last received frame that the ETH did
+ * not verify. Frames are processed synchronously by ethif_input(), so the
+ * flags only apply to this frame.
+ */
+static void _ethif_rx_checksum_ctrl(struct netif *netif)
+{
+	u16_t flags = ETHIF_CHECKSUM_SW;
+
+	switch (ethd_get_rx_checksum(board_get_eth(netif->num), 0)) {
+	case ETH_RX_STATUS_CHECKSUM_NONE:
+		flags |= NETIF_CHECKSUM_CHECK_IP;
+		/* fall through */
+	case ETH_RX_STATUS_CHECKSUM_IP:
+		flags |= NETIF_CHECKSUM_CHECK_TCP | NETIF_CHECKSUM_CHECK_UDP;
+		break;
+	default:
+		break;
+	}
+	NETIF_SET_CHECKSUM_CTRL(netif, flags);
+}
+#endif /* ETHIF_CHECKSUM_OFFLOAD */
+
 /* Forward declarations. */
 static void  ethif_input(struct netif *netif);
 static err_t ethif_output(struct netif *netif, struct pbuf *p, ip4_addr_t *ipaddr);
@@ -151,6 +420,22 @@ static void glow_level_init(struct netif *netif, struct _ethd* ethd)
 	/* set MAC hardware address */
 	ethd_get_mac_addr(ethd, 0, _mac_addr);
 	SMEMCPY(netif->hwaddr, _mac_addr, sizeof(netif->hwaddr));
+#if ETHIF_RX_ZERO_COPY
+	/* RX pool used to re-arm the descriptors loaned to lwIP */
+	if (!rx_pbuf_pool_ready) {
+		LWIP_MEMPOOL_INIT(ETHIF_RX_PBUF);
+		rx_pbuf_pool_ready = true;
+	}
+	ethd_setup_rx_pool(ethd, 0, rx_pool_buffer[netif->num],
+			rx_pool_slots[netif->num], ETHIF_RX_POOL_SIZE);
+#endif
+#if ETHIF_CHECKSUM_OFFLOAD
+	/* Keep software checksums if the ETH cannot offload them (EMAC) */
+	checksum_offload[netif->num] = ethd_set_checksum_offload(ethd,
+			ETH_CHECKSUM_OFFLOAD_RX | ETH_CHECKSUM_OFFLOAD_TX) == ETH_OK;
+	if (checksum_offload[netif->num])
+		NETIF_SET_CHECKSUM_CTRL(netif, ETHIF_CHECKSUM_SW);
+#endif
 	/* maximum transfer unit */
 	netif->mtu = 1500;
 	/* device capabilities */
@@ -179,6 +464,22 @@ static err_t glow_level_output(struct netif *netif, struct pbuf *p)
     pbuf_header(p, -ETH_PAD_SIZE);    /* drop the padding word */
 #endif
 
+#if ETHIF_TX_ZERO_COPY
+    {
+        err_t err = _ethif_send_zero_copy(netif, p);
+        if (err != ERR_MEM) {
+#if ETH_PAD_SIZE
+            pbuf_header(p, ETH_PAD_SIZE);     /* reclaim the padding word */
+#endif
+            if (err == ERR_OK)
+                LINK_STATS_INC(link.xmit);
+            return err;
+        }
+        /* Chain too fragmented, not owning its data or misaligned, fall
+         * back to copy */
+    }
+#endif
+
     for(q = p; q != NULL; q = q->next) {
         /* Send the data from the pbuf to the interface, one pbuf at a
         time. The size of the data in each pbuf is kept in the ->len
@@ -221,6 +522,14 @@ static struct pbuf *glow_level_input(struct netif *netif)
     uint32_t frmlen;
     uint8_t rc;
 
+#if ETHIF_RX_ZERO_COPY
+    p = _ethif_receive_zero_copy(netif, &rc);
+    if (rc != ETH_RX_POOL_EMPTY) {
+        return p;
+    }
+    /* No buffer left to re-arm the descriptors, fall back to copy */
+#endif
+
     /* Obtain the size of the packet and put it into the "len"
        variable. */
     rc = ethd_poll(board_get_eth(netif->num), 0, buf, (uint32_t)sizeof(buf), (uint32_t*)&frmlen);
@@ -303,6 +612,10 @@ static void ethif_input(struct netif *netif)
         case ETHTYPE_IP:
             /* skip Ethernet header */
             pbuf_header(p, -(s16_t)sizeof(struct eth_hdr));
+#if ETHIF_CHECKSUM_OFFLOAD
+            if (checksum_offload[netif->num])
+                _ethif_rx_checksum_ctrl(netif);
+#endif
             /* pass to network layer */
             netif->input(p, netif);
             break;
@@ -350,5 +663,10 @@ void ethif_poll(struct netif *netif)
 	/* Run periodic tasks */
 	timers_update();
 
+#if ETHIF_TX_ZERO_COPY
+	/* Release transmitted frames */
+	_ethif_tx_release(netif->num);
+#endif
+
 	ethif_input(netif);
 }
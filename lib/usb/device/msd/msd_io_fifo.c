@@ -59,6 +59,7 @@ void msd_io_fifo_init(MSDIOFifo *p_fifo,
 {
 	p_fifo->pBuffer = buffer;
 	p_fifo->bufferSize = buffer_size;
+	p_fifo->ringSize = buffer_size;
 
 	p_fifo->inputNdx = 0;
 	p_fifo->outputNdx = 0;
@@ -72,4 +73,37 @@ void msd_io_fifo_init(MSDIOFifo *p_fifo,
 	p_fifo->nullCnt = 0;
 }
 
+#if  defined(MSDIO_READ10_CHUNK_SIZE) || defined(MSDIO_WRITE10_CHUNK_SIZE)
+/**
+ * \brief  Selects the chunk size of a READ10/WRITE10 transfer, according to
+ *         the block size of the LUN media.
+ *
+ *         Whenever the buffer can hold two blocks it is split in two chunks,
+ *         so that the media transfer of one chunk overlaps the USB transfer
+ *         of the other one. A chunk is a whole number of blocks and never
+ *         exceeds max_chunk_size, unless a single block is larger.
+ * \param  p_fifo          Pointer to the MSDIOFifo instance, with its
+ *                         blockSize already set
+ * \param  max_chunk_size  Maximum size of a chunk in bytes
+ */
+void msd_io_fifo_set_chunk_size(MSDIOFifo *p_fifo,
+							  unsigned int max_chunk_size)
+{
+	unsigned int chunk_size = p_fifo->bufferSize / 2;
+
+	if (chunk_size > max_chunk_size)
+		chunk_size = max_chunk_size;
+	chunk_size -= chunk_size % p_fifo->blockSize;
+
+	/* Buffer too small for double-buffering, fall back to one block */
+	if (chunk_size == 0)
+		chunk_size = p_fifo->blockSize;
+
+	p_fifo->chunkSize = chunk_size;
+	p_fifo->ringSize = p_fifo->bufferSize - p_fifo->bufferSize % chunk_size;
+	if (p_fifo->ringSize == 0)
+		p_fifo->ringSize = chunk_size;
+}
+#endif
+
 /**@}*/
@@ -81,6 +81,8 @@ typedef struct _MSDIOFifo {
 	unsigned char * pBuffer;
 	/** The size of the buffer allocated */
 	unsigned int    bufferSize;
+	/** The size of the buffer used as ring (a multiple of the chunk size) */
+	unsigned int    ringSize;
 #ifdef MSDIO_FIFO_OFFSET
 	/** The offset to start USB transfer (READ10) */
 	unsigned int    bufferOffset;
@@ -138,6 +140,11 @@ typedef struct _MSDIOFifo {
 extern void msd_io_fifo_init(MSDIOFifo *pFifo,
 						   void * pBuffer, unsigned int bufferSize);
 
+#if  defined(MSDIO_READ10_CHUNK_SIZE) || defined(MSDIO_WRITE10_CHUNK_SIZE)
+extern void msd_io_fifo_set_chunk_size(MSDIOFifo *pFifo,
+									 unsigned int maxChunkSize);
+#endif
+
 /**@}*/
 
 #endif /* _MSDIOFIFO_H */
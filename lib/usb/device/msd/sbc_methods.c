@@ -177,8 +177,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			fifo->blockSize = lun->blockSize *
 				media_get_block_size(lun->media);
 #ifdef MSDIO_WRITE10_CHUNK_SIZE
-			fifo->chunkSize = max_u32(fifo->blockSize,
-						  MSDIO_WRITE10_CHUNK_SIZE);
+			msd_io_fifo_set_chunk_size(fifo, MSDIO_WRITE10_CHUNK_SIZE);
 #endif
 			fifo->fullCnt = 0;
 			fifo->nullCnt = 0;
@@ -215,7 +214,7 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 	switch(fifo->inputState) {
 	case MSDIO_IDLE:
 		if (fifo->inputTotal < fifo->dataTotal &&
-				fifo->inputTotal - fifo->outputTotal < fifo->bufferSize) {
+				fifo->inputTotal - fifo->outputTotal < fifo->ringSize) {
 			fifo->inputState = MSDIO_START;
 		}
 		break;
@@ -272,7 +271,10 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			/* Prepare next device state */
 			fifo->inputState = MSDIO_WAIT;
 		}
-		break; /* MSDIO_START */
+		if (fifo->inputState != MSDIO_WAIT)
+			break;
+		/* The transfer may already be complete */
+		/* fall through */
 
 	case MSDIO_WAIT:
 		LIBUSB_TRACE("uWait ");
@@ -282,7 +284,9 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			transfer->semaphore--;
 			fifo->inputState = MSDIO_NEXT;
 		}
-		break;
+		if (fifo->inputState != MSDIO_NEXT)
+			break;
+		/* fall through */
 
 	case MSDIO_NEXT:
 		/* Check the result code of the write operation */
@@ -302,11 +306,11 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 				/* Update input index */
 #ifdef MSDIO_WRITE10_CHUNK_SIZE
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->chunkSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->inputTotal += fifo->chunkSize;
 #else
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->blockSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->inputTotal += fifo->blockSize;
 #endif
 
@@ -383,7 +387,10 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			/* Prepare next state */
 			fifo->outputState = MSDIO_WAIT;
 		}
-		break; /* MSDIO_START */
+		if (fifo->outputState != MSDIO_WAIT)
+			break;
+		/* The transfer may already be complete */
+		/* fall through */
 
 	case MSDIO_WAIT:
 		LIBUSB_TRACE("dWait ");
@@ -394,11 +401,13 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 			disktransfer->semaphore--;
 			fifo->outputState = MSDIO_NEXT;
 		}
-		break;
+		if (fifo->outputState != MSDIO_NEXT)
+			break;
+		/* fall through */
 
 	case MSDIO_NEXT:
 		/* Check operation result code */
-		if (transfer->status != USBD_STATUS_SUCCESS) {
+		if (disktransfer->status != USBD_STATUS_SUCCESS) {
 			trace_warning("RBC_Write10: Failed to write\n\r");
 			sbc_update_sense_data(lun->requestSenseData,
 					SBC_SENSE_KEY_RECOVERED_ERROR,
@@ -420,12 +429,12 @@ static uint8_t sbc_write10(MSDLun *lun, MSDCommandState *command_state)
 #ifdef MSDIO_WRITE10_CHUNK_SIZE
 				lba += fifo->chunkSize / fifo->blockSize;
 				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->chunkSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->outputTotal += fifo->chunkSize;
 #else
 				lba++;
 				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->blockSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->outputTotal += fifo->blockSize;
 #endif
 				STORE_DWORDB(lba, command->pLogicalBlockAddress);
@@ -497,8 +506,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 			fifo->blockSize = lun->blockSize *
 				media_get_block_size(lun->media);
 #ifdef MSDIO_READ10_CHUNK_SIZE
-			fifo->chunkSize = max_u32(fifo->blockSize,
-						  MSDIO_READ10_CHUNK_SIZE);
+			msd_io_fifo_set_chunk_size(fifo, MSDIO_READ10_CHUNK_SIZE);
 #endif
 			fifo->fullCnt = 0;
 			fifo->nullCnt = 0;
@@ -534,8 +542,137 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 		return MSDD_STATUS_SUCCESS;
 	}
 
-	/* Disk reading task */
+	/* USB sending task, handled first so that the transfer of a chunk to
+	 * the host is started before the media reads the next one */
 	old_chunk_size = fifo->chunkSize;
+	if ((fifo->dataTotal - fifo->outputTotal) < fifo->chunkSize) {
+		new_chunk_size = fifo->dataTotal - fifo->outputTotal;
+		fifo->chunkSize = new_chunk_size;
+	}
+
+	switch(fifo->outputState) {
+	case MSDIO_IDLE:
+		if (fifo->outputTotal < fifo->inputTotal) {
+#ifdef MSDIO_FIFO_OFFSET
+			/* Offset buffer the input data */
+			if (fifo->bufferOffset) {
+				if (fifo->inputTotal < fifo->bufferOffset) {
+					break;
+				}
+				fifo->bufferOffset = 0;
+			}
+#endif
+			fifo->outputState = MSDIO_START;
+		}
+		break;
+
+	case MSDIO_START:
+		/* Should not start if there is any disk error */
+		if (fifo->inputState == MSDIO_ERROR) {
+			fifo->outputState = MSDIO_ERROR;
+			break;
+		}
+
+		/* Send the block to the host */
+		if (media_is_mapped_read_supported(lun->media)) {
+			uint32_t mappedAddr = media_get_mapped_address(lun->media,
+					DWORDB(command->pLogicalBlockAddress) * lun->blockSize);
+			status = usbd_write(command_state->pipeIN,
+					(void*)mappedAddr, command_state->length,
+					msd_driver_callback, transfer);
+		} else {
+#ifdef MSDIO_READ10_CHUNK_SIZE
+			status = usbd_write(command_state->pipeIN,
+					&fifo->pBuffer[fifo->outputNdx], fifo->chunkSize,
+					msd_driver_callback, transfer);
+#else
+			status = usbd_write(command_state->pipeIN,
+					&fifo->pBuffer[fifo->outputNdx], fifo->blockSize,
+					msd_driver_callback, transfer);
+#endif
+		}
+
+		/* Check operation result code */
+		if (status != USBD_STATUS_SUCCESS) {
+			trace_warning("RBC_Read10: Failed to start to send\n\r");
+			sbc_update_sense_data(lun->requestSenseData,
+					SBC_SENSE_KEY_HARDWARE_ERROR, 0, 0);
+			result = MSDD_STATUS_ERROR;
+		} else {
+			LIBUSB_TRACE("uTx ");
+
+			/* Move to next command state */
+			fifo->outputState = MSDIO_WAIT;
+		}
+		if (fifo->outputState != MSDIO_WAIT)
+			break;
+		/* The transfer may already be complete */
+		/* fall through */
+
+	case MSDIO_WAIT:
+		/* Check semaphore value */
+		if (transfer->semaphore > 0) {
+			LIBUSB_TRACE("uOk ");
+			transfer->semaphore--;
+			fifo->outputState = MSDIO_NEXT;
+		}
+		if (fifo->outputState != MSDIO_NEXT)
+			break;
+		/* fall through */
+
+	case MSDIO_NEXT:
+		/* Check operation result code */
+		if (transfer->status != USBD_STATUS_SUCCESS) {
+			trace_warning("RBC_Read10: Failed to send data\n\r");
+			sbc_update_sense_data(lun->requestSenseData,
+					SBC_SENSE_KEY_HARDWARE_ERROR, 0, 0);
+			result = MSDD_STATUS_ERROR;
+		} else {
+			LIBUSB_TRACE("uNxt ");
+
+			if (media_is_mapped_read_supported(lun->media)) {
+				command_state->length = 0;
+			} else {
+				/* Update output index */
+#ifdef MSDIO_READ10_CHUNK_SIZE
+				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->chunkSize,
+						fifo->ringSize);
+				fifo->outputTotal += fifo->chunkSize;
+#else
+				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->blockSize,
+						fifo->ringSize);
+				fifo->outputTotal += fifo->blockSize;
+#endif
+
+				/* Start Next block */
+
+				/* - All data done? */
+				if (fifo->outputTotal >= fifo->dataTotal) {
+					fifo->outputState = MSDIO_IDLE;
+					command_state->length = 0;
+					LIBUSB_TRACE("uDone ");
+				}
+				/* - Buffer Null? */
+				else if (fifo->inputNdx == fifo->outputNdx) {
+					LIBUSB_TRACE("ufNull%d ", (int)fifo->outputNdx);
+					fifo->outputState = MSDIO_IDLE;
+					fifo->nullCnt ++;
+				}
+				/* - Send next? */
+				else if (fifo->outputTotal < fifo->inputTotal) {
+					LIBUSB_TRACE("uStart ");
+					fifo->outputState = MSDIO_START;
+				}
+			}
+		}
+		break;
+
+	case MSDIO_ERROR:
+		break;
+	}
+
+	/* Disk reading task */
+	fifo->chunkSize = old_chunk_size;
 	if ((fifo->dataTotal - fifo->inputTotal) < fifo->chunkSize) {
 		new_chunk_size = fifo->dataTotal - fifo->inputTotal;
 		fifo->chunkSize = new_chunk_size;
@@ -544,7 +681,7 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 	switch(fifo->inputState) {
 	case MSDIO_IDLE:
 		if (fifo->inputTotal < fifo->dataTotal &&
-				fifo->inputTotal - fifo->outputTotal < fifo->bufferSize) {
+				fifo->inputTotal - fifo->outputTotal < fifo->ringSize) {
 			fifo->inputState = MSDIO_START;
 		}
 		break;
@@ -592,7 +729,10 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 			/* Move to next command state */
 			fifo->inputState = MSDIO_WAIT;
 		}
-		break; /* MSDIO_START */
+		if (fifo->inputState != MSDIO_WAIT)
+			break;
+		/* The transfer may already be complete */
+		/* fall through */
 
 	case MSDIO_WAIT:
 		/* Check semaphore value */
@@ -601,7 +741,9 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 			disktransfer->semaphore--;
 			fifo->inputState = MSDIO_NEXT;
 		}
-		break;
+		if (fifo->inputState != MSDIO_NEXT)
+			break;
+		/* fall through */
 
 	case MSDIO_NEXT:
 		/* Check the operation result code */
@@ -624,12 +766,12 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 #ifdef MSDIO_READ10_CHUNK_SIZE
 				lba += fifo->chunkSize / fifo->blockSize;
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->chunkSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->inputTotal += fifo->chunkSize;
 #else
 				lba++;
 				MSDIOFifo_IncNdx(fifo->inputNdx, fifo->blockSize,
-						fifo->bufferSize);
+						fifo->ringSize);
 				fifo->inputTotal += fifo->blockSize;
 #endif
 				STORE_DWORDB(lba, command->pLogicalBlockAddress);
@@ -662,128 +804,6 @@ static uint8_t sbc_read10(MSDLun *lun, MSDCommandState *command_state)
 
 	fifo->chunkSize = old_chunk_size;
 
-	/* USB sending task */
-	if ((fifo->dataTotal - fifo->outputTotal) < fifo->chunkSize) {
-		new_chunk_size = fifo->dataTotal - fifo->outputTotal;
-		fifo->chunkSize = new_chunk_size;
-	}
-
-	switch(fifo->outputState) {
-	case MSDIO_IDLE:
-		if (fifo->outputTotal < fifo->inputTotal) {
-#ifdef MSDIO_FIFO_OFFSET
-			/* Offset buffer the input data */
-			if (fifo->bufferOffset) {
-				if (fifo->inputTotal < fifo->bufferOffset) {
-					break;
-				}
-				fifo->bufferOffset = 0;
-			}
-#endif
-			fifo->outputState = MSDIO_START;
-		}
-		break;
-
-	case MSDIO_START:
-		/* Should not start if there is any disk error */
-		if (fifo->inputState == MSDIO_ERROR) {
-			fifo->outputState = MSDIO_ERROR;
-			break;
-		}
-
-		/* Send the block to the host */
-		if (media_is_mapped_read_supported(lun->media)) {
-			uint32_t mappedAddr = media_get_mapped_address(lun->media,
-					DWORDB(command->pLogicalBlockAddress) * lun->blockSize);
-			status = usbd_write(command_state->pipeIN,
-					(void*)mappedAddr, command_state->length,
-					msd_driver_callback, transfer);
-		} else {
-#ifdef MSDIO_READ10_CHUNK_SIZE
-			status = usbd_write(command_state->pipeIN,
-					&fifo->pBuffer[fifo->outputNdx], fifo->chunkSize,
-					msd_driver_callback, transfer);
-#else
-			status = usbd_write(command_state->pipeIN,
-					&fifo->pBuffer[fifo->outputNdx], fifo->blockSize,
-					msd_driver_callback, transfer);
-#endif
-		}
-
-		/* Check operation result code */
-		if (status != USBD_STATUS_SUCCESS) {
-			trace_warning("RBC_Read10: Failed to start to send\n\r");
-			sbc_update_sense_data(lun->requestSenseData,
-					SBC_SENSE_KEY_HARDWARE_ERROR, 0, 0);
-			result = MSDD_STATUS_ERROR;
-		} else {
-			LIBUSB_TRACE("uTx ");
-
-			/* Move to next command state */
-			fifo->outputState = MSDIO_WAIT;
-		}
-		break; /* MSDIO_START */
-
-	case MSDIO_WAIT:
-		/* Check semaphore value */
-		if (transfer->semaphore > 0) {
-			LIBUSB_TRACE("uOk ");
-			transfer->semaphore--;
-			fifo->outputState = MSDIO_NEXT;
-		}
-		break;
-
-	case MSDIO_NEXT:
-		/* Check operation result code */
-		if (transfer->status != USBD_STATUS_SUCCESS) {
-			trace_warning("RBC_Read10: Failed to send data\n\r");
-			sbc_update_sense_data(lun->requestSenseData,
-					SBC_SENSE_KEY_HARDWARE_ERROR, 0, 0);
-			result = MSDD_STATUS_ERROR;
-		} else {
-			LIBUSB_TRACE("uNxt ");
-
-			if (media_is_mapped_read_supported(lun->media)) {
-				command_state->length = 0;
-			} else {
-				/* Update output index */
-#ifdef MSDIO_READ10_CHUNK_SIZE
-				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->chunkSize,
-						fifo->bufferSize);
-				fifo->outputTotal += fifo->chunkSize;
-#else
-				MSDIOFifo_IncNdx(fifo->outputNdx, fifo->blockSize,
-						fifo->bufferSize);
-				fifo->outputTotal += fifo->blockSize;
-#endif
-
-				/* Start Next block */
-
-				/* - All data done? */
-				if (fifo->outputTotal >= fifo->dataTotal) {
-					fifo->outputState = MSDIO_IDLE;
-					command_state->length = 0;
-					LIBUSB_TRACE("uDone ");
-				}
-				/* - Buffer Null? */
-				else if (fifo->inputNdx == fifo->outputNdx) {
-					LIBUSB_TRACE("ufNull%d ", (int)fifo->outputNdx);
-					fifo->outputState = MSDIO_IDLE;
-					fifo->nullCnt ++;
-				}
-				/* - Send next? */
-				else if (fifo->outputTotal < fifo->inputTotal) {
-					LIBUSB_TRACE("uStart ");
-					fifo->outputState = MSDIO_START;
-				}
-			}
-		}
-		break;
-
-	case MSDIO_ERROR:
-		break;
-	}
-
 	return result;
 }
 
@@ -46,6 +46,7 @@
 #define APPLET_CMD_WRITE_PAGES       0x33 /* Write pages */
 #define APPLET_CMD_READ_BOOTCFG      0x34 /* Read Boot Config */
 #define APPLET_CMD_WRITE_BOOTCFG     0x35 /* Write Boot Config */
+#define APPLET_CMD_ERASE_WRITE_PAGES 0x36 /* Erase and write pages */
 
 #define APPLET_SUCCESS               0x00 /* Operation was successful */
 #define APPLET_DEV_UNKNOWN           0x01 /* Device unknown */
@@ -135,7 +136,8 @@ union write_bootcfg_mailbox
 	} in;
 };
 
-/** Mailbox content for the 'read/write/erase pages' commands. */
+/** Mailbox content for the 'read/write/erase pages' and 'erase and write
+ * pages' commands. */
 union read_write_erase_pages_mailbox {
 	struct {
 		/** Read/Write/Erase offset (in pages) */
@@ -104,6 +104,9 @@ static uint32_t page_size;
 static uint32_t spare_size;
 static uint32_t block_size;
 
+/* Last block found good, its bad block markers are not checked again */
+static int32_t good_block = -1;
+
 static uint8_t ecc_bit_req_2_tt[] = {
 	2, 4, 8, 12, 24, 32
 };
@@ -288,6 +291,7 @@ static uint32_t handle_cmd_initialize(uint32_t cmd, uint32_t *mailbox)
 	}
 
 	nand_initialize(&nand);
+	good_block = -1;
 
 	/* defaults: use hardcoded NAND model table, no minimum ECC */
 	model = NULL;
@@ -372,17 +376,16 @@ static uint32_t handle_cmd_read_info(uint32_t cmd, uint32_t *mailbox)
 }
 
 /*
-	Write data to NAND flash.
+	Write data to NAND flash, optionally erasing each block before its first
+	page is written.
 */
-static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
+static uint32_t write_pages(union read_write_erase_pages_mailbox *mbx,
+		bool erase)
 {
-	union read_write_erase_pages_mailbox *mbx =
-		(union read_write_erase_pages_mailbox*)mailbox;
 	uint32_t i;
 	uint8_t *buf;
 	uint16_t block, page;
-
-	assert(cmd == APPLET_CMD_WRITE_PAGES);
+	uint8_t status;
 
 	/* check that requested size does not overflow buffer */
 	if (mbx->in.length > buffer_size) {
@@ -394,16 +397,41 @@ static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
 	page = mbx->in.offset - block * block_size;
 
 	for (i = 0, buf = buffer; i < mbx->in.length; i++, buf += page_size) {
+		if (erase && page == 0) {
+			trace_debug_wp("Erasing block %u\r\n", block);
+			/* a block that fails to erase gets marked bad */
+			good_block = -1;
+			status = nand_skipblock_erase_block(&nand, block,
+					NORMAL_ERASE);
+			if (status == NAND_ERROR_BADBLOCK) {
+				trace_error("Cannot erase bad block %u\r\n",
+						block);
+				mbx->out.pages = i;
+				return APPLET_BAD_BLOCK;
+			} else if (status != 0) {
+				trace_error("Erase error at block %u\r\n", block);
+				mbx->out.pages = 0;
+				return APPLET_ERASE_FAIL;
+			}
+		}
+
+		/* only check the bad block markers once per block instead of
+		 * reading them back before each page */
+		if (block != good_block) {
+			if (nand_skipblock_check_block(&nand, block) != GOODBLOCK) {
+				trace_error("Cannot write bad block %u (page %u)\r\n",
+						block, page);
+				mbx->out.pages = i;
+				return APPLET_BAD_BLOCK;
+			}
+			good_block = block;
+		}
+
 		trace_debug_wp("Writing %u bytes at block %u page %u (offset 0x%08x)\r\n",
 				(unsigned)page_size, block, page,
 				(unsigned)((block * block_size + page) * page_size));
-		uint8_t status = nand_skipblock_write_page(&nand, block, page, buf, NULL);
-		if (status == NAND_ERROR_BADBLOCK) {
-			trace_error("Cannot write bad block %u (page %u)\r\n",
-					block, page);
-			mbx->out.pages = i;
-			return APPLET_BAD_BLOCK;
-		} else if (status != 0) {
+		status = nand_ecc_write_page(&nand, block, page, buf, NULL);
+		if (status != 0) {
 			trace_error("Write error at block %u, page %u\r\n",
 					block, page);
 			mbx->out.pages = 0;
@@ -427,6 +455,29 @@ static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
 	return APPLET_SUCCESS;
 }
 
+/*
+	Write data to NAND flash.
+*/
+static uint32_t handle_cmd_write_pages(uint32_t cmd, uint32_t *mailbox)
+{
+	assert(cmd == APPLET_CMD_WRITE_PAGES);
+
+	return write_pages((union read_write_erase_pages_mailbox*)mailbox,
+			false);
+}
+
+/*
+	Erase and write data to NAND flash: each block is erased when the write
+	reaches its first page, saving the separate erase commands.
+*/
+static uint32_t handle_cmd_erase_write_pages(uint32_t cmd, uint32_t *mailbox)
+{
+	assert(cmd == APPLET_CMD_ERASE_WRITE_PAGES);
+
+	return write_pages((union read_write_erase_pages_mailbox*)mailbox,
+			true);
+}
+
 /*
 	Read data from NAND flash.
 */
@@ -504,6 +555,8 @@ static uint32_t handle_cmd_erase_pages(uint32_t cmd, uint32_t *mailbox)
 	}
 	block = mbx->in.offset / block_size;
 
+	/* a block that fails to erase gets marked bad */
+	good_block = -1;
 	status = nand_skipblock_erase_block(&nand, block, NORMAL_ERASE);
 	if (status == NAND_ERROR_BADBLOCK) {
 		trace_error("Cannot erase bad block %u\r\n", block);
@@ -533,5 +586,6 @@ const struct applet_command applet_commands[] = {
 	{ APPLET_CMD_ERASE_PAGES, handle_cmd_erase_pages },
 	{ APPLET_CMD_READ_PAGES, handle_cmd_read_pages },
 	{ APPLET_CMD_WRITE_PAGES, handle_cmd_write_pages },
+	{ APPLET_CMD_ERASE_WRITE_PAGES, handle_cmd_erase_write_pages },
 	{ 0, NULL }
 };
@@ -0,0 +1,646 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/aes.h"
+#include "crypto/aesd.h"
+#include "dma/dma.h"
+#include "mm/cache.h"
+#include "mutex.h"
+#include "peripherals/pmc.h"
+
+#include "aes_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SIM_MAX_TRANSFER_CFG 16
+
+struct _sim_channel {
+	bool allocated;
+	bool started;
+	uint8_t src;
+	struct _dma_cfg cfg;
+	struct _dma_transfer_cfg list[SIM_MAX_TRANSFER_CFG];
+	uint8_t list_size;
+	struct _callback callback;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct {
+	uint32_t mode;
+	bool encrypt;
+	uint8_t round_keys[240];
+	int rounds;
+	uint8_t vector[16];
+	uint8_t output[16];
+	uint32_t status;
+
+	/* GCM */
+	uint8_t h[16];
+	uint8_t j0[16];
+	uint8_t hash[16];
+	uint8_t tag[16];
+	uint32_t aad_len, aad_done;
+	uint32_t data_len, data_done;
+} aes;
+
+static struct _sim_channel channels[2];
+
+static uint8_t sbox[256];
+static uint8_t inv_sbox[256];
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+struct _aes_sim_stats aes_sim_stats;
+
+bool aes_sim_dma_pool_empty;
+
+void (*aes_sim_block_hook)(void);
+
+/*---------------------------------------------------------------------- */
+/*         AES cipher                                                    */
+/*---------------------------------------------------------------------- */
+
+static uint8_t _xtime(uint8_t x)
+{
+	return (uint8_t)(x << 1) ^ ((x & 0x80) ? 0x1b : 0);
+}
+
+static uint8_t _mul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+
+	for (; b; b >>= 1, a = _xtime(a))
+		if (b & 1)
+			r ^= a;
+	return r;
+}
+
+static uint8_t _rotl8(uint8_t x, int n)
+{
+	return (uint8_t)((x << n) | (x >> (8 - n)));
+}
+
+/** Build the S-boxes from the multiplicative inverses in GF(2^8), generated
+ * by walking the powers of 3 */
+static void _init_sbox(void)
+{
+	uint8_t p = 1, q = 1, x;
+	int i;
+
+	if (sbox[0])
+		return;
+	do {
+		p = p ^ _xtime(p);
+		q ^= (uint8_t)(q << 1);
+		q ^= (uint8_t)(q << 2);
+		q ^= (uint8_t)(q << 4);
+		if (q & 0x80)
+			q ^= 0x09;
+		x = q ^ _rotl8(q, 1) ^ _rotl8(q, 2) ^ _rotl8(q, 3) ^ _rotl8(q, 4);
+		sbox[p] = x ^ 0x63;
+	} while (p != 1);
+	sbox[0] = 0x63;
+	for (i = 0; i < 256; i++)
+		inv_sbox[sbox[i]] = (uint8_t)i;
+}
+
+static int _expand_key(const uint8_t *key, uint32_t len, uint8_t *rk)
+{
+	int nk = len / 4, nr = nk + 6, i, j;
+	uint8_t t[4], u, rcon = 1;
+
+	_init_sbox();
+	memcpy(rk, key, len);
+	for (i = nk; i < 4 * (nr + 1); i++) {
+		memcpy(t, rk + 4 * (i - 1), 4);
+		if (i % nk == 0) {
+			u = t[0];
+			t[0] = sbox[t[1]] ^ rcon;
+			t[1] = sbox[t[2]];
+			t[2] = sbox[t[3]];
+			t[3] = sbox[u];
+			rcon = _xtime(rcon);
+		} else if (nk > 6 && i % nk == 4) {
+			for (j = 0; j < 4; j++)
+				t[j] = sbox[t[j]];
+		}
+		for (j = 0; j < 4; j++)
+			rk[4 * i + j] = rk[4 * (i - nk) + j] ^ t[j];
+	}
+	return nr;
+}
+
+static void _add_round_key(uint8_t *s, const uint8_t *rk)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		s[i] ^= rk[i];
+}
+
+static void _encrypt(const uint8_t *rk, int nr, const uint8_t *in, uint8_t *out)
+{
+	uint8_t s[16], t[16], a[4];
+	int r, c, i;
+
+	memcpy(s, in, 16);
+	_add_round_key(s, rk);
+	for (r = 1; r <= nr; r++) {
+		/* SubBytes and ShiftRows */
+		for (c = 0; c < 4; c++)
+			for (i = 0; i < 4; i++)
+				t[i + 4 * c] = sbox[s[i + 4 * ((c + i) % 4)]];
+		/* MixColumns */
+		if (r != nr) {
+			for (c = 0; c < 4; c++) {
+				memcpy(a, &t[4 * c], 4);
+				for (i = 0; i < 4; i++)
+					t[4 * c + i] = _xtime(a[i])
+						^ _xtime(a[(i + 1) % 4]) ^ a[(i + 1) % 4]
+						^ a[(i + 2) % 4] ^ a[(i + 3) % 4];
+			}
+		}
+		memcpy(s, t, 16);
+		_add_round_key(s, rk + 16 * r);
+	}
+	memcpy(out, s, 16);
+}
+
+static void _decrypt(const uint8_t *rk, int nr, const uint8_t *in, uint8_t *out)
+{
+	uint8_t s[16], t[16], a[4];
+	int r, c, i;
+
+	memcpy(s, in, 16);
+	_add_round_key(s, rk + 16 * nr);
+	for (r = nr - 1; r >= 0; r--) {
+		/* InvShiftRows and InvSubBytes */
+		for (c = 0; c < 4; c++)
+			for (i = 0; i < 4; i++)
+				t[i + 4 * ((c + i) % 4)] = inv_sbox[s[i + 4 * c]];
+		_add_round_key(t, rk + 16 * r);
+		/* InvMixColumns */
+		if (r != 0) {
+			for (c = 0; c < 4; c++) {
+				memcpy(a, &t[4 * c], 4);
+				for (i = 0; i < 4; i++)
+					t[4 * c + i] = _mul(a[i], 14)
+						^ _mul(a[(i + 1) % 4], 11)
+						^ _mul(a[(i + 2) % 4], 13)
+						^ _mul(a[(i + 3) % 4], 9);
+			}
+		}
+		memcpy(s, t, 16);
+	}
+	memcpy(out, s, 16);
+}
+
+/*---------------------------------------------------------------------- */
+/*         GCM                                                           */
+/*---------------------------------------------------------------------- */
+
+/** Multiply x by y in GF(2^128), as defined by NIST SP 800-38D */
+static void _gf_mult(const uint8_t *x, const uint8_t *y, uint8_t *z)
+{
+	uint8_t v[16], r[16];
+	int i, j, lsb;
+
+	memset(r, 0, sizeof(r));
+	memcpy(v, y, sizeof(v));
+	for (i = 0; i < 128; i++) {
+		if (x[i / 8] & (0x80 >> (i % 8)))
+			for (j = 0; j < 16; j++)
+				r[j] ^= v[j];
+		lsb = v[15] & 1;
+		for (j = 15; j > 0; j--)
+			v[j] = (uint8_t)((v[j] >> 1) | (v[j - 1] << 7));
+		v[0] >>= 1;
+		if (lsb)
+			v[0] ^= 0xe1;
+	}
+	memcpy(z, r, 16);
+}
+
+static void _ghash(const uint8_t *block)
+{
+	int i;
+
+	for (i = 0; i < 16; i++)
+		aes.hash[i] ^= block[i];
+	_gf_mult(aes.hash, aes.h, aes.hash);
+}
+
+static void _inc32(uint8_t *counter)
+{
+	int i;
+
+	for (i = 15; i >= 12; i--)
+		if (++counter[i])
+			break;
+}
+
+static void _put_be64(uint8_t *p, uint64_t v)
+{
+	int i;
+
+	for (i = 7; i >= 0; i--, v >>= 8)
+		p[i] = (uint8_t)v;
+}
+
+/** Compute the tag once the lengths programmed have been processed */
+static void _gcm_check_done(void)
+{
+	uint8_t block[16];
+	int i;
+
+	if (aes.aad_done != aes.aad_len || aes.data_done != aes.data_len
+	    || (aes.status & AES_ISR_TAGRDY))
+		return;
+	_put_be64(block, (uint64_t)aes.aad_len * 8);
+	_put_be64(block + 8, (uint64_t)aes.data_len * 8);
+	_ghash(block);
+	_encrypt(aes.round_keys, aes.rounds, aes.j0, aes.tag);
+	for (i = 0; i < 16; i++)
+		aes.tag[i] ^= aes.hash[i];
+	aes.status |= AES_ISR_TAGRDY;
+}
+
+static void _gcm_process(const uint8_t *in)
+{
+	uint8_t block[16], key[16];
+	uint32_t len;
+	int i;
+
+	if (aes.aad_done < aes.aad_len) {
+		len = aes.aad_len - aes.aad_done;
+		if (len > 16)
+			len = 16;
+		memset(block, 0, sizeof(block));
+		memcpy(block, in, len);
+		_ghash(block);
+		aes.aad_done += len;
+	} else if (aes.data_done < aes.data_len) {
+		len = aes.data_len - aes.data_done;
+		if (len > 16)
+			len = 16;
+		_encrypt(aes.round_keys, aes.rounds, aes.vector, key);
+		_inc32(aes.vector);
+		for (i = 0; i < 16; i++)
+			aes.output[i] = in[i] ^ key[i];
+		/* The hash covers the ciphertext */
+		memset(block, 0, sizeof(block));
+		memcpy(block, aes.encrypt ? aes.output : in, len);
+		_ghash(block);
+		aes.data_done += len;
+	} else {
+		aes_sim_stats.errors++;
+		return;
+	}
+	_gcm_check_done();
+}
+
+/*---------------------------------------------------------------------- */
+/*         Simulated peripheral                                          */
+/*---------------------------------------------------------------------- */
+
+void aes_start(void)
+{
+}
+
+void aes_soft_reset(void)
+{
+	memset(&aes, 0, sizeof(aes));
+}
+
+void aes_configure(uint32_t cfg)
+{
+}
+
+void aes_set_op_mode(uint32_t mode)
+{
+	aes.mode = mode;
+}
+
+void aes_set_key_size(uint32_t size)
+{
+}
+
+void aes_set_cfbs(uint32_t size)
+{
+}
+
+void aes_set_start_mode(uint32_t mode)
+{
+}
+
+void aes_encrypt_enable(bool encrypt)
+{
+	aes.encrypt = encrypt;
+}
+
+void aes_enable_it(uint32_t sources)
+{
+}
+
+void aes_disable_it(uint32_t sources)
+{
+}
+
+uint32_t aes_get_status(void)
+{
+	return aes.status;
+}
+
+void aes_write_key(const uint32_t *key, uint32_t len)
+{
+	uint8_t zero[16];
+
+	aes.rounds = _expand_key((const uint8_t *)key, len, aes.round_keys);
+	aes_sim_stats.keys++;
+	if (aes.mode == AESD_MODE_GCM) {
+		/* Compute the hash subkey */
+		memset(zero, 0, sizeof(zero));
+		_encrypt(aes.round_keys, aes.rounds, zero, aes.h);
+		aes.status |= AES_ISR_DATRDY;
+	}
+}
+
+void aes_set_input(uint32_t *data)
+{
+	const uint8_t *in = (const uint8_t *)data;
+	uint8_t key[16];
+	int i;
+
+	aes.status &= ~AES_ISR_DATRDY;
+	aes_sim_stats.blocks++;
+	switch (aes.mode) {
+	case AESD_MODE_ECB:
+		if (aes.encrypt)
+			_encrypt(aes.round_keys, aes.rounds, in, aes.output);
+		else
+			_decrypt(aes.round_keys, aes.rounds, in, aes.output);
+		break;
+	case AESD_MODE_CBC:
+		if (aes.encrypt) {
+			for (i = 0; i < 16; i++)
+				key[i] = in[i] ^ aes.vector[i];
+			_encrypt(aes.round_keys, aes.rounds, key, aes.output);
+			memcpy(aes.vector, aes.output, 16);
+		} else {
+			_decrypt(aes.round_keys, aes.rounds, in, aes.output);
+			for (i = 0; i < 16; i++)
+				aes.output[i] ^= aes.vector[i];
+			memcpy(aes.vector, in, 16);
+		}
+		break;
+	case AESD_MODE_CTR:
+		_encrypt(aes.round_keys, aes.rounds, aes.vector, key);
+		_inc32(aes.vector);
+		for (i = 0; i < 16; i++)
+			aes.output[i] = in[i] ^ key[i];
+		break;
+	case AESD_MODE_GCM:
+		_gcm_process(in);
+		break;
+	default:
+		aes_sim_stats.errors++;
+		break;
+	}
+	aes.status |= AES_ISR_DATRDY;
+	if (aes_sim_block_hook)
+		aes_sim_block_hook();
+}
+
+void aes_get_output(uint32_t *data)
+{
+	memcpy(data, aes.output, 16);
+	aes.status &= ~AES_ISR_DATRDY;
+}
+
+void aes_set_vector(const uint32_t *vector)
+{
+	int i;
+
+	aes_sim_stats.vectors++;
+	memcpy(aes.vector, vector, 16);
+	if (aes.mode == AESD_MODE_GCM) {
+		/* The counter loaded is inc32(J0) */
+		memcpy(aes.j0, vector, 16);
+		for (i = 15; i >= 12; i--)
+			if (aes.j0[i]--)
+				break;
+	}
+}
+
+void aes_gcm_tag_enable(bool enable)
+{
+}
+
+void aes_set_aad_len(uint32_t len)
+{
+	aes.aad_len = len;
+	aes.aad_done = 0;
+	memset(aes.hash, 0, sizeof(aes.hash));
+	aes.status &= ~AES_ISR_TAGRDY;
+}
+
+void aes_set_data_len(uint32_t len)
+{
+	aes.data_len = len;
+	aes.data_done = 0;
+	_gcm_check_done();
+}
+
+void aes_get_gcm_tag(uint32_t *tag)
+{
+	memcpy(tag, aes.tag, 16);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Host services                                                 */
+/*---------------------------------------------------------------------- */
+
+/* The driver and the model run on the same thread */
+
+bool mutex_try_lock(mutex_t *mutex)
+{
+	if (*mutex)
+		return false;
+	*mutex = 1;
+	return true;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+	while (!mutex_try_lock(mutex));
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+	*mutex = 0;
+}
+
+bool mutex_is_locked(const mutex_t *mutex)
+{
+	return *mutex != 0;
+}
+
+void cache_clean_region(const void *start, uint32_t length)
+{
+}
+
+void cache_invalidate_region(void *start, uint32_t length)
+{
+}
+
+void pmc_configure_peripheral(uint32_t id, const struct _pmc_periph_cfg *cfg,
+		bool enable)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Simulated DMA                                                 */
+/*---------------------------------------------------------------------- */
+
+struct _dma_channel *dma_allocate_channel(uint8_t src, uint8_t dest)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!channels[i].allocated) {
+			channels[i].allocated = true;
+			channels[i].src = src;
+			return (struct _dma_channel *)&channels[i];
+		}
+	}
+	return NULL;
+}
+
+int dma_configure_transfer(struct _dma_channel *channel,
+		struct _dma_cfg *cfg, struct _dma_transfer_cfg *list,
+		uint8_t list_size)
+{
+	struct _sim_channel *ch = (struct _sim_channel *)channel;
+
+	if (list_size > SIM_MAX_TRANSFER_CFG)
+		return -1;
+	if (list_size > 1 && aes_sim_dma_pool_empty)
+		return -ENOMEM;
+	ch->cfg = *cfg;
+	memcpy(ch->list, list, list_size * sizeof(*list));
+	ch->list_size = list_size;
+	return 0;
+}
+
+int dma_set_callback(struct _dma_channel *channel, struct _callback *cb)
+{
+	callback_copy(&((struct _sim_channel *)channel)->callback, cb);
+	return 0;
+}
+
+int dma_start_transfer(struct _dma_channel *channel)
+{
+	((struct _sim_channel *)channel)->started = true;
+	return 0;
+}
+
+int dma_reset_channel(struct _dma_channel *channel)
+{
+	((struct _sim_channel *)channel)->started = false;
+	return 0;
+}
+
+/** Run the transfers started on the output channel, feeding the peripheral
+ * with the buffers of the input channel, then call back the driver */
+void dma_poll(void)
+{
+	struct _sim_channel *rx = NULL, *tx = NULL;
+	uint32_t i, off, width;
+	int c;
+
+	for (c = 0; c < 2; c++) {
+		if (channels[c].src == ID_AES)
+			rx = &channels[c];
+		else
+			tx = &channels[c];
+	}
+	if (!rx || !tx || !rx->started || !tx->started)
+		return;
+	aes_sim_stats.transfers++;
+	width = DMA_DATA_WIDTH_IN_BYTE(rx->cfg.data_width);
+	for (i = 0; i < tx->list_size; i++) {
+		for (off = 0; off < tx->list[i].len * width; off += 16) {
+			aes_set_input((uint32_t *)((uint8_t *)tx->list[i].saddr + off));
+			aes_get_output((uint32_t *)((uint8_t *)rx->list[i].daddr + off));
+		}
+	}
+	rx->started = false;
+	tx->started = false;
+	callback_call(&rx->callback, NULL);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+void aes_sim_reset(void)
+{
+	memset(&aes, 0, sizeof(aes));
+	memset(channels, 0, sizeof(channels));
+	memset(&aes_sim_stats, 0, sizeof(aes_sim_stats));
+	aes_sim_dma_pool_empty = false;
+	aes_sim_block_hook = NULL;
+}
+
+void aes_sim_encrypt_block(const uint8_t *key, uint32_t key_len,
+		const uint8_t in[16], uint8_t out[16])
+{
+	uint8_t rk[240];
+	int nr;
+
+	nr = _expand_key(key, key_len, rk);
+	_encrypt(rk, nr, in, out);
+}
@@ -0,0 +1,85 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Software model of the AES peripheral and of the DMA channels that feed it,
+ * for the host tests: it stands in for the register accesses of aes.c and
+ * for dma.c, so that the AES driver can be run on a PC. ECB, CBC, CTR and GCM
+ * are modelled, the DMA transfers are run by dma_poll().
+ */
+
+#ifndef AES_SIM_H
+#define AES_SIM_H
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+struct _aes_sim_stats {
+	uint32_t blocks;     /**< Blocks written to AES_IDATARx */
+	uint32_t keys;       /**< Keys written to AES_KEYWRx */
+	uint32_t vectors;    /**< IVs written to AES_IVRx */
+	uint32_t transfers;  /**< DMA transfers started on the output channel */
+	uint32_t errors;     /**< Inputs the peripheral had no use for */
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+extern struct _aes_sim_stats aes_sim_stats;
+
+/** Fail the DMA transfers of more than one item with -ENOMEM, as dma.c does
+ * when its pool of linked list items runs dry */
+extern bool aes_sim_dma_pool_empty;
+
+/** Called after each block processed by the model, or NULL */
+extern void (*aes_sim_block_hook)(void);
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+/** Reset the model, its DMA channels and statistics */
+extern void aes_sim_reset(void);
+
+/** Encrypt one block with the AES cipher, as a reference for the tests */
+extern void aes_sim_encrypt_block(const uint8_t *key, uint32_t key_len,
+		const uint8_t in[16], uint8_t out[16]);
+
+#endif /* AES_SIM_H */
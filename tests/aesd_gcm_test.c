@@ -0,0 +1,466 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the GCM functions of the AES driver against the test vectors
+ * of the GCM specification (McGrew and Viega, also used by NIST CAVP), on
+ * the AES model of aes_sim.c. The hash subkey and the GHASH of each message
+ * are checked apart from the tag, and the driver is checked to stay locked
+ * for the whole message.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Interrupts are not masked, the model runs on the same thread */
+#define CONFIG_ARCH_ARM
+#include "irqflags.h"
+static inline uint32_t arch_irq_save(void) { return 0; }
+static inline void arch_irq_restore(uint32_t flags) {}
+
+#include "crypto/aesd.c"
+
+#include "aes_sim.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define MAX_TEXT 64
+
+struct _gcm_vector {
+	const char *name;
+	const char *key;
+	const char *iv;
+	const char *aad;
+	const char *plain;
+	const char *cipher;
+	const char *h;       /**< hash subkey E(K, 0^128) */
+	const char *ghash;   /**< GHASH(H, A, C) */
+	const char *tag;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+#define K3 "feffe9928665731c6d6a8f9467308308"
+#define IV3 "cafebabefacedbaddecaf888"
+#define P3 "d9313225f88406e5a55909c5aff5269a" \
+	   "86a7a9531534f7da2e4c303d8a318a72" \
+	   "1c3c0c95956809532fcf0e2449a6b525" \
+	   "b16aedf5aa0de657ba637b391aafd255"
+#define P4 "d9313225f88406e5a55909c5aff5269a" \
+	   "86a7a9531534f7da2e4c303d8a318a72" \
+	   "1c3c0c95956809532fcf0e2449a6b525" \
+	   "b16aedf5aa0de657ba637b39"
+#define A4 "feedfacedeadbeeffeedfacedeadbeefabaddad2"
+
+static const struct _gcm_vector vectors[] = {
+	{
+		.name = "test case 1",
+		.key = "00000000000000000000000000000000",
+		.iv = "000000000000000000000000",
+		.aad = "", .plain = "", .cipher = "",
+		.h = "66e94bd4ef8a2c3b884cfa59ca342b2e",
+		.ghash = "00000000000000000000000000000000",
+		.tag = "58e2fccefa7e3061367f1d57a4e7455a",
+	}, {
+		.name = "test case 2",
+		.key = "00000000000000000000000000000000",
+		.iv = "000000000000000000000000",
+		.aad = "",
+		.plain = "00000000000000000000000000000000",
+		.cipher = "0388dace60b6a392f328c2b971b2fe78",
+		.h = "66e94bd4ef8a2c3b884cfa59ca342b2e",
+		.ghash = "f38cbb1ad69223dcc3457ae5b6b0f885",
+		.tag = "ab6e47d42cec13bdf53a67b21257bddf",
+	}, {
+		.name = "test case 3",
+		.key = K3, .iv = IV3, .aad = "", .plain = P3,
+		.cipher = "42831ec2217774244b7221b784d0d49c"
+			  "e3aa212f2c02a4e035c17e2329aca12e"
+			  "21d514b25466931c7d8f6a5aac84aa05"
+			  "1ba30b396a0aac973d58e091473f5985",
+		.h = "b83b533708bf535d0aa6e52980d53b78",
+		.ghash = "7f1b32b81b820d02614f8895ac1d4eac",
+		.tag = "4d5c2af327cd64a62cf35abd2ba6fab4",
+	}, {
+		.name = "test case 4",
+		.key = K3, .iv = IV3, .aad = A4, .plain = P4,
+		.cipher = "42831ec2217774244b7221b784d0d49c"
+			  "e3aa212f2c02a4e035c17e2329aca12e"
+			  "21d514b25466931c7d8f6a5aac84aa05"
+			  "1ba30b396a0aac973d58e091",
+		.h = "b83b533708bf535d0aa6e52980d53b78",
+		.ghash = "698e57f70e6ecc7fd9463b7260a9ae5f",
+		.tag = "5bc94fbc3221a5db94fae95ae7121a47",
+	}, {
+		.name = "test case 10",
+		.key = K3 "feffe9928665731c",
+		.iv = IV3, .aad = A4, .plain = P4,
+		.cipher = "3980ca0b3c00e841eb06fac4872a2757"
+			  "859e1ceaa6efd984628593b40ca1e19c"
+			  "7d773d00c144c525ac619d18c84a3f47"
+			  "18e2448b2fe324d9ccda2710",
+		.tag = "2519498e80f1478f37ba55bd6d27618c",
+	}, {
+		.name = "test case 14",
+		.key = "00000000000000000000000000000000"
+		       "00000000000000000000000000000000",
+		.iv = "000000000000000000000000",
+		.aad = "",
+		.plain = "00000000000000000000000000000000",
+		.cipher = "cea7403d4d606b6e074ec5d3baf39d18",
+		.tag = "d0d1c8a799996bf0265b98b5d48ab919",
+	}, {
+		.name = "test case 16",
+		.key = K3 K3, .iv = IV3, .aad = A4, .plain = P4,
+		.cipher = "522dc1f099567d07f47f37a32a84427d"
+			  "643a8cdcbfe5c0c97598a2bd2555d1aa"
+			  "8cb08e48590dbb3da7b08b1056828838"
+			  "c5f61e6393ba7a0abcc9f662",
+		.tag = "76fc6ece0f4e1768cddf8853bb2d551b",
+	},
+};
+
+static struct _aesd_desc aesd;
+
+/** Decoded vector */
+static struct {
+	uint8_t key[32], iv[12], aad[MAX_TEXT], plain[MAX_TEXT];
+	uint8_t cipher[MAX_TEXT], h[16], ghash[16], tag[16];
+	uint32_t key_len, aad_len, len;
+} v;
+
+static uint8_t out[MAX_TEXT] __attribute__((aligned(4)));
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static uint32_t _unhex(const char *hex, uint8_t *buf)
+{
+	uint32_t i, len = strlen(hex) / 2;
+	unsigned int byte;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		buf[i] = (uint8_t)byte;
+	}
+	return len;
+}
+
+/* Decode a vector and configure the driver for its key */
+static void _load(const struct _gcm_vector *vec, enum _aesd_trans_mode mode)
+{
+	memset(&v, 0, sizeof(v));
+	v.key_len = _unhex(vec->key, v.key);
+	_unhex(vec->iv, v.iv);
+	v.aad_len = _unhex(vec->aad, v.aad);
+	v.len = _unhex(vec->plain, v.plain);
+	_unhex(vec->cipher, v.cipher);
+	_unhex(vec->tag, v.tag);
+	if (vec->h) {
+		_unhex(vec->h, v.h);
+		_unhex(vec->ghash, v.ghash);
+	}
+
+	aes_sim_reset();
+	memset(&aesd, 0, sizeof(aesd));
+	aesd_init(&aesd);
+	aesd.cfg.transfer_mode = mode;
+	aesd.cfg.mode = AESD_MODE_GCM;
+	aesd.cfg.key_size = v.key_len == 16 ? AESD_AES128
+		: (v.key_len == 24 ? AESD_AES192 : AESD_AES256);
+	memcpy(aesd.cfg.key, v.key, v.key_len);
+	memset(out, 0xa5, sizeof(out));
+}
+
+/* Called by the model for every block: the message is processed with the
+ * driver locked */
+static void _check_locked(void)
+{
+	CHECK(aesd_is_busy(&aesd));
+	CHECK(aesd.gcm.active);
+}
+
+static void _run_vectors(enum _aesd_trans_mode mode)
+{
+	uint8_t tag[16];
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		unsigned before = test_failures;
+
+		_load(&vectors[i], mode);
+		aes_sim_block_hook = _check_locked;
+		CHECK(aesd_gcm_encrypt(&aesd, v.iv, sizeof(v.iv), v.aad,
+				v.aad_len, v.plain, out, v.len, tag,
+				sizeof(tag)) == AESD_SUCCESS);
+		CHECK(!memcmp(out, v.cipher, v.len));
+		CHECK(!memcmp(tag, v.tag, sizeof(tag)));
+		CHECK(!aesd_is_busy(&aesd));
+
+		memset(out, 0xa5, sizeof(out));
+		CHECK(aesd_gcm_decrypt(&aesd, v.iv, sizeof(v.iv), v.aad,
+				v.aad_len, v.cipher, out, v.len, v.tag,
+				sizeof(v.tag)) == AESD_SUCCESS);
+		CHECK(!memcmp(out, v.plain, v.len));
+		CHECK(!aesd_is_busy(&aesd));
+
+		/* Whole blocks of text go through the DMA */
+		if (mode == AESD_TRANS_DMA && v.len >= 16)
+			CHECK(aes_sim_stats.transfers == 2);
+		CHECK(aes_sim_stats.errors == 0);
+		if (test_failures != before)
+			printf("  %s\n", vectors[i].name);
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+/* The block cipher of the model against FIPS-197 appendix C, encrypting and
+ * decrypting through the driver in ECB mode */
+static void test_aes_cipher(void)
+{
+	static const char *expected[] = {
+		"69c4e0d86a7b0430d8cdb78070b4c55a",
+		"dda97ca4864cdfe06eaf70a0ec0d7191",
+		"8ea2b7ca516745bfeafc49904b496089",
+	};
+	static uint8_t plain[16] __attribute__((aligned(4)));
+	static uint8_t cipher[16] __attribute__((aligned(4)));
+	uint8_t key[32], ref[16];
+	struct _buffer bin = { .data = plain, .size = 16 };
+	struct _buffer bout = { .data = cipher, .size = 16 };
+	uint32_t i;
+
+	for (i = 0; i < sizeof(key); i++)
+		key[i] = (uint8_t)i;
+	_unhex("00112233445566778899aabbccddeeff", plain);
+
+	for (i = 0; i < ARRAY_SIZE(expected); i++) {
+		_unhex(expected[i], ref);
+		aes_sim_encrypt_block(key, 16 + 8 * i, plain, out);
+		CHECK(!memcmp(out, ref, 16));
+
+		aes_sim_reset();
+		memset(&aesd, 0, sizeof(aesd));
+		aesd_init(&aesd);
+		aesd.cfg.transfer_mode = AESD_TRANS_POLLING_AUTO;
+		aesd.cfg.mode = AESD_MODE_ECB;
+		aesd.cfg.key_size = (enum _aesd_key_size)i;
+		memcpy(aesd.cfg.key, key, sizeof(aesd.cfg.key));
+		aesd.cfg.encrypt = false;
+		aesd_configure_mode(&aesd);
+		bin.data = ref;
+		CHECK(aesd_transfer(&aesd, &bin, &bout, NULL) == AESD_SUCCESS);
+		CHECK(!memcmp(cipher, plain, 16));
+	}
+}
+
+/* The hash subkey and GHASH(H, A, C) of the messages, the tag being
+ * E(K, J0) xor GHASH(H, A, C) */
+static void test_gcm_ghash(void)
+{
+	uint8_t j0[16], ek[16], zero[16], tag[16], ghash[16];
+	uint32_t i, j;
+
+	memset(zero, 0, sizeof(zero));
+	for (i = 0; i < ARRAY_SIZE(vectors); i++) {
+		if (!vectors[i].h)
+			continue;
+		_load(&vectors[i], AESD_TRANS_POLLING_AUTO);
+		aes_sim_encrypt_block(v.key, v.key_len, zero, ek);
+		CHECK(!memcmp(ek, v.h, 16));
+
+		aesd.cfg.encrypt = true;
+		CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), v.aad_len,
+				v.len) == AESD_SUCCESS);
+		CHECK(aesd_gcm_update_aad(&aesd, v.aad, v.aad_len) == AESD_SUCCESS);
+		CHECK(aesd_gcm_update(&aesd, v.plain, out, v.len) == AESD_SUCCESS);
+		CHECK(aesd_gcm_finish(&aesd, tag, sizeof(tag)) == AESD_SUCCESS);
+
+		memcpy(j0, v.iv, sizeof(v.iv));
+		memcpy(j0 + 12, "\0\0\0\1", 4);
+		aes_sim_encrypt_block(v.key, v.key_len, j0, ek);
+		for (j = 0; j < 16; j++)
+			ghash[j] = tag[j] ^ ek[j];
+		CHECK(!memcmp(ghash, v.ghash, 16));
+	}
+}
+
+static void test_gcm_polling(void)
+{
+	_run_vectors(AESD_TRANS_POLLING_AUTO);
+}
+
+static void test_gcm_dma(void)
+{
+	_run_vectors(AESD_TRANS_DMA);
+}
+
+/* A message given in pieces, and a truncated tag */
+static void test_gcm_chunks(void)
+{
+	uint8_t tag[12];
+
+	_load(&vectors[3], AESD_TRANS_DMA);
+	aesd.cfg.encrypt = true;
+	CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), v.aad_len,
+			v.len) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update_aad(&aesd, v.aad, 16) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update_aad(&aesd, v.aad + 16, 4) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update(&aesd, v.plain, out, 16) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update(&aesd, v.plain + 16, out + 16, 16) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update(&aesd, v.plain + 32, out + 32, 28) == AESD_SUCCESS);
+	CHECK(aesd_gcm_finish(&aesd, tag, sizeof(tag)) == AESD_SUCCESS);
+	CHECK(!memcmp(out, v.cipher, v.len));
+	CHECK(!memcmp(tag, v.tag, sizeof(tag)));
+
+	CHECK(aesd_gcm_decrypt(&aesd, v.iv, sizeof(v.iv), v.aad, v.aad_len,
+			v.cipher, out, v.len, v.tag, 12) == AESD_SUCCESS);
+	CHECK(!memcmp(out, v.plain, v.len));
+}
+
+/* A wrong tag or a modified message is rejected, and the plaintext is
+ * wiped */
+static void test_gcm_auth_failure(void)
+{
+	static const uint8_t zero[MAX_TEXT];
+	enum _aesd_trans_mode mode;
+
+	for (mode = AESD_TRANS_POLLING_AUTO; mode <= AESD_TRANS_DMA; mode++) {
+		_load(&vectors[3], mode);
+		v.tag[15] ^= 1;
+		CHECK(aesd_gcm_decrypt(&aesd, v.iv, sizeof(v.iv), v.aad,
+				v.aad_len, v.cipher, out, v.len, v.tag,
+				sizeof(v.tag)) == AESD_ERROR_AUTH);
+		CHECK(!memcmp(out, zero, v.len));
+		CHECK(out[v.len] == 0xa5);
+		CHECK(!aesd_is_busy(&aesd));
+
+		v.tag[15] ^= 1;
+		v.cipher[40] ^= 0x80;
+		memset(out, 0xa5, sizeof(out));
+		CHECK(aesd_gcm_decrypt(&aesd, v.iv, sizeof(v.iv), v.aad,
+				v.aad_len, v.cipher, out, v.len, v.tag,
+				sizeof(v.tag)) == AESD_ERROR_AUTH);
+		CHECK(!memcmp(out, zero, v.len));
+
+		v.cipher[40] ^= 0x80;
+		v.aad[0] ^= 0x01;
+		memset(out, 0xa5, sizeof(out));
+		CHECK(aesd_gcm_decrypt(&aesd, v.iv, sizeof(v.iv), v.aad,
+				v.aad_len, v.cipher, out, v.len, v.tag,
+				sizeof(v.tag)) == AESD_ERROR_AUTH);
+		CHECK(!memcmp(out, zero, v.len));
+		CHECK(!aesd_is_busy(&aesd));
+	}
+}
+
+/* The driver is locked from aesd_gcm_start() to the end of the message */
+static void test_gcm_lock(void)
+{
+	static uint8_t buf[16] __attribute__((aligned(4)));
+	struct _buffer bin = { .data = buf, .size = 16 };
+	struct _buffer bout = { .data = buf, .size = 16 };
+	struct _aesd_ctx ctx = { .mode = AESD_MODE_ECB };
+	struct _aesd_job job = { .ctx = &ctx, .bufin = &bin, .bufout = &bout };
+	uint8_t tag[16];
+
+	_load(&vectors[3], AESD_TRANS_POLLING_AUTO);
+	aesd.cfg.encrypt = true;
+	CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), v.aad_len,
+			v.len) == AESD_SUCCESS);
+	CHECK(aesd_is_busy(&aesd));
+	CHECK(aesd_gcm_update_aad(&aesd, v.aad, v.aad_len) == AESD_SUCCESS);
+
+	/* Other users are turned away without touching the peripheral */
+	CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), 0, 0) == ADES_ERROR_LOCK);
+	aesd.cfg.encrypt = false;
+	CHECK(aesd_transfer(&aesd, &bin, &bout, NULL) == ADES_ERROR_LOCK);
+	aesd.cfg.encrypt = true;
+	CHECK(aesd_submit(&aesd, &job, 1) == ADES_ERROR_LOCK);
+	CHECK(aes_sim_stats.blocks == 2);
+
+	CHECK(aesd_gcm_update(&aesd, v.plain, out, v.len) == AESD_SUCCESS);
+	CHECK(aesd_is_busy(&aesd));
+	CHECK(aesd_gcm_finish(&aesd, tag, sizeof(tag)) == AESD_SUCCESS);
+	CHECK(!memcmp(out, v.cipher, v.len));
+	CHECK(!memcmp(tag, v.tag, sizeof(tag)));
+	CHECK(!aesd_is_busy(&aesd));
+
+	/* The session ends on error, and can't be resumed */
+	CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), v.aad_len,
+			v.len) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update(&aesd, v.plain, out, 16) == AESD_ERROR_PARAM);
+	CHECK(!aesd_is_busy(&aesd));
+	CHECK(aesd_gcm_update_aad(&aesd, v.aad, v.aad_len) == AESD_ERROR_PARAM);
+	CHECK(aesd_gcm_finish(&aesd, tag, sizeof(tag)) == AESD_ERROR_PARAM);
+
+	CHECK(aesd_gcm_start(&aesd, v.iv, sizeof(v.iv), v.aad_len,
+			v.len) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update_aad(&aesd, v.aad, v.aad_len) == AESD_SUCCESS);
+	CHECK(aesd_gcm_update(&aesd, v.plain, out, 16) == AESD_SUCCESS);
+	CHECK(aesd_gcm_finish(&aesd, tag, sizeof(tag)) == AESD_ERROR_PARAM);
+	CHECK(!aesd_is_busy(&aesd));
+
+	/* Released, the driver serves other users again */
+	CHECK(aesd_gcm_encrypt(&aesd, v.iv, sizeof(v.iv), v.aad, v.aad_len,
+			v.plain, out, v.len, tag, sizeof(tag)) == AESD_SUCCESS);
+	CHECK(!memcmp(tag, v.tag, sizeof(tag)));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_aes_cipher);
+	RUN_TEST(test_gcm_ghash);
+	RUN_TEST(test_gcm_polling);
+	RUN_TEST(test_gcm_dma);
+	RUN_TEST(test_gcm_chunks);
+	RUN_TEST(test_gcm_auth_failure);
+	RUN_TEST(test_gcm_lock);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,234 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Throughput of the AES driver on small records, as encrypted by a VPN
+ * tunnel: records of 64 to 256 bytes, in bursts of 8 records per tunnel,
+ * each tunnel having its own key.
+ *
+ * The records are encrypted by DMA on the AES model of aes_sim.c, either
+ * one aesd_transfer() per record, the application loading the key and IV
+ * of the record first, or queued with aesd_submit(). Both runs shall give
+ * the same output. The time is simulated from the operations counted by
+ * the model: a cost per block, per key load, per IV load and per DMA
+ * transfer (channel setup and completion interrupt), in the range of a
+ * SAMA5D2.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Interrupts are not masked, the model runs on the same thread */
+#define CONFIG_ARCH_ARM
+#include "irqflags.h"
+static inline uint32_t arch_irq_save(void) { return 0; }
+static inline void arch_irq_restore(uint32_t flags) {}
+
+#include "crypto/aesd.c"
+
+#include "aes_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define TUNNELS     4
+#define BURST       8
+#define RECORDS     4096
+#define MAX_RECORD  256
+
+/* Cost model */
+#define BLOCK_US     0.2
+#define KEY_US       1.0
+#define VECTOR_US    0.2
+#define TRANSFER_US  4.0
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _aesd_desc aesd;
+
+static struct _aesd_ctx ctxs[TUNNELS];
+
+static struct _aesd_job jobs[RECORDS];
+static struct _buffer bufin[RECORDS], bufout[RECORDS];
+static uint32_t vectors[RECORDS][4];
+static uint32_t sizes[RECORDS];
+
+static uint8_t in[RECORDS][MAX_RECORD] __attribute__((aligned(32)));
+static uint8_t out[RECORDS][MAX_RECORD] __attribute__((aligned(32)));
+static uint8_t ref[RECORDS][MAX_RECORD] __attribute__((aligned(32)));
+
+static uint32_t total_bytes;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _reset(void)
+{
+	aes_sim_reset();
+	memset(&aesd, 0, sizeof(aesd));
+	aesd_init(&aesd);
+	aesd.cfg.transfer_mode = AESD_TRANS_DMA;
+}
+
+static void _prepare(void)
+{
+	uint32_t i, j;
+
+	srand(14);
+	for (i = 0; i < TUNNELS; i++) {
+		ctxs[i].encrypt = true;
+		ctxs[i].mode = AESD_MODE_CBC;
+		ctxs[i].key_size = AESD_AES128;
+		for (j = 0; j < 4; j++)
+			ctxs[i].key[j] = (uint32_t)rand();
+	}
+
+	for (i = 0; i < RECORDS; i++) {
+		sizes[i] = 64 + 16 * (rand() % 13);
+		total_bytes += sizes[i];
+		for (j = 0; j < sizes[i]; j++)
+			in[i][j] = (uint8_t)rand();
+		for (j = 0; j < 4; j++)
+			vectors[i][j] = (uint32_t)rand();
+		bufin[i].data = in[i];
+		bufin[i].size = sizes[i];
+		bufout[i].data = out[i];
+		bufout[i].size = sizes[i];
+		jobs[i].ctx = &ctxs[(i / BURST) % TUNNELS];
+		jobs[i].bufin = &bufin[i];
+		jobs[i].bufout = &bufout[i];
+	}
+}
+
+/* Whether a record loads its own IV, or continues the CBC chain of the
+ * previous record of the burst */
+static bool _has_vector(uint32_t i, bool per_record)
+{
+	return per_record || i % BURST == 0;
+}
+
+/* One aesd_transfer() per record */
+static void _run_transfers(bool per_record)
+{
+	const struct _aesd_ctx *ctx;
+	struct _buffer bref;
+	uint32_t i;
+
+	_reset();
+	for (i = 0; i < RECORDS; i++) {
+		ctx = jobs[i].ctx;
+		if (_has_vector(i, per_record)) {
+			aesd.cfg.encrypt = ctx->encrypt;
+			aesd.cfg.mode = ctx->mode;
+			aesd.cfg.key_size = ctx->key_size;
+			memcpy(aesd.cfg.key, ctx->key, sizeof(aesd.cfg.key));
+			memcpy(aesd.cfg.vector, vectors[i], sizeof(aesd.cfg.vector));
+			aesd_configure_mode(&aesd);
+		}
+		bref.data = ref[i];
+		bref.size = sizes[i];
+		aesd_transfer(&aesd, &bufin[i], &bref, NULL);
+	}
+}
+
+/* All the records queued at once */
+static void _run_queue(bool per_record)
+{
+	uint32_t i;
+
+	_reset();
+	for (i = 0; i < RECORDS; i++)
+		jobs[i].vector = _has_vector(i, per_record) ? vectors[i] : NULL;
+	memset(out, 0, sizeof(out));
+	aesd_submit(&aesd, jobs, RECORDS);
+	aesd_wait_transfer(&aesd);
+}
+
+static void _report(const char *name)
+{
+	double us = aes_sim_stats.blocks * BLOCK_US
+		+ aes_sim_stats.keys * KEY_US
+		+ aes_sim_stats.vectors * VECTOR_US
+		+ aes_sim_stats.transfers * TRANSFER_US;
+
+	printf("  %-14s %7u %7u %9u %9.1f\n", name,
+	       (unsigned)aes_sim_stats.keys, (unsigned)aes_sim_stats.vectors,
+	       (unsigned)aes_sim_stats.transfers, total_bytes / us);
+}
+
+static int _check(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < RECORDS; i++) {
+		if (memcmp(out[i], ref[i], sizeof(out[i]))) {
+			printf("Output mismatch on record %u\n", (unsigned)i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	static const char *names[] = { "chained IV", "IV per record" };
+	int per_record, rc = 0;
+
+	_prepare();
+	printf("%u records of 64 to 256 bytes (%u bytes), %u tunnels, "
+	       "bursts of %u records\n", RECORDS, (unsigned)total_bytes,
+	       TUNNELS, BURST);
+	for (per_record = 0; per_record <= 1; per_record++) {
+		printf("%s\n  %-14s %7s %7s %9s %9s\n", names[per_record], "",
+		       "keys", "IVs", "DMA xfers", "MB/s");
+		_run_transfers(per_record);
+		_report("aesd_transfer");
+		_run_queue(per_record);
+		_report("aesd_submit");
+		rc |= _check();
+	}
+
+	return rc;
+}
@@ -0,0 +1,358 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the job queue of the AES driver (aesd_submit()), on the AES
+ * model of aes_sim.c. Jobs of several key contexts are checked against
+ * one-shot aesd_transfer() calls, in polling and DMA modes; the callbacks
+ * shall run in order, the key shall only be loaded when the context changes
+ * and the configuration of the descriptor shall survive the queue.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Interrupts are not masked, the model runs on the same thread */
+#define CONFIG_ARCH_ARM
+#include "irqflags.h"
+static inline uint32_t arch_irq_save(void) { return 0; }
+static inline void arch_irq_restore(uint32_t flags) {}
+
+#include "crypto/aesd.c"
+
+#include "aes_sim.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define MAX_JOBS  24
+#define MAX_LEN   256
+
+struct _job_spec {
+	uint8_t ctx;
+	bool vector;
+	uint16_t len;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _aesd_ctx ctxs[] = {
+	{ .encrypt = true,  .mode = AESD_MODE_CBC, .key_size = AESD_AES128 },
+	{ .encrypt = true,  .mode = AESD_MODE_CTR, .key_size = AESD_AES256 },
+	{ .encrypt = false, .mode = AESD_MODE_ECB, .key_size = AESD_AES192 },
+	{ .encrypt = false, .mode = AESD_MODE_CBC, .key_size = AESD_AES128 },
+};
+
+/* Chained and IV loading jobs, context changes, and a run of chained jobs
+ * longer than AESD_QUEUE_BATCH_MAX */
+static const struct _job_spec specs[] = {
+	{ 0, true, 64 }, { 0, false, 32 }, { 0, false, 16 },
+	{ 1, true, 48 }, { 1, false, 256 },
+	{ 2, false, 32 },
+	{ 0, true, 128 }, { 0, true, 16 },
+	{ 3, true, 64 },
+	{ 1, true, 80 },
+	{ 2, false, 16 }, { 2, false, 16 }, { 2, false, 16 }, { 2, false, 16 },
+	{ 2, false, 16 }, { 2, false, 16 }, { 2, false, 16 }, { 2, false, 16 },
+	{ 2, false, 16 }, { 2, false, 16 },
+};
+
+static struct _aesd_desc aesd;
+
+static struct _aesd_job jobs[MAX_JOBS];
+static struct _buffer bufin[MAX_JOBS], bufout[MAX_JOBS];
+static uint32_t vectors[MAX_JOBS][4];
+
+static uint8_t in[MAX_JOBS][MAX_LEN] __attribute__((aligned(4)));
+static uint8_t out[MAX_JOBS][MAX_LEN] __attribute__((aligned(4)));
+static uint8_t ref[MAX_JOBS][MAX_LEN] __attribute__((aligned(4)));
+
+/** Jobs in the order of their callbacks */
+static int order[2 * MAX_JOBS];
+static int completed;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static int _job_callback(void *arg, void *arg2)
+{
+	struct _aesd_job *job = (struct _aesd_job *)arg2;
+
+	order[completed++] = (int)(job - jobs);
+	return 0;
+}
+
+static void _load_ctx(const struct _aesd_ctx *ctx, const uint32_t *vector)
+{
+	aesd.cfg.encrypt = ctx->encrypt;
+	aesd.cfg.mode = ctx->mode;
+	aesd.cfg.key_size = ctx->key_size;
+	aesd.cfg.cfbs = ctx->cfbs;
+	memcpy(aesd.cfg.key, ctx->key, sizeof(aesd.cfg.key));
+	if (vector)
+		memcpy(aesd.cfg.vector, vector, sizeof(aesd.cfg.vector));
+	aesd_configure_mode(&aesd);
+}
+
+/* Build the jobs of specs[] and their expected outputs, computed with
+ * aesd_transfer() and a configuration loaded for every context change or
+ * IV */
+static void _prepare(void)
+{
+	uint32_t i, j;
+
+	aes_sim_reset();
+	memset(&aesd, 0, sizeof(aesd));
+	aesd_init(&aesd);
+
+	for (i = 0; i < ARRAY_SIZE(ctxs); i++)
+		for (j = 0; j < sizeof(ctxs[i].key); j++)
+			((uint8_t *)ctxs[i].key)[j] = (uint8_t)(17 * i + 3 * j + 1);
+
+	srand(14);
+	memset(jobs, 0, sizeof(jobs));
+	for (i = 0; i < ARRAY_SIZE(specs); i++) {
+		for (j = 0; j < specs[i].len; j++)
+			in[i][j] = (uint8_t)rand();
+		for (j = 0; j < 4; j++)
+			vectors[i][j] = (uint32_t)rand();
+		bufin[i].data = in[i];
+		bufin[i].size = specs[i].len;
+		bufout[i].data = out[i];
+		bufout[i].size = specs[i].len;
+		jobs[i].ctx = &ctxs[specs[i].ctx];
+		jobs[i].vector = specs[i].vector ? vectors[i] : NULL;
+		jobs[i].bufin = &bufin[i];
+		jobs[i].bufout = &bufout[i];
+		callback_set(&jobs[i].callback, _job_callback, NULL);
+	}
+
+	aesd.cfg.transfer_mode = AESD_TRANS_POLLING_AUTO;
+	for (i = 0; i < ARRAY_SIZE(specs); i++) {
+		struct _buffer bref = { .data = ref[i], .size = specs[i].len };
+
+		if (i == 0 || specs[i].ctx != specs[i - 1].ctx || specs[i].vector)
+			_load_ctx(jobs[i].ctx, jobs[i].vector);
+		CHECK(aesd_transfer(&aesd, &bufin[i], &bref, NULL) == AESD_SUCCESS);
+	}
+
+	memset(out, 0xa5, sizeof(out));
+	memset(order, 0xff, sizeof(order));
+	completed = 0;
+	memset(&aes_sim_stats, 0, sizeof(aes_sim_stats));
+}
+
+/* Configure the driver as an application using aesd_transfer() would */
+static void _configure_user(enum _aesd_trans_mode mode, enum _aesd_mode aes_mode)
+{
+	uint32_t i;
+
+	memset(&aesd.cfg, 0, sizeof(aesd.cfg));
+	aesd.cfg.transfer_mode = mode;
+	aesd.cfg.mode = aes_mode;
+	aesd.cfg.encrypt = true;
+	for (i = 0; i < ARRAY_SIZE(aesd.cfg.vector); i++)
+		aesd.cfg.vector[i] = 0x01010101 * i;
+	aesd_configure_mode(&aesd);
+}
+
+static void _run_queue(enum _aesd_trans_mode mode)
+{
+	static uint8_t block[32] __attribute__((aligned(4)));
+	static uint8_t before[32] __attribute__((aligned(4)));
+	static uint8_t after[32] __attribute__((aligned(4)));
+	struct _buffer bblock = { .data = block, .size = sizeof(block) };
+	struct _buffer bbefore = { .data = before, .size = sizeof(before) };
+	struct _buffer bafter = { .data = after, .size = sizeof(after) };
+	uint32_t i, keys = 0, transfers = 0, batch = 0;
+	uint32_t count = ARRAY_SIZE(specs);
+	__typeof__(aesd.cfg) user;
+
+	_prepare();
+	_configure_user(mode, AESD_MODE_CBC);
+	memcpy(&user, &aesd.cfg, sizeof(user));
+	memset(block, 0x5a, sizeof(block));
+	CHECK(aesd_transfer(&aesd, &bblock, &bbefore, NULL) == AESD_SUCCESS);
+	_configure_user(mode, AESD_MODE_CBC);
+	memset(&aes_sim_stats, 0, sizeof(aes_sim_stats));
+
+	CHECK(aesd_submit(&aesd, jobs, count) == AESD_SUCCESS);
+	aesd_wait_transfer(&aesd);
+	CHECK(!aesd_is_busy(&aesd));
+
+	CHECK(completed == (int)count);
+	for (i = 0; i < count; i++) {
+		CHECK(order[i] == (int)i);
+		if (memcmp(out[i], ref[i], specs[i].len)) {
+			printf("  job %u\n", (unsigned)i);
+			CHECK(!memcmp(out[i], ref[i], specs[i].len));
+		}
+	}
+
+	/* One key per context change; in DMA mode, one transfer per batch */
+	for (i = 0; i < count; i++) {
+		bool change = i == 0 || specs[i].ctx != specs[i - 1].ctx;
+
+		if (change)
+			keys++;
+		if (change || specs[i].vector || batch == AESD_QUEUE_BATCH_MAX) {
+			transfers++;
+			batch = 0;
+		}
+		batch++;
+	}
+	CHECK(aes_sim_stats.keys == keys);
+	if (mode == AESD_TRANS_DMA)
+		CHECK(aes_sim_stats.transfers == transfers);
+	CHECK(aes_sim_stats.errors == 0);
+
+	/* The configuration of the descriptor is untouched, and is loaded in
+	 * the peripheral by the next transfer, not when the queue drains */
+	CHECK(!memcmp(&aesd.cfg, &user, sizeof(user)));
+	CHECK(aesd_transfer(&aesd, &bblock, &bafter, NULL) == AESD_SUCCESS);
+	CHECK(aes_sim_stats.keys == keys + 1);
+	CHECK(!memcmp(after, before, sizeof(after)));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_queue_polling(void)
+{
+	_run_queue(AESD_TRANS_POLLING_AUTO);
+}
+
+static void test_queue_dma(void)
+{
+	_run_queue(AESD_TRANS_DMA);
+}
+
+/* Without linked list items, the jobs are transferred one by one */
+static void test_queue_dma_pool_empty(void)
+{
+	uint32_t i, count = ARRAY_SIZE(specs);
+
+	_prepare();
+	_configure_user(AESD_TRANS_DMA, AESD_MODE_CBC);
+	aes_sim_dma_pool_empty = true;
+	CHECK(aesd_submit(&aesd, jobs, count) == AESD_SUCCESS);
+	aesd_wait_transfer(&aesd);
+	CHECK(!aesd_is_busy(&aesd));
+
+	CHECK(completed == (int)count);
+	for (i = 0; i < count; i++) {
+		CHECK(order[i] == (int)i);
+		CHECK(!memcmp(out[i], ref[i], specs[i].len));
+	}
+	CHECK(aes_sim_stats.transfers == count);
+	CHECK(aes_sim_stats.errors == 0);
+}
+
+static int _append_callback(void *arg, void *arg2)
+{
+	uint32_t split = (uint32_t)(uintptr_t)arg;
+
+	_job_callback(arg, arg2);
+	if (arg2 == &jobs[0])
+		CHECK(aesd_submit(&aesd, &jobs[split],
+				ARRAY_SIZE(specs) - split) == AESD_SUCCESS);
+	return 0;
+}
+
+/* Jobs submitted from a job callback are appended to the running queue */
+static void test_append_from_callback(void)
+{
+	enum _aesd_trans_mode mode;
+	uint32_t i, split = 6;
+
+	for (mode = AESD_TRANS_POLLING_AUTO; mode <= AESD_TRANS_DMA; mode++) {
+		_prepare();
+		_configure_user(mode, AESD_MODE_ECB);
+		callback_set(&jobs[0].callback, _append_callback,
+				(void *)(uintptr_t)split);
+		CHECK(aesd_submit(&aesd, jobs, split) == AESD_SUCCESS);
+		aesd_wait_transfer(&aesd);
+
+		CHECK(completed == (int)ARRAY_SIZE(specs));
+		for (i = 0; i < ARRAY_SIZE(specs); i++) {
+			CHECK(order[i] == (int)i);
+			CHECK(!memcmp(out[i], ref[i], specs[i].len));
+		}
+		CHECK(!aesd_is_busy(&aesd));
+	}
+}
+
+/* A GCM message can be processed once the queue has drained */
+static void test_gcm_after_queue(void)
+{
+	static const uint8_t expected[16] = {
+		0x58, 0xe2, 0xfc, 0xce, 0xfa, 0x7e, 0x30, 0x61,
+		0x36, 0x7f, 0x1d, 0x57, 0xa4, 0xe7, 0x45, 0x5a,
+	};
+	uint8_t iv[AESD_GCM_IV_SIZE], tag[16];
+
+	_prepare();
+	_configure_user(AESD_TRANS_DMA, AESD_MODE_GCM);
+	CHECK(aesd_submit(&aesd, jobs, ARRAY_SIZE(specs)) == AESD_SUCCESS);
+	aesd_wait_transfer(&aesd);
+
+	/* GCM test case 1: zero key and IV, empty message */
+	memset(iv, 0, sizeof(iv));
+	CHECK(aesd_gcm_encrypt(&aesd, iv, sizeof(iv), NULL, 0, NULL, NULL, 0,
+			tag, sizeof(tag)) == AESD_SUCCESS);
+	CHECK(!memcmp(tag, expected, sizeof(tag)));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_queue_polling);
+	RUN_TEST(test_queue_dma);
+	RUN_TEST(test_queue_dma_pool_empty);
+	RUN_TEST(test_append_from_callback);
+	RUN_TEST(test_gcm_after_queue);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the split of long DMA transfers, with the limits of the
+ * XDMAC and DMAC controllers.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dma/dma_plan.h"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/* Limits of dma/xdmac.h and dma/dmac.h, which need a chip to build */
+#define XDMAC_MAX_BT_SIZE   0xFFFFFF
+#define XDMAC_MAX_BLOCK_LEN 0xFFF
+#define DMAC_MAX_BT_SIZE    0xFFFF
+#define DMAC_MAX_BLOCK_LEN  0xFFFF
+
+struct _limits {
+	uint32_t max_ublen;
+	uint32_t max_blocks;
+};
+
+static const struct _limits xdmac = { XDMAC_MAX_BT_SIZE, XDMAC_MAX_BLOCK_LEN };
+static const struct _limits dmac = { DMAC_MAX_BT_SIZE, DMAC_MAX_BLOCK_LEN };
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+/** Plan a transfer as dma.c does, including the DMAC fallback to one buffer
+ * per descriptor when a linked list is needed */
+static void _plan(const struct _limits *lim, uint32_t len,
+		struct _dma_plan *plan)
+{
+	dma_plan_transfer(len, lim->max_ublen, lim->max_blocks, plan);
+	if (lim == &dmac && plan->desc_count > 1)
+		dma_plan_transfer(len, lim->max_ublen, 1, plan);
+}
+
+/** Check that a plan transfers exactly len data elements within the limits
+ * of the controller */
+static bool _plan_ok(const struct _limits *lim, uint32_t len,
+		const struct _dma_plan *plan)
+{
+	uint64_t total;
+
+	if (!plan->blocks || plan->blocks > lim->max_blocks)
+		return false;
+	if (!plan->desc_count || plan->longer >= plan->desc_count)
+		return false;
+	if (!plan->ublen || plan->ublen + (plan->longer ? 1 : 0) > lim->max_ublen)
+		return false;
+	if (lim == &dmac && plan->desc_count > 1 && plan->blocks != 1)
+		return false;
+	total = ((uint64_t)plan->ublen * plan->desc_count + plan->longer) *
+		plan->blocks;
+	return total == len;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_single_descriptor(void)
+{
+	struct _dma_plan plan;
+
+	/* Smallest split */
+	_plan(&xdmac, XDMAC_MAX_BT_SIZE + 1, &plan);
+	CHECK(_plan_ok(&xdmac, XDMAC_MAX_BT_SIZE + 1, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 2);
+
+	/* Block counts that are not powers of two */
+	_plan(&dmac, 65535 * 100, &plan);
+	CHECK(_plan_ok(&dmac, 65535 * 100, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 100 && plan.ublen == 65535);
+
+	_plan(&xdmac, 0xFFFFFFFF, &plan);
+	CHECK(_plan_ok(&xdmac, 0xFFFFFFFF, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 257);
+
+	_plan(&dmac, 65521u * 65519u, &plan);
+	CHECK(_plan_ok(&dmac, 65521u * 65519u, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 65519);
+
+	/* Powers of two far from the smallest block count */
+	_plan(&xdmac, 0x80000000, &plan);
+	CHECK(_plan_ok(&xdmac, 0x80000000, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 2048);
+
+	_plan(&dmac, 0x40000000, &plan);
+	CHECK(_plan_ok(&dmac, 0x40000000, &plan));
+	CHECK(plan.desc_count == 1 && plan.blocks == 32768);
+}
+
+static void test_linked_list(void)
+{
+	struct _dma_plan plan;
+
+	/* Prime lengths: microblocks of one element more first */
+	_plan(&xdmac, 16777259, &plan);
+	CHECK(_plan_ok(&xdmac, 16777259, &plan));
+	CHECK(plan.blocks == 1 && plan.desc_count == 2);
+	CHECK(plan.ublen == 8388629 && plan.longer == 1);
+
+	_plan(&dmac, 1000003, &plan);
+	CHECK(_plan_ok(&dmac, 1000003, &plan));
+	CHECK(plan.blocks == 1 && plan.desc_count == 16);
+
+	/* No candidate block count divides the length: blocks of the
+	 * greatest power of two, in a linked list */
+	_plan(&xdmac, 16u * 134217757u, &plan);
+	CHECK(_plan_ok(&xdmac, 16u * 134217757u, &plan));
+	CHECK(plan.blocks == 16 && plan.desc_count == 9);
+	CHECK(plan.ublen == 14913084 && plan.longer == 1);
+}
+
+static void test_all_lengths_valid(void)
+{
+	struct _dma_plan plan;
+	uint32_t len, step;
+
+	/* Every length just above the limits, then a sweep of the whole range
+	 * with a prime step */
+	for (len = XDMAC_MAX_BT_SIZE + 1; len < XDMAC_MAX_BT_SIZE + 100000; len++) {
+		_plan(&xdmac, len, &plan);
+		CHECK(_plan_ok(&xdmac, len, &plan));
+	}
+	for (len = DMAC_MAX_BT_SIZE + 1; len < 4 * DMAC_MAX_BT_SIZE; len++) {
+		_plan(&dmac, len, &plan);
+		CHECK(_plan_ok(&dmac, len, &plan));
+		CHECK(plan.desc_count <= 4);
+	}
+	step = 1000003;
+	for (len = 0xFFFFFFFF; len > DMAC_MAX_BT_SIZE + step; len -= step) {
+		_plan(&dmac, len, &plan);
+		CHECK(_plan_ok(&dmac, len, &plan));
+		if (len > XDMAC_MAX_BT_SIZE) {
+			_plan(&xdmac, len, &plan);
+			CHECK(_plan_ok(&xdmac, len, &plan));
+		}
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_single_descriptor);
+	RUN_TEST(test_linked_list);
+	RUN_TEST(test_all_lengths_valid);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,422 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the pool of linked list items of the DMA driver (dma.c, for
+ * the XDMAC): slab lists, channel reserves, single-item lists and the pool
+ * statistics. The XDMAC and chip functions are stubbed.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "dma/dma.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define ALL_CHANNELS (DMA_CONTROLLERS * DMA_CHANNELS)
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static Xdmac xdmac[DMA_CONTROLLERS];
+
+static struct _dma_channel* channels[ALL_CHANNELS];
+
+static uint8_t buffer[2][256];
+
+/** Descriptor given to the XDMAC by the last transfer configuration */
+static void* last_desc;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _setup(void)
+{
+	uint32_t i;
+
+	memset(&_dma_ctrl, 0, sizeof(_dma_ctrl));
+	dma_initialize(true);
+	for (i = 0; i < ALL_CHANNELS; i++)
+		channels[i] = dma_allocate_channel(DMA_PERIPH_MEMORY,
+						   DMA_PERIPH_MEMORY);
+}
+
+/** Configure a memory to memory transfer of count buffers */
+static int _configure(struct _dma_channel* channel, uint8_t count, bool loop)
+{
+	struct _dma_transfer_cfg list[DMA_SG_ITEM_POOL_SIZE + 1];
+	struct _dma_cfg cfg = {
+		.data_width = DMA_DATA_WIDTH_BYTE,
+		.chunk_size = DMA_CHUNK_SIZE_1,
+		.incr_saddr = true,
+		.incr_daddr = true,
+		.loop = loop,
+	};
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		list[i].saddr = &buffer[0][i];
+		list[i].daddr = &buffer[1][i];
+		list[i].len = 1;
+	}
+	return dma_configure_transfer(channel, &cfg, list, count);
+}
+
+/** Check that the statistics add up, and return them */
+static struct _dma_sg_stats _stats(void)
+{
+	struct _dma_sg_stats stats;
+
+	dma_sg_get_stats(&stats);
+	CHECK(stats.size == DMA_SG_ITEM_POOL_SIZE);
+	CHECK(stats.free + stats.reserved + stats.used == stats.size);
+	CHECK(stats.used <= stats.high_watermark);
+	return stats;
+}
+
+/** Count the items of a linked list, following the loop at most once */
+static uint32_t _list_length(struct _dma_sg_desc* head)
+{
+	struct _dma_sg_desc* curr = head;
+	uint32_t count = 0;
+
+	do {
+		count++;
+		curr = DMA_SG_DESC_GET_NEXT(curr);
+	} while (curr && curr != head && count <= DMA_SG_ITEM_POOL_SIZE);
+	return count;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_slab_pop_push(void)
+{
+	uint16_t first, second;
+
+	_setup();
+
+	first = _dma_sg_slab_pop(&_dma_sg_pool.head, &_dma_sg_pool.count, 3);
+	CHECK(first == 0);
+	CHECK(_dma_sg_pool.next[0] == 1 && _dma_sg_pool.next[1] == 2);
+	CHECK(_dma_sg_pool.next[2] == DMA_SG_SLAB_NONE);
+	CHECK(_dma_sg_pool.last[first] == 2);
+	CHECK(_dma_sg_pool.length[first] == 3);
+	CHECK(_dma_sg_pool.head == 3);
+	CHECK(_dma_sg_pool.count == DMA_SG_SLABS - 3);
+
+	second = _dma_sg_slab_pop(&_dma_sg_pool.head, &_dma_sg_pool.count, 1);
+	CHECK(second == 3);
+	CHECK(_dma_sg_pool.next[3] == DMA_SG_SLAB_NONE);
+	CHECK(_dma_sg_pool.count == DMA_SG_SLABS - 4);
+
+	/* Pushed lists go back at the head, whole */
+	_dma_sg_slab_push(&_dma_sg_pool.head, &_dma_sg_pool.count, first);
+	CHECK(_dma_sg_pool.head == 0);
+	CHECK(_dma_sg_pool.next[2] == 4);
+	CHECK(_dma_sg_pool.count == DMA_SG_SLABS - 1);
+
+	_dma_sg_slab_push(&_dma_sg_pool.head, &_dma_sg_pool.count, second);
+	CHECK(_dma_sg_pool.head == 3);
+	CHECK(_dma_sg_pool.next[3] == 0);
+	CHECK(_dma_sg_pool.count == DMA_SG_SLABS);
+
+	/* The whole pool in one list */
+	first = _dma_sg_slab_pop(&_dma_sg_pool.head, &_dma_sg_pool.count,
+				 DMA_SG_SLABS);
+	CHECK(_dma_sg_pool.count == 0);
+	CHECK(_dma_sg_pool.head == DMA_SG_SLAB_NONE);
+	CHECK(_dma_sg_pool.length[first] == DMA_SG_SLABS);
+	_dma_sg_slab_push(&_dma_sg_pool.head, &_dma_sg_pool.count, first);
+	CHECK(_dma_sg_pool.count == DMA_SG_SLABS);
+}
+
+static void test_lists_span_slabs(void)
+{
+	struct _dma_sg_stats stats;
+	struct _dma_sg_desc* curr;
+	uint32_t i;
+
+	_setup();
+
+	CHECK(_configure(channels[0], DMA_SG_SLAB_SIZE + 1, false) == 0);
+	CHECK(last_desc == channels[0]->sg_list);
+	CHECK(_list_length(channels[0]->sg_list) == DMA_SG_SLAB_SIZE + 1);
+	stats = _stats();
+	CHECK(stats.used == 2 * DMA_SG_SLAB_SIZE);
+
+	/* Each item points at its buffer, the last one ends the transfer */
+	curr = channels[0]->sg_list;
+	for (i = 0; i <= DMA_SG_SLAB_SIZE; i++) {
+		CHECK(curr->desc.mbr_sa == &buffer[0][i]);
+		CHECK(curr->desc.mbr_da == &buffer[1][i]);
+		CHECK(!!(curr->desc.mbr_ubc & XDMA_UBC_NDE_FETCH_EN)
+		      == (i < DMA_SG_SLAB_SIZE));
+		curr = DMA_SG_DESC_GET_NEXT(curr);
+	}
+	CHECK(curr == NULL);
+
+	/* The whole pool, then one item more */
+	CHECK(_configure(channels[0], DMA_SG_ITEM_POOL_SIZE, false) == 0);
+	stats = _stats();
+	CHECK(stats.used == DMA_SG_ITEM_POOL_SIZE);
+	CHECK(_configure(channels[1], 2, false) == -ENOMEM);
+	CHECK(_configure(channels[0], DMA_SG_ITEM_POOL_SIZE + 1, false) == -ENOMEM);
+	stats = _stats();
+	CHECK(stats.failures == 2);
+	CHECK(stats.free == DMA_SG_ITEM_POOL_SIZE);
+	CHECK(stats.high_watermark == DMA_SG_ITEM_POOL_SIZE);
+}
+
+static void test_single_item_lists(void)
+{
+	struct _dma_sg_stats stats;
+	struct _dma_sg_desc* lists[ALL_CHANNELS];
+	uint32_t i, j;
+
+	_setup();
+	for (i = 0; i < ALL_CHANNELS; i++)
+		CHECK(channels[i] != NULL);
+
+	/* Every channel runs a looped single-item list, without using the
+	 * pool */
+	for (i = 0; i < ALL_CHANNELS; i++) {
+		CHECK(_configure(channels[i], 1, true) == 0);
+		lists[i] = channels[i]->sg_list;
+		CHECK(lists[i] != NULL);
+		CHECK(DMA_SG_DESC_GET_NEXT(lists[i]) == lists[i]);
+		CHECK(lists[i]->desc.mbr_sa == &buffer[0][0]);
+	}
+	for (i = 0; i < ALL_CHANNELS; i++)
+		for (j = i + 1; j < ALL_CHANNELS; j++)
+			CHECK(lists[i] != lists[j]);
+	stats = _stats();
+	CHECK(stats.used == 0);
+	CHECK(stats.free == DMA_SG_ITEM_POOL_SIZE);
+
+	/* So the slabs are all left for longer lists */
+	for (i = 0; i < DMA_SG_SLABS; i++)
+		CHECK(_configure(channels[i], DMA_SG_SLAB_SIZE, true) == 0);
+	stats = _stats();
+	CHECK(stats.free == 0);
+	CHECK(_configure(channels[DMA_SG_SLABS], 2, false) == -ENOMEM);
+	CHECK(_configure(channels[DMA_SG_SLABS], 1, false) == 0);
+
+	/* Reconfiguring a channel releases its slabs; a single buffer
+	 * without loop needs no list at all */
+	CHECK(_configure(channels[0], 1, false) == 0);
+	CHECK(channels[0]->sg_list == NULL);
+	stats = _stats();
+	CHECK(stats.free == DMA_SG_SLAB_SIZE);
+}
+
+static void test_reserve(void)
+{
+	struct _dma_sg_stats stats;
+	uint32_t i;
+
+	_setup();
+
+	/* Rounded up to whole slabs */
+	CHECK(dma_sg_reserve(channels[0], DMA_SG_SLAB_SIZE + 1) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == 2 * DMA_SG_SLAB_SIZE);
+	CHECK(stats.free == DMA_SG_ITEM_POOL_SIZE - 2 * DMA_SG_SLAB_SIZE);
+
+	/* Single-item lists need no reserve */
+	CHECK(dma_sg_reserve(channels[1], 1) == 0);
+	CHECK(_stats().reserved == 2 * DMA_SG_SLAB_SIZE);
+
+	/* The other channels take the shared pool; the reserve still
+	 * serves its channel */
+	for (i = 1; i < DMA_SG_SLABS - 1; i++)
+		CHECK(_configure(channels[i], DMA_SG_SLAB_SIZE, false) == 0);
+	CHECK(_configure(channels[i], DMA_SG_SLAB_SIZE, false) == -ENOMEM);
+	CHECK(_configure(channels[0], 2 * DMA_SG_SLAB_SIZE, false) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == 0);
+	CHECK(stats.used == DMA_SG_ITEM_POOL_SIZE);
+
+	/* Freed lists refill the reserve first: a transfer of a single
+	 * buffer releases the list of the previous one */
+	CHECK(_configure(channels[0], 1, false) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == 2 * DMA_SG_SLAB_SIZE);
+	CHECK(stats.free == 0);
+
+	/* A list longer than the reserve comes from the shared pool */
+	for (i = 1; i <= 3; i++)
+		CHECK(_configure(channels[i], 1, false) == 0);
+	CHECK(_configure(channels[0], 3 * DMA_SG_SLAB_SIZE, false) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == 2 * DMA_SG_SLAB_SIZE);
+	CHECK(stats.free == 0);
+
+	/* Not enough free items to grow the reserve */
+	CHECK(dma_sg_reserve(channels[0], 3 * DMA_SG_SLAB_SIZE) == -ENOMEM);
+	CHECK(dma_sg_reserve(channels[0], DMA_SG_ITEM_POOL_SIZE + 1) == -ENOMEM);
+
+	/* Shrinking gives the free slabs back, freeing the channel gives
+	 * back the rest */
+	CHECK(dma_sg_reserve(channels[0], DMA_SG_SLAB_SIZE) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == DMA_SG_SLAB_SIZE);
+	CHECK(stats.free == DMA_SG_SLAB_SIZE);
+	CHECK(dma_free_channel(channels[0]) == 0);
+	stats = _stats();
+	CHECK(stats.reserved == 0);
+	CHECK(stats.free == 5 * DMA_SG_SLAB_SIZE);
+	CHECK(channels[0]->sg_reserve_size == 0);
+}
+
+static void test_stats_random(void)
+{
+	struct _dma_sg_stats stats;
+	uint32_t seed = 7, i, chan, count, used, peak = 0;
+	int err;
+
+	_setup();
+	for (i = 0; i < 4; i++)
+		CHECK(dma_sg_reserve(channels[i], DMA_SG_SLAB_SIZE * (i + 1)) == 0);
+
+	for (i = 0; i < 2000; i++) {
+		seed = seed * 1103515245 + 12345;
+		chan = (seed >> 8) % 8;
+		count = (seed >> 16) % (3 * DMA_SG_SLAB_SIZE) + 1;
+		if ((seed >> 28) == 0) {
+			CHECK(dma_free_channel(channels[chan]) == 0);
+			channels[chan] = dma_allocate_channel(DMA_PERIPH_MEMORY,
+							      DMA_PERIPH_MEMORY);
+		} else {
+			err = _configure(channels[chan], count, (seed >> 27) & 1);
+			CHECK(err == 0 || err == -ENOMEM);
+		}
+
+		/* The statistics match the lists held by the channels */
+		stats = _stats();
+		for (chan = 0, used = 0; chan < 8; chan++) {
+			struct _dma_sg_desc* list = channels[chan]->sg_list;
+			if (list && _dma_sg_in_slabs(list))
+				used += CEIL_INT_DIV(_list_length(list),
+						     DMA_SG_SLAB_SIZE)
+					* DMA_SG_SLAB_SIZE;
+		}
+		CHECK(stats.used == used);
+		if (used > peak)
+			peak = used;
+		CHECK(stats.high_watermark == peak);
+	}
+	CHECK(_dma_sg_pool.mutex == 0);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+void mutex_lock(mutex_t* mutex)
+{
+	CHECK(*mutex == 0);
+	*mutex = 1;
+}
+
+void mutex_unlock(mutex_t* mutex)
+{
+	CHECK(*mutex == 1);
+	*mutex = 0;
+}
+
+void cache_clean_region(const void* start, uint32_t length)
+{
+}
+
+Xdmac* get_xdmac_addr_from_id(uint32_t id)
+{
+	return &xdmac[id == ID_XDMAC0 ? 0 : 1];
+}
+
+bool is_peripheral_on_dma_controller(uint32_t id, Xdmac* xdmac)
+{
+	return true;
+}
+
+uint8_t get_peripheral_dma_channel(uint32_t id, Xdmac* xdmac, bool transmit)
+{
+	return 0xff;
+}
+
+int xdmacd_configure_transfer(struct _dma_channel* channel,
+			      struct _xdmacd_cfg* cfg, uint32_t desc_ctrl,
+			      void* desc_addr)
+{
+	last_desc = desc_addr;
+	return 0;
+}
+
+int dma_prepare_channel(struct _dma_channel* channel) { return 0; }
+void dma_irq_handler(uint32_t source, void* user_arg) {}
+void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg) {}
+void irq_enable(uint32_t source) {}
+uint32_t xdmac_get_channel_isr(Xdmac* xdmac, uint8_t channel) { return 0; }
+uint32_t xdmac_get_global_channel_status(Xdmac* xdmac) { return 0; }
+uint32_t xdmac_get_microblock_control(Xdmac* xdmac, uint8_t channel) { return 0; }
+void xdmac_enable_channel(Xdmac* xdmac, uint8_t channel) {}
+void xdmac_disable_channel(Xdmac* xdmac, uint8_t channel) {}
+void xdmac_enable_global_it(Xdmac* xdmac, uint32_t int_mask) {}
+void xdmac_disable_channel_it(Xdmac* xdmac, uint8_t channel, uint32_t int_mask) {}
+void xdmac_suspend_channel(Xdmac* xdmac, uint8_t channel) {}
+void xdmac_resume_read_write_channel(Xdmac* xdmac, uint8_t channel) {}
+void xdmac_fifo_flush(Xdmac* xdmac, uint8_t channel) {}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_slab_pop_push);
+	RUN_TEST(test_lists_span_slabs);
+	RUN_TEST(test_single_item_lists);
+	RUN_TEST(test_reserve);
+	RUN_TEST(test_stats_random);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the ETH TX descriptor ring, copy and zero-copy frames,
+ * against a simulated MAC that reads the descriptors and writes back their
+ * status as the GMAC does.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Empty barriers, the simulated MAC runs on the same thread */
+#define CONFIG_ARCH_ARM
+#include "barriers.h"
+static inline void dmb(void) {}
+static inline void dsb(void) {}
+
+#include "network/ethd.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define TX_SIZE   8
+#define MAX_SENT  64
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _eth_desc tx_desc[TX_SIZE];
+
+static uint8_t tx_buffer[TX_SIZE * ETH_TX_UNITSIZE];
+
+static ethd_callback_t tx_callbacks[TX_SIZE];
+
+static struct _ethd ethd;
+
+static struct {
+	uint16_t idx;            /**< next descriptor read by the MAC */
+	bool cleaned[TX_SIZE];   /**< zero-copy buffer cleaned from cache */
+	uint32_t frames;         /**< frames put on the wire */
+	uint8_t wire[MAX_SENT][ETH_MAX_FRAME_LENGTH];
+	uint32_t wire_len[MAX_SENT];
+	uint32_t completed;      /**< TX callbacks invoked */
+} mac;
+
+/** Frames with their buffers, in sending order */
+static uint8_t frame_data[MAX_SENT][4][256] CACHE_ALIGNED;
+
+/*---------------------------------------------------------------------- */
+/*         Simulated MAC                                                 */
+/*---------------------------------------------------------------------- */
+
+void cache_clean_region(const void *start, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < TX_SIZE; i++)
+		if (tx_desc[i].addr == (uint32_t)(uintptr_t)start)
+			mac.cleaned[i] = true;
+}
+
+void cache_invalidate_region(void *start, uint32_t length)
+{
+}
+
+static void _sim_start_transmission(void *eth)
+{
+}
+
+static const struct _ethd_op sim_op = {
+	.start_transmission = _sim_start_transmission,
+};
+
+static void _sim_tx_callback(uint8_t queue, uint32_t status)
+{
+	mac.completed++;
+}
+
+/**
+ * \brief Transmit up to max frames from the ring: concatenate their buffers
+ * and set the USED bit of their first descriptor only.
+ */
+static void _sim_transmit(uint32_t max)
+{
+	struct _ethd_queue *q = &ethd.queues[0];
+
+	while (max-- && (tx_desc[mac.idx].status & ETH_TX_STATUS_USED) == 0) {
+		uint16_t first = mac.idx;
+		uint32_t len = 0, status;
+
+		do {
+			struct _eth_desc *desc = &tx_desc[mac.idx];
+			uint32_t size = desc->status & ETH_RX_STATUS_LENGTH_MASK;
+
+			status = desc->status;
+			/* Zero-copy buffers must have been cleaned, copy
+			 * buffers are the ring own buffers */
+			if (desc->addr != (uint32_t)(uintptr_t)q->tx_buffer +
+					mac.idx * ETH_TX_UNITSIZE)
+				CHECK(mac.cleaned[mac.idx]);
+			mac.cleaned[mac.idx] = false;
+			CHECK(len + size <= ETH_MAX_FRAME_LENGTH);
+			memcpy(&mac.wire[mac.frames][len],
+					(void*)(uintptr_t)desc->addr, size);
+			len += size;
+			if (status & ETH_TX_STATUS_WRAP)
+				mac.idx = 0;
+			else
+				mac.idx++;
+			CHECK(mac.idx < TX_SIZE);
+		} while ((status & ETH_TX_STATUS_LASTBUF) == 0);
+
+		mac.wire_len[mac.frames++] = len;
+		tx_desc[first].status |= ETH_TX_STATUS_USED;
+	}
+}
+
+/**
+ * \brief Process sent frames as the GMAC driver TX complete handler does
+ */
+static void _sim_tx_complete(void)
+{
+	struct _ethd_queue *q = &ethd.queues[0];
+	struct _eth_desc *desc;
+
+	while (!RING_EMPTY(q->tx_head, q->tx_tail)) {
+		desc = &q->tx_desc[q->tx_tail];
+		if ((desc->status & ETH_TX_STATUS_USED) == 0)
+			break;
+		while ((desc->status & ETH_TX_STATUS_LASTBUF) == 0) {
+			RING_INC(q->tx_tail, q->tx_size);
+			desc = &q->tx_desc[q->tx_tail];
+		}
+		if (q->tx_callbacks[q->tx_tail])
+			q->tx_callbacks[q->tx_tail](0, 0);
+		RING_INC(q->tx_tail, q->tx_size);
+	}
+}
+
+/** Set up an empty ring, as gmacd_setup_queue() does */
+static void _sim_reset(void)
+{
+	struct _ethd_queue *q = &ethd.queues[0];
+	uint32_t i;
+
+	memset(&ethd, 0, sizeof(ethd));
+	memset(&mac, 0, sizeof(mac));
+	ethd.op = &sim_op;
+	for (i = 0; i < TX_SIZE; i++) {
+		tx_desc[i].addr = (uint32_t)(uintptr_t)&tx_buffer[i * ETH_TX_UNITSIZE];
+		tx_desc[i].status = ETH_TX_STATUS_USED;
+	}
+	tx_desc[TX_SIZE - 1].status |= ETH_TX_STATUS_WRAP;
+	q->tx_buffer = tx_buffer;
+	q->tx_desc = tx_desc;
+	q->tx_size = TX_SIZE;
+	q->tx_callbacks = tx_callbacks;
+	RING_CLEAR(q->tx_head, q->tx_tail);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+/** Fill frame n with count buffers and send it */
+static uint8_t _send(uint32_t n, uint32_t count, bool zero_copy)
+{
+	struct _eth_sg sg[4];
+	struct _eth_sg_list sgl = { .size = count, .entries = sg };
+	uint32_t i, j;
+
+	for (i = 0; i < count; i++) {
+		sg[i].size = 60 + (n * 7 + i * 13) % 180;
+		sg[i].buffer = frame_data[n][i];
+		sg[i].next = NULL;
+		for (j = 0; j < sg[i].size; j++)
+			frame_data[n][i][j] = n ^ (i << 4) ^ j;
+	}
+	if (zero_copy)
+		return ethd_send_sg_zero_copy(&ethd, 0, &sgl, _sim_tx_callback);
+	else
+		return ethd_send_sg(&ethd, 0, &sgl, _sim_tx_callback);
+}
+
+/** Check that frame n reached the wire with its count buffers */
+static bool _on_wire(uint32_t n, uint32_t wire, uint32_t count)
+{
+	uint32_t i, len = 0, size;
+
+	for (i = 0; i < count; i++) {
+		size = 60 + (n * 7 + i * 13) % 180;
+		if (memcmp(&mac.wire[wire][len], frame_data[n][i], size))
+			return false;
+		len += size;
+	}
+	return mac.wire_len[wire] == len;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_zero_copy_points_at_buffers(void)
+{
+	_sim_reset();
+	CHECK(_send(0, 3, true) == ETH_OK);
+	CHECK(tx_desc[0].addr == (uint32_t)(uintptr_t)frame_data[0][0]);
+	CHECK(tx_desc[1].addr == (uint32_t)(uintptr_t)frame_data[0][1]);
+	CHECK(tx_desc[2].addr == (uint32_t)(uintptr_t)frame_data[0][2]);
+	CHECK(tx_desc[2].status & ETH_TX_STATUS_LASTBUF);
+
+	/* Buffers stay loaned until the frame is sent */
+	_sim_tx_complete();
+	CHECK(mac.completed == 0);
+	_sim_transmit(1);
+	_sim_tx_complete();
+	CHECK(mac.completed == 1);
+	CHECK(mac.frames == 1 && _on_wire(0, 0, 3));
+}
+
+static void test_callbacks_in_order(void)
+{
+	uint32_t n;
+
+	_sim_reset();
+	for (n = 0; n < 3; n++)
+		CHECK(_send(n, 2, true) == ETH_OK);
+	/* 6 of 8 descriptors used, the ring keeps one free */
+	CHECK(_send(3, 2, true) == ETH_TX_BUSY);
+
+	_sim_transmit(2);
+	_sim_tx_complete();
+	CHECK(mac.completed == 2);
+	CHECK(_send(3, 2, true) == ETH_OK);
+	_sim_transmit(MAX_SENT);
+	_sim_tx_complete();
+	CHECK(mac.completed == 4);
+	for (n = 0; n < 4; n++)
+		CHECK(_on_wire(n, n, 2));
+}
+
+static void test_mixed_modes_wrap(void)
+{
+	uint32_t n, count;
+	uint16_t last;
+
+	_sim_reset();
+	for (n = 0; n < MAX_SENT; n++) {
+		count = 1 + n % 4;
+		CHECK(_send(n, count, n % 3 != 0) == ETH_OK);
+		/* Copy frames use the ring own buffers again, after zero-copy
+		 * frames moved the descriptors away from them */
+		last = ethd.queues[0].tx_head;
+		RING_DEC(last, TX_SIZE);
+		if (n % 3 == 0)
+			CHECK(tx_desc[last].addr == (uint32_t)(uintptr_t)
+					&tx_buffer[last * ETH_TX_UNITSIZE]);
+		else
+			CHECK(tx_desc[last].addr == (uint32_t)(uintptr_t)
+					frame_data[n][count - 1]);
+		_sim_transmit(1);
+		_sim_tx_complete();
+	}
+	CHECK(mac.frames == MAX_SENT);
+	CHECK(mac.completed == MAX_SENT);
+	for (n = 0; n < MAX_SENT; n++)
+		CHECK(_on_wire(n, n, 1 + n % 4));
+}
+
+static void test_rejects_misaligned(void)
+{
+	struct _eth_sg sg = {
+		.size = 64,
+		.buffer = &frame_data[0][0][4],
+	};
+	struct _eth_sg_list sgl = { .size = 1, .entries = &sg };
+
+	_sim_reset();
+	CHECK(ethd_send_sg_zero_copy(&ethd, 0, &sgl, _sim_tx_callback) == ETH_PARAM);
+	CHECK(ethd.queues[0].tx_head == 0);
+	CHECK(tx_desc[0].status & ETH_TX_STATUS_USED);
+
+	/* Copy mode has no alignment constraint */
+	CHECK(ethd_send_sg(&ethd, 0, &sgl, _sim_tx_callback) == ETH_OK);
+	CHECK(tx_desc[0].addr == (uint32_t)(uintptr_t)tx_buffer);
+}
+
+static void test_zero_copy_needs_callback(void)
+{
+	struct _eth_sg sg = {
+		.size = 64,
+		.buffer = frame_data[0][0],
+	};
+	struct _eth_sg_list sgl = { .size = 1, .entries = &sg };
+
+	_sim_reset();
+	CHECK(ethd_send_sg_zero_copy(&ethd, 0, &sgl, NULL) == ETH_PARAM);
+	ethd.queues[0].tx_callbacks = NULL;
+	CHECK(ethd_send_sg_zero_copy(&ethd, 0, &sgl, _sim_tx_callback) == ETH_PARAM);
+	CHECK(ethd.queues[0].tx_head == 0);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_zero_copy_points_at_buffers);
+	RUN_TEST(test_callbacks_in_order);
+	RUN_TEST(test_mixed_modes_wrap);
+	RUN_TEST(test_rejects_misaligned);
+	RUN_TEST(test_zero_copy_needs_callback);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,362 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Per-write latency of a data logger appending records to a file on a
+ * fragmented FAT volume, with f_write() and with the streaming writer of
+ * ff_stream.c, over a simulated SD card.
+ *
+ * The card is a RAM disk where each disk_read()/disk_write() request costs
+ * a fixed time plus a time per sector. A write that does not start where the
+ * previous one ended costs an extra penalty, as SD cards rewrite part of an
+ * allocation unit for small random writes such as FAT and directory updates.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fatfs/src/ff.h"
+#include "fatfs/src/diskio.h"
+#include "fatfs/src/ff_stream.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SECTOR_SIZE  512
+#define RAM_SECTORS  (64 * 1024 * 1024 / SECTOR_SIZE)
+#define FRAG_SIZE    (8 * 1024 * 1024)
+#define FILE_SIZE    (4 * 1024 * 1024)
+#define EXTENT_SIZE  (FILE_SIZE + 1024 * 1024)
+#define RECORD_SIZE  1000
+
+/* Latency model */
+#define REQUEST_US   100.0
+#define SECTOR_US    25.6
+#define RANDOM_US    2000.0
+
+/* Latency of the writes of a run */
+struct _latency {
+	uint32_t writes;
+	uint32_t slow;     /**< number of writes longer than 1 ms */
+	double total_us;
+	double max_us;
+	double open_us;
+	double close_us;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t *ram;
+
+/** Simulated time, in microseconds */
+static double now_us;
+
+/** Sector following the last write */
+static DWORD next_write;
+
+static FATFS fs;
+
+static FIL file;
+
+static struct _ff_stream stream;
+
+static uint8_t record[RECORD_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         Simulated card                                                */
+/*---------------------------------------------------------------------- */
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+	return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+	return pdrv == 0 ? 0 : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+	if (sector + count > RAM_SECTORS)
+		return RES_PARERR;
+	now_us += REQUEST_US + count * SECTOR_US;
+	memcpy(buff, ram + sector * SECTOR_SIZE, count * SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+	if (sector + count > RAM_SECTORS)
+		return RES_PARERR;
+	now_us += REQUEST_US + count * SECTOR_US;
+	if (sector != next_write)
+		now_us += RANDOM_US;
+	next_write = sector + count;
+	memcpy(ram + sector * SECTOR_SIZE, buff, count * SECTOR_SIZE);
+	return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff)
+{
+	switch (cmd) {
+	case CTRL_SYNC:
+	case CTRL_TRIM:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD*)buff = RAM_SECTORS;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD*)buff = SECTOR_SIZE;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD*)buff = 1;
+		return RES_OK;
+	default:
+		return RES_PARERR;
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _fill_record(uint32_t offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < RECORD_SIZE; i++)
+		record[i] = (offset + i) * 7 + ((offset + i) >> 11);
+}
+
+static void _account(struct _latency *lat, double start_us)
+{
+	double us = now_us - start_us;
+
+	lat->writes++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+	if (us > 1000.0)
+		lat->slow++;
+}
+
+static void _report(const char *name, const struct _latency *lat)
+{
+	printf("%-10s %7u %10.1f %10.1f %8u %10.1f %10.1f\n", name,
+			lat->writes, lat->total_us / lat->writes, lat->max_us,
+			lat->slow, lat->open_us / 1000.0, lat->close_us / 1000.0);
+}
+
+/* Fill the start of the volume with one cluster files and remove every
+ * other one: the free space below FRAG_SIZE is made of single cluster
+ * holes */
+static int _fragment(void)
+{
+	char path[32];
+	uint32_t csz = fs.csize * SECTOR_SIZE;
+	uint32_t i, count = FRAG_SIZE / csz;
+	UINT len;
+
+	if (f_mkdir("0:frag") != FR_OK)
+		return -1;
+	memset(record, 0xa5, sizeof(record));
+	for (i = 0; i < count; i++) {
+		snprintf(path, sizeof(path), "0:frag/%05u", i);
+		if (f_open(&file, path, FA_CREATE_NEW | FA_WRITE) != FR_OK ||
+		    f_write(&file, record, 1, &len) != FR_OK ||
+		    f_close(&file) != FR_OK)
+			return -1;
+	}
+	for (i = 0; i < count; i += 2) {
+		snprintf(path, sizeof(path), "0:frag/%05u", i);
+		if (f_unlink(path) != FR_OK)
+			return -1;
+	}
+	return 0;
+}
+
+static int _verify(const char *path)
+{
+	static uint8_t data[RECORD_SIZE];
+	uint32_t offset, size;
+	UINT len;
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return -1;
+	if (f_size(&file) != FILE_SIZE)
+		return -1;
+	for (offset = 0; offset < FILE_SIZE; offset += RECORD_SIZE) {
+		size = FILE_SIZE - offset < RECORD_SIZE ? FILE_SIZE - offset : RECORD_SIZE;
+		if (f_read(&file, data, size, &len) != FR_OK || len != size)
+			return -1;
+		_fill_record(offset);
+		if (memcmp(data, record, size))
+			return -1;
+	}
+	return f_close(&file) == FR_OK ? 0 : -1;
+}
+
+static int _log_f_write(struct _latency *lat)
+{
+	uint32_t offset, size;
+	double start;
+	UINT len;
+
+	start = now_us;
+	if (f_open(&file, "0:log.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return -1;
+	lat->open_us = now_us - start;
+
+	for (offset = 0; offset < FILE_SIZE; offset += RECORD_SIZE) {
+		size = FILE_SIZE - offset < RECORD_SIZE ? FILE_SIZE - offset : RECORD_SIZE;
+		_fill_record(offset);
+		start = now_us;
+		if (f_write(&file, record, size, &len) != FR_OK || len != size)
+			return -1;
+		_account(lat, start);
+	}
+
+	start = now_us;
+	if (f_close(&file) != FR_OK)
+		return -1;
+	lat->close_us = now_us - start;
+	return 0;
+}
+
+static int _log_stream(struct _latency *lat)
+{
+	uint32_t offset, size;
+	double start;
+	UINT len;
+
+	start = now_us;
+	if (f_open(&file, "0:stream.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK ||
+	    ff_stream_open(&stream, &file, EXTENT_SIZE) != FR_OK)
+		return -1;
+	lat->open_us = now_us - start;
+
+	for (offset = 0; offset < FILE_SIZE; offset += RECORD_SIZE) {
+		size = FILE_SIZE - offset < RECORD_SIZE ? FILE_SIZE - offset : RECORD_SIZE;
+		_fill_record(offset);
+		start = now_us;
+		if (ff_stream_write(&stream, record, size, &len) != FR_OK || len != size)
+			return -1;
+		_account(lat, start);
+	}
+
+	start = now_us;
+	if (ff_stream_close(&stream) != FR_OK)
+		return -1;
+	lat->close_us = now_us - start;
+	return 0;
+}
+
+static int _free_clusters(DWORD *nclst)
+{
+	FATFS *pfs;
+
+	return f_getfree("0:", nclst, &pfs) == FR_OK ? 0 : -1;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	struct _latency f_write_lat, stream_lat;
+	DWORD free_before, free_after, free_scanned, ncl;
+
+	memset(&f_write_lat, 0, sizeof(f_write_lat));
+	memset(&stream_lat, 0, sizeof(stream_lat));
+
+	ram = calloc(RAM_SECTORS, SECTOR_SIZE);
+
+	/* Register the work area of f_mkfs(), format without partition table
+	 * and with the default cluster size, then fragment the volume and mount
+	 * it again: FatFs allocates from the start of the FAT after a mount */
+	if (f_mount(&fs, "0:", 0) != FR_OK || f_mkfs("0:", 1, 0) != FR_OK ||
+	    f_mount(&fs, "0:", 1) != FR_OK || _fragment() != 0 ||
+	    f_mount(&fs, "0:", 1) != FR_OK) {
+		printf("Cannot prepare the RAM volume\n");
+		return 1;
+	}
+
+	printf("%u bytes logged in %u byte records, %u KiB of the volume "
+			"fragmented in %u byte holes\n", FILE_SIZE, RECORD_SIZE,
+			FRAG_SIZE / 1024, fs.csize * SECTOR_SIZE);
+	printf("%-10s %7s %10s %10s %8s %10s %10s\n", "", "writes",
+			"mean (us)", "max (us)", "> 1 ms", "open (ms)", "close (ms)");
+
+	if (_log_f_write(&f_write_lat) != 0 || _verify("0:log.bin") != 0) {
+		printf("f_write run failed\n");
+		return 1;
+	}
+	_report("f_write", &f_write_lat);
+
+	/* Give the holes back, the stream reserves its extent past them */
+	if (f_unlink("0:log.bin") != FR_OK || _free_clusters(&free_before) != 0)
+		return 1;
+
+	if (_log_stream(&stream_lat) != 0 || _verify("0:stream.bin") != 0) {
+		printf("ff_stream run failed\n");
+		return 1;
+	}
+	_report("ff_stream", &stream_lat);
+
+	/* The tail of the extent is released, and the free cluster count kept
+	 * by FatFs matches the one found by a scan of the FAT */
+	ncl = (FILE_SIZE + fs.csize * SECTOR_SIZE - 1) / (fs.csize * SECTOR_SIZE);
+	if (_free_clusters(&free_after) != 0 ||
+	    f_mount(&fs, "0:", 1) != FR_OK ||
+	    _free_clusters(&free_scanned) != 0 ||
+	    free_after != free_before - ncl || free_scanned != free_after) {
+		printf("Free clusters: %lu before, %lu after, %lu scanned, "
+				"%lu expected\n", (unsigned long)free_before,
+				(unsigned long)free_after,
+				(unsigned long)free_scanned,
+				(unsigned long)(free_before - ncl));
+		return 1;
+	}
+
+	free(ram);
+	return 0;
+}
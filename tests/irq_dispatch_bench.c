@@ -0,0 +1,257 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Interrupt handlers of the XDMAC and DMAC drivers (dma_irq_handler) and of
+ * the MCAN dedicated RX buffers (_mcand_rx_buffer_handler), run against the
+ * simulated status registers of irq_sim.h. The registers flag few channels
+ * or buffers (sparse), all of them (dense), or only the highest one. Every
+ * pattern is replayed once to check that each flagged channel or buffer is
+ * handled exactly once, then timed. The time to set and clear the
+ * registers is measured apart and subtracted. Absolute numbers only compare
+ * implementations on the same host: they say nothing of the Cortex-A5/M7
+ * targets.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "intmath.h"
+#include "irq/irq.h"
+#include "peripherals/pmc.h"
+
+#include "irq_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/* Simulated status values per pattern, and timed passes over them */
+#define STATUSES 4096
+#define PASSES   200
+
+/* Most channels or buffers of a model, NDAT1 and NDAT2 of the MCAN */
+#define MAX_COUNT 64
+
+enum _pattern {
+	PATTERN_SPARSE,
+	PATTERN_DENSE,
+	PATTERN_HIGH,
+};
+
+struct _status {
+	uint32_t word[2];
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static const char *pattern_names[] = {
+	[PATTERN_SPARSE] = "sparse",
+	[PATTERN_DENSE] = "dense",
+	[PATTERN_HIGH] = "single high bit",
+};
+
+static const struct _irq_sim *sims[] = {
+	&irq_sim_xdmac,
+	&irq_sim_dmac,
+	&irq_sim_mcan,
+};
+
+static struct _status statuses[STATUSES];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Set bit index of a status made of 32-bit words */
+static void _set(struct _status *st, uint32_t index)
+{
+	st->word[index / 32] |= 1u << (index % 32);
+}
+
+static void _fill(enum _pattern pattern, uint32_t count)
+{
+	uint32_t i, j, bits;
+
+	srand(1);
+	for (i = 0; i < STATUSES; i++) {
+		struct _status *st = &statuses[i];
+
+		st->word[0] = st->word[1] = 0;
+		switch (pattern) {
+		case PATTERN_SPARSE:
+			/* 1 to 3 pending bits */
+			bits = 1 + rand() % 3;
+			for (j = 0; j < bits; j++)
+				_set(st, rand() % count);
+			break;
+		case PATTERN_DENSE:
+			for (j = 0; j < count; j++)
+				_set(st, j);
+			break;
+		case PATTERN_HIGH:
+			_set(st, count - 1);
+			break;
+		}
+	}
+}
+
+/* Raise the channels or buffers flagged by a status */
+static void _raise(const struct _irq_sim *sim, const struct _status *st)
+{
+	uint32_t w, bits;
+
+	for (w = 0; w < ARRAY_SIZE(st->word); w++) {
+		bits = st->word[w];
+		while (bits)
+			sim->raise(32 * w + pop_lsb_u32(&bits));
+	}
+}
+
+/* Replay the statuses once, checking after each interrupt that the driver
+ * handled every flagged channel or buffer once, and no other */
+static int _check(const struct _irq_sim *sim)
+{
+	uint32_t handled[MAX_COUNT];
+	uint32_t i, index, expected;
+	int errors = 0;
+
+	sim->reset();
+	for (i = 0; i < STATUSES; i++) {
+		const struct _status *st = &statuses[i];
+
+		memset(handled, 0, sizeof(handled));
+		_raise(sim, st);
+		sim->handle();
+		sim->collect(handled);
+		for (index = 0; index < sim->count; index++) {
+			expected = (st->word[index / 32] >> (index % 32)) & 1;
+			if (handled[index] != expected) {
+				if (errors++ < 4)
+					printf("%s: status %08x %08x, "
+					       "index %u handled %u times\n",
+					       sim->name, st->word[1],
+					       st->word[0], index,
+					       handled[index]);
+			}
+		}
+	}
+
+	return errors;
+}
+
+static double _time(const struct _irq_sim *sim, void (*done)(void))
+{
+	double start, elapsed;
+	uint32_t pass, i;
+
+	sim->reset();
+	start = _now();
+	for (pass = 0; pass < PASSES; pass++) {
+		for (i = 0; i < STATUSES; i++) {
+			_raise(sim, &statuses[i]);
+			done();
+		}
+	}
+	elapsed = _now() - start;
+
+	return elapsed * 1e9 / ((double)PASSES * STATUSES);
+}
+
+static int _bench(const struct _irq_sim *sim)
+{
+	uint32_t p;
+	double ns_regs, ns_handler;
+	int errors = 0, pattern_errors;
+
+	for (p = 0; p < ARRAY_SIZE(pattern_names); p++) {
+		_fill(p, sim->count);
+		pattern_errors = _check(sim);
+		ns_regs = _time(sim, sim->clear);
+		ns_handler = _time(sim, sim->handle);
+		printf("%-6s %-16s %8.1f %8.1f %s\n", sim->name,
+		       pattern_names[p], ns_regs, ns_handler - ns_regs,
+		       pattern_errors ? "FAIL" : "ok");
+		errors += pattern_errors;
+	}
+
+	return errors;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+void irq_add_handler(uint32_t source, irq_handler_t handler, void* user_arg)
+{
+}
+
+void irq_enable(uint32_t source)
+{
+}
+
+void pmc_configure_peripheral(uint32_t id, const struct _pmc_periph_cfg* cfg,
+			      bool enable)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	uint32_t i;
+	int errors = 0;
+
+	printf("ns per interrupt       registers  handler  once\n");
+	for (i = 0; i < ARRAY_SIZE(sims); i++)
+		errors += _bench(sims[i]);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Simulated status registers for the interrupt handlers of the XDMAC and
+ * DMAC drivers (dma_irq_handler) and of the MCAN driver (dedicated RX
+ * buffers, _mcand_rx_buffer_handler). Each model includes its driver source
+ * and builds for its own SoC; the handlers run unchanged against register
+ * blocks in host memory.
+ */
+
+#ifndef IRQ_SIM_H
+#define IRQ_SIM_H
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+
+/*---------------------------------------------------------------------- */
+/*         Definitions                                                   */
+/*---------------------------------------------------------------------- */
+
+/** Status registers are read-only to the drivers, not to the models */
+#define SIM_REG(reg) (*(volatile uint32_t*)&(reg))
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+struct _irq_sim {
+	const char *name;
+	uint32_t count;  /**< Channels or RX buffers of the controller */
+
+	/** Reset the registers and the driver state, every channel or buffer
+	 * in use */
+	void (*reset)(void);
+
+	/** Set the status bits of a channel or buffer, as the hardware does
+	 * when its transfer ends */
+	void (*raise)(uint32_t index);
+
+	/** Clear the status bits raised, as reading or acknowledging them
+	 * does on the hardware */
+	void (*clear)(void);
+
+	/** Run the interrupt handler of the driver, then clear() */
+	void (*handle)(void);
+
+	/** Add to handled[] the channels or buffers completed by the driver
+	 * since the last call, and make them ready to complete again */
+	void (*collect)(uint32_t *handled);
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+extern const struct _irq_sim irq_sim_xdmac;
+extern const struct _irq_sim irq_sim_dmac;
+extern const struct _irq_sim irq_sim_mcan;
+
+#endif /* IRQ_SIM_H */
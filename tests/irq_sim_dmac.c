@@ -0,0 +1,153 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * DMAC model for irq_dispatch_bench, built for the SAMA5D3: dmac.c and
+ * dma_dmac.c are included, with DMAC0 pointing to a register block in host
+ * memory. The driver entry points are renamed so that the model links next
+ * to the XDMAC one. A channel completes when its chained buffer transfer
+ * ends (BTC and CBTC in EBCISR).
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "chip.h"
+
+static Dmac regs;
+
+#undef DMAC0
+#define DMAC0 (&regs)
+
+#define dma_prepare_channel dmac_sim_prepare_channel
+#define dma_irq_handler dmac_sim_irq_handler
+
+#include "dma/dmac.c"
+#include "dma/dma_dmac.c"
+
+#include "irq_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define EBCISR_CHANNEL(chan) \
+	((DMAC_EBCISR_BTC0 | DMAC_EBCISR_CBTC0) << (chan))
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _dma_controller ctrl;
+
+/* Callbacks run per channel since the last collect */
+static uint32_t done[DMA_CHANNELS];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static int _done(void* arg, void* arg2)
+{
+	done[(uintptr_t)arg]++;
+	return 0;
+}
+
+static void _reset(void)
+{
+	uint32_t i;
+
+	memset(&regs, 0, sizeof(regs));
+	memset(&ctrl, 0, sizeof(ctrl));
+	memset(done, 0, sizeof(done));
+	ctrl.hw = DMAC0;
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		ctrl.channels[i].hw = DMAC0;
+		ctrl.channels[i].id = i;
+		ctrl.channels[i].state = DMA_STATE_STARTED;
+		callback_set(&ctrl.channels[i].callback, _done,
+			     (void*)(uintptr_t)i);
+	}
+}
+
+static void _raise(uint32_t index)
+{
+	SIM_REG(regs.DMAC_EBCISR) |= EBCISR_CHANNEL(index);
+}
+
+static void _clear(void)
+{
+	/* EBCISR clears on read */
+	SIM_REG(regs.DMAC_EBCISR) = 0;
+}
+
+static void _handle(void)
+{
+	dma_irq_handler(ID_DMAC0, &ctrl);
+	_clear();
+}
+
+static void _collect(uint32_t* handled)
+{
+	uint32_t i;
+
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		handled[i] += done[i];
+		done[i] = 0;
+		ctrl.channels[i].state = DMA_STATE_STARTED;
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+const struct _irq_sim irq_sim_dmac = {
+	.name = "DMAC",
+	.count = DMA_CHANNELS,
+	.reset = _reset,
+	.raise = _raise,
+	.clear = _clear,
+	.handle = _handle,
+	.collect = _collect,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+uint32_t get_dmac_id_from_addr(const Dmac* addr)
+{
+	return ID_DMAC0;
+}
@@ -0,0 +1,240 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * MCAN model for irq_dispatch_bench: mcand.c is included to reach the
+ * handler of the dedicated RX buffers. A buffer completes when its bit is
+ * set in NDAT1 or NDAT2; the driver then copies the frame, flags the
+ * application buffer with CAND_BUF_ATTR_TRANSFER_DONE, releases the Message
+ * RAM element and drops the callback of the element, once per frame.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stddef.h>
+
+/* The driver orders its accesses to the Message RAM; the host needs no
+ * barrier */
+#define CONFIG_ARCH_ARM
+#include "barriers.h"
+static inline void dmb(void) {}
+static inline void dsb(void) {}
+
+/* Count the callbacks dropped per element */
+#define callback_copy mcan_sim_callback_copy
+
+#include "can/mcand.c"
+
+#undef callback_copy
+extern void callback_copy(struct _callback* cb, struct _callback* orig);
+
+#include "irq_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/* Dedicated RX buffers, the most NDAT1 and NDAT2 can flag */
+#define RX_BUFFERS 64
+
+/* Data field of the RX buffer elements, in bytes */
+#define RX_DATA_SIZE 8
+
+#define RX_ELEMENT_SIZE (MCAN_RAM_BUF_HDR_SIZE + RX_DATA_SIZE / 4)
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static Mcan regs;
+
+static struct _mcan_desc desc;
+
+static struct _cand_ram_item items[RX_BUFFERS];
+
+static struct _buffer bufs[RX_BUFFERS];
+
+static uint8_t data[RX_BUFFERS][RX_DATA_SIZE];
+
+static uint32_t ram_rx[RX_BUFFERS * RX_ELEMENT_SIZE];
+
+/* Callbacks dropped per element since the last collect */
+static uint32_t dropped[RX_BUFFERS];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _reset(void)
+{
+	uint32_t i, *element;
+
+	memset(&regs, 0, sizeof(regs));
+	memset(&desc, 0, sizeof(desc));
+	memset(dropped, 0, sizeof(dropped));
+	desc.addr = &regs;
+	desc.ram_item = items;
+	desc.set.cfg.item_count[MCAN_RAM_RX_BUFFER] = RX_BUFFERS;
+	desc.set.cfg.ram_index[MCAN_RAM_RX_BUFFER] = 0;
+	desc.set.cfg.buf_size_rx = RX_DATA_SIZE;
+	desc.set.ram_array_rx = ram_rx;
+
+	for (i = 0; i < RX_BUFFERS; i++) {
+		/* Frames accepted without a filter, so that the driver
+		 * releases none */
+		element = &ram_rx[i * RX_ELEMENT_SIZE];
+		element[0] = MCAN_RAM_R0_STDID(i);
+		element[1] = MCAN_RAM_R1_DLC(CAN_DLC_8) | MCAN_RAM_R1_ANMF;
+		memset(&element[MCAN_RAM_BUF_HDR_SIZE], i, RX_DATA_SIZE);
+
+		bufs[i].data = data[i];
+		bufs[i].size = RX_DATA_SIZE;
+		bufs[i].attr = CAND_BUF_ATTR_RX;
+		items[i].buf = &bufs[i];
+	}
+}
+
+static void _raise(uint32_t index)
+{
+	/* mcand_transfer() holds the element until the frame is received */
+	desc.set.cfg.ram_status[MCAN_RAM_RX_BUFFER + index / 32] |=
+		1u << (index % 32);
+	if (index < 32)
+		regs.MCAN_NDAT1 |= 1u << index;
+	else
+		regs.MCAN_NDAT2 |= 1u << (index - 32);
+}
+
+static void _clear(void)
+{
+	/* The driver writes the flags back to NDATx; ones clear them */
+	regs.MCAN_NDAT1 = 0;
+	regs.MCAN_NDAT2 = 0;
+}
+
+static void _handle(void)
+{
+	_mcand_rx_buffer_handler(&desc);
+	_clear();
+}
+
+static void _collect(uint32_t* handled)
+{
+	uint32_t i;
+	const uint32_t *status = &desc.set.cfg.ram_status[MCAN_RAM_RX_BUFFER];
+
+	for (i = 0; i < RX_BUFFERS; i++) {
+		if (!dropped[i])
+			continue;
+		/* The frame is copied and the element released */
+		if ((bufs[i].attr & CAND_BUF_ATTR_TRANSFER_DONE) &&
+		    !(status[i / 32] & (1u << (i % 32))) &&
+		    bufs[i].size == RX_DATA_SIZE && data[i][0] == (uint8_t)i)
+			handled[i] += dropped[i];
+		dropped[i] = 0;
+		bufs[i].attr &= ~CAND_BUF_ATTR_TRANSFER_DONE;
+		memset(data[i], 0xff, RX_DATA_SIZE);
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+const struct _irq_sim irq_sim_mcan = {
+	.name = "MCAN",
+	.count = RX_BUFFERS,
+	.reset = _reset,
+	.raise = _raise,
+	.clear = _clear,
+	.handle = _handle,
+	.collect = _collect,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+void mcan_sim_callback_copy(struct _callback* cb, struct _callback* orig)
+{
+	struct _cand_ram_item* item;
+
+	item = (struct _cand_ram_item*)((uint8_t*)cb -
+			offsetof(struct _cand_ram_item, cb));
+	if (!orig && item >= items && item < items + RX_BUFFERS)
+		dropped[item - items]++;
+	callback_copy(cb, orig);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+uint32_t get_mcan_id_from_addr(const Mcan* addr, uint8_t int_idx)
+{
+	return ID_MCAN0_INT0;
+}
+
+uint32_t pmc_get_gck_clock(uint32_t id)
+{
+	return 0;
+}
+
+void mcan_reconfigure(Mcan *mcan)
+{
+}
+
+void mcan_disable(Mcan *mcan)
+{
+}
+
+enum can_mode mcan_get_mode(Mcan *mcan)
+{
+	return CAN_MODE_CAN;
+}
+
+bool mcan_get_length_code(uint8_t len, enum mcan_dlc *dlc)
+{
+	return false;
+}
+
+bool mcan_set_rx_element_size(Mcan *mcan, uint8_t buf, uint8_t fifo0,
+			      uint8_t fifo1)
+{
+	return true;
+}
+
+bool mcan_set_tx_element_size(Mcan *mcan, uint8_t buf)
+{
+	return true;
+}
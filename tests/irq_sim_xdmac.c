@@ -0,0 +1,141 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * XDMAC model for irq_dispatch_bench: dma_xdmac.c is included to reach its
+ * interrupt handler, and xdmac.c reads a register block in host memory. A
+ * channel completes when its linked list ends (LIS and BIS in CIS) while the
+ * channel is disabled in GS.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "dma/dma_xdmac.c"
+
+#include "irq_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static Xdmac regs;
+
+static struct _dma_controller ctrl;
+
+/* Callbacks run per channel since the last collect */
+static uint32_t done[DMA_CHANNELS];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static int _done(void* arg, void* arg2)
+{
+	done[(uintptr_t)arg]++;
+	return 0;
+}
+
+static void _reset(void)
+{
+	uint32_t i;
+
+	memset(&regs, 0, sizeof(regs));
+	memset(&ctrl, 0, sizeof(ctrl));
+	memset(done, 0, sizeof(done));
+	ctrl.hw = &regs;
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		ctrl.channels[i].hw = &regs;
+		ctrl.channels[i].id = i;
+		ctrl.channels[i].state = DMA_STATE_STARTED;
+		callback_set(&ctrl.channels[i].callback, _done,
+			     (void*)(uintptr_t)i);
+	}
+}
+
+static void _raise(uint32_t index)
+{
+	SIM_REG(regs.XDMAC_GIS) |= 1u << index;
+	SIM_REG(regs.XDMAC_CH[index].XDMAC_CIS) |= XDMAC_CIS_BIS | XDMAC_CIS_LIS;
+}
+
+static void _clear(void)
+{
+	uint32_t gis = regs.XDMAC_GIS;
+
+	/* GIS follows the CIS registers, which clear on read */
+	while (gis)
+		SIM_REG(regs.XDMAC_CH[pop_lsb_u32(&gis)].XDMAC_CIS) = 0;
+	SIM_REG(regs.XDMAC_GIS) = 0;
+}
+
+static void _handle(void)
+{
+	dma_irq_handler(ID_XDMAC0, &ctrl);
+	_clear();
+}
+
+static void _collect(uint32_t* handled)
+{
+	uint32_t i;
+
+	for (i = 0; i < DMA_CHANNELS; i++) {
+		handled[i] += done[i];
+		done[i] = 0;
+		ctrl.channels[i].state = DMA_STATE_STARTED;
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+const struct _irq_sim irq_sim_xdmac = {
+	.name = "XDMAC",
+	.count = DMA_CHANNELS,
+	.reset = _reset,
+	.raise = _raise,
+	.clear = _clear,
+	.handle = _handle,
+	.collect = _collect,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+uint32_t get_xdmac_id_from_addr(const Xdmac* addr)
+{
+	return ID_XDMAC0;
+}
@@ -0,0 +1,406 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Hit rate of the write-back block cache media (media_cache.c) on a FatFs
+ * workload, and the media accesses it saves.
+ *
+ * A FatFs workload (small files in directories, a log file synced after
+ * every few records, directory listings, reads and deletions) runs on
+ * media_ramdisk through media_ff, and the media requests it issues are
+ * recorded. The trace is then replayed on the ramdisk directly, then through
+ * caches of several sizes. Each replay ends with media_flush(), and the
+ * ramdisk contents are checked against those of the direct replay.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_cache.h"
+#include "libstoragemedia/media_ff.h"
+#include "libstoragemedia/media_private.h"
+#include "libstoragemedia/media_ramdisk.h"
+
+#include "fatfs/src/ff.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define BLOCK_SIZE   512
+#define RAM_BLOCKS   (16 * 1024 * 1024 / BLOCK_SIZE)
+
+#define DIRS         4
+#define FILES        24
+#define LOG_RECORDS  2000
+#define LOG_RECORD   200
+#define LOG_SYNC     20
+
+#define MAX_LINES    256
+
+/** Media request of the trace */
+struct _request {
+	bool write;
+	uint32_t address;
+	uint32_t length;
+};
+
+/** Requests and blocks that reached the ramdisk */
+struct _counters {
+	uint32_t requests;
+	uint32_t blocks;
+};
+
+/** Cache configuration */
+struct _config {
+	uint32_t lines;
+	uint32_t read_ahead;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static const struct _config configs[] = {
+	{ 16, 0 }, { 16, 4 },
+	{ 64, 0 }, { 64, 8 },
+	{ 256, 0 }, { 256, 8 },
+};
+
+/* media_ramdisk addresses its storage with 32-bit block numbers */
+static uint8_t *ram;
+
+static uint8_t *reference;
+
+static struct _media ramdisk;
+
+/* Counts the requests reaching the ramdisk, and records them */
+static struct _media probe;
+
+static struct _media cached;
+
+static struct _media_cache cache;
+
+static struct _media_cache_line lines[MAX_LINES];
+
+static uint8_t line_buffer[MAX_LINES * BLOCK_SIZE];
+
+static struct {
+	struct _request *requests;
+	uint32_t count;
+	uint32_t size;
+	bool recording;
+} trace;
+
+static struct _counters counters;
+
+static struct _media *ff_media;
+
+static FATFS fs;
+
+static FIL file;
+
+static uint8_t data[128 * BLOCK_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         Probe media                                                   */
+/*---------------------------------------------------------------------- */
+
+static void _record(bool write, uint32_t address, uint32_t length)
+{
+	counters.requests++;
+	counters.blocks += length;
+
+	if (!trace.recording)
+		return;
+	if (trace.count == trace.size) {
+		trace.size = trace.size ? 2 * trace.size : 1024;
+		trace.requests = realloc(trace.requests,
+				trace.size * sizeof(*trace.requests));
+	}
+	trace.requests[trace.count].write = write;
+	trace.requests[trace.count].address = address;
+	trace.requests[trace.count].length = length;
+	trace.count++;
+}
+
+static uint8_t _probe_read(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	_record(false, address, length);
+	return media_read(&ramdisk, address, buf, length, callback,
+			callback_arg);
+}
+
+static uint8_t _probe_write(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	_record(true, address, length);
+	return media_write(&ramdisk, address, buf, length, callback,
+			callback_arg);
+}
+
+bool media_ff_get_instance(uint8_t index, struct _media **holder)
+{
+	if (index != 0)
+		return false;
+	*holder = ff_media;
+	return true;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static bool _write_file(const char *path, uint32_t size, uint32_t chunk)
+{
+	uint32_t offset, count;
+	UINT len;
+
+	if (f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return false;
+	for (offset = 0; offset < size; offset += count) {
+		count = size - offset < chunk ? size - offset : chunk;
+		memset(data, offset / chunk, count);
+		if (f_write(&file, data, count, &len) != FR_OK || len != count)
+			return false;
+	}
+	return f_close(&file) == FR_OK;
+}
+
+static bool _read_file(const char *path)
+{
+	UINT len;
+
+	if (f_open(&file, path, FA_READ) != FR_OK)
+		return false;
+	do {
+		if (f_read(&file, data, 300, &len) != FR_OK)
+			return false;
+	} while (len == 300);
+	return f_close(&file) == FR_OK;
+}
+
+static bool _list_dir(const char *path)
+{
+	DIR dir;
+	FILINFO info;
+
+	if (f_opendir(&dir, path) != FR_OK)
+		return false;
+	while (f_readdir(&dir, &info) == FR_OK && info.fname[0])
+		;
+	return f_closedir(&dir) == FR_OK;
+}
+
+/**
+ * Run the FatFs workload whose media requests are replayed: what a data
+ * logger with a few configuration and result files does.
+ */
+static bool _workload(void)
+{
+	char path[16];
+	uint32_t d, f, r;
+	UINT len;
+
+	/* Format without partition table, register the work area first */
+	if (f_mount(&fs, "0:", 0) != FR_OK || f_mkfs("0:", 1, 0) != FR_OK ||
+	    f_mount(&fs, "0:", 1) != FR_OK)
+		return false;
+
+	/* Small files, written in small chunks */
+	for (d = 0; d < DIRS; d++) {
+		snprintf(path, sizeof(path), "0:DIR%u", d);
+		if (f_mkdir(path) != FR_OK)
+			return false;
+		for (f = 0; f < FILES; f++) {
+			snprintf(path, sizeof(path), "0:DIR%u/F%u.DAT", d, f);
+			if (!_write_file(path, 1024 + 256 * ((d * FILES + f) % 29),
+					256))
+				return false;
+		}
+	}
+
+	/* Log records, synced every few records, listing the directories
+	 * from time to time */
+	if (f_open(&file, "0:LOG.BIN", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return false;
+	for (r = 0; r < LOG_RECORDS; r++) {
+		memset(data, r, LOG_RECORD);
+		if (f_write(&file, data, LOG_RECORD, &len) != FR_OK ||
+		    len != LOG_RECORD)
+			return false;
+		if ((r + 1) % LOG_SYNC == 0 && f_sync(&file) != FR_OK)
+			return false;
+		if ((r + 1) % 500 == 0) {
+			snprintf(path, sizeof(path), "0:DIR%u", r / 500 % DIRS);
+			if (!_list_dir(path))
+				return false;
+		}
+	}
+	if (f_close(&file) != FR_OK)
+		return false;
+
+	/* Read the files back, remove every other one */
+	for (d = 0; d < DIRS; d++) {
+		snprintf(path, sizeof(path), "0:DIR%u", d);
+		if (!_list_dir(path))
+			return false;
+		for (f = 0; f < FILES; f++) {
+			snprintf(path, sizeof(path), "0:DIR%u/F%u.DAT", d, f);
+			if (!_read_file(path))
+				return false;
+			if ((f & 1) && f_unlink(path) != FR_OK)
+				return false;
+		}
+	}
+
+	return f_mount(NULL, "0:", 0) == FR_OK;
+}
+
+/**
+ * Replay the trace on a media, starting from an erased ramdisk.
+ */
+static bool _replay(struct _media *media)
+{
+	const struct _request *req;
+	uint32_t i;
+	uint8_t status;
+
+	memset(ram, 0, RAM_BLOCKS * BLOCK_SIZE);
+	memset(&counters, 0, sizeof(counters));
+
+	for (i = 0; i < trace.count; i++) {
+		req = &trace.requests[i];
+		if (req->length * BLOCK_SIZE > sizeof(data))
+			return false;
+		if (req->write) {
+			memset(data, i, req->length * BLOCK_SIZE);
+			status = media_write(media, req->address, data,
+					req->length, NULL, NULL);
+		} else {
+			status = media_read(media, req->address, data,
+					req->length, NULL, NULL);
+		}
+		if (status != MEDIA_STATUS_SUCCESS)
+			return false;
+	}
+	return media_flush(media) == MEDIA_STATUS_SUCCESS;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	struct _media_cache_stats stats;
+	struct _counters direct;
+	uint32_t i, reads = 0;
+	int32_t saved;
+	double hit_rate;
+
+	ram = mmap(NULL, RAM_BLOCKS * BLOCK_SIZE, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	reference = malloc(RAM_BLOCKS * BLOCK_SIZE);
+	if (ram == MAP_FAILED || !reference) {
+		printf("Cannot allocate the ramdisk\n");
+		return 1;
+	}
+	media_ramdisk_init(&ramdisk, (uint32_t)(uintptr_t)ram / BLOCK_SIZE,
+			RAM_BLOCKS, BLOCK_SIZE);
+
+	memset(&probe, 0, sizeof(probe));
+	probe.read = _probe_read;
+	probe.write = _probe_write;
+	probe.block_size = BLOCK_SIZE;
+	probe.size = RAM_BLOCKS;
+	probe.state = MEDIA_STATE_READY;
+
+	/* Record the trace */
+	ff_media = &probe;
+	trace.recording = true;
+	if (!_workload()) {
+		printf("FatFs workload failed\n");
+		return 1;
+	}
+	trace.recording = false;
+	for (i = 0; i < trace.count; i++)
+		if (!trace.requests[i].write)
+			reads++;
+
+	if (!_replay(&probe)) {
+		printf("Uncached replay failed\n");
+		return 1;
+	}
+	direct = counters;
+	memcpy(reference, ram, RAM_BLOCKS * BLOCK_SIZE);
+
+	printf("FatFs trace: %u requests (%u reads, %u writes), %u blocks\n",
+			trace.count, reads, trace.count - reads, direct.blocks);
+	printf("%5s %5s %8s %9s %9s %15s\n", "lines", "ahead", "hit rate",
+			"requests", "blocks", "requests saved");
+	printf("%5s %5s %8s %9u %9u %15s\n", "-", "-", "-",
+			direct.requests, direct.blocks, "-");
+
+	for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+		if (media_cache_init(&cached, &cache, &probe, lines, line_buffer,
+				configs[i].lines, configs[i].read_ahead)
+				!= MEDIA_STATUS_SUCCESS ||
+		    !_replay(&cached)) {
+			printf("Cached replay failed\n");
+			return 1;
+		}
+		if (memcmp(ram, reference, RAM_BLOCKS * BLOCK_SIZE)) {
+			printf("Cached replay left other contents\n");
+			return 1;
+		}
+		media_cache_get_stats(&cached, &stats);
+		hit_rate = 100.0 * stats.hits / (stats.hits + stats.misses);
+		saved = (int32_t)(direct.requests - counters.requests);
+		printf("%5u %5u %7.1f%% %9u %9u %8d (%3.0f%%)\n",
+				configs[i].lines, configs[i].read_ahead,
+				hit_rate, counters.requests, counters.blocks,
+				saved, 100.0 * saved / direct.requests);
+	}
+
+	munmap(ram, RAM_BLOCKS * BLOCK_SIZE);
+	free(reference);
+	free(trace.requests);
+	return 0;
+}
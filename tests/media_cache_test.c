@@ -0,0 +1,341 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the write-back block cache media over a RAM media that logs
+ * the requests it receives: LRU eviction, write-back ordering and
+ * coalescing, and a random workload checked against a shadow copy.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_cache.h"
+#include "libstoragemedia/media_private.h"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define BLOCK_SIZE  512
+#define RAM_BLOCKS  64
+#define LINES       8
+#define LOG_SIZE    64
+
+/** Request received by the RAM media */
+struct _request {
+	char op;           /**< 'r', 'w' or 'f' */
+	uint32_t address;
+	uint32_t length;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t ram[RAM_BLOCKS][BLOCK_SIZE];
+
+static uint8_t shadow[RAM_BLOCKS][BLOCK_SIZE];
+
+static struct {
+	struct _request log[LOG_SIZE];
+	uint32_t count;
+	int32_t fail_write;   /**< fail the next write of this block, or -1 */
+} backend;
+
+static struct _media ram_media;
+
+static struct _media media;
+
+static struct _media_cache cache;
+
+static struct _media_cache_line lines[LINES];
+
+static uint8_t line_buffer[LINES * BLOCK_SIZE];
+
+static uint8_t data[RAM_BLOCKS * BLOCK_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         RAM media                                                     */
+/*---------------------------------------------------------------------- */
+
+static void _log(char op, uint32_t address, uint32_t length)
+{
+	if (backend.count < LOG_SIZE) {
+		backend.log[backend.count].op = op;
+		backend.log[backend.count].address = address;
+		backend.log[backend.count].length = length;
+	}
+	backend.count++;
+}
+
+static uint8_t _ram_read(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	CHECK(address + length <= RAM_BLOCKS);
+	_log('r', address, length);
+	memcpy(buf, ram[address], length * BLOCK_SIZE);
+	return MEDIA_STATUS_SUCCESS;
+}
+
+static uint8_t _ram_write(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	CHECK(address + length <= RAM_BLOCKS);
+	if (backend.fail_write >= (int32_t)address &&
+	    backend.fail_write < (int32_t)(address + length)) {
+		backend.fail_write = -1;
+		return MEDIA_STATUS_ERROR;
+	}
+	_log('w', address, length);
+	memcpy(ram[address], buf, length * BLOCK_SIZE);
+	return MEDIA_STATUS_SUCCESS;
+}
+
+static uint8_t _ram_flush(struct _media *m)
+{
+	_log('f', 0, 0);
+	return MEDIA_STATUS_SUCCESS;
+}
+
+/** Start with a RAM media filled with a known pattern and an empty cache */
+static void _setup(uint32_t read_ahead)
+{
+	uint32_t b, i;
+
+	for (b = 0; b < RAM_BLOCKS; b++)
+		for (i = 0; i < BLOCK_SIZE; i++)
+			ram[b][i] = b ^ (i * 3);
+	memcpy(shadow, ram, sizeof(ram));
+
+	memset(&backend, 0, sizeof(backend));
+	backend.fail_write = -1;
+
+	memset(&ram_media, 0, sizeof(ram_media));
+	ram_media.read = _ram_read;
+	ram_media.write = _ram_write;
+	ram_media.flush = _ram_flush;
+	ram_media.block_size = BLOCK_SIZE;
+	ram_media.size = RAM_BLOCKS;
+	ram_media.state = MEDIA_STATE_READY;
+
+	CHECK(media_cache_init(&media, &cache, &ram_media, lines, line_buffer,
+			LINES, read_ahead) == MEDIA_STATUS_SUCCESS);
+}
+
+static bool _logged(uint32_t index, char op, uint32_t address, uint32_t length)
+{
+	return index < backend.count && backend.log[index].op == op &&
+		backend.log[index].address == address &&
+		backend.log[index].length == length;
+}
+
+/** Write count blocks filled with value through the cache and the shadow */
+static uint8_t _write(uint32_t address, uint32_t count, uint8_t value)
+{
+	memset(data, value, count * BLOCK_SIZE);
+	memset(shadow[address], value, count * BLOCK_SIZE);
+	return media_write(&media, address, data, count, NULL, NULL);
+}
+
+/** Read count blocks through the cache and compare them with the shadow */
+static bool _read(uint32_t address, uint32_t count)
+{
+	if (media_read(&media, address, data, count, NULL, NULL) !=
+			MEDIA_STATUS_SUCCESS)
+		return false;
+	return !memcmp(data, shadow[address], count * BLOCK_SIZE);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_read_ahead_and_hits(void)
+{
+	struct _media_cache_stats stats;
+
+	_setup(3);
+	CHECK(_read(10, 1));
+	CHECK(backend.count == 1 && _logged(0, 'r', 10, 4));
+
+	/* The blocks read ahead are hits */
+	CHECK(_read(11, 3));
+	CHECK(_read(10, 1));
+	CHECK(backend.count == 1);
+
+	media_cache_get_stats(&media, &stats);
+	CHECK(stats.misses == 1 && stats.read_ahead == 3 && stats.hits == 4);
+}
+
+static void test_lru_eviction(void)
+{
+	uint32_t b;
+
+	_setup(0);
+	for (b = 0; b < LINES; b++)
+		CHECK(_read(b, 1));
+	/* Use all the lines again but block 3 */
+	for (b = 0; b < LINES; b++)
+		if (b != 3)
+			CHECK(_read(b, 1));
+	CHECK(backend.count == LINES);
+
+	/* Block 3 is the least recently used, then block 0 */
+	CHECK(_read(20, 1));
+	CHECK(_read(0, 1) && _read(1, 1) && _read(2, 1));
+	CHECK(backend.count == LINES + 1);
+	CHECK(_read(3, 1));
+	CHECK(backend.count == LINES + 2 && _logged(LINES + 1, 'r', 3, 1));
+}
+
+static void test_write_back_on_eviction(void)
+{
+	uint32_t b;
+
+	_setup(0);
+	CHECK(_write(5, 1, 0xA5) == MEDIA_STATUS_SUCCESS);
+	/* Write-back cache: nothing reaches the media yet */
+	CHECK(backend.count == 0);
+	CHECK(ram[5][0] != 0xA5);
+	CHECK(_read(5, 1));
+
+	/* Fill the other lines, then evict block 5 */
+	for (b = 0; b < LINES - 1; b++)
+		CHECK(_read(30 + b, 1));
+	CHECK(backend.count == LINES - 1);
+	CHECK(_read(40, 1));
+
+	/* The dirty block is written before its line is refilled */
+	CHECK(_logged(LINES - 1, 'w', 5, 1));
+	CHECK(_logged(LINES, 'r', 40, 1));
+	CHECK(!memcmp(ram[5], shadow[5], BLOCK_SIZE));
+}
+
+static void test_flush_coalesces(void)
+{
+	_setup(0);
+	CHECK(_write(8, 1, 1) == MEDIA_STATUS_SUCCESS);
+	CHECK(_write(9, 2, 2) == MEDIA_STATUS_SUCCESS);
+	CHECK(_write(20, 1, 3) == MEDIA_STATUS_SUCCESS);
+	CHECK(backend.count == 0);
+
+	CHECK(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	CHECK(backend.count == 3);
+	CHECK(_logged(0, 'w', 8, 3));
+	CHECK(_logged(1, 'w', 20, 1));
+	/* The media is flushed once all the dirty lines are written */
+	CHECK(_logged(2, 'f', 0, 0));
+	CHECK(!memcmp(ram, shadow, sizeof(ram)));
+
+	/* Nothing left to write */
+	CHECK(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	CHECK(backend.count == 4 && _logged(3, 'f', 0, 0));
+}
+
+static void test_large_transfers_bypass(void)
+{
+	struct _media_cache_stats stats;
+
+	_setup(0);
+	CHECK(_read(2, 1));
+	CHECK(_write(0, 16, 7) == MEDIA_STATUS_SUCCESS);
+	/* Blocks 0 and 1 fit in the cache, block 2 is updated in its line,
+	 * the 13 next ones go through */
+	CHECK(backend.count == 2 && _logged(1, 'w', 3, 13));
+	CHECK(_read(0, 16));
+	CHECK(backend.count == 3 && _logged(2, 'r', 3, 13));
+	media_cache_get_stats(&media, &stats);
+	CHECK(stats.bypassed == 13 + 13);
+
+	CHECK(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	CHECK(!memcmp(ram, shadow, sizeof(ram)));
+}
+
+static void test_write_back_failure(void)
+{
+	uint32_t b;
+
+	_setup(0);
+	for (b = 0; b < LINES; b++)
+		CHECK(_write(b, 1, b) == MEDIA_STATUS_SUCCESS);
+
+	/* The eviction fails, the dirty line is kept */
+	backend.fail_write = 0;
+	CHECK(media_read(&media, 50, data, 1, NULL, NULL) == MEDIA_STATUS_ERROR);
+	CHECK(_read(0, 1));
+	CHECK(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	CHECK(!memcmp(ram, shadow, sizeof(ram)));
+}
+
+static void test_random_workload(void)
+{
+	uint32_t n, address, count;
+
+	srand(5);
+	_setup(2);
+	for (n = 0; n < 20000; n++) {
+		count = 1 + rand() % 6;
+		address = rand() % (RAM_BLOCKS - count + 1);
+		if (rand() % 3 == 0)
+			CHECK(_write(address, count, rand()) == MEDIA_STATUS_SUCCESS);
+		else
+			CHECK(_read(address, count));
+		if (n % 1000 == 999)
+			CHECK(media_flush(&media) == MEDIA_STATUS_SUCCESS);
+	}
+	CHECK(media_cache_invalidate(&media) == MEDIA_STATUS_SUCCESS);
+	CHECK(!memcmp(ram, shadow, sizeof(ram)));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_read_ahead_and_hits);
+	RUN_TEST(test_lru_eviction);
+	RUN_TEST(test_write_back_on_eviction);
+	RUN_TEST(test_flush_coalesces);
+	RUN_TEST(test_large_transfers_bypass);
+	RUN_TEST(test_write_back_failure);
+	RUN_TEST(test_random_workload);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Media requests issued by the FatFs disk I/O layer of libstoragemedia
+ * (media_ff.c), for a file written and read back in small chunks on a RAM
+ * volume.
+ *
+ * Each FatFs disk_read()/disk_write() call is counted as well: a disk I/O
+ * layer without burst buffer, as the one of libsdmmc, issues one media
+ * request per call. The time is simulated with a fixed cost per request
+ * and a cost per sector, in the range of an SD card in high speed mode.
+ *
+ * The file is then read at random offsets, once following its FAT chain
+ * and once through a cluster link map (_USE_FASTSEEK), which saves the FAT
+ * sector reads of each seek.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libstoragemedia/media.h"
+#include "libstoragemedia/media_private.h"
+
+/* FatFs calls the functions below, which forward to media_ff.c */
+#define disk_read media_ff_disk_read
+#define disk_write media_ff_disk_write
+#include "libstoragemedia/media_ff.c"
+#undef disk_read
+#undef disk_write
+
+#include "fatfs/src/ff.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SECTOR_SIZE  512
+#define RAM_SECTORS  (64 * 1024 * 1024 / SECTOR_SIZE)
+#define FILE_SIZE    (4 * 1024 * 1024)
+#define CHUNK_SIZE   1000
+#define SEEK_COUNT   1000
+
+/* Cluster link map of the file, in DWORDs */
+#define LINK_MAP_SIZE 64
+
+/* Latency model */
+#define REQUEST_US   100.0
+#define SECTOR_US    25.6
+
+struct _counters {
+	uint32_t requests;
+	uint32_t sectors;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t *ram;
+
+static struct _media ram_media;
+
+static struct _counters media_reads, media_writes, ff_reads, ff_writes;
+
+static FATFS fs;
+
+static FIL file;
+
+static uint8_t chunk[CHUNK_SIZE];
+
+static DWORD link_map[LINK_MAP_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         RAM media                                                     */
+/*---------------------------------------------------------------------- */
+
+static uint8_t _ram_read(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	if (address + length > RAM_SECTORS)
+		return MEDIA_STATUS_ERROR;
+	media_reads.requests++;
+	media_reads.sectors += length;
+	memcpy(buf, ram + address * SECTOR_SIZE, length * SECTOR_SIZE);
+	return MEDIA_STATUS_SUCCESS;
+}
+
+static uint8_t _ram_write(struct _media *m, uint32_t address, void *buf,
+		uint32_t length, media_callback_t callback, void *callback_arg)
+{
+	if (address + length > RAM_SECTORS)
+		return MEDIA_STATUS_ERROR;
+	media_writes.requests++;
+	media_writes.sectors += length;
+	memcpy(ram + address * SECTOR_SIZE, buf, length * SECTOR_SIZE);
+	return MEDIA_STATUS_SUCCESS;
+}
+
+bool media_ff_get_instance(uint8_t index, struct _media **holder)
+{
+	if (index != 0)
+		return false;
+	*holder = &ram_media;
+	return true;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Disk I/O seen by FatFs                                        */
+/*---------------------------------------------------------------------- */
+
+DRESULT disk_read(BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+	ff_reads.requests++;
+	ff_reads.sectors += count;
+	return media_ff_disk_read(pdrv, buff, sector, count);
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+	ff_writes.requests++;
+	ff_writes.sectors += count;
+	return media_ff_disk_write(pdrv, buff, sector, count);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static double _time_ms(const struct _counters *c)
+{
+	return (c->requests * REQUEST_US + c->sectors * SECTOR_US) / 1000.0;
+}
+
+static void _reset(void)
+{
+	memset(&media_reads, 0, sizeof(media_reads));
+	memset(&media_writes, 0, sizeof(media_writes));
+	memset(&ff_reads, 0, sizeof(ff_reads));
+	memset(&ff_writes, 0, sizeof(ff_writes));
+}
+
+static void _report(const char *phase, const struct _counters *direct,
+		const struct _counters *burst)
+{
+	printf("%-6s %9u %9u %10.1f   %9u %9u %10.1f\n", phase,
+			direct->requests, direct->sectors, _time_ms(direct),
+			burst->requests, burst->sectors, _time_ms(burst));
+}
+
+static void _fill_chunk(uint32_t offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < CHUNK_SIZE; i++)
+		chunk[i] = (offset + i) * 7 + ((offset + i) >> 11);
+}
+
+/**
+ * Read chunks at pseudo-random offsets of the file, following the FAT
+ * chain or, with fast_seek, its cluster link map.
+ */
+static bool _random_reads(bool fast_seek)
+{
+	static uint8_t expected[CHUNK_SIZE];
+	uint32_t i, offset, seed = 1;
+	UINT len;
+
+	if (f_open(&file, "0:bench.bin", FA_READ) != FR_OK)
+		return false;
+	if (fast_seek) {
+		link_map[0] = LINK_MAP_SIZE;
+		file.cltbl = link_map;
+		if (f_lseek(&file, CREATE_LINKMAP) != FR_OK)
+			return false;
+	}
+	for (i = 0; i < SEEK_COUNT; i++) {
+		seed = seed * 1103515245 + 12345;
+		offset = (seed >> 8) % (FILE_SIZE - CHUNK_SIZE);
+		if (f_lseek(&file, offset) != FR_OK ||
+		    f_read(&file, chunk, CHUNK_SIZE, &len) != FR_OK ||
+		    len != CHUNK_SIZE)
+			return false;
+		memcpy(expected, chunk, CHUNK_SIZE);
+		_fill_chunk(offset);
+		if (memcmp(expected, chunk, CHUNK_SIZE)) {
+			printf("Data mismatch at offset %u\n", offset);
+			return false;
+		}
+	}
+	f_close(&file);
+	return true;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	static uint8_t expected[CHUNK_SIZE];
+	uint32_t offset, size;
+	UINT len;
+
+	ram = calloc(RAM_SECTORS, SECTOR_SIZE);
+	ram_media.read = _ram_read;
+	ram_media.write = _ram_write;
+	ram_media.block_size = SECTOR_SIZE;
+	ram_media.size = RAM_SECTORS;
+	ram_media.state = MEDIA_STATE_READY;
+
+	/* Register the work area of f_mkfs(), then format without partition
+	 * table and with the default cluster size */
+	if (f_mount(&fs, "0:", 0) != FR_OK || f_mkfs("0:", 1, 0) != FR_OK ||
+	    f_mount(&fs, "0:", 1) != FR_OK) {
+		printf("Cannot format the RAM volume\n");
+		return 1;
+	}
+
+	printf("%u bytes written then read in %u byte chunks\n",
+			FILE_SIZE, CHUNK_SIZE);
+	printf("%-6s %29s   %29s\n", "", "one request per FatFs call",
+			"media_ff burst buffer");
+	printf("%-6s %9s %9s %10s   %9s %9s %10s\n", "", "requests",
+			"sectors", "time (ms)", "requests", "sectors", "time (ms)");
+
+	_reset();
+	if (f_open(&file, "0:bench.bin", FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return 1;
+	for (offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+		size = FILE_SIZE - offset < CHUNK_SIZE ? FILE_SIZE - offset : CHUNK_SIZE;
+		_fill_chunk(offset);
+		if (f_write(&file, chunk, size, &len) != FR_OK || len != size)
+			return 1;
+	}
+	if (f_close(&file) != FR_OK)
+		return 1;
+	_report("write", &ff_writes, &media_writes);
+
+	_reset();
+	if (f_open(&file, "0:bench.bin", FA_READ) != FR_OK)
+		return 1;
+	for (offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+		size = FILE_SIZE - offset < CHUNK_SIZE ? FILE_SIZE - offset : CHUNK_SIZE;
+		if (f_read(&file, chunk, size, &len) != FR_OK || len != size)
+			return 1;
+		memcpy(expected, chunk, size);
+		_fill_chunk(offset);
+		if (memcmp(expected, chunk, size)) {
+			printf("Data mismatch at offset %u\n", offset);
+			return 1;
+		}
+	}
+	f_close(&file);
+	_report("read", &ff_reads, &media_reads);
+
+	printf("\n%u chunks read at random offsets\n", SEEK_COUNT);
+	_reset();
+	if (!_random_reads(false))
+		return 1;
+	_report("chain", &ff_reads, &media_reads);
+
+	_reset();
+	if (!_random_reads(true))
+		return 1;
+	_report("map", &ff_reads, &media_reads);
+
+	free(ram);
+	return 0;
+}
@@ -0,0 +1,365 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * READ10 and WRITE10 throughput of the mass storage class on a virtual
+ * clock. The state machine is the real one (sbc_methods.c), polled as by
+ * msdd_state_machine.c; the USB and the media are modelled:
+ * - the USB transfers are asynchronous, at USB_MBPS, and complete in the
+ *   first poll past their end;
+ * - the media transfers are blocking, with a fixed latency per command
+ *   and a transfer rate, as the SD/MMC and eMMC media of libstoragemedia.
+ *
+ * Each case runs with the buffer split in two chunks (ping-pong, the
+ * current msd_io_fifo_set_chunk_size()) and with a single chunk of up to
+ * MSDIO_*_CHUNK_SIZE, as the FIFO was before. The figures depend on the
+ * model only, not on the build machine.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The ping-pong chunk selection is wrapped by the benchmark, to compare it
+ * with a single chunk */
+#define msd_io_fifo_set_chunk_size _ping_pong_set_chunk_size
+#include "usb/device/msd/msd_io_fifo.c"
+#undef msd_io_fifo_set_chunk_size
+
+void msd_io_fifo_set_chunk_size(MSDIOFifo *p_fifo,
+		unsigned int max_chunk_size);
+
+#include "usb/device/msd/sbc_methods.c"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define BLOCK_SIZE  512
+#define BUFFER_SIZE (64 * 1024)
+#define COMMANDS    50
+
+/* USB: bulk transfer rate, and cost of the CBW and CSW of a command */
+#define USB_MBPS    40.0
+#define CMD_US      60.0
+
+/* Cost of one call of the state machine */
+#define CALL_US     0.5
+
+struct _media_model {
+	const char *name;
+	double latency_us;
+	double mbps;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static const struct _media_model medias[] = {
+	{ "SD   300us, 22MB/s", 300.0, 22.0 },
+	{ "eMMC 150us, 45MB/s", 150.0, 45.0 },
+};
+
+static const uint32_t command_blocks[] = { 64, 240, 2048 };
+
+/* Virtual clock, in us */
+static double now;
+
+static const struct _media_model *media;
+
+static bool ping_pong;
+
+/* USB transfer in progress */
+static struct {
+	bool pending;
+	double end;
+	uint32_t length;
+	usbd_xfer_cb_t callback;
+	void *arg;
+	double free;
+} usb;
+
+CACHE_ALIGNED static uint8_t buffer[BUFFER_SIZE];
+
+static SBCRequestSenseData sense;
+
+static uint8_t media_dummy;
+
+/*---------------------------------------------------------------------- */
+/*         Models                                                        */
+/*---------------------------------------------------------------------- */
+
+void msd_io_fifo_set_chunk_size(MSDIOFifo *p_fifo,
+		unsigned int max_chunk_size)
+{
+	unsigned int chunk_size;
+
+	if (ping_pong) {
+		_ping_pong_set_chunk_size(p_fifo, max_chunk_size);
+		return;
+	}
+
+	chunk_size = p_fifo->bufferSize < max_chunk_size ?
+		p_fifo->bufferSize : max_chunk_size;
+	chunk_size -= chunk_size % p_fifo->blockSize;
+	p_fifo->chunkSize = chunk_size;
+	p_fifo->ringSize = p_fifo->bufferSize - p_fifo->bufferSize % chunk_size;
+}
+
+static uint8_t _usb_start(uint32_t length, usbd_xfer_cb_t callback,
+		void *arg)
+{
+	double start = now > usb.free ? now : usb.free;
+
+	if (usb.pending)
+		return USBD_STATUS_LOCKED;
+
+	usb.pending = true;
+	usb.end = start + length / USB_MBPS;
+	usb.free = usb.end;
+	usb.length = length;
+	usb.callback = callback;
+	usb.arg = arg;
+	return USBD_STATUS_SUCCESS;
+}
+
+/* Complete the USB transfer if it has ended */
+static bool _usb_poll(void)
+{
+	if (!usb.pending || now < usb.end)
+		return false;
+
+	usb.pending = false;
+	usb.callback(usb.arg, USBD_STATUS_SUCCESS, usb.length, 0);
+	return true;
+}
+
+uint8_t usbd_write(uint8_t endpoint, const void *data, uint32_t length,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	return _usb_start(length, callback, callback_arg);
+}
+
+uint8_t usbd_read(uint8_t endpoint, void *data, uint32_t length,
+		usbd_xfer_cb_t callback, void *callback_arg)
+{
+	return _usb_start(length, callback, callback_arg);
+}
+
+static uint32_t _media_transfer(uint32_t length, usbd_xfer_cb_t callback,
+		void *argument)
+{
+	uint32_t bytes = length * BLOCK_SIZE;
+
+	now += media->latency_us + bytes / media->mbps;
+	callback(argument, MEDIA_STATUS_SUCCESS, bytes, 0);
+	return LUN_STATUS_SUCCESS;
+}
+
+uint32_t lun_read(MSDLun *lun, uint32_t blockAddress, void *data,
+		uint32_t length, usbd_xfer_cb_t callback, void *argument)
+{
+	return _media_transfer(length, callback, argument);
+}
+
+uint32_t lun_write(MSDLun *lun, uint32_t blockAddress, void *data,
+		uint32_t length, usbd_xfer_cb_t callback, void *argument)
+{
+	return _media_transfer(length, callback, argument);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _init_lun(MSDLun *lun)
+{
+	memset(lun, 0, sizeof(*lun));
+	lun->media = &media_dummy;
+	lun->blockSize = 1;
+	lun->status = LUN_READY;
+	lun->requestSenseData = &sense;
+	msd_io_fifo_init(&lun->ioFifo, buffer, sizeof(buffer));
+}
+
+/* State of the command, to detect the calls that wait for the USB */
+static void _snapshot(const MSDIOFifo *fifo, const MSDCommandState *state,
+		uint32_t *values)
+{
+	values[0] = state->state;
+	values[1] = state->transfer.semaphore;
+	values[2] = state->disktransfer.semaphore;
+	values[3] = fifo->inputState;
+	values[4] = fifo->inputTotal;
+	values[5] = fifo->outputState;
+	values[6] = fifo->outputTotal;
+}
+
+/* Run one READ10 or WRITE10 command, return false on failure */
+static bool _run_command(MSDLun *lun, bool write, uint32_t lba,
+		uint32_t blocks)
+{
+	MSDCommandState state;
+	SBCRead10 *command = (SBCRead10 *)state.cbw.pCommand;
+	MSDIOFifo *fifo = &lun->ioFifo;
+	uint32_t before[7], after[7];
+	uint8_t result;
+
+	memset(&state, 0, sizeof(state));
+	command->bOperationCode = write ? SBC_WRITE_10 : SBC_READ_10;
+	STORE_DWORDB(lba, command->pLogicalBlockAddress);
+	STORE_WORDB(blocks, command->pTransferLength);
+	state.length = blocks * BLOCK_SIZE;
+
+	now += CMD_US;
+	for (;;) {
+		_usb_poll();
+		_snapshot(fifo, &state, before);
+
+		result = write ? sbc_write10(lun, &state) : sbc_read10(lun, &state);
+		now += CALL_US;
+		if (result == MSDD_STATUS_SUCCESS)
+			return true;
+		if (result != MSDD_STATUS_INCOMPLETE)
+			return false;
+
+		_snapshot(fifo, &state, after);
+
+		/* Waiting for the USB: skip to its completion */
+		if (!memcmp(before, after, sizeof(before))) {
+			if (!usb.pending)
+				return false;
+			if (now < usb.end)
+				now = usb.end;
+		}
+	}
+}
+
+static double _throughput(bool write, uint32_t blocks)
+{
+	MSDLun lun;
+	uint32_t i;
+
+	_init_lun(&lun);
+	memset(&usb, 0, sizeof(usb));
+	now = 0;
+
+	for (i = 0; i < COMMANDS; i++) {
+		if (!_run_command(&lun, write, i * blocks, blocks)) {
+			printf("command failed\n");
+			return 0;
+		}
+	}
+
+	return (double)COMMANDS * blocks * BLOCK_SIZE / now;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+bool media_is_mapped_read_supported(struct _media *m)
+{
+	return false;
+}
+
+bool media_is_mapped_write_supported(struct _media *m)
+{
+	return false;
+}
+
+uint32_t media_get_block_size(struct _media *m)
+{
+	return BLOCK_SIZE;
+}
+
+uint32_t media_get_mapped_address(struct _media *m, uint32_t block)
+{
+	return 0;
+}
+
+uint8_t media_get_state(struct _media *m)
+{
+	return MEDIA_STATE_READY;
+}
+
+uint8_t media_flush(struct _media *m)
+{
+	return MEDIA_STATUS_SUCCESS;
+}
+
+uint32_t lun_access(MSDLun *lun, uint32_t block_address, uint32_t length,
+		uint8_t write)
+{
+	return LUN_STATUS_SUCCESS;
+}
+
+uint32_t lun_eject(MSDLun *lun)
+{
+	return LUN_STATUS_SUCCESS;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	uint32_t m, b, w;
+	double single, pp;
+
+	printf("MB/s, %u commands, %u KB buffer, USB %.0f MB/s\n",
+	       COMMANDS, BUFFER_SIZE / 1024, USB_MBPS);
+	printf("%-20s %-7s %6s %8s %10s\n", "media", "command", "blocks",
+	       "single", "ping-pong");
+	for (m = 0; m < ARRAY_SIZE(medias); m++) {
+		media = &medias[m];
+		for (w = 0; w < 2; w++) {
+			for (b = 0; b < ARRAY_SIZE(command_blocks); b++) {
+				ping_pong = false;
+				single = _throughput(w, command_blocks[b]);
+				ping_pong = true;
+				pp = _throughput(w, command_blocks[b]);
+				printf("%-20s %-7s %6u %8.2f %10.2f\n",
+				       media->name, w ? "WRITE10" : "READ10",
+				       (unsigned)command_blocks[b], single, pp);
+			}
+		}
+	}
+
+	return 0;
+}
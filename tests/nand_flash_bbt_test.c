@@ -0,0 +1,364 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the NAND bad block table, skip block and logical block
+ * mapping layers, run on the RAM-backed device of nand_sim.c.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "nvm/nand/nand_flash_bbt.h"
+#include "nvm/nand/nand_flash_l2p.h"
+#include "nvm/nand/nand_flash_skip_block.h"
+
+#include "nand_sim.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SPARE_BLOCKS 8
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _nand_l2p l2p, l2p_reboot;
+
+static struct _nand_bbt bbt, bbt_reboot;
+
+static uint8_t wbuf[SIM_PAGE_SIZE];
+
+static uint8_t rbuf[SIM_PAGE_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _fill(uint16_t block, uint16_t page)
+{
+	memset(wbuf, (block * 7 + page) & 0xff, sizeof(wbuf));
+	wbuf[0] = block;
+	wbuf[1] = page;
+}
+
+static void _write_blocks(struct _nand_l2p *l, uint16_t count)
+{
+	uint16_t block, page;
+
+	for (block = 0; block < count; block++) {
+		for (page = 0; page < SIM_PAGES_PER_BLOCK; page++) {
+			_fill(block, page);
+			CHECK(nand_l2p_write_page(l, block, page, wbuf) == 0);
+		}
+	}
+}
+
+static bool _block_ok(struct _nand_l2p *l, uint16_t block, uint16_t pages)
+{
+	uint16_t page;
+
+	for (page = 0; page < pages; page++) {
+		_fill(block, page);
+		if (nand_l2p_read_page(l, block, page, rbuf) ||
+		    memcmp(wbuf, rbuf, sizeof(rbuf)))
+			return false;
+	}
+	return true;
+}
+
+static bool _is_mapped(const struct _nand_l2p *l, uint16_t phys)
+{
+	uint16_t block;
+
+	for (block = 0; block < l->table.num_logical; block++)
+		if (l->table.map[block] == phys)
+			return true;
+	return false;
+}
+
+/** Store a new copy of the table, and return where its first page is */
+static void _save(struct _nand_bbt *b, uint16_t *block, uint16_t *page)
+{
+	uint16_t prev_block = b->table_block;
+	uint16_t prev_page = b->table_page;
+
+	CHECK(nand_bbt_save(b) == 0);
+	*block = b->table_block;
+	*page = b->table_block == prev_block ? prev_page : 0;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_first_init_scans_markers(void)
+{
+	uint16_t reserved = SIM_NUM_BLOCKS - NAND_BBT_RESERVED_BLOCKS;
+
+	nand_sim_reset();
+	nand_sim_set_factory_bad(3, 0);
+	nand_sim_set_factory_bad(100, 1);
+	nand_sim_set_factory_bad(SIM_NUM_BLOCKS - 2, 0);
+
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(nand_l2p_get_num_blocks(&l2p) ==
+			reserved - 2 - SPARE_BLOCKS);
+	CHECK(nand_bbt_is_bad(&l2p.bbt, 3));
+	CHECK(nand_bbt_is_bad(&l2p.bbt, 100));
+	CHECK(!nand_bbt_is_bad(&l2p.bbt, 4));
+	CHECK(!_is_mapped(&l2p, 3));
+	CHECK(!_is_mapped(&l2p, 100));
+	CHECK(l2p.bbt.table_block != SIM_NUM_BLOCKS - 2);
+}
+
+static void test_reboot_loads_table(void)
+{
+	uint32_t spare_reads;
+
+	nand_sim_reset();
+	nand_sim_set_factory_bad(3, 0);
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	_write_blocks(&l2p, 20);
+
+	/* Only the markers of the reserved blocks are read */
+	spare_reads = nand_sim_stats.spare_reads;
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(nand_sim_stats.spare_reads - spare_reads <=
+			2 * NAND_BBT_RESERVED_BLOCKS);
+	CHECK(l2p_reboot.bbt.version == l2p.bbt.version);
+	CHECK(!memcmp(&l2p.table, &l2p_reboot.table, sizeof(l2p.table)));
+	CHECK(!memcmp(l2p.bbt.bitmap, l2p_reboot.bbt.bitmap,
+			sizeof(l2p.bbt.bitmap)));
+	CHECK(_block_ok(&l2p_reboot, 0, SIM_PAGES_PER_BLOCK));
+	CHECK(_block_ok(&l2p_reboot, 19, SIM_PAGES_PER_BLOCK));
+}
+
+static void test_skipblock_uses_table(void)
+{
+	uint16_t data_blocks = SIM_NUM_BLOCKS - NAND_BBT_RESERVED_BLOCKS;
+	uint32_t spare_reads;
+	uint16_t i, block;
+
+	nand_sim_reset();
+	nand_sim_set_factory_bad(3, 0);
+	nand_sim_set_factory_bad(100, 1);
+	CHECK(nand_bbt_initialize(&bbt, &nand_sim, NULL, 0) == 0);
+
+	nand_skipblock_set_bbt(&bbt);
+	spare_reads = nand_sim_stats.spare_reads;
+	for (i = 0; i < 1000; i++) {
+		block = i % data_blocks;
+		CHECK(nand_skipblock_check_block(&nand_sim, block) ==
+				(block == 3 || block == 100 ? BADBLOCK : GOODBLOCK));
+	}
+	CHECK(nand_sim_stats.spare_reads == spare_reads);
+	nand_skipblock_set_bbt(NULL);
+}
+
+static void test_program_failure_relocates(void)
+{
+	uint16_t page, phys;
+
+	nand_sim_reset();
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	_write_blocks(&l2p, 8);
+
+	CHECK(nand_l2p_erase_block(&l2p, 5) == 0);
+	phys = l2p.table.map[5];
+	for (page = 0; page < 10; page++) {
+		_fill(5, page);
+		CHECK(nand_l2p_write_page(&l2p, 5, page, wbuf) == 0);
+	}
+	nand_sim_fail_program(phys);
+	for (; page < 12; page++) {
+		_fill(5, page);
+		CHECK(nand_l2p_write_page(&l2p, 5, page, wbuf) == 0);
+	}
+	CHECK(l2p.table.map[5] != phys);
+	CHECK(nand_bbt_is_bad(&l2p.bbt, phys));
+	CHECK(_block_ok(&l2p, 5, 12));
+
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(!memcmp(l2p.table.map, l2p_reboot.table.map,
+			sizeof(l2p.table.map)));
+	CHECK(_block_ok(&l2p_reboot, 5, 12));
+	CHECK(_block_ok(&l2p_reboot, 4, SIM_PAGES_PER_BLOCK));
+}
+
+static void test_erase_failure_relocates(void)
+{
+	uint16_t phys;
+
+	nand_sim_reset();
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	phys = l2p.table.map[6];
+	nand_sim_fail_erase(phys);
+	CHECK(nand_l2p_erase_block(&l2p, 6) == 0);
+	CHECK(l2p.table.map[6] != phys);
+	CHECK(nand_bbt_is_bad(&l2p.bbt, phys));
+
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(nand_bbt_is_bad(&l2p_reboot.bbt, phys));
+	CHECK(l2p_reboot.table.map[6] == l2p.table.map[6]);
+}
+
+static void test_wear_levelling(void)
+{
+	uint16_t data_blocks = SIM_NUM_BLOCKS - NAND_BBT_RESERVED_BLOCKS;
+	uint32_t max = 0;
+	uint16_t i;
+
+	nand_sim_reset();
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	for (i = 0; i < 5000; i++)
+		CHECK(nand_l2p_erase_block(&l2p, 0) == 0);
+	CHECK(nand_l2p_flush(&l2p) == 0);
+
+	/* The erasures rotate over the spare blocks */
+	for (i = 0; i < data_blocks; i++)
+		if (l2p.table.erase_count[i] > max)
+			max = l2p.table.erase_count[i];
+	CHECK(max <= 5000 / SPARE_BLOCKS + NAND_L2P_WEAR_THRESHOLD);
+
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(!memcmp(l2p.table.erase_count, l2p_reboot.table.erase_count,
+			sizeof(l2p.table.erase_count)));
+}
+
+static void test_bit_flips(void)
+{
+	uint16_t phys, block, page;
+	uint32_t version;
+
+	nand_sim_reset();
+	CHECK(nand_l2p_initialize(&l2p, &nand_sim, SPARE_BLOCKS) == 0);
+	_write_blocks(&l2p, 2);
+
+	/* Data pages */
+	phys = l2p.table.map[1];
+	nand_sim_flip_bits(phys, 3, SIM_ECC_BITS);
+	CHECK(_block_ok(&l2p, 1, SIM_PAGES_PER_BLOCK));
+	nand_sim_flip_bits(phys, 3, 1);
+	CHECK(nand_l2p_read_page(&l2p, 1, 3, rbuf) == NAND_ERROR_CORRUPTEDDATA);
+
+	/* Copies of the table: correctable flips are ignored, an
+	 * uncorrectable copy is replaced by the previous one */
+	_save(&l2p.bbt, &block, &page);
+	version = l2p.bbt.version;
+	nand_sim_flip_bits(block, page, SIM_ECC_BITS);
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(l2p_reboot.bbt.version == version);
+	nand_sim_flip_bits(block, page, 1);
+	CHECK(nand_l2p_initialize(&l2p_reboot, &nand_sim, SPARE_BLOCKS) == 0);
+	CHECK(l2p_reboot.bbt.version == version - 1);
+
+	/* Saving again must not reuse the unreadable page */
+	CHECK(nand_bbt_save(&l2p_reboot.bbt) == 0);
+	CHECK(nand_bbt_initialize(&bbt_reboot, &nand_sim, NULL, 0) == 0);
+	CHECK(bbt_reboot.version == version);
+}
+
+static void test_corrupted_copy(void)
+{
+	uint32_t version;
+	uint16_t block, page;
+
+	nand_sim_reset();
+	CHECK(nand_bbt_initialize(&bbt, &nand_sim, NULL, 0) == 0);
+	CHECK(nand_bbt_save(&bbt) == 0);
+	_save(&bbt, &block, &page);
+	version = bbt.version;
+
+	/* Bit error missed by the ECC: the CRC rejects the copy */
+	nand_sim_page(block, page)[30] ^= 1;
+	CHECK(nand_bbt_initialize(&bbt_reboot, &nand_sim, NULL, 0) == 0);
+	CHECK(bbt_reboot.version == version - 1);
+}
+
+static void test_power_loss_during_save(void)
+{
+	jmp_buf env;
+	uint32_t version;
+	uint16_t block;
+
+	nand_sim_reset();
+	nand_sim_set_factory_bad(7, 0);
+	CHECK(nand_bbt_initialize(&bbt, &nand_sim, NULL, 0) == 0);
+	CHECK(nand_bbt_save(&bbt) == 0);
+	version = bbt.version;
+	block = bbt.table_block;
+
+	/* The power is lost after the bad block marker is written, while the
+	 * first page of the next copy is programmed */
+	if (!setjmp(env)) {
+		nand_sim_power_loss(1, &env);
+		nand_bbt_mark_bad(&bbt, 9);
+		CHECK(false);
+	}
+
+	CHECK(nand_bbt_initialize(&bbt_reboot, &nand_sim, NULL, 0) == 0);
+	CHECK(bbt_reboot.version == version);
+	CHECK(nand_bbt_is_bad(&bbt_reboot, 7));
+
+	/* The new copy goes elsewhere and is found on the next boot */
+	CHECK(nand_bbt_mark_bad(&bbt_reboot, 9) == 0);
+	CHECK(bbt_reboot.table_block != block);
+	CHECK(nand_bbt_initialize(&bbt, &nand_sim, NULL, 0) == 0);
+	CHECK(bbt.version == version + 1);
+	CHECK(nand_bbt_is_bad(&bbt, 7));
+	CHECK(nand_bbt_is_bad(&bbt, 9));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_first_init_scans_markers);
+	RUN_TEST(test_reboot_loads_table);
+	RUN_TEST(test_skipblock_uses_table);
+	RUN_TEST(test_program_failure_relocates);
+	RUN_TEST(test_erase_failure_relocates);
+	RUN_TEST(test_wear_levelling);
+	RUN_TEST(test_bit_flips);
+	RUN_TEST(test_corrupted_copy);
+	RUN_TEST(test_power_loss_during_save);
+
+	return test_failures ? 1 : 0;
+}
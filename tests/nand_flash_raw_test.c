@@ -0,0 +1,397 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the command sequences of nand_flash_raw.c, run on the bus
+ * front end of the NAND model (nand_sim_bus.c): sequential cache read
+ * (31h/3Fh) and cache program (15h) crossing block ends, multi-plane program
+ * (11h), and the placement of the PMECC redundancy read along with the data.
+ * nand_flash_raw.c is included to reach its spare buffer and its page
+ * program sequence.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <string.h>
+
+#include "nvm/nand/nand_flash_raw.c"
+#include "nvm/nand/nand_flash_ecc.h"
+
+#include "nand_sim.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define BLOCK_DATA_SIZE (SIM_PAGES_PER_BLOCK * SIM_PAGE_SIZE)
+
+#define ALL_OPTIONS (NAND_OPT_CACHE_READ | NAND_OPT_CACHE_PROGRAM | \
+		NAND_OPT_MULTIPLANE_PROGRAM | NAND_OPT_MULTIPLANE_CACHE)
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t wbuf[4 * BLOCK_DATA_SIZE];
+
+/* Exactly one block: the sanitizer catches reads past its end */
+static uint8_t rbuf[BLOCK_DATA_SIZE];
+
+static uint8_t spare[NAND_MAX_PAGE_SPARE_SIZE];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _pattern(uint16_t block, uint16_t page, uint8_t *data)
+{
+	uint32_t i;
+
+	for (i = 0; i < SIM_PAGE_SIZE; i++)
+		data[i] = (i >> 3) + block * 31 + page * 7;
+	data[0] = block;
+	data[1] = page;
+}
+
+/** Fill consecutive blocks of wbuf with the pattern of their pages */
+static void _fill(uint16_t block, uint16_t num_blocks)
+{
+	uint16_t i, page;
+
+	for (i = 0; i < num_blocks; i++)
+		for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+			_pattern(block + i, page, wbuf + i * BLOCK_DATA_SIZE +
+					page * SIM_PAGE_SIZE);
+}
+
+/** Store the pattern of a page in the device, with a spare area pattern */
+static void _store(uint16_t block, uint16_t page)
+{
+	uint8_t *raw = nand_sim_page(block, page);
+	uint32_t i;
+
+	_pattern(block, page, raw);
+	for (i = 0; i < SIM_SPARE_SIZE; i++)
+		raw[SIM_PAGE_SIZE + i] = ~(i + page);
+}
+
+static bool _data_ok(uint16_t block, uint16_t page, const uint8_t *data)
+{
+	uint8_t expected[SIM_PAGE_SIZE];
+
+	_pattern(block, page, expected);
+	return !memcmp(data, expected, SIM_PAGE_SIZE);
+}
+
+/** Check that a page holds the pattern, and either an erased spare area or
+ * only the PMECC redundancy of the data */
+static bool _page_ok(uint16_t block, uint16_t page, bool pmecc)
+{
+	const uint8_t *raw = nand_sim_page(block, page);
+	uint8_t ecc[SIM_PMECC_SECTORS * SIM_PMECC_BYTES];
+	uint32_t i;
+
+	if (!_data_ok(block, page, raw))
+		return false;
+
+	nand_sim_pmecc_compute(raw, ecc);
+	for (i = 0; i < SIM_SPARE_SIZE; i++) {
+		uint8_t expected = 0xff;
+
+		if (pmecc && i >= SIM_PMECC_OFFSET &&
+		    i < SIM_PMECC_OFFSET + sizeof(ecc))
+			expected = ecc[i - SIM_PMECC_OFFSET];
+		if (raw[SIM_PAGE_SIZE + i] != expected)
+			return false;
+	}
+	return true;
+}
+
+static bool _blocks_ok(uint16_t block, uint16_t num_blocks, bool pmecc)
+{
+	uint16_t page;
+
+	for (; num_blocks; block++, num_blocks--)
+		for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+			if (!_page_ok(block, page, pmecc))
+				return false;
+	return true;
+}
+
+/** Check that the given buffer holds the spare area of a page up to the end
+ * of the PMECC redundancy */
+static bool _spare_ok(uint16_t block, uint16_t page, const uint8_t *buf)
+{
+	return !memcmp(buf, nand_sim_page(block, page) + SIM_PAGE_SIZE,
+			pmecc_get_ecc_end_address());
+}
+
+static uint32_t _commands(uint8_t cmd)
+{
+	return nand_sim_bus_stats.commands[cmd];
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_cache_read_across_blocks(void)
+{
+	uint16_t block, page, i;
+
+	nand_sim_bus_reset(NAND_OPT_CACHE_READ);
+	for (i = 0; i < 8; i++)
+		_store(3 + (60 + i) / SIM_PAGES_PER_BLOCK,
+		       (60 + i) % SIM_PAGES_PER_BLOCK);
+
+	/* Pages 60 to 63 of block 3, then 0 to 3 of block 4 */
+	CHECK(nand_raw_cache_read_start(&nand_sim, 3, 60) == 0);
+	for (i = 0; i < 8; i++)
+		CHECK(nand_raw_cache_read_page(&nand_sim,
+				rbuf + i * SIM_PAGE_SIZE, NULL, i == 7) == 0);
+
+	for (i = 0; i < 8; i++) {
+		block = 3 + (60 + i) / SIM_PAGES_PER_BLOCK;
+		page = (60 + i) % SIM_PAGES_PER_BLOCK;
+		CHECK(_data_ok(block, page, rbuf + i * SIM_PAGE_SIZE));
+	}
+	CHECK(_commands(NAND_CMD_READ_2) == 1);
+	CHECK(_commands(NAND_CMD_READ_CACHE_SEQ) == 7);
+	CHECK(_commands(NAND_CMD_READ_CACHE_END) == 1);
+	CHECK(nand_sim_bus_stats.block_crossings == 1);
+	CHECK(nand_sim_stats.page_reads == 8);
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_read_block(void)
+{
+	uint16_t page;
+
+	nand_sim_bus_reset(NAND_OPT_CACHE_READ);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		_store(5, page);
+
+	CHECK(nand_raw_read_block(&nand_sim, 5, rbuf) == 0);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		CHECK(_data_ok(5, page, rbuf + page * SIM_PAGE_SIZE));
+	CHECK(_commands(NAND_CMD_READ_2) == 1);
+	CHECK(_commands(NAND_CMD_READ_CACHE_SEQ) == SIM_PAGES_PER_BLOCK - 1);
+	CHECK(_commands(NAND_CMD_READ_CACHE_END) == 1);
+	CHECK(nand_sim_bus_stats.block_crossings == 0);
+
+	/* Without cache read, page by page */
+	nand_sim_bus_reset(0);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		_store(5, page);
+	memset(rbuf, 0, sizeof(rbuf));
+	CHECK(nand_raw_read_block(&nand_sim, 5, rbuf) == 0);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		CHECK(_data_ok(5, page, rbuf + page * SIM_PAGE_SIZE));
+	CHECK(_commands(NAND_CMD_READ_2) == SIM_PAGES_PER_BLOCK);
+	CHECK(_commands(NAND_CMD_READ_CACHE_SEQ) == 0);
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_write_blocks(void)
+{
+	/* Block 3 is not aligned on the planes, 4 and 5 are programmed
+	 * together, 6 has no block left to pair with */
+	nand_sim_bus_reset(ALL_OPTIONS);
+	_fill(3, 4);
+	CHECK(nand_raw_write_blocks(&nand_sim, 3, 4, wbuf) == 0);
+	CHECK(_blocks_ok(3, 4, false));
+	CHECK(_commands(NAND_CMD_WRITE_1) == 4 * SIM_PAGES_PER_BLOCK);
+	CHECK(_commands(NAND_CMD_WRITE_MULTIPLANE) == SIM_PAGES_PER_BLOCK);
+	CHECK(_commands(NAND_CMD_WRITE_CACHE) == 3 * (SIM_PAGES_PER_BLOCK - 1));
+	CHECK(_commands(NAND_CMD_WRITE_2) == 3);
+	CHECK(nand_sim_stats.programs == 4 * SIM_PAGES_PER_BLOCK);
+	CHECK(nand_sim_bus_stats.errors == 0);
+
+	/* Multi-plane program without cache */
+	nand_sim_bus_reset(NAND_OPT_CACHE_PROGRAM | NAND_OPT_MULTIPLANE_PROGRAM);
+	CHECK(nand_raw_write_blocks(&nand_sim, 3, 4, wbuf) == 0);
+	CHECK(_blocks_ok(3, 4, false));
+	CHECK(_commands(NAND_CMD_WRITE_MULTIPLANE) == SIM_PAGES_PER_BLOCK);
+	CHECK(_commands(NAND_CMD_WRITE_CACHE) == 2 * (SIM_PAGES_PER_BLOCK - 1));
+	CHECK(_commands(NAND_CMD_WRITE_2) == 2 + SIM_PAGES_PER_BLOCK);
+	CHECK(nand_sim_bus_stats.errors == 0);
+
+	/* Cache program only */
+	nand_sim_bus_reset(NAND_OPT_CACHE_PROGRAM);
+	_fill(8, 2);
+	CHECK(nand_raw_write_blocks(&nand_sim, 8, 2, wbuf) == 0);
+	CHECK(_blocks_ok(8, 2, false));
+	CHECK(_commands(NAND_CMD_WRITE_MULTIPLANE) == 0);
+	CHECK(_commands(NAND_CMD_WRITE_CACHE) == 2 * (SIM_PAGES_PER_BLOCK - 1));
+	CHECK(_commands(NAND_CMD_WRITE_2) == 2);
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_write_blocks_failure(void)
+{
+	nand_sim_bus_reset(NAND_OPT_CACHE_PROGRAM);
+	nand_sim_fail_program(14);
+	_fill(13, 2);
+
+	/* The first page of block 14 fails */
+	CHECK(nand_raw_write_blocks(&nand_sim, 13, 2, wbuf) ==
+			NAND_ERROR_CANNOTWRITE);
+	CHECK(_blocks_ok(13, 1, false));
+	CHECK(_commands(NAND_CMD_WRITE_CACHE) == SIM_PAGES_PER_BLOCK);
+	CHECK(_commands(NAND_CMD_WRITE_2) == 1);
+
+	/* The next sequence does not inherit the failure */
+	_fill(15, 1);
+	CHECK(nand_raw_write_blocks(&nand_sim, 15, 1, wbuf) == 0);
+	CHECK(_blocks_ok(15, 1, false));
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_pmecc_spare(void)
+{
+	uint16_t block, page, i;
+
+	nand_sim_bus_reset(ALL_OPTIONS);
+	nand_set_ecc_type(ECC_PMECC);
+	_fill(7, 3);
+
+	/* The redundancy is written right after the data of each page */
+	CHECK(nand_raw_write_blocks(&nand_sim, 7, 3, wbuf) == 0);
+	CHECK(_blocks_ok(7, 3, true));
+	CHECK(_commands(NAND_CMD_RANDOM_IN) == 3 * SIM_PAGES_PER_BLOCK);
+
+	/* Block read: the redundancy goes to the driver buffer, the data
+	 * exactly fills the caller buffer */
+	memset(spare_buf, 0, sizeof(spare_buf));
+	CHECK(nand_raw_read_block(&nand_sim, 9, rbuf) == 0);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		CHECK(_data_ok(9, page, rbuf + page * SIM_PAGE_SIZE));
+	CHECK(_spare_ok(9, SIM_PAGES_PER_BLOCK - 1, spare_buf));
+	CHECK(pmecc_error_status() == 0);
+
+	/* Page read, into the last page of the caller buffer */
+	memset(spare_buf, 0, sizeof(spare_buf));
+	CHECK(nand_raw_read_page(&nand_sim, 8, 5,
+			rbuf + BLOCK_DATA_SIZE - SIM_PAGE_SIZE, NULL) == 0);
+	CHECK(_data_ok(8, 5, rbuf + BLOCK_DATA_SIZE - SIM_PAGE_SIZE));
+	CHECK(_spare_ok(8, 5, spare_buf));
+	CHECK(pmecc_error_status() == 0);
+	pmecc_disable();
+
+	/* Cache read across a block end, with the caller spare buffer */
+	CHECK(nand_raw_cache_read_start(&nand_sim, 7, 62) == 0);
+	for (i = 0; i < 4; i++) {
+		block = 7 + (62 + i) / SIM_PAGES_PER_BLOCK;
+		page = (62 + i) % SIM_PAGES_PER_BLOCK;
+		memset(spare, 0, sizeof(spare));
+		CHECK(nand_raw_cache_read_page(&nand_sim, rbuf, spare,
+				i == 3) == 0);
+		CHECK(_data_ok(block, page, rbuf));
+		CHECK(_spare_ok(block, page, spare));
+		CHECK(pmecc_error_status() == 0);
+	}
+	pmecc_disable();
+	CHECK(nand_sim_bus_stats.block_crossings == 1);
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_ecc_read_block_pmecc(void)
+{
+	uint32_t ends;
+	uint16_t page;
+
+	nand_sim_bus_reset(ALL_OPTIONS);
+	nand_set_ecc_type(ECC_PMECC);
+	_fill(10, 2);
+	CHECK(nand_ecc_write_blocks(&nand_sim, 10, 2, wbuf) == 0);
+
+	CHECK(nand_ecc_read_block(&nand_sim, 11, rbuf) == 0);
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+		CHECK(_data_ok(11, page, rbuf + page * SIM_PAGE_SIZE));
+
+	/* An erased block has an erased redundancy */
+	CHECK(nand_ecc_read_block(&nand_sim, 12, rbuf) == 0);
+
+	/* A corrupted page is reported once the sequence is over */
+	nand_sim_page(11, 20)[SIM_PAGE_SIZE + SIM_PMECC_OFFSET] ^= 1;
+	ends = _commands(NAND_CMD_READ_CACHE_END);
+	CHECK(nand_ecc_read_block(&nand_sim, 11, rbuf) ==
+			NAND_ERROR_CORRUPTEDDATA);
+	CHECK(_commands(NAND_CMD_READ_CACHE_END) == ends + 1);
+	CHECK(_data_ok(11, SIM_PAGES_PER_BLOCK - 1,
+			rbuf + BLOCK_DATA_SIZE - SIM_PAGE_SIZE));
+	CHECK(nand_sim_bus_stats.errors == 0);
+}
+
+static void test_model_checks(void)
+{
+	/* The model rejects a multi-plane program of two blocks in the same
+	 * plane, or of different pages (the messages are expected) */
+	nand_sim_bus_reset(ALL_OPTIONS);
+	_fill(4, 1);
+	_program_page(&nand_sim, 4, 0, wbuf, NAND_CMD_WRITE_MULTIPLANE);
+	_program_page(&nand_sim, 6, 0, wbuf, NAND_CMD_WRITE_2);
+	CHECK(nand_sim_bus_stats.errors == 1);
+
+	_program_page(&nand_sim, 8, 0, wbuf, NAND_CMD_WRITE_MULTIPLANE);
+	_program_page(&nand_sim, 9, 1, wbuf, NAND_CMD_WRITE_2);
+	CHECK(nand_sim_bus_stats.errors == 2);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+uint8_t nand_model_list_find(uint32_t chip_id,
+		struct _nand_flash_model *model)
+{
+	return NAND_ERROR_UNKNOWNMODEL;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_cache_read_across_blocks);
+	RUN_TEST(test_read_block);
+	RUN_TEST(test_write_blocks);
+	RUN_TEST(test_write_blocks_failure);
+	RUN_TEST(test_pmecc_spare);
+	RUN_TEST(test_ecc_read_block_pmecc);
+	RUN_TEST(test_model_checks);
+
+	return test_failures ? 1 : 0;
+}
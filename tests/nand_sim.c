@@ -0,0 +1,249 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvm/nand/nand_flash_common.h"
+
+#include "nand_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/** Spare area offset of the ECC bytes written by the ECC page programs */
+#define SIM_ECC_OFFSET 8
+#define SIM_ECC_BYTES  8
+
+struct _sim_page {
+	uint8_t raw[SIM_PAGE_SIZE + SIM_SPARE_SIZE];
+
+	/** Data area programmed since the last erasure */
+	bool programmed;
+
+	/** Data area can't be corrected by the ECC (programmed twice, or
+	 * interrupted while programmed) */
+	bool corrupted;
+
+	/** Bits flipped in the data area since the last erasure */
+	uint8_t flips;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _sim_page pages[SIM_NUM_BLOCKS][SIM_PAGES_PER_BLOCK];
+
+static bool program_fails[SIM_NUM_BLOCKS];
+
+static bool erase_fails[SIM_NUM_BLOCKS];
+
+static uint32_t power_loss_countdown;
+
+static jmp_buf *power_loss_env;
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+struct _nand_flash nand_sim;
+
+struct _nand_sim_stats nand_sim_stats;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _sim_page *_sim_get_page(uint16_t block, uint16_t page)
+{
+	if (block >= SIM_NUM_BLOCKS || page >= SIM_PAGES_PER_BLOCK) {
+		fprintf(stderr, "nand_sim: access out of device, block %u page %u\n",
+				block, page);
+		abort();
+	}
+	return &pages[block][page];
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: device array                              */
+/*---------------------------------------------------------------------- */
+
+void nand_sim_read(uint16_t block, uint16_t page, uint8_t *data,
+		uint8_t *spare, bool flipped)
+{
+	const struct _sim_page *p = _sim_get_page(block, page);
+	uint8_t i;
+
+	if (data) {
+		nand_sim_stats.page_reads++;
+		memcpy(data, p->raw, SIM_PAGE_SIZE);
+		for (i = 0; flipped && i < p->flips; i++)
+			data[(i * 397) % SIM_PAGE_SIZE] ^= 1 << (i % 8);
+	} else {
+		nand_sim_stats.spare_reads++;
+	}
+	if (spare)
+		memcpy(spare, p->raw + SIM_PAGE_SIZE, SIM_SPARE_SIZE);
+}
+
+uint8_t nand_sim_program(uint16_t block, uint16_t page,
+		const uint8_t *data, const uint8_t *spare, bool ecc)
+{
+	struct _sim_page *p = _sim_get_page(block, page);
+	uint32_t size = SIM_PAGE_SIZE;
+	uint32_t i;
+	bool torn = false;
+
+	nand_sim_stats.programs++;
+	if (power_loss_env) {
+		if (!power_loss_countdown) {
+			torn = true;
+			size /= 2;
+		} else {
+			power_loss_countdown--;
+		}
+	}
+
+	if (program_fails[block])
+		return NAND_ERROR_CANNOTWRITE;
+
+	/* Programming can only clear bits */
+	if (data) {
+		if (p->programmed)
+			p->corrupted = true;
+		p->programmed = true;
+		for (i = 0; i < size; i++)
+			p->raw[i] &= data[i];
+	}
+	if (spare)
+		for (i = 0; i < SIM_SPARE_SIZE; i++)
+			p->raw[SIM_PAGE_SIZE + i] &= spare[i];
+	if (ecc)
+		memset(p->raw + SIM_PAGE_SIZE + SIM_ECC_OFFSET, 0, SIM_ECC_BYTES);
+
+	if (torn) {
+		jmp_buf *env = power_loss_env;
+
+		p->corrupted = true;
+		power_loss_env = NULL;
+		longjmp(*env, 1);
+	}
+	return 0;
+}
+
+uint8_t nand_sim_erase(uint16_t block)
+{
+	uint16_t page;
+
+	_sim_get_page(block, 0);
+	nand_sim_stats.erases++;
+	if (erase_fails[block])
+		return NAND_ERROR_BADBLOCK;
+
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++) {
+		memset(&pages[block][page], 0, sizeof(pages[block][page]));
+		memset(pages[block][page].raw, 0xff,
+				sizeof(pages[block][page].raw));
+	}
+	return 0;
+}
+
+bool nand_sim_is_correctable(uint16_t block, uint16_t page)
+{
+	const struct _sim_page *p = _sim_get_page(block, page);
+
+	return !p->corrupted && p->flips <= SIM_ECC_BITS;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: test control                              */
+/*---------------------------------------------------------------------- */
+
+void nand_sim_reset(void)
+{
+	uint16_t block, page;
+
+	memset(pages, 0, sizeof(pages));
+	for (block = 0; block < SIM_NUM_BLOCKS; block++)
+		for (page = 0; page < SIM_PAGES_PER_BLOCK; page++)
+			memset(pages[block][page].raw, 0xff,
+					sizeof(pages[block][page].raw));
+	memset(program_fails, 0, sizeof(program_fails));
+	memset(erase_fails, 0, sizeof(erase_fails));
+	memset(&nand_sim_stats, 0, sizeof(nand_sim_stats));
+	power_loss_env = NULL;
+
+	memset(&nand_sim, 0, sizeof(nand_sim));
+	nand_sim.model.data_bus_width = 8;
+	nand_sim.model.page_size = SIM_PAGE_SIZE;
+	nand_sim.model.spare_size = SIM_SPARE_SIZE;
+	nand_sim.model.block_size = SIM_PAGES_PER_BLOCK * SIM_PAGE_SIZE;
+	nand_sim.model.device_size = SIM_NUM_BLOCKS *
+		(SIM_PAGES_PER_BLOCK * SIM_PAGE_SIZE / 1024) / 1024;
+	nand_sim.badblock_marker_pos = 0;
+}
+
+void nand_sim_set_factory_bad(uint16_t block, uint16_t page)
+{
+	_sim_get_page(block, page)->raw[SIM_PAGE_SIZE +
+		nand_sim.badblock_marker_pos] = 0;
+}
+
+void nand_sim_fail_program(uint16_t block)
+{
+	program_fails[block] = true;
+}
+
+void nand_sim_fail_erase(uint16_t block)
+{
+	erase_fails[block] = true;
+}
+
+void nand_sim_flip_bits(uint16_t block, uint16_t page, uint8_t count)
+{
+	_sim_get_page(block, page)->flips += count;
+}
+
+void nand_sim_power_loss(uint32_t programs, jmp_buf *env)
+{
+	power_loss_countdown = programs;
+	power_loss_env = env;
+}
+
+uint8_t *nand_sim_page(uint16_t block, uint16_t page)
+{
+	return _sim_get_page(block, page)->raw;
+}
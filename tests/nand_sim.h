@@ -0,0 +1,166 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * RAM-backed model of a NAND flash device for the host tests, with injected
+ * bad blocks, program and erase failures, bit flips and power losses. The
+ * device array (nand_sim.c) has two front ends:
+ *
+ * - nand_sim_pages.c stands in for the raw and ECC page accesses of the
+ *   driver, so that the layers above them (bad block table, skip block,
+ *   logical block mapping) can be run on a PC;
+ * - nand_sim_bus.c stands in for the bus accesses of nand_flash.c, the DMA
+ *   transfers and the PMECC, so that nand_flash_raw.c itself can be run,
+ *   down to its command sequences (cache read, cache and multi-plane
+ *   program).
+ */
+
+#ifndef NAND_SIM_H
+#define NAND_SIM_H
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nvm/nand/nand_flash.h"
+
+/*---------------------------------------------------------------------- */
+/*         Definitions                                                   */
+/*---------------------------------------------------------------------- */
+
+#define SIM_NUM_BLOCKS      256
+#define SIM_PAGES_PER_BLOCK 64
+#define SIM_PAGE_SIZE       2048
+#define SIM_SPARE_SIZE      64
+
+/** Number of bit errors per page corrected by the ECC */
+#define SIM_ECC_BITS        4
+
+/** Planes of the device seen through the bus, block n being in plane n % 2 */
+#define SIM_NUM_PLANES      2
+
+/** Data address of the device seen through the bus */
+#define SIM_DATA_ADDR       0x40000000
+
+/** PMECC seen through the bus: 4 sectors of 512 bytes, each one with 8
+ * bytes of redundancy, stored from the given offset of the spare area */
+#define SIM_PMECC_SECTORS   4
+#define SIM_PMECC_BYTES     8
+#define SIM_PMECC_OFFSET    16
+
+/*---------------------------------------------------------------------- */
+/*         Types                                                         */
+/*---------------------------------------------------------------------- */
+
+struct _nand_sim_stats {
+	uint32_t page_reads;   /**< Reads of the data area of a page */
+	uint32_t spare_reads;  /**< Reads of the spare area only */
+	uint32_t programs;
+	uint32_t erases;
+};
+
+struct _nand_sim_bus_stats {
+	/** Number of times each command was issued */
+	uint32_t commands[256];
+
+	/** Sequential cache reads (31h) which loaded the first page of a
+	 * block, following the last page of the previous one */
+	uint32_t block_crossings;
+
+	/** Command sequences a device would not accept: unknown command,
+	 * wrong number of address cycles, data transfer out of the page
+	 * register, multi-plane program of pages not in distinct planes or
+	 * at different page addresses. Details are printed on stderr. */
+	uint32_t errors;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+/** Device handle given to the driver, initialized by nand_sim_reset() */
+extern struct _nand_flash nand_sim;
+
+extern struct _nand_sim_stats nand_sim_stats;
+
+extern struct _nand_sim_bus_stats nand_sim_bus_stats;
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+/** Erase the whole device and clear all injected faults and statistics */
+extern void nand_sim_reset(void);
+
+/** Write a factory bad block marker in the given page (0 or 1) of a block */
+extern void nand_sim_set_factory_bad(uint16_t block, uint16_t page);
+
+/** Make every program (resp. erase) of a block fail from now on */
+extern void nand_sim_fail_program(uint16_t block);
+extern void nand_sim_fail_erase(uint16_t block);
+
+/** Flip bits in the data area of a page, as seen by the ECC reads, until the
+ * block is erased. More than SIM_ECC_BITS flips make the page uncorrectable. */
+extern void nand_sim_flip_bits(uint16_t block, uint16_t page, uint8_t count);
+
+/** Cut the power after the given number of further page programs: the next
+ * one only programs half of its data, then longjmp(env, 1) is called */
+extern void nand_sim_power_loss(uint32_t programs, jmp_buf *env);
+
+/** Direct access to the contents of a page, data then spare area */
+extern uint8_t *nand_sim_page(uint16_t block, uint16_t page);
+
+/** Device array accesses, for the front ends. The read returns the flipped
+ * bits if requested, the program fails as injected (returning
+ * NAND_ERROR_CANNOTWRITE) and clears the spare area ECC bytes if requested. */
+extern void nand_sim_read(uint16_t block, uint16_t page, uint8_t *data,
+		uint8_t *spare, bool flipped);
+extern uint8_t nand_sim_program(uint16_t block, uint16_t page,
+		const uint8_t *data, const uint8_t *spare, bool ecc);
+extern uint8_t nand_sim_erase(uint16_t block);
+
+/** True if the data area of a page can be corrected by the ECC */
+extern bool nand_sim_is_correctable(uint16_t block, uint16_t page);
+
+/** Reset the device as nand_sim_reset() does, then describe it as a device
+ * accessed through the bus: SIM_DATA_ADDR, SIM_NUM_PLANES planes and the
+ * given NAND_OPT_xxx options. The ECC type is set back to ECC_NO. */
+extern void nand_sim_bus_reset(uint8_t options);
+
+/** Redundancy the PMECC model computes for the data area of a page, which
+ * is SIM_PMECC_SECTORS * SIM_PMECC_BYTES bytes long */
+extern void nand_sim_pmecc_compute(const uint8_t *data, uint8_t *ecc);
+
+#endif /* NAND_SIM_H */
@@ -0,0 +1,717 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvm/nand/nand_flash.h"
+#include "nvm/nand/nand_flash_commands.h"
+#include "nvm/nand/nand_flash_dma.h"
+#include "nvm/nand/pmecc.h"
+
+#include "nand_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SIM_RAW_SIZE      (SIM_PAGE_SIZE + SIM_SPARE_SIZE)
+#define SIM_NUM_ROWS      (SIM_NUM_BLOCKS * SIM_PAGES_PER_BLOCK)
+
+/** Column address cycles of a 2048 byte page */
+#define SIM_COL_CYCLES    2
+
+/** Size of the address space of the data, the ALE and CLE lines being
+ * address lines above it */
+#define SIM_DATA_SPAN     0x200000
+
+/** Status reads returning busy after an array operation, so that the driver
+ * has to poll */
+#define SIM_BUSY_READS    2
+
+/** Page register of the device, with the row of the page it holds */
+struct _sim_reg {
+	uint8_t buf[SIM_RAW_SIZE];
+	uint32_t row;
+};
+
+enum _sim_output {
+	OUTPUT_NONE,
+	OUTPUT_STATUS,
+	OUTPUT_DATA,
+};
+
+enum _sim_pmecc {
+	PMECC_OFF,
+	PMECC_READ,
+	PMECC_WRITE,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t ecc_type;
+
+/* Command sequence in progress */
+static uint8_t command;
+static uint8_t address[5];
+static uint8_t num_address;
+static enum _sim_output output;
+
+/* Data register, loaded from the array by 30h and 31h, and cache register,
+ * transferred out during a cache read */
+static struct _sim_reg data_reg;
+static struct _sim_reg cache_reg;
+static bool data_reg_loaded;
+
+/* Page being loaded by 80h and 85h, and pages loaded for the other planes
+ * by 11h */
+static struct _sim_reg program_reg;
+static bool program_started;
+static bool program_address_latched;
+static struct _sim_reg plane_regs[SIM_NUM_PLANES - 1];
+static uint8_t num_planes_loaded;
+
+/* Register and column of the next data transfer */
+static uint8_t *io_reg;
+static uint32_t io_column;
+
+static uint8_t status;
+static bool cache_programming;
+static uint8_t rdy_busy;
+static uint8_t ardy_busy;
+
+static enum _sim_pmecc pmecc_mode;
+static bool pmecc_data_phase;
+static uint32_t pmecc_data_count;
+static uint8_t pmecc_data[SIM_PAGE_SIZE];
+static uint8_t pmecc_ecc[SIM_PMECC_SECTORS * SIM_PMECC_BYTES];
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+struct _nand_sim_bus_stats nand_sim_bus_stats;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _bus_error(const char *fmt, ...)
+{
+	va_list ap;
+
+	nand_sim_bus_stats.errors++;
+	fprintf(stderr, "nand_sim: command %02xh: ", command);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+static uint8_t _row_cycles(void)
+{
+	uint32_t num_rows = SIM_NUM_ROWS;
+	uint8_t cycles = 0;
+
+	while (num_rows > 0) {
+		cycles++;
+		num_rows >>= 8;
+	}
+	return cycles;
+}
+
+/**
+ * Decode the address cycles of the current command, which carry a column
+ * and/or a row address. Returns false if there is not the expected number of
+ * cycles or if the address is out of the device.
+ */
+static bool _decode_address(uint32_t *column, uint32_t *row)
+{
+	uint8_t expected = (column ? SIM_COL_CYCLES : 0) +
+		(row ? _row_cycles() : 0);
+	uint8_t i = 0, shift;
+
+	if (num_address != expected) {
+		_bus_error("%u address cycles, %u expected", num_address,
+				expected);
+		return false;
+	}
+	if (column) {
+		*column = 0;
+		for (shift = 0; i < SIM_COL_CYCLES; i++, shift += 8)
+			*column |= address[i] << shift;
+		if (*column >= SIM_RAW_SIZE) {
+			_bus_error("column %u out of the page", *column);
+			return false;
+		}
+	}
+	if (row) {
+		*row = 0;
+		for (shift = 0; i < num_address; i++, shift += 8)
+			*row |= address[i] << shift;
+		if (*row >= SIM_NUM_ROWS) {
+			_bus_error("row %u out of the device", *row);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void _busy(uint8_t rdy, uint8_t ardy)
+{
+	rdy_busy = rdy;
+	ardy_busy = ardy;
+}
+
+static void _load_data_reg(uint32_t row)
+{
+	nand_sim_read(row / SIM_PAGES_PER_BLOCK, row % SIM_PAGES_PER_BLOCK,
+			data_reg.buf, data_reg.buf + SIM_PAGE_SIZE, true);
+	data_reg.row = row;
+	data_reg_loaded = true;
+}
+
+/** Address cycles of 80h and 85h are only known once the data comes in, or
+ * once the program is confirmed */
+static void _latch_program_address(void)
+{
+	uint32_t column, row;
+
+	if (program_address_latched)
+		return;
+	program_address_latched = true;
+
+	if (command == NAND_CMD_WRITE_1) {
+		if (!_decode_address(&column, &row))
+			return;
+		program_reg.row = row;
+	} else {
+		if (!_decode_address(&column, NULL))
+			return;
+	}
+	io_reg = program_reg.buf;
+	io_column = column;
+}
+
+/** Checks that a page loaded for a multi-plane program can be programmed
+ * with the ones already loaded: same page, distinct planes */
+static void _check_plane(uint32_t row)
+{
+	uint32_t block = row / SIM_PAGES_PER_BLOCK;
+	uint8_t i;
+
+	for (i = 0; i < num_planes_loaded; i++) {
+		uint32_t other = plane_regs[i].row / SIM_PAGES_PER_BLOCK;
+
+		if ((other % SIM_NUM_PLANES) == (block % SIM_NUM_PLANES))
+			_bus_error("blocks %u and %u in the same plane",
+					other, block);
+		if ((plane_regs[i].row % SIM_PAGES_PER_BLOCK) !=
+		    (row % SIM_PAGES_PER_BLOCK))
+			_bus_error("rows %u and %u at different pages",
+					plane_regs[i].row, row);
+	}
+}
+
+static uint8_t _program_reg(const struct _sim_reg *reg)
+{
+	return nand_sim_program(reg->row / SIM_PAGES_PER_BLOCK,
+			reg->row % SIM_PAGES_PER_BLOCK,
+			reg->buf, reg->buf + SIM_PAGE_SIZE, false);
+}
+
+static void _confirm_program(uint8_t cmd)
+{
+	uint8_t fail = 0;
+	uint8_t i;
+
+	if (!program_started) {
+		_bus_error("no page loaded");
+		return;
+	}
+	program_started = false;
+	_check_plane(program_reg.row);
+
+	if (cmd == NAND_CMD_WRITE_MULTIPLANE) {
+		if (num_planes_loaded == SIM_NUM_PLANES - 1) {
+			_bus_error("more pages than planes");
+			return;
+		}
+		plane_regs[num_planes_loaded++] = program_reg;
+		_busy(1, 1);
+		return;
+	}
+
+	for (i = 0; i < num_planes_loaded; i++)
+		if (_program_reg(&plane_regs[i]))
+			fail = NAND_STATUS_FAIL;
+	if (_program_reg(&program_reg))
+		fail = NAND_STATUS_FAIL;
+	num_planes_loaded = 0;
+
+	/* Within a cache program, FAILC reports the previous page */
+	if (cache_programming && (status & NAND_STATUS_FAIL))
+		fail |= NAND_STATUS_FAILC;
+	status = fail;
+	cache_programming = cmd == NAND_CMD_WRITE_CACHE;
+	if (cmd == NAND_CMD_WRITE_CACHE)
+		_busy(1, SIM_BUSY_READS + 1);
+	else
+		_busy(SIM_BUSY_READS, SIM_BUSY_READS);
+}
+
+static void _cache_read(bool last)
+{
+	uint32_t row;
+
+	if (!data_reg_loaded) {
+		_bus_error("no page read");
+		return;
+	}
+	cache_reg = data_reg;
+	io_reg = cache_reg.buf;
+	io_column = 0;
+	output = OUTPUT_DATA;
+
+	if (last) {
+		data_reg_loaded = false;
+		_busy(1, 1);
+		return;
+	}
+
+	row = data_reg.row + 1;
+	if (row >= SIM_NUM_ROWS) {
+		_bus_error("read beyond the last page");
+		data_reg_loaded = false;
+		return;
+	}
+	if ((row % SIM_PAGES_PER_BLOCK) == 0)
+		nand_sim_bus_stats.block_crossings++;
+	_load_data_reg(row);
+	_busy(1, SIM_BUSY_READS + 1);
+}
+
+static void _pmecc_feed(uint32_t column, const uint8_t *data, uint32_t size)
+{
+	uint32_t i;
+
+	if (pmecc_mode == PMECC_OFF || !pmecc_data_phase)
+		return;
+
+	for (i = 0; i < size; i++, column++) {
+		if (column < SIM_PAGE_SIZE) {
+			pmecc_data[column] = data[i];
+			pmecc_data_count++;
+		} else if (pmecc_mode == PMECC_READ &&
+		           column >= SIM_PAGE_SIZE + SIM_PMECC_OFFSET &&
+		           column < SIM_PAGE_SIZE + SIM_PMECC_OFFSET +
+		                    sizeof(pmecc_ecc)) {
+			pmecc_ecc[column - SIM_PAGE_SIZE - SIM_PMECC_OFFSET] =
+				data[i];
+		}
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: test control                              */
+/*---------------------------------------------------------------------- */
+
+void nand_sim_bus_reset(uint8_t options)
+{
+	nand_sim_reset();
+	nand_sim.model.options = options;
+	nand_sim.model.num_planes = SIM_NUM_PLANES;
+	nand_sim.data_addr = SIM_DATA_ADDR;
+
+	memset(&nand_sim_bus_stats, 0, sizeof(nand_sim_bus_stats));
+	ecc_type = ECC_NO;
+	command = NAND_CMD_RESET;
+	num_address = 0;
+	output = OUTPUT_NONE;
+	data_reg_loaded = false;
+	program_started = false;
+	num_planes_loaded = 0;
+	io_reg = NULL;
+	status = 0;
+	cache_programming = false;
+	_busy(0, 0);
+	pmecc_mode = PMECC_OFF;
+	pmecc_data_phase = false;
+}
+
+void nand_sim_pmecc_compute(const uint8_t *data, uint8_t *ecc)
+{
+	uint32_t i, j, k;
+	uint8_t sum;
+
+	/* Sum of the bytes of each lane of a sector, enough for a model:
+	 * any change of a single byte changes the redundancy */
+	for (i = 0; i < SIM_PMECC_SECTORS; i++) {
+		for (j = 0; j < SIM_PMECC_BYTES; j++) {
+			sum = i * SIM_PMECC_BYTES + j;
+			for (k = j; k < SIM_PAGE_SIZE / SIM_PMECC_SECTORS;
+			     k += SIM_PMECC_BYTES)
+				sum += data[i * SIM_PAGE_SIZE /
+				            SIM_PMECC_SECTORS + k];
+			ecc[i * SIM_PMECC_BYTES + j] = sum;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: bus (nand_flash.c)                        */
+/*---------------------------------------------------------------------- */
+
+void nand_write_command(const struct _nand_flash *nand, uint8_t cmd)
+{
+	uint32_t column, row;
+
+	nand_sim_bus_stats.commands[cmd]++;
+
+	switch (cmd) {
+	case NAND_CMD_READ_1:
+	case NAND_CMD_WRITE_1:
+	case NAND_CMD_ERASE_1:
+		/* Also re-enters data output after a status read, if no
+		 * address follows */
+		command = cmd;
+		num_address = 0;
+		if (cmd == NAND_CMD_READ_1) {
+			output = OUTPUT_DATA;
+		} else if (cmd == NAND_CMD_WRITE_1) {
+			memset(program_reg.buf, 0xff, sizeof(program_reg.buf));
+			program_started = true;
+			program_address_latched = false;
+		}
+		break;
+
+	case NAND_CMD_RANDOM_IN:
+		if (!program_started) {
+			_bus_error("no page loaded");
+			break;
+		}
+		_latch_program_address();
+		command = cmd;
+		num_address = 0;
+		program_address_latched = false;
+		break;
+
+	case NAND_CMD_READ_2:
+		if (command != NAND_CMD_READ_1) {
+			_bus_error("30h not following 00h");
+			break;
+		}
+		command = cmd;
+		if (!_decode_address(&column, &row))
+			break;
+		_load_data_reg(row);
+		io_reg = data_reg.buf;
+		io_column = column;
+		output = OUTPUT_DATA;
+		_busy(SIM_BUSY_READS, SIM_BUSY_READS);
+		break;
+
+	case NAND_CMD_READ_CACHE_SEQ:
+	case NAND_CMD_READ_CACHE_END:
+		command = cmd;
+		_cache_read(cmd == NAND_CMD_READ_CACHE_END);
+		break;
+
+	case NAND_CMD_WRITE_2:
+	case NAND_CMD_WRITE_CACHE:
+	case NAND_CMD_WRITE_MULTIPLANE:
+		if (program_started)
+			_latch_program_address();
+		command = cmd;
+		_confirm_program(cmd);
+		break;
+
+	case NAND_CMD_ERASE_2:
+		if (command != NAND_CMD_ERASE_1) {
+			_bus_error("D0h not following 60h");
+			break;
+		}
+		command = cmd;
+		if (!_decode_address(NULL, &row))
+			break;
+		status = nand_sim_erase(row / SIM_PAGES_PER_BLOCK) ?
+			NAND_STATUS_FAIL : 0;
+		cache_programming = false;
+		_busy(SIM_BUSY_READS, SIM_BUSY_READS);
+		break;
+
+	case NAND_CMD_STATUS:
+		output = OUTPUT_STATUS;
+		break;
+
+	case NAND_CMD_RESET:
+		command = cmd;
+		num_address = 0;
+		output = OUTPUT_NONE;
+		data_reg_loaded = false;
+		program_started = false;
+		num_planes_loaded = 0;
+		status = 0;
+		cache_programming = false;
+		_busy(1, 1);
+		break;
+
+	default:
+		command = cmd;
+		_bus_error("not supported");
+		break;
+	}
+}
+
+void nand_write_address(const struct _nand_flash *nand, uint8_t addr)
+{
+	if (num_address == sizeof(address)) {
+		_bus_error("too many address cycles");
+		return;
+	}
+	address[num_address++] = addr;
+}
+
+void nand_write_address16(const struct _nand_flash *nand, uint16_t addr)
+{
+	_bus_error("16-bit bus not supported");
+}
+
+uint8_t nand_read_data(const struct _nand_flash *nand)
+{
+	uint8_t value = status;
+
+	if (output == OUTPUT_DATA) {
+		if (!io_reg || io_column >= SIM_RAW_SIZE) {
+			_bus_error("data read out of the page register");
+			return 0xff;
+		}
+		return io_reg[io_column++];
+	}
+
+	if (output != OUTPUT_STATUS) {
+		_bus_error("data read with no output");
+		return 0xff;
+	}
+
+	if (rdy_busy)
+		rdy_busy--;
+	else
+		value |= NAND_STATUS_RDY;
+	if (ardy_busy)
+		ardy_busy--;
+	else
+		value |= NAND_STATUS_ARDY;
+	return value;
+}
+
+void nand_set_ecc_type(uint8_t type)
+{
+	ecc_type = type;
+}
+
+bool nand_is_using_pmecc(void)
+{
+	return ecc_type == ECC_PMECC;
+}
+
+bool nand_is_using_no_ecc(void)
+{
+	return ecc_type == ECC_NO;
+}
+
+bool nand_is_dma_enabled(void)
+{
+	/* The byte by byte accesses of the driver go to the bus addresses,
+	 * which do not exist on the host */
+	return true;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: DMA (nand_flash_dma.c)                    */
+/*---------------------------------------------------------------------- */
+
+uint8_t nand_dma_read(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	if (src_address != SIM_DATA_ADDR) {
+		_bus_error("read from 0x%08x", src_address);
+		return 0;
+	}
+	if (output != OUTPUT_DATA || !io_reg || io_reg == program_reg.buf) {
+		_bus_error("data read with no output");
+		return 0;
+	}
+	if (io_column + size > SIM_RAW_SIZE) {
+		_bus_error("read of %u bytes at column %u", size, io_column);
+		return 0;
+	}
+
+	memcpy((void*)dest_address, io_reg + io_column, size);
+	_pmecc_feed(io_column, io_reg + io_column, size);
+	io_column += size;
+	return 0;
+}
+
+uint8_t nand_dma_write(uint32_t src_address, uint32_t dest_address,
+		uint32_t size)
+{
+	if (dest_address < SIM_DATA_ADDR ||
+	    dest_address >= SIM_DATA_ADDR + SIM_DATA_SPAN) {
+		_bus_error("write to 0x%08x", dest_address);
+		return 0;
+	}
+	if (!program_started) {
+		_bus_error("data written with no page loaded");
+		return 0;
+	}
+	_latch_program_address();
+	if (io_column + size > SIM_RAW_SIZE) {
+		_bus_error("write of %u bytes at column %u", size, io_column);
+		return 0;
+	}
+
+	memcpy(io_reg + io_column, (const void*)src_address, size);
+	_pmecc_feed(io_column, io_reg + io_column, size);
+	io_column += size;
+	return 0;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions: PMECC (pmecc.c)                           */
+/*---------------------------------------------------------------------- */
+
+void pmecc_reset(void)
+{
+	pmecc_data_phase = false;
+	pmecc_data_count = 0;
+	memset(pmecc_ecc, 0xff, sizeof(pmecc_ecc));
+}
+
+void pmecc_enable_read(void)
+{
+	pmecc_mode = PMECC_READ;
+}
+
+void pmecc_enable_write(void)
+{
+	pmecc_mode = PMECC_WRITE;
+}
+
+void pmecc_disable(void)
+{
+	pmecc_mode = PMECC_OFF;
+	pmecc_data_phase = false;
+}
+
+void pmecc_start_data_phase(void)
+{
+	if (pmecc_mode == PMECC_OFF)
+		_bus_error("PMECC data phase with the PMECC disabled");
+	pmecc_data_phase = true;
+	pmecc_data_count = 0;
+}
+
+bool pmecc_auto_spare_en(void)
+{
+	return false;
+}
+
+void pmecc_auto_enable(void)
+{
+}
+
+void pmecc_auto_disable(void)
+{
+}
+
+void pmecc_wait_ready(void)
+{
+	if (pmecc_data_count != SIM_PAGE_SIZE)
+		_bus_error("PMECC data phase of %u bytes", pmecc_data_count);
+}
+
+uint32_t pmecc_get_sectors_per_page(void)
+{
+	return SIM_PMECC_SECTORS;
+}
+
+uint32_t pmecc_get_ecc_bytes_per_page(void)
+{
+	return SIM_PMECC_SECTORS * SIM_PMECC_BYTES;
+}
+
+uint32_t pmecc_get_ecc_start_address(void)
+{
+	return SIM_PMECC_OFFSET;
+}
+
+uint32_t pmecc_get_ecc_end_address(void)
+{
+	return SIM_PMECC_OFFSET + SIM_PMECC_SECTORS * SIM_PMECC_BYTES;
+}
+
+uint8_t pmecc_value(uint32_t sector_index, uint32_t byte_index)
+{
+	uint8_t ecc[SIM_PMECC_SECTORS * SIM_PMECC_BYTES];
+
+	if (pmecc_mode != PMECC_WRITE)
+		_bus_error("PMECC value read with the PMECC not encoding");
+	nand_sim_pmecc_compute(pmecc_data, ecc);
+	return ecc[sector_index * SIM_PMECC_BYTES + byte_index];
+}
+
+uint32_t pmecc_error_status(void)
+{
+	uint8_t ecc[SIM_PMECC_SECTORS * SIM_PMECC_BYTES];
+	uint32_t sectors = 0;
+	uint32_t i;
+
+	if (pmecc_mode != PMECC_READ)
+		_bus_error("PMECC status read with the PMECC not decoding");
+	nand_sim_pmecc_compute(pmecc_data, ecc);
+	for (i = 0; i < SIM_PMECC_SECTORS; i++)
+		if (memcmp(ecc + i * SIM_PMECC_BYTES,
+		           pmecc_ecc + i * SIM_PMECC_BYTES, SIM_PMECC_BYTES))
+			sectors |= 1 << i;
+	return sectors;
+}
+
+uint32_t pmecc_correction(uint32_t pmecc_status, uint32_t page_buffer)
+{
+	/* Errors are detected, not located: they can't be corrected */
+	return pmecc_status ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Page level front end of the NAND model: stands in for the raw and ECC page
+ * accesses of the driver (nand_flash_raw.c, nand_flash_ecc.c) and for the
+ * model getters they rely on.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stddef.h>
+
+#include "nvm/nand/nand_flash_ecc.h"
+#include "nvm/nand/nand_flash_raw.h"
+
+#include "nand_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+uint16_t nand_model_get_device_size_in_blocks(
+		const struct _nand_flash_model *model)
+{
+	return (model->device_size * 1024) / (model->block_size / 1024);
+}
+
+uint16_t nand_model_get_block_size_in_pages(
+		const struct _nand_flash_model *model)
+{
+	return model->block_size / model->page_size;
+}
+
+uint32_t nand_model_get_page_data_size(const struct _nand_flash_model *model)
+{
+	return model->page_size;
+}
+
+uint16_t nand_model_get_page_spare_size(const struct _nand_flash_model *model)
+{
+	return model->spare_size;
+}
+
+uint8_t nand_raw_erase_block(const struct _nand_flash *nand, uint16_t block)
+{
+	return nand_sim_erase(block);
+}
+
+uint8_t nand_raw_read_page(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data, void *spare)
+{
+	nand_sim_read(block, page, data, spare, true);
+	return 0;
+}
+
+uint8_t nand_raw_write_page(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data, void *spare)
+{
+	return nand_sim_program(block, page, data, spare, false);
+}
+
+uint8_t nand_ecc_read_page(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data, void *spare)
+{
+	bool correctable = nand_sim_is_correctable(block, page);
+
+	nand_sim_read(block, page, data, spare, !correctable);
+	return correctable ? 0 : NAND_ERROR_CORRUPTEDDATA;
+}
+
+uint8_t nand_ecc_write_page(const struct _nand_flash *nand,
+		uint16_t block, uint16_t page, void *data, void *spare)
+{
+	return nand_sim_program(block, page, data, spare, true);
+}
+
+uint8_t nand_ecc_read_block(const struct _nand_flash *nand,
+		uint16_t block, void *data)
+{
+	uint16_t page;
+	uint8_t error;
+
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++) {
+		error = nand_ecc_read_page(nand, block, page,
+				(uint8_t*)data + page * SIM_PAGE_SIZE, NULL);
+		if (error)
+			return error;
+	}
+	return 0;
+}
+
+uint8_t nand_ecc_write_block(const struct _nand_flash *nand,
+		uint16_t block, void *data)
+{
+	uint16_t page;
+	uint8_t error;
+
+	for (page = 0; page < SIM_PAGES_PER_BLOCK; page++) {
+		error = nand_ecc_write_page(nand, block, page,
+				(uint8_t*)data + page * SIM_PAGE_SIZE, NULL);
+		if (error)
+			return error;
+	}
+	return 0;
+}
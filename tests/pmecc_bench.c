@@ -0,0 +1,182 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Decoding time of the PMECC BCH decoder on the build machine, against the
+ * previous one (pmecc_ref.h): syndromes, error location polynomial and
+ * Chien search of a sector with 0 to tt bit errors, for 512- and 1024-byte
+ * sectors. Absolute numbers only compare the implementations on the same
+ * host: they say nothing of the Cortex-A5 targets, and the previous decoder
+ * relied on the PMERRLOC for the Chien search where the chip has one.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CONFIG_PMECC_SW_ERROR_LOCATION
+
+#include "chip.h"
+
+/* The PMECC registers are a RAM instance filled by the benchmark */
+static Pmecc pmecc_regs;
+#undef PMECC
+#define PMECC (&pmecc_regs)
+
+#include "nvm/nand/pmecc.c"
+
+#include "pmecc_ref.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+/* Error patterns per case, and passes over them */
+#define PATTERNS 64
+#define PASSES   20
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+/* Remainders of the patterns of the current case */
+static uint32_t remainders[PATTERNS][ARRAY_SIZE(pmecc_regs.PMECC_REM[0].PMECC_REM)];
+
+static volatile int32_t sink;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _fill_patterns(uint32_t bits, uint32_t errors)
+{
+	uint32_t pos[PMECC_NB_ERROR_MAX];
+	uint32_t n, i, j;
+
+	for (n = 0; n < PATTERNS; n++) {
+		for (i = 0; i < errors; i++) {
+			do {
+				pos[i] = 1 + rand() % bits;
+				for (j = 0; j < i && pos[j] != pos[i]; j++);
+			} while (j < i);
+		}
+		_set_remainders(pos, errors);
+		memcpy(remainders[n], &pmecc_regs.PMECC_REM[0],
+		       sizeof(remainders[n]));
+	}
+}
+
+/* Decode every pattern PASSES times, return the time per sector in us */
+static double _decode(bool previous, uint32_t bits, uint32_t errors)
+{
+	double start;
+	uint32_t pass, n;
+	int32_t found;
+
+	start = _now();
+	for (pass = 0; pass < PASSES; pass++) {
+		for (n = 0; n < PATTERNS; n++) {
+			memcpy(&pmecc_regs.PMECC_REM[0], remainders[n],
+			       sizeof(remainders[n]));
+			gen_partial_syndromes(0);
+			if (previous) {
+				ref_substitute();
+				ref_get_sigma();
+				found = ref_error_location(bits);
+			} else {
+				substitute();
+				get_sigma();
+				found = error_location(bits);
+			}
+			if (found != (int32_t)errors)
+				printf("decoding failure\n");
+			sink = found;
+		}
+	}
+
+	return (_now() - start) * 1e6 / (PASSES * PATTERNS);
+}
+
+static void _bench(uint8_t sector_size, uint8_t tt)
+{
+	uint32_t bytes = sector_size ? 1024 : 512;
+	uint32_t errors[] = { 0, 1, tt / 2, tt };
+	uint32_t bits, i;
+	double old_us, new_us;
+
+	pmecc_initialize(sector_size, tt, bytes, 224, 2, 0);
+	bits = bytes * 8 + pmecc_desc.tt * pmecc_desc.mm;
+
+	for (i = 0; i < ARRAY_SIZE(errors); i++) {
+		_fill_patterns(bits, errors[i]);
+		old_us = _decode(true, bits, errors[i]);
+		new_us = _decode(false, bits, errors[i]);
+		printf("%6u %4u %6u %10.2f %10.2f %7.1fx\n", (unsigned)bytes,
+		       (unsigned)tt, (unsigned)errors[i], old_us, new_us,
+		       old_us / new_us);
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	static const uint8_t tts[] = { 4, 8, 24 };
+	uint32_t i;
+
+	srand(1);
+
+	printf("sector   tt errors   previous    current  (us/sector)\n");
+	for (i = 0; i < ARRAY_SIZE(tts); i++)
+		_bench(0, tts[i]);
+	for (i = 0; i < ARRAY_SIZE(tts); i++)
+		_bench(1, tts[i]);
+#ifdef PMECC_CFG_BCH_ERR_BCH_ERR32
+	_bench(1, 32);
+#endif
+
+	return 0;
+}
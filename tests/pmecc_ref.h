@@ -0,0 +1,303 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Reference models shared by the PMECC test and benchmark, to include after
+ * pmecc.c (they use its pmecc_desc) with PMECC pointing to a RAM instance
+ * named pmecc_regs:
+ * - the previous BCH decoder, modulo based, and a per-position Chien search;
+ * - an encoder model giving the remainders the PMECC reports for a set of
+ *   bit errors.
+ */
+
+#ifndef PMECC_REF_H
+#define PMECC_REF_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+
+/** State of the previous decoder */
+static struct {
+	int16_t si[2 * PMECC_NB_ERROR_MAX];
+	int16_t smu[PMECC_NB_ERROR_MAX + 2][2 * PMECC_NB_ERROR_MAX + 1];
+	int16_t lmu[PMECC_NB_ERROR_MAX + 1];
+	uint32_t err_pos[PMECC_NB_ERROR_MAX];
+} ref;
+
+/*---------------------------------------------------------------------- */
+/*         Previous decoder                                              */
+/*---------------------------------------------------------------------- */
+
+static void ref_substitute(void)
+{
+	int32_t i, j;
+	int16_t *si = ref.si;
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+	const int16_t *index_of = pmecc_desc.index_of;
+
+	memset(ref.si, 0, sizeof(ref.si));
+	for (i = 1; i <= 2 * pmecc_desc.tt - 1; i = i + 2) {
+		si[i] = 0;
+		for (j = 0; j < pmecc_desc.mm; j++) {
+			if (pmecc_desc.partial_syn[i] & ((uint16_t)0x1 << j))
+				si[i] = alpha_to[(i * j)] ^ si[i];
+		}
+	}
+	for (i = 2; i <= 2 * pmecc_desc.tt; i = i + 2) {
+		j = i / 2;
+		if (si[j] == 0)
+			si[i] = 0;
+		else
+			si[i] = alpha_to[(2 * index_of[si[j]]) % pmecc_desc.nn];
+	}
+}
+
+static void ref_get_sigma(void)
+{
+	uint32_t dmu_0_count = 0;
+	int32_t i, j, k;
+	int16_t *lmu = ref.lmu;
+	int16_t *si = ref.si;
+	int16_t tt = pmecc_desc.tt;
+	int32_t nn = pmecc_desc.nn;
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+	const int16_t *index_of = pmecc_desc.index_of;
+	int32_t mu[PMECC_NB_ERROR_MAX + 1];
+	int32_t dmu[PMECC_NB_ERROR_MAX + 1];
+	int32_t delta[PMECC_NB_ERROR_MAX + 1];
+	int32_t ro, largest, diff;
+
+	memset(ref.smu, 0, sizeof(ref.smu));
+	mu[0] = -1;
+	ref.smu[0][0] = 1;
+	dmu[0] = 1;
+	lmu[0] = 0;
+	delta[0] = (mu[0] * 2 - lmu[0]) >> 1;
+	mu[1] = 0;
+	ref.smu[1][0] = 1;
+	dmu[1] = si[1];
+	lmu[1] = 0;
+	delta[1] = (mu[1] * 2 - lmu[1]) >> 1;
+
+	for (i = 1; i <= tt; i++) {
+		mu[i + 1] = i << 1;
+		if (dmu[i] == 0) {
+			dmu_0_count++;
+			if ((tt - (lmu[i] >> 1) - 1) & 0x1) {
+				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 2) {
+					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+						ref.smu[tt + 1][j] = ref.smu[i][j];
+					lmu[tt + 1] = lmu[i];
+					return;
+				}
+			} else {
+				if (dmu_0_count == (uint32_t)((tt - (lmu[i] >> 1) - 1) / 2) + 1) {
+					for (j = 0; j <= (lmu[i] >> 1) + 1; j++)
+						ref.smu[tt + 1][j] = ref.smu[i][j];
+					lmu[tt + 1] = lmu[i];
+					return;
+				}
+			}
+			for (j = 0; j <= (lmu[i] >> 1); j++)
+				ref.smu[i + 1][j] = ref.smu[i][j];
+			lmu[i + 1] = lmu[i];
+		} else {
+			ro = 0;
+			largest = -1;
+			for (j = 0; j < i; j++) {
+				if (dmu[j] && delta[j] > largest) {
+					largest = delta[j];
+					ro = j;
+				}
+			}
+			diff = (mu[i] - mu[ro]);
+			if ((lmu[i] >> 1) > ((lmu[ro] >> 1) + diff))
+				lmu[i + 1] = lmu[i];
+			else
+				lmu[i + 1] = ((lmu[ro] >> 1) + diff) * 2;
+			for (k = 0; k < (2 * PMECC_NB_ERROR_MAX + 1); k++)
+				ref.smu[i + 1][k] = 0;
+			for (k = 0; k <= (lmu[ro] >> 1); k++) {
+				if (ref.smu[ro][k] && dmu[i])
+					ref.smu[i + 1][k + diff] = alpha_to[(index_of[dmu[i]] +
+							(nn - index_of[dmu[ro]]) +
+							index_of[ref.smu[ro][k]]) % nn];
+			}
+			for (k = 0; k <= (lmu[i] >> 1); k++)
+				ref.smu[i + 1][k] ^= ref.smu[i][k];
+		}
+		delta[i + 1] = (mu[i + 1] * 2 - lmu[i + 1]) >> 1;
+		if (i < tt) {
+			for (k = 0; k <= (lmu[i + 1] >> 1); k++) {
+				if (k == 0)
+					dmu[i + 1] = si[2 * (i - 1) + 3];
+				else if (ref.smu[i + 1][k] && si[2 * (i - 1) + 3 - k])
+					dmu[i + 1] = alpha_to[(index_of[ref.smu[i + 1][k]] +
+							index_of[si[2 * (i - 1) + 3 - k]]) % nn] ^ dmu[i + 1];
+			}
+		}
+	}
+}
+
+/**
+ * \brief Chien search of the previous decoder's polynomial, evaluated at each
+ * position as the PMERRLOC does: sigma(alpha^-(p-1)), with one modulo per
+ * term. The tree had no software search before the current one.
+ * \return Number of errors, or -1 if the roots do not match the degree.
+ */
+static int32_t ref_error_location(uint32_t sector_size_in_bits)
+{
+	const int16_t *alpha_to = pmecc_desc.alpha_to;
+	const int16_t *index_of = pmecc_desc.index_of;
+	const int16_t *sigma = ref.smu[pmecc_desc.tt + 1];
+	int32_t nn = pmecc_desc.nn;
+	int32_t error_number, nbr_of_roots, k, inv;
+	uint32_t pos;
+	int16_t value;
+
+	error_number = ref.lmu[pmecc_desc.tt + 1] >> 1;
+	if (error_number == 0)
+		return 0;
+
+	nbr_of_roots = 0;
+	for (pos = 1; pos <= sector_size_in_bits; pos++) {
+		inv = (nn - (int32_t)((pos - 1) % nn)) % nn;
+		value = sigma[0];
+		for (k = 1; k <= error_number; k++) {
+			if (sigma[k])
+				value ^= alpha_to[(index_of[sigma[k]] + k * inv) % nn];
+		}
+		if (value == 0) {
+			ref.err_pos[nbr_of_roots++] = pos;
+			if (nbr_of_roots == error_number)
+				break;
+		}
+	}
+
+	if (nbr_of_roots != error_number)
+		return -1;
+
+	return error_number;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Encoder model                                                 */
+/*---------------------------------------------------------------------- */
+
+static int16_t _gf_mul(int16_t a, int16_t b)
+{
+	if (!a || !b)
+		return 0;
+	return pmecc_desc.alpha_to[(pmecc_desc.index_of[a] +
+			pmecc_desc.index_of[b]) % pmecc_desc.nn];
+}
+
+/**
+ * \brief Minimal polynomial of alpha^i over GF(2), as a bit mask: product of
+ * (x + alpha^j) for j in the cyclotomic coset of i.
+ */
+static uint32_t _minimal_poly(uint32_t i)
+{
+	int16_t poly[16] = { 1 };
+	uint32_t deg = 0, j = i, k, mask = 0;
+
+	do {
+		int16_t root = pmecc_desc.alpha_to[j];
+
+		/* poly *= (x + root) */
+		poly[deg + 1] = 0;
+		for (k = deg + 1; k > 0; k--)
+			poly[k] = poly[k - 1] ^ _gf_mul(poly[k], root);
+		poly[0] = _gf_mul(poly[0], root);
+		deg++;
+		j = (2 * j) % pmecc_desc.nn;
+	} while (j != i);
+
+	for (k = 0; k <= deg; k++)
+		if (poly[k])
+			mask |= 1u << k;
+	return mask;
+}
+
+/** x^n modulo a polynomial over GF(2) */
+static uint32_t _x_pow_mod(uint32_t n, uint32_t poly)
+{
+	uint32_t deg = 31 - __builtin_clz(poly);
+	uint32_t result = 1, base = 2 % poly, prod, k;
+
+	if (deg == 1)
+		base = 2 ^ poly;
+	for (; n; n >>= 1) {
+		if (n & 1) {
+			for (prod = 0, k = 0; k < deg; k++)
+				if (base & (1u << k))
+					prod ^= result << k;
+			for (k = 2 * deg; k >= deg; k--)
+				if (prod & (1u << k))
+					prod ^= poly << (k - deg);
+			result = prod;
+		}
+		for (prod = 0, k = 0; k < deg; k++)
+			if (base & (1u << k))
+				prod ^= base << k;
+		for (k = 2 * deg; k >= deg; k--)
+			if (prod & (1u << k))
+				prod ^= poly << (k - deg);
+		base = prod;
+	}
+	return result;
+}
+
+/**
+ * \brief Fill the remainder registers of sector 0 for errors on the given
+ * bit positions (1-based): remainder 2k+1 is E(x) mod m_2k+1(x), with
+ * E(x) = sum of x^(pos-1).
+ */
+static void _set_remainders(const uint32_t *pos, uint32_t count)
+{
+	int16_t *rem = (int16_t*)&pmecc_regs.PMECC_REM[0];
+	uint32_t k, e, poly, value;
+
+	memset(&pmecc_regs.PMECC_REM[0], 0, sizeof(pmecc_regs.PMECC_REM[0]));
+	for (k = 0; k < (uint32_t)pmecc_desc.tt; k++) {
+		poly = _minimal_poly(2 * k + 1);
+		for (value = 0, e = 0; e < count; e++)
+			value ^= _x_pow_mod(pos[e] - 1, poly);
+		rem[k] = value;
+	}
+}
+
+#endif /* PMECC_REF_H */
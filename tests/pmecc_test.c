@@ -0,0 +1,190 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host test of the PMECC BCH decoder: random error patterns are encoded as
+ * the remainders the PMECC would report, then decoded by pmecc_correction()
+ * with the software Chien search. The error location polynomial is compared
+ * with the one of the previous decoder (pmecc_ref.h, modulo based), and the
+ * error positions with the injected ones and the reference Chien search.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_PMECC_SW_ERROR_LOCATION
+
+#include "chip.h"
+
+/* The PMECC registers are a RAM instance filled by the test */
+static Pmecc pmecc_regs;
+#undef PMECC
+#define PMECC (&pmecc_regs)
+
+#include "nvm/nand/pmecc.c"
+
+#include "pmecc_ref.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define PATTERNS 200
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t sector_buf[1024];
+
+static uint8_t sector_ref[1024];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static bool _contains(const uint32_t *set, uint32_t count, uint32_t value)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		if (set[i] == value)
+			return true;
+	return false;
+}
+
+/**
+ * \brief Decode random patterns of up to tt errors in a sector.
+ */
+static void _check_patterns(uint8_t sector_size, uint8_t tt)
+{
+	uint32_t bytes = sector_size ? 1024 : 512;
+	uint32_t pos[PMECC_NB_ERROR_MAX];
+	uint32_t bits, count, n, i, j, deg;
+
+	CHECK(pmecc_initialize(sector_size, tt, bytes, 224, 2, 0) == 0);
+	bits = bytes * 8 + pmecc_desc.tt * pmecc_desc.mm;
+
+	for (n = 0; n < PATTERNS; n++) {
+		count = n % (tt + 1);
+		for (i = 0; i < bytes; i++)
+			sector_ref[i] = rand();
+		memcpy(sector_buf, sector_ref, bytes);
+
+		/* Distinct positions, in the data and in the ECC */
+		for (i = 0; i < count; i++) {
+			do {
+				pos[i] = 1 + rand() % bits;
+			} while (_contains(pos, i, pos[i]));
+			if (pos[i] <= bytes * 8)
+				sector_buf[(pos[i] - 1) >> 3] ^= 1 << ((pos[i] - 1) & 7);
+		}
+		_set_remainders(pos, count);
+
+		CHECK(pmecc_correction(1, (uint32_t)(uintptr_t)sector_buf) == 0);
+		CHECK(!memcmp(sector_buf, sector_ref, bytes));
+
+		/* Same error location polynomial as the previous decoder */
+		ref_substitute();
+		ref_get_sigma();
+		deg = ref.lmu[tt + 1] >> 1;
+		CHECK(pmecc_desc.lmu[tt + 1] == ref.lmu[tt + 1]);
+		CHECK(deg == count);
+		for (j = 0; j <= deg; j++)
+			CHECK(pmecc_desc.smu[tt + 1][j] == ref.smu[tt + 1][j]);
+
+		/* And roots on the injected positions */
+		for (j = 0; j < count; j++)
+			CHECK(_contains(pos, count, pmecc_desc.err_pos[j]));
+		CHECK(ref_error_location(bits) == (int32_t)count);
+		CHECK(!memcmp(ref.err_pos, pmecc_desc.err_pos,
+			      count * sizeof(ref.err_pos[0])));
+	}
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_512_byte_sectors(void)
+{
+	static const uint8_t tts[] = { 2, 4, 8, 12, 24 };
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(tts); i++)
+		_check_patterns(0, tts[i]);
+}
+
+static void test_1024_byte_sectors(void)
+{
+	static const uint8_t tts[] = { 2, 4, 8, 12, 24,
+#ifdef PMECC_CFG_BCH_ERR_BCH_ERR32
+		32,
+#endif
+	};
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(tts); i++)
+		_check_patterns(1, tts[i]);
+}
+
+static void test_too_many_errors(void)
+{
+	uint32_t pos[9];
+	uint32_t i, failures = 0;
+
+	CHECK(pmecc_initialize(0, 8, 512, 224, 2, 0) == 0);
+	for (i = 0; i < ARRAY_SIZE(pos); i++)
+		pos[i] = 1 + 397 * i;
+	_set_remainders(pos, ARRAY_SIZE(pos));
+	failures = pmecc_correction(1, (uint32_t)(uintptr_t)sector_buf);
+	CHECK(failures == 1);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	srand(1);
+
+	RUN_TEST(test_512_byte_sectors);
+	RUN_TEST(test_1024_byte_sectors);
+	RUN_TEST(test_too_many_errors);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Throughput of the single-producer/single-consumer ring on the build
+ * machine, against the byte ring built on the RING_* index macros that the
+ * drivers used before. Absolute numbers only compare implementations on
+ * the same host: they say nothing of the Cortex-A5/M7 targets.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CONFIG_ARCH_ARM
+#include "barriers.h"
+static inline void dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#include "ring.c"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define BYTES    (64u * 1024 * 1024)
+#define CAPACITY 512
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t storage[CAPACITY];
+
+static struct _ring ring;
+
+/** Byte ring with the RING_* macros, 511 usable bytes */
+static struct {
+	uint8_t buffer[CAPACITY];
+	volatile uint32_t head;
+	volatile uint32_t tail;
+} legacy;
+
+static volatile uint32_t sink;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static double _now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _report(const char *name, double start)
+{
+	double elapsed = _now() - start;
+
+	printf("%-36s %8.1f MB/s\n", name, BYTES / elapsed / 1e6);
+}
+
+static void _legacy_bytes(void)
+{
+	uint32_t i, sum = 0;
+
+	RING_CLEAR(legacy.head, legacy.tail);
+	for (i = 0; i < BYTES; i++) {
+		if (RING_SPACE(legacy.head, legacy.tail, CAPACITY) == 0) {
+			while (!RING_EMPTY(legacy.head, legacy.tail)) {
+				sum += legacy.buffer[legacy.tail];
+				RING_INC(legacy.tail, CAPACITY);
+			}
+		}
+		legacy.buffer[legacy.head] = i;
+		RING_INC(legacy.head, CAPACITY);
+	}
+	sink = sum;
+}
+
+static void _ring_bytes(void)
+{
+	uint32_t i, sum = 0;
+	uint8_t byte;
+
+	RING_INIT_ARRAY(&ring, storage);
+	for (i = 0; i < BYTES; i++) {
+		byte = i;
+		if (!ring_push(&ring, &byte)) {
+			while (ring_pop(&ring, &byte))
+				sum += byte;
+			ring_push(&ring, &byte);
+		}
+	}
+	sink = sum;
+}
+
+static void _ring_batches(uint32_t batch)
+{
+	static uint8_t data[CAPACITY];
+	uint32_t i;
+
+	RING_INIT_ARRAY(&ring, storage);
+	for (i = 0; i < BYTES; i += batch) {
+		ring_push_n(&ring, data, batch);
+		ring_pop_n(&ring, data, batch);
+	}
+	sink = data[0];
+}
+
+static void *_producer(void *arg)
+{
+	static uint8_t data[64];
+	uint32_t sent = 0;
+
+	uint32_t n;
+
+	while (sent < BYTES) {
+		n = ring_push_n(&ring, data, sizeof(data));
+		/* Let the consumer run on a single core host */
+		if (n == 0)
+			sched_yield();
+		sent += n;
+	}
+	return NULL;
+}
+
+static void _ring_threads(void)
+{
+	uint8_t data[64];
+	uint32_t received = 0;
+	pthread_t producer;
+
+	RING_INIT_ARRAY(&ring, storage);
+	pthread_create(&producer, NULL, _producer, NULL);
+	uint32_t n;
+
+	while (received < BYTES) {
+		n = ring_pop_n(&ring, data, sizeof(data));
+		if (n == 0)
+			sched_yield();
+		received += n;
+	}
+	pthread_join(producer, NULL);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	double start;
+
+	start = _now();
+	_legacy_bytes();
+	_report("RING_* macros, bytes", start);
+
+	start = _now();
+	_ring_bytes();
+	_report("ring_push/ring_pop, bytes", start);
+
+	start = _now();
+	_ring_batches(16);
+	_report("ring_push_n/ring_pop_n, 16 bytes", start);
+
+	start = _now();
+	_ring_batches(256);
+	_report("ring_push_n/ring_pop_n, 256 bytes", start);
+
+	start = _now();
+	_ring_threads();
+	_report("two threads, 64 bytes", start);
+
+	return 0;
+}
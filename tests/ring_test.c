@@ -0,0 +1,279 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the single-producer/single-consumer ring: boundaries on a
+ * single thread, then a producer and a consumer thread exchanging a long
+ * sequence through every access function.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Host barriers: the compiler must not move the element accesses across
+ * the counter updates, the threads may run on different cores */
+#define CONFIG_ARCH_ARM
+#include "barriers.h"
+static inline void dmb(void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#include "ring.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define STRESS_COUNT 4000000
+
+/** Element larger than a word, to detect torn copies */
+struct _elem {
+	uint32_t seq;
+	uint32_t check;
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct _elem storage[64];
+
+static struct _ring ring;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _fill(struct _elem *elems, uint32_t first, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		elems[i].seq = first + i;
+		elems[i].check = ~(first + i);
+	}
+}
+
+/** Producer: alternate ring_push(), ring_push_n() and spans */
+static void *_producer(void *arg)
+{
+	struct _elem batch[80];
+	uint32_t seq = 0, n;
+	unsigned rnd = 1;
+
+	while (seq < STRESS_COUNT) {
+		n = 1 + rand_r(&rnd) % ARRAY_SIZE(batch);
+		if (n > STRESS_COUNT - seq)
+			n = STRESS_COUNT - seq;
+		switch (seq % 3) {
+		case 0:
+			_fill(batch, seq, 1);
+			if (ring_push(&ring, batch))
+				seq++;
+			break;
+		case 1:
+			_fill(batch, seq, n);
+			seq += ring_push_n(&ring, batch, n);
+			break;
+		default:
+		{
+			void *span;
+			uint32_t count = ring_write_span(&ring, &span);
+			if (count > n)
+				count = n;
+			_fill(span, seq, count);
+			ring_write_commit(&ring, count);
+			seq += count;
+			break;
+		}
+		}
+		if (rand_r(&rnd) % 64 == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+static bool _consumed(const struct _elem *elems, uint32_t first,
+		uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		if (elems[i].seq != first + i || elems[i].check != ~(first + i))
+			return false;
+	return true;
+}
+
+/** Consumer: alternate ring_pop(), ring_pop_n() and spans, check the order
+ */
+static void *_consumer(void *arg)
+{
+	struct _elem batch[80];
+	uint32_t seq = 0, n, count;
+	unsigned rnd = 2;
+	bool *ok = arg;
+
+	*ok = true;
+	while (seq < STRESS_COUNT && *ok) {
+		n = 1 + rand_r(&rnd) % ARRAY_SIZE(batch);
+		switch (seq % 3) {
+		case 0:
+			count = ring_pop(&ring, batch) ? 1 : 0;
+			*ok = _consumed(batch, seq, count);
+			break;
+		case 1:
+			count = ring_pop_n(&ring, batch, n);
+			*ok = _consumed(batch, seq, count);
+			break;
+		default:
+		{
+			void *span;
+			count = ring_read_span(&ring, &span);
+			if (count > n)
+				count = n;
+			*ok = _consumed(span, seq, count);
+			ring_read_commit(&ring, count);
+			break;
+		}
+		}
+		CHECK(ring_count(&ring) <= ARRAY_SIZE(storage));
+		seq += count;
+		if (rand_r(&rnd) % 64 == 0)
+			sched_yield();
+	}
+	return NULL;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_init(void)
+{
+	CHECK(ring_init(&ring, storage, sizeof(storage[0]), 0) == -EINVAL);
+	CHECK(ring_init(&ring, storage, sizeof(storage[0]), 48) == -EINVAL);
+	CHECK(RING_INIT_ARRAY(&ring, storage) == 0);
+	CHECK(ring_is_empty(&ring));
+	CHECK(ring_space(&ring) == ARRAY_SIZE(storage));
+}
+
+static void test_all_slots_used(void)
+{
+	struct _elem elems[ARRAY_SIZE(storage) + 1];
+
+	RING_INIT_ARRAY(&ring, storage);
+	_fill(elems, 0, ARRAY_SIZE(elems));
+	CHECK(ring_push_n(&ring, elems, ARRAY_SIZE(elems)) == ARRAY_SIZE(storage));
+	CHECK(ring_is_full(&ring));
+	CHECK(!ring_push(&ring, &elems[0]));
+
+	memset(elems, 0, sizeof(elems));
+	CHECK(ring_pop_n(&ring, elems, ARRAY_SIZE(elems)) == ARRAY_SIZE(storage));
+	CHECK(_consumed(elems, 0, ARRAY_SIZE(storage)));
+	CHECK(ring_is_empty(&ring));
+	CHECK(!ring_pop(&ring, &elems[0]));
+}
+
+static void test_wrap_and_spans(void)
+{
+	struct _elem elems[ARRAY_SIZE(storage)];
+	void *span;
+
+	RING_INIT_ARRAY(&ring, storage);
+	_fill(elems, 0, 40);
+	CHECK(ring_push_n(&ring, elems, 40) == 40);
+	CHECK(ring_pop_n(&ring, elems, 40) == 40);
+
+	/* 24 free slots up to the end, then 40 from the start */
+	CHECK(ring_write_span(&ring, &span) == 24);
+	CHECK(span == &storage[40]);
+	_fill(elems, 40, 50);
+	CHECK(ring_push_n(&ring, elems, 50) == 50);
+	CHECK(ring_read_span(&ring, &span) == 24);
+	CHECK(span == &storage[40]);
+	ring_read_commit(&ring, 24);
+	CHECK(ring_read_span(&ring, &span) == 26);
+	CHECK(span == &storage[0]);
+	CHECK(_consumed(span, 64, 26));
+	ring_read_commit(&ring, 26);
+	CHECK(ring_is_empty(&ring));
+}
+
+static void test_counter_overflow(void)
+{
+	struct _elem elem;
+
+	/* Free-running counters wrap around 2^32 */
+	RING_INIT_ARRAY(&ring, storage);
+	ring.head = ring.tail = 0xFFFFFFF0u;
+	_fill(&elem, 7, 1);
+	while (ring_push(&ring, &elem))
+		elem.seq++, elem.check--;
+	CHECK(ring_count(&ring) == ARRAY_SIZE(storage));
+	CHECK(ring.head == (uint32_t)(0xFFFFFFF0u + ARRAY_SIZE(storage)));
+	CHECK(ring_pop(&ring, &elem) && elem.seq == 7);
+}
+
+static void test_two_threads(void)
+{
+	pthread_t producer, consumer;
+	bool ok = false;
+
+	RING_INIT_ARRAY(&ring, storage);
+	CHECK(pthread_create(&consumer, NULL, _consumer, &ok) == 0);
+	CHECK(pthread_create(&producer, NULL, _producer, NULL) == 0);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	CHECK(ok);
+	CHECK(ring_is_empty(&ring));
+	CHECK(ring.head == STRESS_COUNT);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_init);
+	RUN_TEST(test_all_slots_used);
+	RUN_TEST(test_wrap_and_spans);
+	RUN_TEST(test_counter_overflow);
+	RUN_TEST(test_two_threads);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the ADMA2 descriptor tables of the SDMMC driver: split of
+ * the buffers at the 64 KiB limit of a descriptor line, scatter-gather
+ * segment boundaries, word alignment of the buffers and reduction of the
+ * transfer when the table is too small.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "sdmmc/sdmmc_adma.h"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define TABLE_LINES  16
+#define GUARD        0xdeadbeef
+
+#define LINE_LEN(l) \
+	((((l)[0] & SDMMC_DMA0DL_LEN_Msk) >> SDMMC_DMA0DL_LEN_Pos) \
+	 ? (((l)[0] & SDMMC_DMA0DL_LEN_Msk) >> SDMMC_DMA0DL_LEN_Pos) \
+	 : SDMMC_DMADL_TRAN_LEN_MAX)
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint32_t table[(TABLE_LINES + 1) * SDMMC_DMADL_SIZE];
+
+static uint8_t buf_a[4096] __attribute__((aligned(4)));
+static uint8_t buf_b[256 * 1024] __attribute__((aligned(4)));
+static uint8_t buf_c[4096] __attribute__((aligned(4)));
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _init_cmd(sSdmmcCommand *cmd, uint8_t *data, uint16_t blk_size,
+		uint16_t blocks, const sSdmmcIoVec *iovec, uint16_t count)
+{
+	uint32_t i;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->pData = data;
+	cmd->wBlockSize = blk_size;
+	cmd->wNbBlocks = blocks;
+	cmd->pIoVec = iovec;
+	cmd->wIoVecCount = count;
+
+	for (i = 0; i < ARRAY_SIZE(table); i++)
+		table[i] = GUARD;
+}
+
+/* Check a filled table against the segments it describes: every line is a
+ * valid transfer line within one segment, in order, only the last one ends
+ * the table, and the lines past the table are left alone */
+static void _check_table(const sSdmmcCommand *cmd, uint32_t table_size,
+		uint32_t lines)
+{
+	const sSdmmcIoVec single = {
+		.pData = cmd->pData,
+		.wNbBlocks = cmd->wNbBlocks,
+	};
+	const sSdmmcIoVec *seg = cmd->pIoVec ? cmd->pIoVec : &single;
+	uint32_t left = cmd->wNbBlocks * (uint32_t)cmd->wBlockSize;
+	uint32_t seg_addr, seg_left, i;
+
+	CHECK(lines >= 1 && lines <= table_size);
+
+	seg_addr = (uint32_t)(uintptr_t)seg->pData;
+	seg_left = seg->wNbBlocks * (uint32_t)cmd->wBlockSize;
+	for (i = 0; i < lines; i++) {
+		const uint32_t *line = &table[i * SDMMC_DMADL_SIZE];
+		uint32_t len = LINE_LEN(line);
+
+		CHECK(line[0] & SDMMC_DMA0DL_ATTR_VALID);
+		CHECK((line[0] & SDMMC_DMA0DL_ATTR_ACT_Msk) == SDMMC_DMA0DL_ATTR_ACT_TRAN);
+		CHECK(!(line[0] & SDMMC_DMA0DL_ATTR_END) == (i != lines - 1));
+
+		while (seg_left == 0) {
+			seg++;
+			seg_addr = (uint32_t)(uintptr_t)seg->pData;
+			seg_left = seg->wNbBlocks * (uint32_t)cmd->wBlockSize;
+		}
+		CHECK(line[1] == seg_addr);
+		CHECK(len <= seg_left && len <= left);
+		seg_addr += len;
+		seg_left -= len;
+		left -= len;
+	}
+	CHECK(left == 0);
+
+	for (i = table_size * SDMMC_DMADL_SIZE; i < ARRAY_SIZE(table); i++)
+		CHECK(table[i] == GUARD);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_single_buffer(void)
+{
+	sSdmmcCommand cmd;
+	uint32_t lines;
+
+	_init_cmd(&cmd, buf_b, 512, 8, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 1);
+	CHECK(table[0] == (SDMMC_DMA0DL_LEN(4096u) | SDMMC_DMA0DL_ATTR_ACT_TRAN
+			| SDMMC_DMA0DL_ATTR_VALID | SDMMC_DMA0DL_ATTR_END));
+	CHECK(table[1] == (uint32_t)(uintptr_t)buf_b);
+	CHECK(table[2] == GUARD);
+	_check_table(&cmd, TABLE_LINES, lines);
+}
+
+static void test_64k_limit(void)
+{
+	sSdmmcCommand cmd;
+	uint32_t lines;
+
+	/* exactly 64 KiB: one line, with the length field set to 0 */
+	_init_cmd(&cmd, buf_b, 512, 128, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 1);
+	CHECK((table[0] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN_MAX);
+	_check_table(&cmd, TABLE_LINES, lines);
+
+	/* one block more */
+	_init_cmd(&cmd, buf_b, 512, 129, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 2);
+	CHECK((table[0] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN_MAX);
+	CHECK(!(table[0] & SDMMC_DMA0DL_ATTR_END));
+	CHECK((table[2] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN(512u));
+	CHECK(table[3] == (uint32_t)(uintptr_t)buf_b + 65536);
+	_check_table(&cmd, TABLE_LINES, lines);
+
+	/* 256 KiB in 4 full lines */
+	_init_cmd(&cmd, buf_b, 512, 512, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 4);
+	_check_table(&cmd, TABLE_LINES, lines);
+
+	/* blocks straddling the limit of a line */
+	_init_cmd(&cmd, buf_b, 1000, 100, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 2);
+	CHECK((table[2] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN(100000u - 65536u));
+	_check_table(&cmd, TABLE_LINES, lines);
+}
+
+static void test_segments(void)
+{
+	const sSdmmcIoVec iovec[] = {
+		{ .pData = buf_a, .wNbBlocks = 8 },
+		{ .pData = buf_b, .wNbBlocks = 0 },
+		{ .pData = buf_b, .wNbBlocks = 200 },
+		{ .pData = buf_c, .wNbBlocks = 4 },
+	};
+	sSdmmcCommand cmd;
+	uint32_t lines;
+
+	/* one line per segment and per 64 KiB, empty segments skipped */
+	_init_cmd(&cmd, buf_a, 512, 212, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 1 + 2 + 1);
+	CHECK(table[1] == (uint32_t)(uintptr_t)buf_a);
+	CHECK(table[3] == (uint32_t)(uintptr_t)buf_b);
+	CHECK(table[5] == (uint32_t)(uintptr_t)buf_b + 65536);
+	CHECK(table[7] == (uint32_t)(uintptr_t)buf_c);
+	CHECK(cmd.wNbBlocks == 212);
+	_check_table(&cmd, TABLE_LINES, lines);
+
+	/* the transfer ends inside the last segment */
+	_init_cmd(&cmd, buf_a, 512, 210, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 4);
+	CHECK((table[6] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN(1024u));
+	_check_table(&cmd, TABLE_LINES, lines);
+
+	/* and inside the first one */
+	_init_cmd(&cmd, buf_a, 512, 3, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	CHECK(lines == 1);
+	_check_table(&cmd, TABLE_LINES, lines);
+}
+
+static void test_misaligned(void)
+{
+	const sSdmmcIoVec iovec[] = {
+		{ .pData = buf_a, .wNbBlocks = 1 },
+		{ .pData = buf_b + 2, .wNbBlocks = 1 },
+	};
+	sSdmmcCommand cmd;
+	uint32_t lines;
+
+	_init_cmd(&cmd, buf_a + 1, 512, 1, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_PARAM);
+
+	_init_cmd(&cmd, buf_a, 512, 2, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_PARAM);
+	CHECK(cmd.wNbBlocks == 2);
+
+	/* a misaligned segment past the end of the transfer is ignored */
+	_init_cmd(&cmd, buf_a, 512, 1, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, TABLE_LINES, &cmd, &lines) == SDMMC_OK);
+	_check_table(&cmd, TABLE_LINES, lines);
+}
+
+static void test_table_too_small(void)
+{
+	const sSdmmcIoVec iovec[] = {
+		{ .pData = buf_a, .wNbBlocks = 8 },
+		{ .pData = buf_b, .wNbBlocks = 200 },
+		{ .pData = buf_c, .wNbBlocks = 4 },
+	};
+	sSdmmcCommand cmd;
+	uint32_t lines;
+
+	/* single buffer, reduced to the blocks of the lines available */
+	_init_cmd(&cmd, buf_b, 512, 300, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, 2, &cmd, &lines) == SDMMC_CHANGED);
+	CHECK(lines == 2);
+	CHECK(cmd.wNbBlocks == 256);
+	_check_table(&cmd, 2, lines);
+
+	/* whole blocks only */
+	_init_cmd(&cmd, buf_b, 1000, 100, NULL, 0);
+	CHECK(sdmmc_adma_fill_table(table, 1, &cmd, &lines) == SDMMC_CHANGED);
+	CHECK(lines == 1);
+	CHECK(cmd.wNbBlocks == 65);
+	CHECK((table[0] & SDMMC_DMA0DL_LEN_Msk) == SDMMC_DMA0DL_LEN(65000u));
+	_check_table(&cmd, 1, lines);
+
+	/* the last segment does not fit at all */
+	_init_cmd(&cmd, buf_a, 512, 212, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, 3, &cmd, &lines) == SDMMC_CHANGED);
+	CHECK(lines == 3);
+	CHECK(cmd.wNbBlocks == 208);
+	_check_table(&cmd, 3, lines);
+
+	/* the second segment partly fits */
+	_init_cmd(&cmd, buf_a, 512, 212, iovec, ARRAY_SIZE(iovec));
+	CHECK(sdmmc_adma_fill_table(table, 2, &cmd, &lines) == SDMMC_CHANGED);
+	CHECK(lines == 2);
+	CHECK(cmd.wNbBlocks == 8 + 128);
+	_check_table(&cmd, 2, lines);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_single_buffer);
+	RUN_TEST(test_64k_limit);
+	RUN_TEST(test_segments);
+	RUN_TEST(test_misaligned);
+	RUN_TEST(test_table_too_small);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,596 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the asynchronous request queue of libsdmmc:
+ * SD_SubmitRequest() and SD_PollRequests() run against a stub driver which
+ * holds each data command until the test completes it, as the completion
+ * interrupt would, or until the busy check if it is polling. Covered: a full
+ * queue completing in order, requests split by the driver or at the 65535
+ * block limit and chained from _RequestCallback(), requests submitted from a
+ * completion callback, the queue halting upon error and recovering from
+ * SD_PollRequests(), and the synchronous fallback of the devices which need
+ * SET_BLOCK_COUNT or STOP_TRANSMISSION.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Interrupts are not masked, completions run on the same thread */
+#define CONFIG_ARCH_ARM
+#include "irqflags.h"
+static inline uint32_t arch_irq_save(void) { return 0; }
+static inline void arch_irq_restore(uint32_t flags) {}
+
+/* sdmmc_api.c is included to reach the device status definitions */
+#include "libsdmmc/sdmmc_api.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define NUM_BLOCKS   256
+#define BLOCK_LEN    512
+
+#define NUM_REQUESTS 8
+#define MAX_LOG      16
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct {
+	uint8_t mem[NUM_BLOCKS * BLOCK_LEN];
+	uint32_t state;          /* card state, STATUS_xxx */
+
+	sSdmmcCommand *pending;  /* data command waiting for completion */
+	bool polling;            /* complete data commands on busy check */
+	bool open_ended;         /* card stays in the data state until CMD12 */
+	bool no_data;            /* do not transfer data, only log commands */
+	uint16_t max_blocks;     /* blocks per command, 0 if not limited */
+	uint32_t reject;         /* data commands to reject with SDMMC_BUSY */
+	uint8_t fail;            /* status of the next data command */
+	uint32_t resp_error;     /* device status of the next data command */
+
+	uint32_t cmds[64];
+	uint32_t cmd_while_busy;
+	struct {
+		uint8_t cmd;
+		uint32_t arg;
+		uint16_t blocks;
+		uint8_t *data;
+	} log[MAX_LOG];
+	uint32_t log_len;
+} drv;
+
+static struct {
+	uint32_t count;
+	uint32_t order[NUM_REQUESTS];
+	uint8_t status[NUM_REQUESTS];
+	/* the next data command was issued before the notification */
+	bool busy[NUM_REQUESTS];
+} done;
+
+static sSdCard sd;
+
+static sSdmmcRequest reqs[NUM_REQUESTS];
+
+static uint8_t bufs[NUM_REQUESTS][16 * BLOCK_LEN];
+
+/* The library gives the address of its local variables to the driver as a
+ * 32-bit integer: the tests run on a stack in the low 4GB, as the static
+ * buffers */
+static uint8_t stack[512 * 1024] __attribute__((aligned(16)));
+
+/*---------------------------------------------------------------------- */
+/*         Stub driver                                                   */
+/*---------------------------------------------------------------------- */
+
+static void _transfer(sSdmmcCommand *cmd)
+{
+	uint32_t block = cmd->dwArg;
+	uint32_t size = cmd->wNbBlocks * BLOCK_LEN;
+
+	if (!(sd.bCardType & CARD_TYPE_bmHC))
+		block /= BLOCK_LEN;
+
+	*cmd->pResp = STATUS_TRAN | STATUS_READY_FOR_DATA | drv.resp_error;
+	drv.resp_error = 0;
+	cmd->bStatus = drv.fail;
+	drv.fail = SDMMC_OK;
+
+	if (cmd->bStatus != SDMMC_OK || drv.open_ended)
+		drv.state = cmd->bCmd == 18 ? STATUS_DATA : STATUS_RCV;
+	if (cmd->bStatus != SDMMC_OK || drv.no_data)
+		return;
+
+	CHECK(block + cmd->wNbBlocks <= NUM_BLOCKS);
+	if (cmd->bCmd == 18)
+		memcpy(cmd->pData, drv.mem + block * BLOCK_LEN, size);
+	else
+		memcpy(drv.mem + block * BLOCK_LEN, cmd->pData, size);
+}
+
+/** Completion interrupt of the pending data command */
+static void _complete(void)
+{
+	sSdmmcCommand *cmd = drv.pending;
+
+	_transfer(cmd);
+	drv.pending = NULL;
+	if (cmd->fCallback)
+		cmd->fCallback(cmd->bStatus, cmd->pArg);
+}
+
+static uint32_t _command(void *pDrv, sSdmmcCommand *cmd)
+{
+	uint32_t rc = SDMMC_OK;
+
+	drv.cmds[cmd->bCmd]++;
+	if (drv.pending) {
+		drv.cmd_while_busy++;
+		return SDMMC_BUSY;
+	}
+
+	switch (cmd->bCmd) {
+	case 18:
+	case 25:
+		if (drv.reject) {
+			drv.reject--;
+			return SDMMC_BUSY;
+		}
+		if (drv.max_blocks && cmd->wNbBlocks > drv.max_blocks) {
+			cmd->wNbBlocks = drv.max_blocks;
+			rc = SDMMC_CHANGED;
+		}
+		if (drv.log_len < MAX_LOG) {
+			drv.log[drv.log_len].cmd = cmd->bCmd;
+			drv.log[drv.log_len].arg = cmd->dwArg;
+			drv.log[drv.log_len].blocks = cmd->wNbBlocks;
+			drv.log[drv.log_len].data = cmd->pData;
+			drv.log_len++;
+		}
+		cmd->bStatus = SDMMC_BUSY;
+		drv.pending = cmd;
+		/* Without callback, the library polls the busy check */
+		if (!cmd->fCallback)
+			_complete();
+		return rc;
+
+	case 12:
+		drv.state = STATUS_TRAN;
+		break;
+
+	case 13:
+	case 23:
+		break;
+
+	default:
+		CHECK(false);
+		return SDMMC_PARAM;
+	}
+
+	if (cmd->pResp)
+		*cmd->pResp = drv.state | STATUS_READY_FOR_DATA;
+	cmd->bStatus = SDMMC_OK;
+	return SDMMC_OK;
+}
+
+static uint32_t _ioctl(void *pDrv, uint32_t ctrl, uint32_t param)
+{
+	CHECK(ctrl == SDMMC_IOCTL_BUSY_CHECK);
+	if (drv.pending && drv.polling)
+		_complete();
+	*(uint32_t *)param = drv.pending ? 1 : 0;
+	return SDMMC_OK;
+}
+
+static const sSdHalFunctions hal = {
+	.fCommand = _command,
+	.fIOCtrl = _ioctl,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _reset(uint8_t card_type)
+{
+	uint32_t i;
+
+	memset(&drv, 0, sizeof(drv));
+	for (i = 0; i < sizeof(drv.mem); i++)
+		drv.mem[i] = i * 7 + (i >> 9);
+	drv.state = STATUS_TRAN;
+	memset(&done, 0, sizeof(done));
+	memset(reqs, 0, sizeof(reqs));
+
+	SDD_Initialize(&sd, &drv, 0, &hal);
+	sd.bCardType = card_type;
+	sd.wCurrBlockLen = BLOCK_LEN;
+	sd.bStatus = SDMMC_OK;
+}
+
+static void _on_done(uint32_t status, void *arg)
+{
+	sSdmmcRequest *req = arg;
+
+	if (done.count < NUM_REQUESTS) {
+		done.order[done.count] = req - reqs;
+		done.status[done.count] = status;
+		done.busy[done.count] = drv.pending != NULL;
+	}
+	done.count++;
+}
+
+/** Completion callback of reqs[0], which submits reqs[1] */
+static void _on_done_submit(uint32_t status, void *arg)
+{
+	_on_done(status, arg);
+	CHECK(SD_SubmitRequest(&sd, &reqs[1]) == SDMMC_OK);
+}
+
+/** Prepare reqs[index], filling its buffer if it is a write */
+static sSdmmcRequest *_request(uint32_t index, bool read, uint32_t addr,
+		uint32_t blocks)
+{
+	sSdmmcRequest *req = &reqs[index];
+	uint32_t i;
+
+	req->bRead = read;
+	req->dwAddr = addr;
+	req->dwNbBlocks = blocks;
+	req->pData = bufs[index];
+	req->fCallback = _on_done;
+	req->pArg = req;
+	for (i = 0; !read && i < blocks * BLOCK_LEN; i++)
+		bufs[index][i] = 0xa5 ^ (i + index * 3);
+	return req;
+}
+
+/** Check that the data of a request is both in its buffer and in memory */
+static bool _data_ok(const sSdmmcRequest *req)
+{
+	return !memcmp(req->pData, drv.mem + req->dwAddr * BLOCK_LEN,
+			req->dwNbBlocks * BLOCK_LEN);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_full_queue_in_order(void)
+{
+	uint32_t i;
+
+	_reset(CARD_SDHC);
+	for (i = 0; i < NUM_REQUESTS; i++)
+		CHECK(SD_SubmitRequest(&sd, _request(i, i % 2 == 0, 8 + i * 4,
+				1 + i % 4)) == SDMMC_OK);
+
+	/* One command at a time, the others wait in the queue */
+	CHECK(drv.log_len == 1);
+	CHECK(SD_PollRequests(&sd) == SDMMC_BUSY);
+	for (i = 0; i < NUM_REQUESTS; i++)
+		CHECK(reqs[i].bStatus == SDMMC_BUSY);
+
+	/* Each completion starts the next request, before the notification */
+	for (i = 0; i < NUM_REQUESTS; i++) {
+		CHECK(drv.pending != NULL);
+		if (drv.pending)
+			_complete();
+	}
+	CHECK(done.count == NUM_REQUESTS);
+	for (i = 0; i < NUM_REQUESTS; i++) {
+		CHECK(done.order[i] == i);
+		CHECK(done.status[i] == SDMMC_OK);
+		CHECK(done.busy[i] == (i < NUM_REQUESTS - 1));
+		CHECK(reqs[i].bStatus == SDMMC_OK);
+		CHECK(_data_ok(&reqs[i]));
+		CHECK(drv.log[i].cmd == (reqs[i].bRead ? 18 : 25));
+		CHECK(drv.log[i].arg == reqs[i].dwAddr);
+		CHECK(drv.log[i].blocks == reqs[i].dwNbBlocks);
+	}
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+	CHECK(drv.cmd_while_busy == 0);
+}
+
+static void test_driver_splits(void)
+{
+	uint32_t i;
+
+	/* The driver transfers 3 blocks at most: the request goes on from
+	 * _RequestCallback(). Standard capacity: byte addresses. */
+	_reset(CARD_SD);
+	drv.max_blocks = 3;
+	CHECK(SD_SubmitRequest(&sd, _request(0, true, 20, 10)) == SDMMC_OK);
+	while (drv.pending)
+		_complete();
+
+	CHECK(drv.log_len == 4);
+	for (i = 0; i < 4; i++) {
+		CHECK(drv.log[i].arg == (20 + i * 3) * BLOCK_LEN);
+		CHECK(drv.log[i].blocks == (i < 3 ? 3 : 1));
+		CHECK(drv.log[i].data == bufs[0] + i * 3 * BLOCK_LEN);
+	}
+	CHECK(done.count == 1);
+	CHECK(reqs[0].bStatus == SDMMC_OK);
+	CHECK(_data_ok(&reqs[0]));
+	CHECK(drv.cmd_while_busy == 0);
+}
+
+static void test_65535_block_limit(void)
+{
+	_reset(CARD_SDHC);
+	drv.no_data = true;
+	CHECK(SD_SubmitRequest(&sd, _request(0, true, 1000, 70000)) ==
+			SDMMC_OK);
+	while (drv.pending)
+		_complete();
+
+	CHECK(drv.log_len == 2);
+	CHECK(drv.log[0].arg == 1000);
+	CHECK(drv.log[0].blocks == 65535);
+	CHECK(drv.log[1].arg == 1000 + 65535);
+	CHECK(drv.log[1].blocks == 70000 - 65535);
+	CHECK(drv.log[1].data - drv.log[0].data == 65535 * BLOCK_LEN);
+	CHECK(done.count == 1);
+	CHECK(reqs[0].bStatus == SDMMC_OK);
+}
+
+static void test_submit_from_callback(void)
+{
+	_reset(CARD_SDHC);
+	_request(0, true, 4, 2)->fCallback = _on_done_submit;
+	_request(1, false, 40, 3);
+	CHECK(SD_SubmitRequest(&sd, &reqs[0]) == SDMMC_OK);
+
+	/* reqs[1] is started from the completion of reqs[0] */
+	_complete();
+	CHECK(done.count == 1);
+	CHECK(drv.pending != NULL);
+	CHECK(drv.log_len == 2 && drv.log[1].cmd == 25);
+	if (drv.pending)
+		_complete();
+	CHECK(done.count == 2);
+	CHECK(done.order[1] == 1);
+	CHECK(_data_ok(&reqs[0]) && _data_ok(&reqs[1]));
+
+	/* The idle queue restarts on submission */
+	CHECK(SD_SubmitRequest(&sd, _request(2, true, 60, 1)) == SDMMC_OK);
+	CHECK(drv.pending != NULL);
+	if (drv.pending)
+		_complete();
+	CHECK(done.count == 3);
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+}
+
+static void test_error_halts_queue(void)
+{
+	uint32_t i;
+
+	_reset(CARD_SDHC);
+	for (i = 0; i < 3; i++)
+		CHECK(SD_SubmitRequest(&sd, _request(i, false, 100 + i * 8, 2))
+				== SDMMC_OK);
+	_complete();
+
+	/* The second write fails, the card stays in the receive state */
+	drv.fail = SDMMC_ERR_IO;
+	_complete();
+	CHECK(done.count == 2);
+	CHECK(reqs[1].bStatus == SDMMC_ERR_IO);
+	CHECK(done.status[1] == SDMMC_ERR_IO);
+	CHECK(drv.pending == NULL);
+	CHECK(drv.log_len == 2);
+	CHECK(reqs[2].bStatus == SDMMC_BUSY);
+
+	/* Recovery: STOP_TRANSMISSION, then the queue resumes */
+	CHECK(SD_PollRequests(&sd) == SDMMC_BUSY);
+	CHECK(drv.cmds[13] >= 1);
+	CHECK(drv.cmds[12] == 1);
+	CHECK(drv.state == STATUS_TRAN);
+	CHECK(drv.pending != NULL);
+	if (drv.pending)
+		_complete();
+	CHECK(done.count == 3);
+	CHECK(done.order[2] == 2);
+	CHECK(reqs[2].bStatus == SDMMC_OK);
+	CHECK(_data_ok(&reqs[0]) && _data_ok(&reqs[2]));
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+
+	/* An error reported in the device status */
+	CHECK(SD_SubmitRequest(&sd, _request(3, true, 8, 1)) == SDMMC_OK);
+	drv.resp_error = STATUS_ADDR_OUT_OR_RANGE;
+	_complete();
+	CHECK(reqs[3].bStatus == SDMMC_ERROR);
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+	CHECK(drv.cmds[12] == 1);
+	CHECK(drv.cmd_while_busy == 0);
+}
+
+static void test_driver_busy(void)
+{
+	/* The driver rejects the command: the request fails at once and the
+	 * following ones wait for the recovery */
+	_reset(CARD_SDHC);
+	drv.reject = 1;
+	CHECK(SD_SubmitRequest(&sd, _request(0, true, 0, 1)) == SDMMC_OK);
+	CHECK(done.count == 1);
+	CHECK(reqs[0].bStatus == SDMMC_BUSY);
+	CHECK(done.status[0] == SDMMC_BUSY);
+
+	CHECK(SD_SubmitRequest(&sd, _request(1, true, 2, 2)) == SDMMC_OK);
+	CHECK(drv.pending == NULL);
+	CHECK(SD_PollRequests(&sd) == SDMMC_BUSY);
+	CHECK(drv.cmds[12] == 0);
+	CHECK(drv.pending != NULL);
+	if (drv.pending)
+		_complete();
+	CHECK(done.count == 2);
+	CHECK(reqs[1].bStatus == SDMMC_OK);
+	CHECK(_data_ok(&reqs[1]));
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+}
+
+static void test_polling(void)
+{
+	uint32_t i, polls;
+
+	_reset(CARD_SDHC);
+	drv.polling = true;
+	for (i = 0; i < 4; i++)
+		CHECK(SD_SubmitRequest(&sd, _request(i, i != 2, 30 + i * 16,
+				4 + i)) == SDMMC_OK);
+
+	for (polls = 0; polls < 100; polls++)
+		if (SD_PollRequests(&sd) != SDMMC_BUSY)
+			break;
+	CHECK(polls < 100);
+	CHECK(done.count == 4);
+	for (i = 0; i < 4; i++) {
+		CHECK(done.order[i] == i);
+		CHECK(reqs[i].bStatus == SDMMC_OK);
+		CHECK(_data_ok(&reqs[i]));
+	}
+	CHECK(drv.cmd_while_busy == 0);
+}
+
+static void test_sync_fallback(void)
+{
+	/* SET_BLOCK_COUNT: complete before SD_SubmitRequest() returns */
+	_reset(CARD_SDHC);
+	sd.bSetBlkCnt = 1;
+	CHECK(SD_SubmitRequest(&sd, _request(0, true, 40, 4)) == SDMMC_OK);
+	CHECK(done.count == 1);
+	CHECK(reqs[0].bStatus == SDMMC_OK);
+	CHECK(_data_ok(&reqs[0]));
+	CHECK(drv.cmds[23] == 1 && drv.cmds[18] == 1);
+	CHECK(sd.pReqHead == NULL && !sd.bReqActive);
+
+	/* A failure is reported through the request, not by the call */
+	drv.fail = SDMMC_ERR_IO;
+	CHECK(SD_SubmitRequest(&sd, _request(1, true, 50, 1)) == SDMMC_OK);
+	CHECK(done.count == 2);
+	CHECK(reqs[1].bStatus == SDMMC_ERR_IO);
+	CHECK(done.status[1] == SDMMC_ERR_IO);
+	CHECK(drv.state == STATUS_TRAN);
+
+	/* STOP_TRANSMISSION */
+	_reset(CARD_SDHC);
+	sd.bStopMultXfer = 1;
+	drv.open_ended = true;
+	CHECK(SD_SubmitRequest(&sd, _request(0, false, 70, 2)) == SDMMC_OK);
+	CHECK(done.count == 1);
+	CHECK(reqs[0].bStatus == SDMMC_OK);
+	CHECK(_data_ok(&reqs[0]));
+	CHECK(drv.cmds[25] == 1 && drv.cmds[12] == 1);
+	CHECK(drv.state == STATUS_TRAN);
+	CHECK(SD_PollRequests(&sd) == SDMMC_OK);
+}
+
+static void test_invalid_requests(void)
+{
+	_reset(CARD_SDHC);
+	_request(0, true, 0, 1)->pData = NULL;
+	CHECK(SD_SubmitRequest(&sd, &reqs[0]) == SDMMC_PARAM);
+	CHECK(SD_SubmitRequest(&sd, _request(1, true, 0, 0)) == SDMMC_PARAM);
+	CHECK(SD_SubmitRequest(&sd, _request(2, true, 0xffffffff, 2)) ==
+			SDMMC_PARAM);
+
+	/* Byte addresses of a standard capacity card hold on 32 bits */
+	_reset(CARD_SD);
+	CHECK(SD_SubmitRequest(&sd, _request(3, true, 0x800000, 1)) ==
+			SDMMC_PARAM);
+	CHECK(done.count == 0);
+	CHECK(drv.log_len == 0);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+void timer_start_timeout(struct _timeout* timeout, uint64_t count)
+{
+}
+
+uint8_t timer_timeout_reached(struct _timeout* timeout)
+{
+	return 0;
+}
+
+void msleep(uint32_t count)
+{
+}
+
+void usleep(uint32_t count)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+static void *_run_tests(void *arg)
+{
+	RUN_TEST(test_full_queue_in_order);
+	RUN_TEST(test_driver_splits);
+	RUN_TEST(test_65535_block_limit);
+	RUN_TEST(test_submit_from_callback);
+	RUN_TEST(test_error_halts_queue);
+	RUN_TEST(test_driver_busy);
+	RUN_TEST(test_polling);
+	RUN_TEST(test_sync_fallback);
+	RUN_TEST(test_invalid_requests);
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, stack, sizeof(stack));
+	if (pthread_create(&thread, &attr, _run_tests, NULL))
+		return 1;
+	pthread_join(thread, NULL);
+
+	return test_failures ? 1 : 0;
+}
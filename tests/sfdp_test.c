@@ -0,0 +1,609 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the SFDP parser (sfdp.c) on the SFDP images of three
+ * memories above 16 MiB: Micron MT25QL512ABB, Macronix MX25L51245G and
+ * Spansion S25FS512S, whose hybrid sectors are described by a Sector Map
+ * Parameter Table. The images hold the Basic Flash Parameter Table, the
+ * 4-byte Address Instruction Table (4BAIT) and, for the Spansion part, the
+ * Sector Map Parameter Table (SMPT), modelled on the SFDP sections of the
+ * datasheets: the fields the parser reads follow the datasheets, the others
+ * are filler.
+ *
+ * Each image is parsed as spi_nor_probe() does, then spi_flash_setup()
+ * selects the commands for a QSPI controller without x-x-x protocols. The
+ * test checks the read, program and erase instructions and the sector map.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nvm/spi-nor/spi-nor.h"
+#include "timer.h"
+
+/* sfdp.c is included to reach the 4BAIT and SMPT parsers */
+#include "nvm/spi-nor/sfdp.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SZ_4K   (4 * 1024)
+#define SZ_32K  (32 * 1024)
+#define SZ_64K  (64 * 1024)
+#define SZ_256K (256 * 1024)
+#define SZ_16M  (16 * 1024 * 1024)
+#define SZ_64M  (64 * 1024 * 1024)
+
+/* Byte address of the parameter tables in the images */
+#define BFPT_PTP   0x30
+#define BAIT_PTP   0x80
+#define SMPT_PTP   0x90
+
+#define DW(ptp) ((ptp) / 4)
+
+#define SFDP_HEADER(nph) \
+	SFDP_SIGNATURE, (SFDP_JESD216B_MINOR | (SFDP_JESD216_MAJOR << 8) \
+			 | ((nph) << 16) | (0xffu << 24))
+
+#define PARAM_HEADER(id, minor, len, ptp) \
+	(((id) & 0xffu) | ((minor) << 8) | (1u << 16) | ((uint32_t)(len) << 24)), \
+	((ptp) | (((id) >> 8) << 24))
+
+/* Controller capabilities of the QSPI */
+#define QSPI_HWCAPS (SFLASH_HWCAPS_READ | SFLASH_HWCAPS_READ_FAST \
+		     | SFLASH_HWCAPS_READ_1_1_2 | SFLASH_HWCAPS_READ_1_2_2 \
+		     | SFLASH_HWCAPS_READ_1_1_4 | SFLASH_HWCAPS_READ_1_4_4 \
+		     | SFLASH_HWCAPS_PP | SFLASH_HWCAPS_PP_1_1_4 \
+		     | SFLASH_HWCAPS_PP_1_4_4)
+
+/* Read Any Register of the Spansion parts, and its registers */
+#define SPANSION_RDAR  0x65
+#define SPANSION_CR1V  0x800002
+#define SPANSION_CR3V  0x800004
+
+struct _register {
+	uint32_t addr;
+	uint8_t value;
+};
+
+struct _dump {
+	const char *name;
+	uint8_t mfr;
+	const uint32_t *image;
+	uint32_t size;
+	/* Page Program protocols declared by the flash table, if any */
+	uint32_t pp_hwcaps;
+	/* Registers read by the SMPT configuration detection commands */
+	struct _register regs[2];
+};
+
+struct _expect {
+	uint32_t size;
+	uint32_t page_size;
+	uint32_t hwcaps;
+	uint8_t read_inst;
+	enum spi_flash_protocol read_proto;
+	uint8_t mode_cycles;
+	uint8_t wait_states;
+	uint8_t pp_inst;
+	enum spi_flash_protocol pp_proto;
+	bool addr_4b_inst;
+	struct {
+		uint32_t size;
+		uint8_t inst;
+	} erases[SFLASH_CMD_ERASE_MAX];
+	int (*quad_enable)(struct spi_flash *flash);
+	bool uniform;
+	uint32_t num_regions;
+	struct spi_flash_erase_region regions[SFLASH_ERASE_REGION_MAX];
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+/* Micron MT25QL512ABB: 1-1-2 to 4-4-4 reads, 4K/32K/64K erases */
+static const uint32_t mt25ql512[] = {
+	SFDP_HEADER(1),
+	PARAM_HEADER(SFDP_BFPT_ID, SFDP_JESD216B_MINOR, 16, BFPT_PTP),
+	PARAM_HEADER(SFDP_4BAIT_ID, 0, 2, BAIT_PTP),
+	[DW(BFPT_PTP)] =
+	0xfff320e5, 0x1fffffff, 0x6b08eb29, 0xbb273b08,
+	0xffffffff, 0xbb27ffff, 0xeb29ffff, 0x520f200c,
+	0x0000d810, 0xa3267521, 0xf1d98181, 0xeb3a0f7e,
+	0x7a757a75, 0xf7a2d55c, 0x000f9dff, 0xb01608f4,
+	[DW(BAIT_PTP)] =
+	0x0000efff, 0xffdc5c21,
+};
+
+/* Micron MT25QL128ABB: same tables at 16 MiB, where the 4BAIT is not
+ * needed */
+static uint32_t mt25ql128[ARRAY_SIZE(mt25ql512)];
+
+/* Macronix MX25L51245G: no 2-2-2 read, no 4-byte 1-1-4 program */
+static const uint32_t mx25l51245g[] = {
+	SFDP_HEADER(1),
+	PARAM_HEADER(SFDP_BFPT_ID, SFDP_JESD216B_MINOR, 16, BFPT_PTP),
+	PARAM_HEADER(SFDP_4BAIT_ID, 0, 2, BAIT_PTP),
+	[DW(BFPT_PTP)] =
+	0xfff320e5, 0x1fffffff, 0x6b08eb44, 0xbb043b08,
+	0xfffffffe, 0xff00ffff, 0xeb44ffff, 0x520f200c,
+	0xff00d810, 0x00ff82d5, 0x00c9e28f, 0xcf8c4000,
+	0x7a75ff00, 0xf79a5c00, 0xff219ff9, 0x003ed000,
+	[DW(BAIT_PTP)] =
+	0x0000af7f, 0xffdc5c21,
+};
+
+/* Spansion S25FS512S: 256K sectors, with 8 4K sectors at the bottom or at
+ * the top when the hybrid configuration is enabled (CR3V[3] = 0), as
+ * selected by CR1V[2] */
+static const uint32_t s25fs512s[] = {
+	SFDP_HEADER(2),
+	PARAM_HEADER(SFDP_BFPT_ID, SFDP_JESD216B_MINOR, 16, BFPT_PTP),
+	PARAM_HEADER(SFDP_4BAIT_ID, 0, 2, BAIT_PTP),
+	PARAM_HEADER(SFDP_SMPT_ID, 0, 16, SMPT_PTP),
+	[DW(BFPT_PTP)] =
+	0xfff320e5, 0x1fffffff, 0x6b08eb48, 0xbb803b08,
+	0xffffffee, 0xffffffff, 0xffffffff, 0x0000200c,
+	0x0000d812, 0x0000ffff, 0x00c9e281, 0x03308cea,
+	0xf5f57ae8, 0xff53b39c, 0x00508ff9, 0xb0ffffff,
+	[DW(BAIT_PTP)] =
+	0x0000ea7f, 0xffdcff21,
+	[DW(SMPT_PTP)] =
+	/* configuration detection: CR3V[3], then CR1V[2] */
+	0x08cf6500, SPANSION_CR3V,
+	0x04cf6501, SPANSION_CR1V,
+	/* map 0: 4K sectors at the bottom */
+	0x00020002, 0x00007f01, 0x00037f04, 0x03fbff04,
+	/* map 1: 4K sectors at the top */
+	0x00020102, 0x03fbff04, 0x00037f04, 0x00007f01,
+	/* maps 2 and 3: uniform 256K sectors */
+	0x00000202, 0x03ffff04,
+	0x00000303, 0x03ffff04,
+};
+
+static const struct _dump *current;
+
+/* Number of SMPT configuration detection commands run */
+static int detections;
+
+static int quad_enabled;
+
+/*---------------------------------------------------------------------- */
+/*         Simulated memory                                              */
+/*---------------------------------------------------------------------- */
+
+static int _exec(union spi_flash_priv *priv, const struct spi_flash_command *cmd)
+{
+	uint8_t *rx = (uint8_t *)cmd->rx_data;
+	int i;
+
+	switch (cmd->inst) {
+	case SFLASH_INST_READ_SFDP:
+		CHECK(cmd->addr_len == 3 && cmd->num_wait_states == 8);
+		/* past the tables, the SFDP area reads as erased */
+		memset(rx, 0xff, cmd->data_len);
+		if (cmd->addr < current->size)
+			memcpy(rx, (const uint8_t *)current->image + cmd->addr,
+			       min_u32(cmd->data_len, current->size - cmd->addr));
+		return 0;
+
+	case SPANSION_RDAR:
+		CHECK(cmd->addr_len == 3 && cmd->num_wait_states == 8);
+		CHECK(cmd->data_len == 1);
+		detections++;
+		for (i = 0; i < ARRAY_SIZE(current->regs); i++) {
+			if (current->regs[i].addr == cmd->addr) {
+				*rx = current->regs[i].value;
+				return 0;
+			}
+		}
+		CHECK(false);
+		return -EIO;
+
+	default:
+		CHECK(false);
+		return -EIO;
+	}
+}
+
+static const struct spi_ops sim_ops = {
+	.exec = _exec,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+/* Probe the memory as spi_nor_probe() does: legacy defaults, then SFDP,
+ * then selection of the commands */
+static void _probe(const struct _dump *dump, struct spi_flash *flash,
+		struct spi_flash_parameters *params)
+{
+	current = dump;
+	detections = 0;
+	quad_enabled = 0;
+
+	memset(flash, 0, sizeof(*flash));
+	flash->ops = &sim_ops;
+	flash->id[0] = dump->mfr;
+	flash->read_proto = SFLASH_PROTO_1_1_1;
+	flash->hwcaps.mask = QSPI_HWCAPS;
+
+	memset(params, 0, sizeof(*params));
+	params->hwcaps.mask = SFLASH_HWCAPS_READ | SFLASH_HWCAPS_READ_FAST
+		| SFLASH_HWCAPS_PP | dump->pp_hwcaps;
+	spi_flash_set_read_settings(&params->reads[SFLASH_CMD_READ], 0, 0,
+			SFLASH_INST_READ, SFLASH_PROTO_1_1_1);
+	spi_flash_set_read_settings(&params->reads[SFLASH_CMD_READ_FAST], 0, 8,
+			SFLASH_INST_FAST_READ, SFLASH_PROTO_1_1_1);
+	spi_flash_set_pp_settings(&params->page_programs[SFLASH_CMD_PP],
+			SFLASH_INST_PAGE_PROGRAM, SFLASH_PROTO_1_1_1);
+	spi_flash_set_pp_settings(&params->page_programs[SFLASH_CMD_PP_1_1_4],
+			SFLASH_INST_PAGE_PROGRAM_1_1_4, SFLASH_PROTO_1_1_4);
+	spi_flash_set_pp_settings(&params->page_programs[SFLASH_CMD_PP_1_4_4],
+			SFLASH_INST_PAGE_PROGRAM_1_4_4, SFLASH_PROTO_1_4_4);
+
+	CHECK(spi_flash_parse_sfdp(flash, params) == 0);
+	CHECK(spi_flash_setup(flash, params) == 0);
+}
+
+static void _check(const struct _dump *dump, const struct _expect *e)
+{
+	struct spi_flash flash;
+	struct spi_flash_parameters params;
+	const struct spi_flash_erase_map *map = &flash.erase_map;
+	unsigned before = test_failures;
+	uint32_t i;
+
+	_probe(dump, &flash, &params);
+
+	CHECK(params.size == e->size);
+	CHECK(params.page_size == e->page_size);
+	CHECK(params.hwcaps.mask == e->hwcaps);
+	CHECK(params.addr_4b_inst == e->addr_4b_inst);
+	CHECK(params.quad_enable == e->quad_enable);
+
+	CHECK(flash.read_inst == e->read_inst);
+	CHECK(flash.read_proto == e->read_proto);
+	CHECK(flash.num_mode_cycles == e->mode_cycles);
+	CHECK(flash.num_wait_states == e->wait_states);
+	CHECK(flash.write_inst == e->pp_inst);
+	CHECK(flash.write_proto == e->pp_proto);
+	CHECK(quad_enabled == (e->quad_enable != NULL));
+
+	for (i = 0; i < SFLASH_CMD_ERASE_MAX; i++) {
+		CHECK(map->commands[i].size == e->erases[i].size);
+		if (e->erases[i].size)
+			CHECK(map->commands[i].inst == e->erases[i].inst);
+	}
+
+	CHECK(spi_flash_has_uniform_erase(&flash) == e->uniform);
+	CHECK(map->num_regions == e->num_regions);
+	for (i = 0; i < e->num_regions && i < map->num_regions; i++) {
+		CHECK(map->regions[i].offset == e->regions[i].offset);
+		CHECK(map->regions[i].size == e->regions[i].size);
+		CHECK(map->regions[i].cmd_mask == e->regions[i].cmd_mask);
+	}
+
+	if (test_failures != before)
+		printf("  %s\n", dump->name);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_micron(void)
+{
+	static const struct _dump dump = {
+		.name = "MT25QL512ABB", .mfr = SFLASH_MFR_MICRON,
+		.image = mt25ql512, .size = sizeof(mt25ql512),
+	};
+	static const struct _expect expect = {
+		.size = SZ_64M,
+		.page_size = 256,
+		.hwcaps = SFLASH_HWCAPS_READ_MASK | SFLASH_HWCAPS_PP,
+		.read_inst = SFLASH_INST_FAST_READ_1_4_4_4B,
+		.read_proto = SFLASH_PROTO_1_4_4,
+		.mode_cycles = 1, .wait_states = 9,
+		.pp_inst = SFLASH_INST_PAGE_PROGRAM_4B,
+		.pp_proto = SFLASH_PROTO_1_1_1,
+		.addr_4b_inst = true,
+		.erases = {
+			{ SZ_4K, SFLASH_INST_ERASE_4K_4B },
+			{ SZ_32K, SFLASH_INST_ERASE_32K_4B },
+			{ SZ_64K, SFLASH_INST_ERASE_64K_4B },
+		},
+		.uniform = true,
+		.num_regions = 1,
+		.regions = { { 0x7, 0, SZ_64M } },
+	};
+	struct spi_flash flash;
+	struct spi_flash_parameters params;
+
+	_check(&dump, &expect);
+
+	/* The x-x-x reads, not selected with this controller, keep their
+	 * settings and get the 4-byte instruction of their 1-x-x
+	 * counterpart */
+	_probe(&dump, &flash, &params);
+	CHECK(params.reads[SFLASH_CMD_READ_2_2_2].inst == SFLASH_INST_FAST_READ_1_2_2_4B);
+	CHECK(params.reads[SFLASH_CMD_READ_2_2_2].proto == SFLASH_PROTO_2_2_2);
+	CHECK(params.reads[SFLASH_CMD_READ_4_4_4].inst == SFLASH_INST_FAST_READ_1_4_4_4B);
+	CHECK(params.reads[SFLASH_CMD_READ_4_4_4].proto == SFLASH_PROTO_4_4_4);
+	CHECK(params.reads[SFLASH_CMD_READ_1_1_4].inst == SFLASH_INST_FAST_READ_1_1_4_4B);
+	CHECK(params.reads[SFLASH_CMD_READ].inst == SFLASH_INST_READ_4B);
+	CHECK(flash.enable_0_4_4 == micron_enable_0_4_4);
+}
+
+/* At 16 MiB, the 4BAIT is ignored and the 3-byte instructions are kept */
+static void test_micron_16m(void)
+{
+	static const struct _dump dump = {
+		.name = "MT25QL128ABB", .mfr = SFLASH_MFR_MICRON,
+		.image = mt25ql128, .size = sizeof(mt25ql128),
+	};
+	static const struct _expect expect = {
+		.size = SZ_16M,
+		.page_size = 256,
+		.hwcaps = SFLASH_HWCAPS_READ_MASK | SFLASH_HWCAPS_PP,
+		.read_inst = SFLASH_INST_FAST_READ_1_4_4,
+		.read_proto = SFLASH_PROTO_1_4_4,
+		.mode_cycles = 1, .wait_states = 9,
+		.pp_inst = SFLASH_INST_PAGE_PROGRAM,
+		.pp_proto = SFLASH_PROTO_1_1_1,
+		.addr_4b_inst = false,
+		.erases = {
+			{ SZ_4K, SFLASH_INST_ERASE_4K },
+			{ SZ_32K, SFLASH_INST_ERASE_32K },
+			{ SZ_64K, SFLASH_INST_ERASE_64K },
+		},
+		.uniform = true,
+		.num_regions = 1,
+		.regions = { { 0x7, 0, SZ_16M } },
+	};
+
+	memcpy(mt25ql128, mt25ql512, sizeof(mt25ql128));
+	mt25ql128[DW(BFPT_PTP) + BFPT_DWORD2] = 0x07ffffff;
+	_check(&dump, &expect);
+}
+
+/* The flash table declares the quad Page Programs: 1-1-4 has no 4-byte
+ * instruction and is dropped */
+static void test_macronix(void)
+{
+	static const struct _dump dump = {
+		.name = "MX25L51245G", .mfr = SFLASH_MFR_MACRONIX,
+		.image = mx25l51245g, .size = sizeof(mx25l51245g),
+		.pp_hwcaps = SFLASH_HWCAPS_PP_1_1_4 | SFLASH_HWCAPS_PP_1_4_4,
+	};
+	static const struct _expect expect = {
+		.size = SZ_64M,
+		.page_size = 256,
+		.hwcaps = (SFLASH_HWCAPS_READ_MASK & ~SFLASH_HWCAPS_READ_2_2_2)
+			| SFLASH_HWCAPS_PP | SFLASH_HWCAPS_PP_1_4_4,
+		.read_inst = SFLASH_INST_FAST_READ_1_4_4_4B,
+		.read_proto = SFLASH_PROTO_1_4_4,
+		.mode_cycles = 2, .wait_states = 4,
+		.pp_inst = SFLASH_INST_PAGE_PROGRAM_1_4_4_4B,
+		.pp_proto = SFLASH_PROTO_1_4_4,
+		.addr_4b_inst = true,
+		.erases = {
+			{ SZ_4K, SFLASH_INST_ERASE_4K_4B },
+			{ SZ_32K, SFLASH_INST_ERASE_32K_4B },
+			{ SZ_64K, SFLASH_INST_ERASE_64K_4B },
+		},
+		.quad_enable = macronix_quad_enable,
+		.uniform = true,
+		.num_regions = 1,
+		.regions = { { 0x7, 0, SZ_64M } },
+	};
+	struct spi_flash flash;
+	struct spi_flash_parameters params;
+
+	_check(&dump, &expect);
+
+	_probe(&dump, &flash, &params);
+	CHECK(params.reads[SFLASH_CMD_READ_4_4_4].inst == SFLASH_INST_FAST_READ_1_4_4_4B);
+}
+
+static void test_spansion_hybrid(void)
+{
+	struct _dump dump = {
+		.mfr = SFLASH_MFR_SPANSION,
+		.image = s25fs512s, .size = sizeof(s25fs512s),
+	};
+	struct _expect expect = {
+		.size = SZ_64M,
+		.page_size = 256,
+		.hwcaps = SFLASH_HWCAPS_READ | SFLASH_HWCAPS_READ_FAST
+			| SFLASH_HWCAPS_READ_1_1_2 | SFLASH_HWCAPS_READ_1_2_2
+			| SFLASH_HWCAPS_READ_1_1_4 | SFLASH_HWCAPS_READ_1_4_4
+			| SFLASH_HWCAPS_PP,
+		.read_inst = SFLASH_INST_FAST_READ_1_4_4_4B,
+		.read_proto = SFLASH_PROTO_1_4_4,
+		.mode_cycles = 2, .wait_states = 8,
+		.pp_inst = SFLASH_INST_PAGE_PROGRAM_4B,
+		.pp_proto = SFLASH_PROTO_1_1_1,
+		.addr_4b_inst = true,
+		.erases = {
+			{ SZ_4K, SFLASH_INST_ERASE_4K_4B },
+			{ 0, 0 },
+			{ SZ_256K, SFLASH_INST_ERASE_64K_4B },
+		},
+		.quad_enable = spansion_new_quad_enable,
+		.uniform = false,
+		.num_regions = 3,
+	};
+	const struct spi_flash_erase_region bottom[] = {
+		{ 0x1, 0, SZ_32K },
+		{ 0x4, SZ_32K, SZ_256K - SZ_32K },
+		{ 0x4, SZ_256K, SZ_64M - SZ_256K },
+	};
+	const struct spi_flash_erase_region top[] = {
+		{ 0x4, 0, SZ_64M - SZ_256K },
+		{ 0x4, SZ_64M - SZ_256K, SZ_256K - SZ_32K },
+		{ 0x1, SZ_64M - SZ_32K, SZ_32K },
+	};
+
+	/* CR3V[3] = 0, CR1V[2] = 0: map 0 */
+	dump.name = "S25FS512S, 4K sectors at the bottom";
+	dump.regs[0].addr = SPANSION_CR3V;
+	dump.regs[0].value = 0x00;
+	dump.regs[1].addr = SPANSION_CR1V;
+	dump.regs[1].value = 0x00;
+	memcpy(expect.regions, bottom, sizeof(bottom));
+	_check(&dump, &expect);
+	CHECK(detections == 2);
+
+	/* CR3V[3] = 0, CR1V[2] = 1: map 1 */
+	dump.name = "S25FS512S, 4K sectors at the top";
+	dump.regs[1].value = 0x04;
+	memcpy(expect.regions, top, sizeof(top));
+	_check(&dump, &expect);
+}
+
+static void test_spansion_uniform(void)
+{
+	struct _dump dump = {
+		.name = "S25FS512S, uniform",
+		.mfr = SFLASH_MFR_SPANSION,
+		.image = s25fs512s, .size = sizeof(s25fs512s),
+		.regs = {
+			{ SPANSION_CR3V, 0x08 },
+			{ SPANSION_CR1V, 0x04 },
+		},
+	};
+	struct spi_flash flash;
+	struct spi_flash_parameters params;
+	const struct spi_flash_erase_map *map = &flash.erase_map;
+
+	/* CR3V[3] = 1: map 3, a single region of 256K sectors */
+	_probe(&dump, &flash, &params);
+	CHECK(map->num_regions == 1);
+	CHECK(!spi_flash_has_uniform_erase(&flash));
+	CHECK(map->regions[0].offset == 0);
+	CHECK(map->regions[0].size == SZ_64M);
+	CHECK(map->regions[0].cmd_mask == 0x4);
+	CHECK(spi_flash_select_erase(map, SZ_256K, SZ_256K) == &map->commands[2]);
+	CHECK(spi_flash_select_erase(map, 0, SZ_4K) == NULL);
+}
+
+/* A Sector Map not covering the whole memory, or a 4BAIT without any Page
+ * Program, is ignored */
+static void test_invalid_tables(void)
+{
+	static uint32_t image[ARRAY_SIZE(s25fs512s)];
+	struct _dump dump = {
+		.name = "S25FS512S, damaged",
+		.mfr = SFLASH_MFR_SPANSION,
+		.image = image, .size = sizeof(image),
+		.regs = {
+			{ SPANSION_CR3V, 0x08 },
+			{ SPANSION_CR1V, 0x00 },
+		},
+	};
+	struct spi_flash flash;
+	struct spi_flash_parameters params;
+
+	memcpy(image, s25fs512s, sizeof(image));
+	image[DW(SMPT_PTP) + 13] = 0x03fffe04;
+	image[DW(BAIT_PTP)] &= ~0x1c0u;
+	_probe(&dump, &flash, &params);
+	CHECK(spi_flash_has_uniform_erase(&flash));
+	CHECK(flash.erase_map.uniform_region.cmd_mask == 0x5);
+	CHECK(!params.addr_4b_inst);
+	CHECK(flash.read_inst == SFLASH_INST_FAST_READ_1_4_4);
+	CHECK(flash.write_inst == SFLASH_INST_PAGE_PROGRAM);
+	CHECK(flash.erase_map.commands[0].inst == SFLASH_INST_ERASE_4K);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+int spansion_new_quad_enable(struct spi_flash *flash)
+{
+	quad_enabled++;
+	return 0;
+}
+
+int spansion_quad_enable(struct spi_flash *flash)
+{
+	quad_enabled++;
+	return 0;
+}
+
+int macronix_quad_enable(struct spi_flash *flash)
+{
+	quad_enabled++;
+	return 0;
+}
+
+int sr2_bit7_quad_enable(struct spi_flash *flash)
+{
+	quad_enabled++;
+	return 0;
+}
+
+int micron_enable_0_4_4(struct spi_flash *flash, bool enable)
+{
+	return 0;
+}
+
+void msleep(uint32_t count)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_micron);
+	RUN_TEST(test_micron_16m);
+	RUN_TEST(test_macronix);
+	RUN_TEST(test_spansion_hybrid);
+	RUN_TEST(test_spansion_uniform);
+	RUN_TEST(test_invalid_tables);
+
+	return test_failures ? 1 : 0;
+}
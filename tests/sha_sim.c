@@ -0,0 +1,376 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "chip.h"
+#include "crypto/sha.h"
+#include "dma/dma.h"
+#include "mm/cache.h"
+#include "mutex.h"
+#include "peripherals/pmc.h"
+
+#include "sha_sim.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define SHA_SIM_BLOCK_SIZE 64
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct {
+	uint32_t mode;
+	bool first;
+	uint32_t state[8];
+	uint8_t uihv[32];
+	bool uihv_loaded;
+	uint32_t status;
+} sha;
+
+static const uint32_t sha1_iv[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+static const uint32_t sha256_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static struct _dma_channel *dummy_channel = (struct _dma_channel *)&sha;
+
+/*---------------------------------------------------------------------- */
+/*         Exported variables                                            */
+/*---------------------------------------------------------------------- */
+
+struct _sha_sim_stats sha_sim_stats;
+
+/*---------------------------------------------------------------------- */
+/*         SHA-1 and SHA-256                                             */
+/*---------------------------------------------------------------------- */
+
+static uint32_t _get_be32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+		| ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void _put_be32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void _sha1_block(uint32_t *h, const uint8_t *block)
+{
+	uint32_t w[80], a, b, c, d, e, f, k, t;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = _get_be32(&block[4 * i]);
+	for (i = 16; i < 80; i++)
+		w[i] = ROTL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		t = ROTL(a, 5) + f + e + k + w[i];
+		e = d; d = c; c = ROTL(b, 30); b = a; a = t;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void _sha256_block(uint32_t *h, const uint8_t *block)
+{
+	uint32_t w[64], s[8], s0, s1, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = _get_be32(&block[4 * i]);
+	for (i = 16; i < 64; i++) {
+		s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	memcpy(s, h, sizeof(s));
+	for (i = 0; i < 64; i++) {
+		t1 = s[7] + (ROTR(s[4], 6) ^ ROTR(s[4], 11) ^ ROTR(s[4], 25))
+			+ ((s[4] & s[5]) ^ (~s[4] & s[6])) + sha256_k[i] + w[i];
+		t2 = (ROTR(s[0], 2) ^ ROTR(s[0], 13) ^ ROTR(s[0], 22))
+			+ ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		memmove(&s[1], &s[0], 7 * sizeof(s[0]));
+		s[4] += t1;
+		s[0] = t1 + t2;
+	}
+	for (i = 0; i < 8; i++)
+		h[i] += s[i];
+}
+
+/* Number of hash words of the configured algorithm, 0 if not modelled */
+static int _hash_words(void)
+{
+	switch (sha.mode & SHA_MR_ALGO_Msk) {
+	case SHA_MR_ALGO_SHA1:
+		return 5;
+	case SHA_MR_ALGO_SHA256:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+static void _process(const uint8_t *block)
+{
+	int i, words = _hash_words();
+
+	sha.status &= ~SHA_ISR_DATRDY;
+	if (!words || (sha.mode & SHA_MR_SMOD_Msk) != SHA_MR_SMOD_AUTO_START) {
+		sha_sim_stats.errors++;
+		return;
+	}
+
+	if (sha.first) {
+		if (sha.mode & SHA_MR_UIHV) {
+			if (!sha.uihv_loaded)
+				sha_sim_stats.errors++;
+			for (i = 0; i < words; i++)
+				sha.state[i] = _get_be32(&sha.uihv[4 * i]);
+			sha_sim_stats.restores++;
+		} else {
+			memcpy(sha.state, words == 5 ? sha1_iv : sha256_iv,
+			       words * sizeof(uint32_t));
+		}
+		sha.first = false;
+	}
+
+	if (words == 5)
+		_sha1_block(sha.state, block);
+	else
+		_sha256_block(sha.state, block);
+	sha_sim_stats.blocks++;
+	sha.status |= SHA_ISR_DATRDY;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Simulated peripheral                                          */
+/*---------------------------------------------------------------------- */
+
+void sha_start(void)
+{
+}
+
+void sha_soft_reset(void)
+{
+	memset(&sha, 0, sizeof(sha));
+}
+
+void sha_first_block(void)
+{
+	sha.first = true;
+}
+
+void sha_configure(uint32_t mode)
+{
+	sha.mode = mode;
+}
+
+void sha_enable_it(uint32_t sources)
+{
+}
+
+void sha_disable_it(uint32_t sources)
+{
+}
+
+uint32_t sha_get_status(void)
+{
+	return sha.status;
+}
+
+void sha_set_input(const uint8_t* data, int len)
+{
+	/* In auto start mode, the block is processed once its last word is
+	 * written */
+	if (len != SHA_SIM_BLOCK_SIZE) {
+		sha_sim_stats.errors++;
+		return;
+	}
+	_process(data);
+}
+
+void sha_get_output(uint8_t* data, int len)
+{
+	int i;
+
+	for (i = 0; i < len / 4 && i < 8; i++)
+		_put_be32(&data[4 * i], sha.state[i]);
+}
+
+void sha_set_initial_hash(const uint8_t* data, int len)
+{
+	if (len > (int)sizeof(sha.uihv)) {
+		sha_sim_stats.errors++;
+		return;
+	}
+	memcpy(sha.uihv, data, len);
+	sha.uihv_loaded = true;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Host services                                                 */
+/*---------------------------------------------------------------------- */
+
+/* The driver and the model run on the same thread */
+
+bool mutex_try_lock(mutex_t *mutex)
+{
+	if (*mutex)
+		return false;
+	*mutex = 1;
+	return true;
+}
+
+void mutex_lock(mutex_t *mutex)
+{
+	while (!mutex_try_lock(mutex));
+}
+
+void mutex_unlock(mutex_t *mutex)
+{
+	*mutex = 0;
+}
+
+bool mutex_is_locked(const mutex_t *mutex)
+{
+	return *mutex != 0;
+}
+
+void cache_clean_region(const void *start, uint32_t length)
+{
+}
+
+void pmc_configure_peripheral(uint32_t id, const struct _pmc_periph_cfg *cfg,
+		bool enable)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         DMA                                                           */
+/*---------------------------------------------------------------------- */
+
+/* The channel is allocated by shad_init(), the transfers are not modelled */
+
+struct _dma_channel *dma_allocate_channel(uint8_t src, uint8_t dest)
+{
+	return dummy_channel;
+}
+
+int dma_configure_transfer(struct _dma_channel *channel,
+		struct _dma_cfg *cfg, struct _dma_transfer_cfg *list,
+		uint8_t list_size)
+{
+	sha_sim_stats.errors++;
+	return -1;
+}
+
+int dma_set_callback(struct _dma_channel *channel, struct _callback *cb)
+{
+	return 0;
+}
+
+int dma_start_transfer(struct _dma_channel *channel)
+{
+	sha_sim_stats.errors++;
+	return -1;
+}
+
+int dma_reset_channel(struct _dma_channel *channel)
+{
+	return 0;
+}
+
+void dma_poll(void)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Exported functions                                            */
+/*---------------------------------------------------------------------- */
+
+void sha_sim_reset(void)
+{
+	memset(&sha, 0, sizeof(sha));
+	memset(&sha_sim_stats, 0, sizeof(sha_sim_stats));
+}
@@ -0,0 +1,501 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the SHA contexts and HMAC functions of the SHA driver, on the
+ * SHA model of sha_sim.c: the FIPS 180 example messages for SHA-1 and
+ * SHA-256, hashed whole and split at every offset with another computation
+ * run on the peripheral in between, so that each split goes through a save
+ * and a restore of the intermediate hash value. The HMAC functions are
+ * checked against the SHA-256 vectors of RFC 4231 and the SHA-1 vectors of
+ * RFC 2202.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Interrupts are not masked, the model runs on the same thread */
+#define CONFIG_ARCH_ARM
+#include "irqflags.h"
+static inline uint32_t arch_irq_save(void) { return 0; }
+static inline void arch_irq_restore(uint32_t flags) {}
+
+#include "crypto/shad.c"
+
+#include "sha_sim.h"
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define MAX_TEXT 160
+
+struct _sha_vector {
+	const char *msg;
+	const char *sha1;
+	const char *sha256;
+};
+
+struct _hmac_vector {
+	const char *name;
+	const char *key;   /**< hex */
+	const char *data;  /**< hex */
+	const char *mac;   /**< hex, possibly truncated */
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+/* FIPS 180-2 appendices A and B, and the 896-bit message of appendix C */
+static const struct _sha_vector sha_vectors[] = {
+	{
+		.msg = "",
+		.sha1 = "da39a3ee5e6b4b0d3255bfef95601890afd80709",
+		.sha256 = "e3b0c44298fc1c149afbf4c8996fb924"
+			  "27ae41e4649b934ca495991b7852b855",
+	}, {
+		.msg = "abc",
+		.sha1 = "a9993e364706816aba3e25717850c26c9cd0d89d",
+		.sha256 = "ba7816bf8f01cfea414140de5dae2223"
+			  "b00361a396177a9cb410ff61f20015ad",
+	}, {
+		.msg = "abcdbcdecdefdefgefghfghighijhijk"
+		       "ijkljklmklmnlmnomnopnopq",
+		.sha1 = "84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+		.sha256 = "248d6a61d20638b8e5c026930c3e6039"
+			  "a33ce45964ff2167f6ecedd419db06c1",
+	}, {
+		.msg = "abcdefghbcdefghicdefghijdefghijk"
+		       "efghijklfghijklmghijklmnhijklmno"
+		       "ijklmnopjklmnopqklmnopqrlmnopqrs"
+		       "mnopqrstnopqrstu",
+		.sha1 = "a49b2446a02c645bf419f995b67091253a04a259",
+		.sha256 = "cf5b16a778af8380036ce59e7b049237"
+			  "0b249b11e8f07a51afac45037afee9d1",
+	},
+};
+
+/* One million repetitions of "a", FIPS 180-2 appendices A.3 and B.3 */
+#define MILLION_SHA1 "34aa973cd4c4daa4f61eeb2bdbad27316534016f"
+#define MILLION_SHA256 "cdc76e5c9914fb9281a1c7e284d73e67" \
+		       "f1809a48a497200e046d39ccc7112cd0"
+
+#define AA131 "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	      "aaaaaa"
+#define AA80 "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	     "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" \
+	     "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+#define DD50 "dddddddddddddddddddddddddddddddddddddddddddddddddd" \
+	     "dddddddddddddddddddddddddddddddddddddddddddddddddd"
+#define CD50 "cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd" \
+	     "cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"
+
+/* "Test Using Larger Than Block-Size Key - Hash Key First" */
+#define LARGER_KEY_DATA "54657374205573696e67204c61726765" \
+			"72205468616e20426c6f636b2d53697a" \
+			"65204b6579202d2048617368204b6579" \
+			"204669727374"
+
+/* RFC 4231, section 4 */
+static const struct _hmac_vector hmac_sha256_vectors[] = {
+	{
+		.name = "test case 1",
+		.key = "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
+		.data = "4869205468657265",
+		.mac = "b0344c61d8db38535ca8afceaf0bf12b"
+		       "881dc200c9833da726e9376c2e32cff7",
+	}, {
+		.name = "test case 2",
+		.key = "4a656665",
+		.data = "7768617420646f2079612077616e7420"
+			"666f72206e6f7468696e673f",
+		.mac = "5bdcc146bf60754e6a042426089575c7"
+		       "5a003f089d2739839dec58b964ec3843",
+	}, {
+		.name = "test case 3",
+		.key = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+		.data = DD50,
+		.mac = "773ea91e36800e46854db8ebd09181a7"
+		       "2959098b3ef8c122d9635514ced565fe",
+	}, {
+		.name = "test case 4",
+		.key = "0102030405060708090a0b0c0d0e0f10111213141516171819",
+		.data = CD50,
+		.mac = "82558a389a443c0ea4cc819899f2083a"
+		       "85f0faa3e578f8077a2e3ff46729665b",
+	}, {
+		.name = "test case 5",
+		.key = "0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c0c",
+		.data = "546573742057697468205472756e6361"
+			"74696f6e",
+		.mac = "a3b6167473100ee06e0c796c2955552b",
+	}, {
+		.name = "test case 6",
+		.key = AA131,
+		.data = LARGER_KEY_DATA,
+		.mac = "60e431591ee0b67f0d8a26aacbf5b77f"
+		       "8e0bc6213728c5140546040f0ee37f54",
+	}, {
+		.name = "test case 7",
+		.key = AA131,
+		.data = "54686973206973206120746573742075"
+			"73696e672061206c6172676572207468"
+			"616e20626c6f636b2d73697a65206b65"
+			"7920616e642061206c61726765722074"
+			"68616e20626c6f636b2d73697a652064"
+			"6174612e20546865206b6579206e6565"
+			"647320746f2062652068617368656420"
+			"6265666f7265206265696e6720757365"
+			"642062792074686520484d414320616c"
+			"676f726974686d2e",
+		.mac = "9b09ffa71b942fcb27635fbcd5b0e944"
+		       "bfdc63644f0713938a7f51535c3a35e2",
+	},
+};
+
+/* RFC 2202, section 3 */
+static const struct _hmac_vector hmac_sha1_vectors[] = {
+	{
+		.name = "test case 1",
+		.key = "0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
+		.data = "4869205468657265",
+		.mac = "b617318655057264e28bc0b6fb378c8ef146be00",
+	}, {
+		.name = "test case 2",
+		.key = "4a656665",
+		.data = "7768617420646f2079612077616e7420"
+			"666f72206e6f7468696e673f",
+		.mac = "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79",
+	}, {
+		.name = "test case 6",
+		.key = AA80,
+		.data = LARGER_KEY_DATA,
+		.mac = "aa4ae5e15272d00e95705637ce8a3b55ed402112",
+	}, {
+		.name = "test case 7",
+		.key = AA80,
+		.data = "54657374205573696e67204c61726765"
+			"72205468616e20426c6f636b2d53697a"
+			"65204b657920616e64204c6172676572"
+			"205468616e204f6e6520426c6f636b2d"
+			"53697a652044617461",
+		.mac = "e8e99d0f45237d786d6bbaa7965c7808bbff1a91",
+	},
+};
+
+static struct _shad_desc shad;
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static uint32_t _unhex(const char *hex, uint8_t *buf)
+{
+	uint32_t i, len = strlen(hex) / 2;
+	unsigned int byte;
+
+	for (i = 0; i < len; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		buf[i] = (uint8_t)byte;
+	}
+	return len;
+}
+
+static void _reset(void)
+{
+	sha_sim_reset();
+	memset(&shad, 0, sizeof(shad));
+	shad_init(&shad);
+	shad.cfg.transfer_mode = SHAD_TRANS_POLLING;
+}
+
+static bool _check_digest(struct _shad_ctx *ctx, const char *hex)
+{
+	uint8_t expected[SHAD_CTX_HASH_SIZE], out[SHAD_CTX_HASH_SIZE];
+	struct _buffer digest = {
+		.data = out,
+		.size = _unhex(hex, expected),
+	};
+
+	if (shad_ctx_finish(&shad, ctx, &digest) != 0)
+		return false;
+	return !memcmp(out, expected, digest.size);
+}
+
+/* Hash "abc" on the peripheral, overwriting its state */
+static void _hash_other(void)
+{
+	struct _shad_ctx other;
+
+	shad_ctx_init(&other, ALGO_SHA_256);
+	shad_ctx_update(&shad, &other, (const uint8_t *)"abc", 3);
+	CHECK(_check_digest(&other, sha_vectors[1].sha256));
+}
+
+/* Hash a message split in three parts, with another message hashed on the
+ * peripheral between the parts */
+static bool _hash_split(enum _shad_algo algo, const struct _sha_vector *vec,
+			uint32_t split1, uint32_t split2)
+{
+	const uint8_t *msg = (const uint8_t *)vec->msg;
+	uint32_t len = strlen(vec->msg);
+	struct _shad_ctx ctx;
+
+	shad_ctx_init(&ctx, algo);
+	if (shad_ctx_update(&shad, &ctx, msg, split1) != 0)
+		return false;
+	_hash_other();
+	if (shad_ctx_update(&shad, &ctx, msg + split1, split2 - split1) != 0)
+		return false;
+	_hash_other();
+	if (shad_ctx_update(&shad, &ctx, msg + split2, len - split2) != 0)
+		return false;
+	return _check_digest(&ctx, algo == ALGO_SHA_1 ? vec->sha1 : vec->sha256);
+}
+
+static void _run_hmac(enum _shad_algo algo, const struct _hmac_vector *vec)
+{
+	struct _shad_hmac_ctx ctx, other;
+	uint8_t key[MAX_TEXT], data[MAX_TEXT], expected[32], out[32];
+	uint32_t key_len, len, split;
+	struct _buffer mac = {
+		.data = out,
+	};
+	unsigned before = test_failures;
+
+	key_len = _unhex(vec->key, key);
+	len = _unhex(vec->data, data);
+	mac.size = _unhex(vec->mac, expected);
+
+	/* Whole message */
+	CHECK(shad_hmac_init(&shad, &ctx, algo, key, key_len) == 0);
+	CHECK(shad_hmac_update(&shad, &ctx, data, len) == 0);
+	memset(out, 0, sizeof(out));
+	CHECK(shad_hmac_finish(&shad, &ctx, &mac) == 0);
+	CHECK(!memcmp(out, expected, mac.size));
+
+	/* Split, interleaved with another HMAC computation */
+	for (split = 0; split <= len; split++) {
+		CHECK(shad_hmac_init(&shad, &ctx, algo, key, key_len) == 0);
+		CHECK(shad_hmac_update(&shad, &ctx, data, split) == 0);
+		CHECK(shad_hmac_init(&shad, &other, ALGO_SHA_256, data,
+				     len) == 0);
+		CHECK(shad_hmac_update(&shad, &other, key, key_len) == 0);
+		CHECK(shad_hmac_update(&shad, &ctx, data + split,
+				       len - split) == 0);
+		memset(out, 0, sizeof(out));
+		CHECK(shad_hmac_finish(&shad, &ctx, &mac) == 0);
+		CHECK(!memcmp(out, expected, mac.size));
+	}
+
+	if (test_failures != before)
+		printf("  %s\n", vec->name);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+/* The example messages hashed in one update */
+static void test_sha_vectors(void)
+{
+	struct _shad_ctx ctx;
+	uint32_t i;
+
+	_reset();
+	for (i = 0; i < ARRAY_SIZE(sha_vectors); i++) {
+		const struct _sha_vector *vec = &sha_vectors[i];
+		uint32_t len = strlen(vec->msg);
+
+		CHECK(shad_ctx_init(&ctx, ALGO_SHA_1) == 0);
+		CHECK(shad_ctx_update(&shad, &ctx, (const uint8_t *)vec->msg,
+				      len) == 0);
+		CHECK(_check_digest(&ctx, vec->sha1));
+
+		CHECK(shad_ctx_init(&ctx, ALGO_SHA_256) == 0);
+		CHECK(shad_ctx_update(&shad, &ctx, (const uint8_t *)vec->msg,
+				      len) == 0);
+		CHECK(_check_digest(&ctx, vec->sha256));
+	}
+	CHECK(sha_sim_stats.errors == 0);
+
+	/* The peripheral saves no 512-bit state */
+	CHECK(shad_ctx_init(&ctx, ALGO_SHA_512) == -ENOTSUP);
+}
+
+/* The example messages split in three parts at every pair of offsets: the
+ * intermediate hash value is saved and restored across the other
+ * computations */
+static void test_sha_save_restore(void)
+{
+	uint32_t i, split1, split2, len;
+
+	_reset();
+	for (i = 0; i < ARRAY_SIZE(sha_vectors); i++) {
+		len = strlen(sha_vectors[i].msg);
+		for (split1 = 0; split1 <= len; split1++) {
+			for (split2 = split1; split2 <= len; split2++) {
+				CHECK(_hash_split(ALGO_SHA_1, &sha_vectors[i],
+						  split1, split2));
+				CHECK(_hash_split(ALGO_SHA_256, &sha_vectors[i],
+						  split1, split2));
+			}
+		}
+	}
+	CHECK(sha_sim_stats.restores > 0);
+	CHECK(sha_sim_stats.errors == 0);
+}
+
+/* One million "a" in chunks of odd size, SHA-1 and SHA-256 interleaved */
+static void test_sha_million(void)
+{
+	static uint8_t chunk[997];
+	struct _shad_ctx sha1, sha256;
+	uint32_t done, len;
+
+	_reset();
+	memset(chunk, 'a', sizeof(chunk));
+	shad_ctx_init(&sha1, ALGO_SHA_1);
+	shad_ctx_init(&sha256, ALGO_SHA_256);
+	for (done = 0; done < 1000000; done += len) {
+		len = min_u32(sizeof(chunk), 1000000 - done);
+		CHECK(shad_ctx_update(&shad, &sha1, chunk, len) == 0);
+		CHECK(shad_ctx_update(&shad, &sha256, chunk, len) == 0);
+	}
+	CHECK(_check_digest(&sha1, MILLION_SHA1));
+	CHECK(_check_digest(&sha256, MILLION_SHA256));
+	CHECK(sha_sim_stats.errors == 0);
+}
+
+static void test_hmac_sha256(void)
+{
+	uint32_t i;
+
+	_reset();
+	for (i = 0; i < ARRAY_SIZE(hmac_sha256_vectors); i++)
+		_run_hmac(ALGO_SHA_256, &hmac_sha256_vectors[i]);
+	CHECK(sha_sim_stats.errors == 0);
+}
+
+static void test_hmac_sha1(void)
+{
+	uint32_t i;
+
+	_reset();
+	for (i = 0; i < ARRAY_SIZE(hmac_sha1_vectors); i++)
+		_run_hmac(ALGO_SHA_1, &hmac_sha1_vectors[i]);
+	CHECK(sha_sim_stats.errors == 0);
+}
+
+/* A copy of an initialized HMAC context authenticates several messages
+ * without hashing the key again */
+static void test_hmac_key_reuse(void)
+{
+	const struct _hmac_vector *vec = &hmac_sha256_vectors[5];
+	struct _shad_hmac_ctx keyed, ctx;
+	uint8_t key[MAX_TEXT], data[MAX_TEXT], expected[32], out[32];
+	uint32_t key_len, len, blocks, i;
+	struct _buffer mac = {
+		.data = out,
+		.size = sizeof(out),
+	};
+
+	_reset();
+	key_len = _unhex(vec->key, key);
+	len = _unhex(vec->data, data);
+	_unhex(vec->mac, expected);
+	CHECK(shad_hmac_init(&shad, &keyed, ALGO_SHA_256, key, key_len) == 0);
+
+	for (i = 0; i < 3; i++) {
+		blocks = sha_sim_stats.blocks;
+		ctx = keyed;
+		CHECK(shad_hmac_update(&shad, &ctx, data, len) == 0);
+		CHECK(shad_hmac_finish(&shad, &ctx, &mac) == 0);
+		CHECK(!memcmp(out, expected, sizeof(out)));
+		/* One block to finish the inner hash, one for the outer
+		 * one: the three blocks of the key are not hashed again */
+		CHECK(sha_sim_stats.blocks - blocks == 2);
+	}
+
+	/* Truncation to nothing or beyond the hash */
+	ctx = keyed;
+	mac.size = 0;
+	CHECK(shad_hmac_finish(&shad, &ctx, &mac) == -EINVAL);
+	mac.size = 33;
+	CHECK(shad_hmac_finish(&shad, &ctx, &mac) == -EINVAL);
+}
+
+/* The contexts do not wait for the peripheral: they fail while it is in
+ * use */
+static void test_ctx_busy(void)
+{
+	struct _shad_ctx ctx;
+	struct _shad_hmac_ctx hmac;
+	uint8_t key[4] = { 1, 2, 3, 4 };
+
+	_reset();
+	shad_ctx_init(&ctx, ALGO_SHA_256);
+	CHECK(mutex_try_lock(&shad.mutex));
+	CHECK(shad_ctx_update(&shad, &ctx, (const uint8_t *)"abc", 3) == -EAGAIN);
+	CHECK(shad_hmac_init(&shad, &hmac, ALGO_SHA_256, key,
+			     sizeof(key)) == -EAGAIN);
+	mutex_unlock(&shad.mutex);
+
+	/* Nothing was lost */
+	CHECK(shad_ctx_update(&shad, &ctx, (const uint8_t *)"abc", 3) == 0);
+	CHECK(_check_digest(&ctx, sha_vectors[1].sha256));
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_sha_vectors);
+	RUN_TEST(test_sha_save_restore);
+	RUN_TEST(test_sha_million);
+	RUN_TEST(test_hmac_sha256);
+	RUN_TEST(test_hmac_sha1);
+	RUN_TEST(test_hmac_key_reuse);
+	RUN_TEST(test_ctx_busy);
+
+	return test_failures ? 1 : 0;
+}
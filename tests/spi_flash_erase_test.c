@@ -0,0 +1,303 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the SPI NOR erase planner: erase command selection over
+ * uniform and non-uniform erase maps, region lookup at the boundaries, and
+ * the number of commands issued to cover a range.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "nvm/spi-nor/spi-flash.h"
+#include "timer.h"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define FLASH_SIZE  (1024 * 1024)
+
+#define SZ_4K  (4 * 1024)
+#define SZ_32K (32 * 1024)
+#define SZ_64K (64 * 1024)
+
+/* size of the 4K sector areas at both ends of the non-uniform map */
+#define BOOT_SIZE SZ_64K
+
+#define CMD_4K  (0x1UL << 0)
+#define CMD_32K (0x1UL << 1)
+#define CMD_64K (0x1UL << 2)
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static void _init_commands(struct spi_flash_erase_map *map)
+{
+	memset(map, 0, sizeof(*map));
+	spi_flash_set_erase_command(&map->commands[0], SZ_4K, SFLASH_INST_ERASE_4K);
+	spi_flash_set_erase_command(&map->commands[1], SZ_32K, SFLASH_INST_ERASE_32K);
+	spi_flash_set_erase_command(&map->commands[2], SZ_64K, SFLASH_INST_ERASE_64K);
+}
+
+/* Erase map of a flash with 4K sectors at both ends (boot and parameter
+ * areas) and 64K sectors in the middle, as described by an SFDP Sector Map */
+static void _init_boot_map(struct spi_flash_erase_map *map)
+{
+	_init_commands(map);
+	map->region_table[0].cmd_mask = CMD_4K;
+	map->region_table[0].offset = 0;
+	map->region_table[0].size = BOOT_SIZE;
+	map->region_table[1].cmd_mask = CMD_64K;
+	map->region_table[1].offset = BOOT_SIZE;
+	map->region_table[1].size = FLASH_SIZE - 2 * BOOT_SIZE;
+	map->region_table[2].cmd_mask = CMD_4K;
+	map->region_table[2].offset = FLASH_SIZE - BOOT_SIZE;
+	map->region_table[2].size = BOOT_SIZE;
+	map->regions = map->region_table;
+	map->num_regions = 3;
+}
+
+/* Plan the erase of a range the way spi_nor_erase() does: returns the number
+ * of commands, or -1 if some part of the range cannot be erased */
+static int _plan(const struct spi_flash_erase_map *map, uint32_t offset,
+		uint32_t len, uint32_t *sizes)
+{
+	int count = 0;
+
+	while (len) {
+		const struct spi_flash_erase_command *erase;
+		uint32_t rem;
+
+		erase = spi_flash_select_erase(map, offset, len);
+		if (!erase)
+			return -1;
+
+		/* the command is aligned and stays within the range */
+		spi_flash_div_by_erase_size(erase, offset, &rem);
+		CHECK(rem == 0);
+		CHECK(erase->size <= len);
+
+		if (sizes)
+			sizes[count] = erase->size;
+		count++;
+		offset += erase->size;
+		len -= erase->size;
+	}
+
+	return count;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_erase_command(void)
+{
+	struct spi_flash_erase_command cmd;
+	uint32_t rem, quot;
+
+	spi_flash_set_erase_command(&cmd, SZ_64K, SFLASH_INST_ERASE_64K);
+	CHECK(cmd.size_shift == 16);
+	CHECK(cmd.size_mask == SZ_64K - 1);
+	quot = spi_flash_div_by_erase_size(&cmd, 3 * SZ_64K + 5, &rem);
+	CHECK(quot == 3 && rem == 5);
+
+	/* sizes that are not a power of two fall back to a division */
+	spi_flash_set_erase_command(&cmd, 48 * 1024, 0x81);
+	CHECK(cmd.size_shift == 0);
+	quot = spi_flash_div_by_erase_size(&cmd, 100 * 1024, &rem);
+	CHECK(quot == 2 && rem == 4 * 1024);
+}
+
+static void test_uniform_select(void)
+{
+	struct spi_flash_erase_map map;
+	const struct spi_flash_erase_command *erase;
+
+	_init_commands(&map);
+	spi_flash_init_uniform_erase_map(&map, CMD_4K | CMD_32K | CMD_64K, FLASH_SIZE);
+
+	/* the largest command aligned on the offset */
+	erase = spi_flash_select_erase(&map, 0, FLASH_SIZE);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_64K);
+	erase = spi_flash_select_erase(&map, SZ_32K, FLASH_SIZE - SZ_32K);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_32K);
+	erase = spi_flash_select_erase(&map, SZ_4K, FLASH_SIZE - SZ_4K);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+
+	/* which does not erase beyond the requested length */
+	erase = spi_flash_select_erase(&map, 0, SZ_64K - 1);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_32K);
+	erase = spi_flash_select_erase(&map, 0, SZ_32K - 1);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+	CHECK(spi_flash_select_erase(&map, 0, SZ_4K - 1) == NULL);
+
+	/* unaligned or outside of the flash */
+	CHECK(spi_flash_select_erase(&map, 1, SZ_64K) == NULL);
+	CHECK(spi_flash_select_erase(&map, SZ_4K + 512, SZ_4K) == NULL);
+	CHECK(spi_flash_select_erase(&map, FLASH_SIZE, SZ_4K) == NULL);
+
+	/* commands missing from the region mask are never selected */
+	spi_flash_init_uniform_erase_map(&map, CMD_4K | CMD_64K, FLASH_SIZE);
+	erase = spi_flash_select_erase(&map, SZ_32K, FLASH_SIZE - SZ_32K);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+	erase = spi_flash_select_erase(&map, 0, SZ_64K - 1);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+
+	/* nor commands the flash does not provide */
+	map.commands[2].size = 0;
+	erase = spi_flash_select_erase(&map, 0, FLASH_SIZE);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+}
+
+static void test_uniform_plan(void)
+{
+	struct spi_flash_erase_map map;
+	uint32_t sizes[FLASH_SIZE / SZ_4K];
+	int count, i;
+
+	_init_commands(&map);
+	spi_flash_init_uniform_erase_map(&map, CMD_4K | CMD_32K | CMD_64K, FLASH_SIZE);
+
+	CHECK(_plan(&map, 0, FLASH_SIZE, NULL) == FLASH_SIZE / SZ_64K);
+
+	/* [4K, 204K): 4K up to 32K, 32K up to 64K, 64K up to 192K, 4K to the end */
+	count = _plan(&map, SZ_4K, 200 * 1024, sizes);
+	CHECK(count == 7 + 1 + 2 + 3);
+	if (count == 13) {
+		for (i = 0; i < 7; i++)
+			CHECK(sizes[i] == SZ_4K);
+		CHECK(sizes[7] == SZ_32K);
+		CHECK(sizes[8] == SZ_64K && sizes[9] == SZ_64K);
+		for (i = 10; i < 13; i++)
+			CHECK(sizes[i] == SZ_4K);
+	}
+
+	/* a range that does not end on a sector boundary cannot be erased */
+	CHECK(_plan(&map, 0, SZ_64K + 100, NULL) == -1);
+}
+
+static void test_find_region(void)
+{
+	struct spi_flash_erase_map map;
+
+	_init_boot_map(&map);
+
+	CHECK(spi_flash_find_erase_region(&map, 0) == &map.region_table[0]);
+	CHECK(spi_flash_find_erase_region(&map, BOOT_SIZE - 1) == &map.region_table[0]);
+	CHECK(spi_flash_find_erase_region(&map, BOOT_SIZE) == &map.region_table[1]);
+	CHECK(spi_flash_find_erase_region(&map, FLASH_SIZE - BOOT_SIZE - 1) == &map.region_table[1]);
+	CHECK(spi_flash_find_erase_region(&map, FLASH_SIZE - BOOT_SIZE) == &map.region_table[2]);
+	CHECK(spi_flash_find_erase_region(&map, FLASH_SIZE - 1) == &map.region_table[2]);
+	CHECK(spi_flash_find_erase_region(&map, FLASH_SIZE) == NULL);
+	CHECK(spi_flash_find_erase_region(&map, UINT32_MAX) == NULL);
+}
+
+static void test_non_uniform_select(void)
+{
+	struct spi_flash_erase_map map;
+	const struct spi_flash_erase_command *erase;
+
+	_init_boot_map(&map);
+
+	/* 4K only in the boot area, even for a 64K aligned offset */
+	erase = spi_flash_select_erase(&map, 0, FLASH_SIZE);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+
+	/* 64K only in the middle: a smaller range cannot be erased */
+	erase = spi_flash_select_erase(&map, BOOT_SIZE, SZ_64K);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_64K);
+	CHECK(spi_flash_select_erase(&map, BOOT_SIZE, SZ_32K) == NULL);
+	CHECK(spi_flash_select_erase(&map, BOOT_SIZE + SZ_4K, SZ_64K) == NULL);
+
+	/* the last 64K sector of the middle region ends on its boundary */
+	erase = spi_flash_select_erase(&map, FLASH_SIZE - BOOT_SIZE - SZ_64K, FLASH_SIZE);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_64K);
+	erase = spi_flash_select_erase(&map, FLASH_SIZE - BOOT_SIZE, FLASH_SIZE);
+	CHECK(erase && erase->inst == SFLASH_INST_ERASE_4K);
+}
+
+static void test_non_uniform_plan(void)
+{
+	struct spi_flash_erase_map map;
+	uint32_t sizes[FLASH_SIZE / SZ_4K];
+	int count, boot;
+
+	_init_boot_map(&map);
+	boot = BOOT_SIZE / SZ_4K;
+
+	/* whole memory: 4K sectors, then 64K sectors, then 4K sectors again */
+	count = _plan(&map, 0, FLASH_SIZE, sizes);
+	CHECK(count == boot + (FLASH_SIZE - 2 * BOOT_SIZE) / SZ_64K + boot);
+	if (count == 2 * boot + 14) {
+		CHECK(sizes[boot - 1] == SZ_4K && sizes[boot] == SZ_64K);
+		CHECK(sizes[boot + 13] == SZ_64K && sizes[boot + 14] == SZ_4K);
+	}
+
+	/* across the first boundary */
+	CHECK(_plan(&map, BOOT_SIZE - 2 * SZ_4K, 2 * SZ_4K + SZ_64K, NULL) == 3);
+
+	/* ending inside a 64K sector of the middle region */
+	CHECK(_plan(&map, 0, BOOT_SIZE + SZ_32K, NULL) == -1);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+void msleep(uint32_t count)
+{
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_erase_command);
+	RUN_TEST(test_uniform_select);
+	RUN_TEST(test_uniform_plan);
+	RUN_TEST(test_find_region);
+	RUN_TEST(test_non_uniform_select);
+	RUN_TEST(test_non_uniform_plan);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,416 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the asynchronous page programming of the SPI NOR driver:
+ * spi_nor_write_async() and spi_nor_write_poll() run against a simulated
+ * memory that checks the Write Enable before each Page Program, the page
+ * boundaries, and holds WIP for a few status reads after each page.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "callback.h"
+#include "errno.h"
+#include "timer.h"
+
+/* spi-nor.c is included to reach the write state machine */
+#include "nvm/spi-nor/spi-nor.c"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define MEM_SIZE   (16 * 1024)
+#define PAGE_SIZE  256
+
+/* Status reads with WIP set after each Page Program */
+#define PP_BUSY_READS 3
+
+/* Write Enable Latch bit of the status register */
+#define SR_WEL (0x1UL << 1)
+
+/* Ticks elapsed per status read, in ms */
+#define TICKS_PER_READ 10
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static struct {
+	uint8_t mem[MEM_SIZE];
+	bool wel;              /* Write Enable Latch */
+	uint32_t busy;         /* status reads left with WIP set */
+	bool stuck;            /* WIP never clears */
+	int fail_pp;           /* Page Program to fail (1-based), or 0 */
+
+	uint32_t wrens;
+	uint32_t pps;
+	uint32_t pp_without_wren;
+	uint32_t pp_while_busy;
+	uint32_t crossings;
+	uint32_t status_reads;
+} sim;
+
+static uint64_t ticks;
+
+static struct {
+	uint32_t calls;
+	int rc;
+} completion;
+
+static uint8_t data[3 * MEM_SIZE / 4];
+
+/*---------------------------------------------------------------------- */
+/*         Simulated memory                                              */
+/*---------------------------------------------------------------------- */
+
+static int _exec(union spi_flash_priv *priv, const struct spi_flash_command *cmd)
+{
+	uint8_t *rx = (uint8_t *)cmd->rx_data;
+	uint32_t i;
+
+	switch (cmd->inst) {
+	case SFLASH_INST_WRITE_ENABLE:
+		sim.wrens++;
+		if (!sim.busy)
+			sim.wel = true;
+		return 0;
+
+	case SFLASH_INST_READ_SR:
+		sim.status_reads++;
+		ticks += TICKS_PER_READ;
+		*rx = (sim.busy ? SR_WIP : 0) | (sim.wel ? SR_WEL : 0);
+		if (sim.busy && !sim.stuck)
+			sim.busy--;
+		return 0;
+
+	case SFLASH_INST_PAGE_PROGRAM:
+		sim.pps++;
+		if (sim.fail_pp == sim.pps)
+			return -EIO;
+		if (sim.busy) {
+			sim.pp_while_busy++;
+			return 0;
+		}
+		if (!sim.wel) {
+			sim.pp_without_wren++;
+			return 0;
+		}
+		sim.wel = false;
+		if (cmd->addr / PAGE_SIZE != (cmd->addr + cmd->data_len - 1) / PAGE_SIZE)
+			sim.crossings++;
+		/* the address wraps within the page, as on the real parts */
+		for (i = 0; i < cmd->data_len; i++) {
+			uint32_t addr = (cmd->addr & ~(PAGE_SIZE - 1))
+				| ((cmd->addr + i) & (PAGE_SIZE - 1));
+			sim.mem[addr % MEM_SIZE] &= ((const uint8_t *)cmd->tx_data)[i];
+		}
+		sim.busy = PP_BUSY_READS;
+		return 0;
+
+	default:
+		CHECK(false);
+		return -EIO;
+	}
+}
+
+static const struct spi_ops sim_ops = {
+	.exec = _exec,
+};
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+static int _write_done(void *arg, void *arg2)
+{
+	completion.calls++;
+	completion.rc = *(int *)arg2;
+	return 0;
+}
+
+static void _init(struct spi_flash *flash)
+{
+	uint32_t i;
+
+	memset(&sim, 0, sizeof(sim));
+	memset(sim.mem, 0xff, sizeof(sim.mem));
+	memset(&completion, 0, sizeof(completion));
+
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = (uint8_t)(i * 7 + 3);
+
+	memset(flash, 0, sizeof(*flash));
+	flash->ops = &sim_ops;
+	flash->size = MEM_SIZE;
+	flash->page_size = PAGE_SIZE;
+	flash->addr_len = 3;
+	flash->reg_proto = SFLASH_PROTO_1_1_1;
+	flash->write_inst = SFLASH_INST_PAGE_PROGRAM;
+	flash->write_proto = SFLASH_PROTO_1_1_1;
+}
+
+static int _write(struct spi_flash *flash, uint32_t to, uint32_t len)
+{
+	struct _callback cb;
+	int rc;
+
+	callback_set(&cb, _write_done, NULL);
+	rc = spi_nor_write_async(flash, to, data, len, &cb);
+	if (rc < 0)
+		return rc;
+
+	do {
+		rc = spi_nor_write_poll(flash);
+	} while (rc == -EAGAIN);
+
+	return rc;
+}
+
+static uint32_t _pages(uint32_t to, uint32_t len)
+{
+	return (to + len - 1) / PAGE_SIZE - to / PAGE_SIZE + 1;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_aligned_pages(void)
+{
+	struct spi_flash flash;
+
+	_init(&flash);
+	CHECK(_write(&flash, 0, 4 * PAGE_SIZE) == 0);
+	CHECK(sim.pps == 4);
+	CHECK(sim.wrens == sim.pps);
+	CHECK(sim.pp_without_wren == 0);
+	CHECK(sim.pp_while_busy == 0);
+	CHECK(sim.crossings == 0);
+	CHECK(memcmp(sim.mem, data, 4 * PAGE_SIZE) == 0);
+	CHECK(completion.calls == 1 && completion.rc == 0);
+	CHECK(!flash.write_req.busy);
+}
+
+/* Unaligned start and length: the first and last Page Programs are partial
+ * and none crosses a page boundary */
+static void test_unaligned_splits(void)
+{
+	static const struct {
+		uint32_t to, len;
+	} cases[] = {
+		{ 1, 1 },
+		{ 255, 2 },
+		{ 100, PAGE_SIZE },
+		{ 300, 3 * PAGE_SIZE + 17 },
+		{ PAGE_SIZE - 1, 5 * PAGE_SIZE + 1 },
+		{ 2 * PAGE_SIZE, PAGE_SIZE - 1 },
+		{ 4097, 8000 },
+	};
+	struct spi_flash flash;
+	uint32_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		uint32_t to = cases[i].to, len = cases[i].len;
+
+		_init(&flash);
+		CHECK(_write(&flash, to, len) == 0);
+		CHECK(sim.pps == _pages(to, len));
+		CHECK(sim.wrens == sim.pps);
+		CHECK(sim.pp_without_wren == 0);
+		CHECK(sim.pp_while_busy == 0);
+		CHECK(sim.crossings == 0);
+		CHECK(memcmp(sim.mem + to, data, len) == 0);
+		CHECK(sim.mem[to - 1] == 0xff);
+		CHECK(to + len == MEM_SIZE || sim.mem[to + len] == 0xff);
+		CHECK(completion.calls == 1 && completion.rc == 0);
+	}
+}
+
+/* The next page is sent by the first poll that sees the memory ready */
+static void test_poll_steps(void)
+{
+	struct spi_flash flash;
+	struct _callback cb;
+	int polls = 0, rc;
+
+	_init(&flash);
+	callback_set(&cb, _write_done, NULL);
+	CHECK(spi_nor_write_async(&flash, 128, data, 2 * PAGE_SIZE, &cb) == 0);
+	CHECK(sim.pps == 1);
+	CHECK(spi_nor_write_async(&flash, 0, data, 1, &cb) == -EBUSY);
+
+	do {
+		rc = spi_nor_write_poll(&flash);
+		polls++;
+		CHECK(completion.calls == (rc == -EAGAIN ? 0 : 1));
+	} while (rc == -EAGAIN);
+
+	CHECK(rc == 0);
+	CHECK(sim.pps == 3);
+	/* each page: PP_BUSY_READS busy reads, then the ready one */
+	CHECK(polls == 3 * (PP_BUSY_READS + 1));
+	CHECK(sim.status_reads == polls);
+
+	/* Polling again after completion returns the status without any
+	 * access to the memory nor new callback */
+	CHECK(spi_nor_write_poll(&flash) == 0);
+	CHECK(sim.status_reads == polls);
+	CHECK(completion.calls == 1);
+}
+
+static void test_empty_write(void)
+{
+	struct spi_flash flash;
+	struct _callback cb;
+
+	_init(&flash);
+	callback_set(&cb, _write_done, NULL);
+	CHECK(spi_nor_write_async(&flash, 0, data, 0, &cb) == 0);
+	CHECK(completion.calls == 1 && completion.rc == 0);
+	CHECK(spi_nor_write_poll(&flash) == 0);
+	CHECK(completion.calls == 1);
+	CHECK(sim.pps == 0 && sim.wrens == 0);
+}
+
+/* WIP never clears: the write fails after TIMEOUT_PAGE_PROGRAM */
+static void test_page_program_timeout(void)
+{
+	struct spi_flash flash;
+
+	_init(&flash);
+	sim.stuck = true;
+	CHECK(_write(&flash, 0, 3 * PAGE_SIZE) == -ETIMEDOUT);
+	CHECK(sim.pps == 1);
+	CHECK(sim.status_reads >= TIMEOUT_PAGE_PROGRAM / TICKS_PER_READ);
+	CHECK(sim.status_reads <= TIMEOUT_PAGE_PROGRAM / TICKS_PER_READ + 1);
+	CHECK(completion.calls == 1 && completion.rc == -ETIMEDOUT);
+	CHECK(!flash.write_req.busy);
+
+	/* the driver accepts a new write once the memory recovers */
+	sim.stuck = false;
+	sim.busy = 0;
+	CHECK(_write(&flash, PAGE_SIZE, 2) == 0);
+	CHECK(completion.calls == 2 && completion.rc == 0);
+}
+
+/* A bus error on a later page ends the write with that error */
+static void test_bus_error(void)
+{
+	struct spi_flash flash;
+	struct _callback cb;
+
+	_init(&flash);
+	sim.fail_pp = 3;
+	CHECK(_write(&flash, 10, 4 * PAGE_SIZE) == -EIO);
+	CHECK(sim.pps == 3);
+	CHECK(completion.calls == 1 && completion.rc == -EIO);
+	CHECK(!flash.write_req.busy);
+
+	/* failure of the first page is returned by spi_nor_write_async():
+	 * the write never started and the callback is not invoked */
+	_init(&flash);
+	sim.fail_pp = 1;
+	callback_set(&cb, _write_done, NULL);
+	CHECK(spi_nor_write_async(&flash, 0, data, PAGE_SIZE, &cb) == -EIO);
+	CHECK(completion.calls == 0);
+	CHECK(spi_nor_write_poll(&flash) == -EIO);
+	CHECK(completion.calls == 0);
+	CHECK(!flash.write_req.busy);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Stubs                                                         */
+/*---------------------------------------------------------------------- */
+
+uint64_t timer_get_tick(void)
+{
+	return ticks;
+}
+
+uint64_t timer_get_interval(uint64_t start, uint64_t end)
+{
+	return end - start;
+}
+
+void msleep(uint32_t count)
+{
+	ticks += count;
+}
+
+int bus_configure_slave(uint8_t bus_id, const struct _bus_dev_cfg* cfg)
+{
+	return -ENOSYS;
+}
+
+int bus_start_transaction(uint8_t bus_id)
+{
+	return -ENOSYS;
+}
+
+int bus_stop_transaction(uint8_t bus_id)
+{
+	return -ENOSYS;
+}
+
+int bus_transfer(uint8_t bus_id, uint16_t remote, struct _buffer* buf, uint16_t buffers, struct _callback* cb)
+{
+	return -ENOSYS;
+}
+
+int bus_wait_transfer(uint8_t bus_id)
+{
+	return -ENOSYS;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_aligned_pages);
+	RUN_TEST(test_unaligned_splits);
+	RUN_TEST(test_poll_steps);
+	RUN_TEST(test_empty_write);
+	RUN_TEST(test_page_program_timeout);
+	RUN_TEST(test_bus_error);
+
+	return test_failures ? 1 : 0;
+}
@@ -0,0 +1,242 @@
+/* ----------------------------------------------------------------------------
+ *         SAM Software Package License
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * \file
+ *
+ * Host tests of the USBHS DMA descriptor list builder: single and chained
+ * descriptors, the interrupt bits of the last descriptor only, buffers that
+ * are not a multiple of the packet size, and lists too short for the
+ * buffer.
+ */
+
+/*---------------------------------------------------------------------- */
+/*         Headers                                                       */
+/*---------------------------------------------------------------------- */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "usb/usbhs_dma.h"
+
+#include "test.h"
+
+/*---------------------------------------------------------------------- */
+/*         Local definitions                                             */
+/*---------------------------------------------------------------------- */
+
+#define CHAIN_SIZE 8
+
+/* Control of the IN transfers of the driver */
+#define CFG_IN (USBHS_DEVDMACONTROL_END_B_EN | \
+		USBHS_DEVDMACONTROL_END_BUFFIT | \
+		USBHS_DEVDMACONTROL_CHANN_ENB)
+
+/* Interrupts raised by a descriptor */
+#define CTRL_IT (USBHS_DEVDMACONTROL_END_TR_IT | \
+		 USBHS_DEVDMACONTROL_END_BUFFIT)
+
+#define CTRL_LENGTH(ctrl) \
+	(((ctrl) & USBHS_DEVDMACONTROL_BUFF_LENGTH_Msk) >> \
+	 USBHS_DEVDMACONTROL_BUFF_LENGTH_Pos)
+
+/*---------------------------------------------------------------------- */
+/*         Local variables                                               */
+/*---------------------------------------------------------------------- */
+
+static uint8_t buffer[CHAIN_SIZE * USBHS_DMA_BUFF_MAX_SIZE + 4096];
+
+/*---------------------------------------------------------------------- */
+/*         Local functions                                               */
+/*---------------------------------------------------------------------- */
+
+/* Check a list built for len bytes at data and return the number of
+ * descriptors used */
+static uint32_t _check_chain(const struct _usb_dma_desc *desc,
+		uint32_t desc_count, const uint8_t *data, uint32_t len,
+		uint32_t cfg, uint32_t total)
+{
+	uint32_t i, size, covered = 0;
+
+	CHECK(total == (len < desc_count * USBHS_DMA_BUFF_MAX_SIZE ?
+			len : desc_count * USBHS_DMA_BUFF_MAX_SIZE));
+
+	for (i = 0; i < desc_count && covered < total; i++) {
+		size = CTRL_LENGTH(desc[i].ctrl);
+		CHECK(size > 0 && size <= USBHS_DMA_BUFF_MAX_SIZE);
+		CHECK(desc[i].addr == data + covered);
+		CHECK(desc[i].reserved == 0);
+		covered += size;
+
+		if (covered < total) {
+			/* intermediate: full chunk, next descriptor, no
+			 * interrupt */
+			CHECK(size == USBHS_DMA_BUFF_MAX_SIZE);
+			CHECK(desc[i].next == &desc[i + 1]);
+			CHECK(desc[i].ctrl & USBHS_DEVDMACONTROL_LDNXT_DSC);
+			CHECK(!(desc[i].ctrl & CTRL_IT));
+			CHECK((desc[i].ctrl & ~(USBHS_DEVDMACONTROL_BUFF_LENGTH_Msk |
+					USBHS_DEVDMACONTROL_LDNXT_DSC)) ==
+			      (cfg & ~CTRL_IT));
+		} else {
+			/* last: end of list, caller configuration */
+			CHECK(desc[i].next == NULL);
+			CHECK((desc[i].ctrl & ~USBHS_DEVDMACONTROL_BUFF_LENGTH_Msk) == cfg);
+		}
+	}
+	CHECK(covered == total);
+
+	return i;
+}
+
+static uint32_t _build(uint32_t desc_count, uint32_t offset, uint32_t len,
+		uint32_t cfg, uint32_t *used)
+{
+	struct _usb_dma_desc desc[CHAIN_SIZE + 1];
+	uint32_t total;
+
+	/* descriptors past the list are left untouched */
+	memset(desc, 0xa5, sizeof(desc));
+	total = usbhs_dma_build_chain(desc, desc_count, buffer + offset, len, cfg);
+	*used = _check_chain(desc, desc_count, buffer + offset, len, cfg, total);
+	CHECK(desc[*used].ctrl == 0xa5a5a5a5);
+
+	return total;
+}
+
+/*---------------------------------------------------------------------- */
+/*         Tests                                                         */
+/*---------------------------------------------------------------------- */
+
+static void test_single_descriptor(void)
+{
+	uint32_t used;
+
+	CHECK(_build(CHAIN_SIZE, 0, 1, CFG_IN, &used) == 1);
+	CHECK(used == 1);
+	CHECK(_build(CHAIN_SIZE, 0, 512, CFG_IN, &used) == 512);
+	CHECK(used == 1);
+	CHECK(_build(CHAIN_SIZE, 3, USBHS_DMA_BUFF_MAX_SIZE, CFG_IN, &used)
+	      == USBHS_DMA_BUFF_MAX_SIZE);
+	CHECK(used == 1);
+
+	/* a list of one descriptor holds one chunk */
+	CHECK(_build(1, 0, 3 * USBHS_DMA_BUFF_MAX_SIZE, CFG_IN, &used)
+	      == USBHS_DMA_BUFF_MAX_SIZE);
+	CHECK(used == 1);
+}
+
+static void test_chained_descriptors(void)
+{
+	uint32_t used;
+
+	CHECK(_build(CHAIN_SIZE, 0, USBHS_DMA_BUFF_MAX_SIZE + 1, CFG_IN, &used)
+	      == USBHS_DMA_BUFF_MAX_SIZE + 1);
+	CHECK(used == 2);
+	CHECK(_build(CHAIN_SIZE, 0, 4 * USBHS_DMA_BUFF_MAX_SIZE, CFG_IN, &used)
+	      == 4 * USBHS_DMA_BUFF_MAX_SIZE);
+	CHECK(used == 4);
+
+	/* the whole list */
+	CHECK(_build(CHAIN_SIZE, 0, CHAIN_SIZE * USBHS_DMA_BUFF_MAX_SIZE, CFG_IN,
+		     &used) == CHAIN_SIZE * USBHS_DMA_BUFF_MAX_SIZE);
+	CHECK(used == CHAIN_SIZE);
+
+	/* longer buffers: the rest is re-chained by the DMA handler */
+	CHECK(_build(CHAIN_SIZE, 0, CHAIN_SIZE * USBHS_DMA_BUFF_MAX_SIZE + 5,
+		     CFG_IN, &used) == CHAIN_SIZE * USBHS_DMA_BUFF_MAX_SIZE);
+	CHECK(used == CHAIN_SIZE);
+}
+
+/* Only the last descriptor may end the USB transfer with a short packet */
+static void test_not_packet_multiple(void)
+{
+	static const uint32_t packet_sizes[] = { 8, 64, 512, 1024 };
+	uint32_t i, n, len, used, last;
+
+	for (i = 0; i < ARRAY_SIZE(packet_sizes); i++) {
+		for (n = 1; n <= CHAIN_SIZE; n++) {
+			len = (n - 1) * USBHS_DMA_BUFF_MAX_SIZE
+				+ 3 * packet_sizes[i] + packet_sizes[i] / 2 + 1;
+			CHECK(_build(CHAIN_SIZE, 1, len, CFG_IN, &used) == len);
+			CHECK(used == n);
+
+			/* the intermediate chunks are whole packets */
+			CHECK(USBHS_DMA_BUFF_MAX_SIZE % packet_sizes[i] == 0);
+			last = len - (n - 1) * USBHS_DMA_BUFF_MAX_SIZE;
+			CHECK(last % packet_sizes[i] != 0);
+		}
+	}
+}
+
+/* The interrupt bits of the caller, whichever they are, are only kept on
+ * the last descriptor */
+static void test_interrupt_bits(void)
+{
+	static const uint32_t cfgs[] = {
+		CFG_IN,
+		CFG_IN | USBHS_DEVDMACONTROL_END_TR_IT,
+		USBHS_DEVDMACONTROL_END_TR_EN | USBHS_DEVDMACONTROL_END_TR_IT |
+			USBHS_DEVDMACONTROL_END_B_EN | USBHS_DEVDMACONTROL_END_BUFFIT |
+			USBHS_DEVDMACONTROL_CHANN_ENB,
+		USBHS_DEVDMACONTROL_CHANN_ENB,
+	};
+	uint32_t i, used;
+
+	for (i = 0; i < ARRAY_SIZE(cfgs); i++) {
+		CHECK(_build(CHAIN_SIZE, 0, 3 * USBHS_DMA_BUFF_MAX_SIZE - 7,
+			     cfgs[i], &used) == 3 * USBHS_DMA_BUFF_MAX_SIZE - 7);
+		CHECK(used == 3);
+	}
+}
+
+/* An empty buffer fills no descriptor */
+static void test_empty_buffer(void)
+{
+	struct _usb_dma_desc desc[1];
+
+	memset(desc, 0xa5, sizeof(desc));
+	CHECK(usbhs_dma_build_chain(desc, 1, buffer, 0, CFG_IN) == 0);
+	CHECK(desc[0].ctrl == 0xa5a5a5a5);
+}
+
+/*---------------------------------------------------------------------- */
+/*         Main                                                          */
+/*---------------------------------------------------------------------- */
+
+int main(void)
+{
+	RUN_TEST(test_single_descriptor);
+	RUN_TEST(test_chained_descriptors);
+	RUN_TEST(test_not_packet_multiple);
+	RUN_TEST(test_interrupt_bits);
+	RUN_TEST(test_empty_buffer);
+
+	return test_failures ? 1 : 0;
+}
@@ -5,7 +5,7 @@ int fls(int value)
 	int i;
 
 	for (i = 31; i >= 0; i--)
-		if (value & (1 << i))
+		if (value & (1u << i))
 			return i + 1;
 
 	return 0;
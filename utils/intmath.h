@@ -53,6 +53,8 @@
 
 #include <stdint.h>
 
+#include "compiler.h"
+
 /**
  *  Returns the minimum value between two integers.
  *  \param a First integer to compare
@@ -113,6 +115,33 @@ static inline int fixed_mod(int a, int b)
 	return rem;
 }
 
+/**
+ *  Returns the index of the least significant bit set (count of trailing
+ *  zeros) in a non-zero integer.
+ *  \param value Integer value, not 0
+ */
+static inline uint32_t ctz_u32(uint32_t value)
+{
+	return 31 - CLZ(value & -value);
+}
+
+/**
+ *  Clears the least significant bit set in a non-zero integer, and returns
+ *  its index. Iterating over the bits set in a mask only costs one step per
+ *  bit set:
+ *  \code
+ *  while (mask)
+ *  	handle(pop_lsb_u32(&mask));
+ *  \endcode
+ *  \param mask Integer value, not 0
+ */
+static inline uint32_t pop_lsb_u32(uint32_t* mask)
+{
+	uint32_t bit = ctz_u32(*mask);
+	*mask &= *mask - 1;
+	return bit;
+}
+
 extern int fls(int value);
 
 #endif /* _INTMATH_H_ */
@@ -0,0 +1,138 @@
+/* ----------------------------------------------------------------------------
+ *         ATMEL Microcontroller Software Support
+ * ----------------------------------------------------------------------------
+ * Copyright (c) 2018, Atmel Corporation
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Atmel's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY ATMEL "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL ATMEL BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * ----------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ *         Headers
+ *----------------------------------------------------------------------------*/
+
+#include "barriers.h"
+#include "errno.h"
+#include "ring.h"
+
+#include <string.h>
+
+/*----------------------------------------------------------------------------
+ *         Exported functions
+ *----------------------------------------------------------------------------*/
+
+int ring_init(struct _ring* ring, void* buffer, uint32_t elem_size, uint32_t capacity)
+{
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+		return -EINVAL;
+
+	ring->buffer = buffer;
+	ring->elem_size = elem_size;
+	ring->mask = capacity - 1;
+	ring->head = 0;
+	ring->tail = 0;
+
+	return 0;
+}
+
+uint32_t ring_write_span(struct _ring* ring, void** span)
+{
+	uint32_t head = ring->head;
+	uint32_t index = head & ring->mask;
+	uint32_t to_end = ring->mask + 1 - index;
+	uint32_t space = ring->mask + 1 - (head - ring->tail);
+
+	/* Do not write the slots before the consumer is done with them */
+	dmb();
+
+	*span = ring->buffer + index * ring->elem_size;
+	return min_u32(space, to_end);
+}
+
+void ring_write_commit(struct _ring* ring, uint32_t count)
+{
+	/* Elements must be visible before the new head */
+	dmb();
+	ring->head += count;
+}
+
+uint32_t ring_read_span(struct _ring* ring, void** span)
+{
+	uint32_t tail = ring->tail;
+	uint32_t index = tail & ring->mask;
+	uint32_t to_end = ring->mask + 1 - index;
+	uint32_t count = ring->head - tail;
+
+	/* Do not read the slots before the head that published them */
+	dmb();
+
+	*span = ring->buffer + index * ring->elem_size;
+	return min_u32(count, to_end);
+}
+
+void ring_read_commit(struct _ring* ring, uint32_t count)
+{
+	/* Elements must be read before the slots are given back */
+	dmb();
+	ring->tail += count;
+}
+
+uint32_t ring_push_n(struct _ring* ring, const void* elems, uint32_t count)
+{
+	const uint8_t* src = elems;
+	uint32_t pushed = 0;
+
+	/* At most two spans: up to the end of the buffer, then from its start */
+	while (pushed < count) {
+		void* span;
+		uint32_t n = min_u32(ring_write_span(ring, &span), count - pushed);
+		if (n == 0)
+			break;
+		memcpy(span, src, n * ring->elem_size);
+		src += n * ring->elem_size;
+		pushed += n;
+		ring_write_commit(ring, n);
+	}
+
+	return pushed;
+}
+
+uint32_t ring_pop_n(struct _ring* ring, void* elems, uint32_t count)
+{
+	uint8_t* dst = elems;
+	uint32_t popped = 0;
+
+	/* At most two spans: up to the end of the buffer, then from its start */
+	while (popped < count) {
+		void* span;
+		uint32_t n = min_u32(ring_read_span(ring, &span), count - popped);
+		if (n == 0)
+			break;
+		memcpy(dst, span, n * ring->elem_size);
+		dst += n * ring->elem_size;
+		popped += n;
+		ring_read_commit(ring, n);
+	}
+
+	return popped;
+}
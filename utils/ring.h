@@ -30,8 +30,12 @@
 #ifndef _RING_H_
 #define _RING_H_
 
+#include "compiler.h"
 #include "intmath.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /*------------------------------------------------------------------------------
  *         Exported functions
  *------------------------------------------------------------------------------*/
@@ -78,4 +82,120 @@
 /** Clear circular buffer */
 #define RING_CLEAR(head, tail) ((head) = (tail) = 0)
 
+/*------------------------------------------------------------------------------
+ *         Single-producer/single-consumer ring
+ *------------------------------------------------------------------------------*/
+
+/**
+ * Lock-free ring of fixed-size elements shared by one producer and one
+ * consumer (for example an IRQ handler and the main loop).
+ *
+ * The capacity is a power of two and head/tail are free-running counters
+ * masked on access, so all slots can be used. Only the producer writes
+ * head and only the consumer writes tail; memory barriers order the
+ * element accesses with the counter updates.
+ */
+struct _ring {
+	uint8_t *buffer;        /**< element storage */
+	uint32_t elem_size;     /**< size of one element in bytes */
+	uint32_t mask;          /**< capacity - 1 */
+	volatile uint32_t head; /**< elements pushed, written by the producer */
+	volatile uint32_t tail; /**< elements popped, written by the consumer */
+};
+
+/** Initialize a ring over an array, deducing element size and capacity */
+#define RING_INIT_ARRAY(ring, array) \
+	ring_init((ring), (array), sizeof((array)[0]), ARRAY_SIZE(array))
+
+/**
+ * \brief Initialize a ring.
+ * \param ring       Pointer to the ring
+ * \param buffer     Element storage of capacity * elem_size bytes
+ * \param elem_size  Size of one element in bytes
+ * \param capacity   Number of elements, must be a power of two
+ * \return 0 on success, -EINVAL if capacity is not a power of two
+ */
+extern int ring_init(struct _ring* ring, void* buffer, uint32_t elem_size, uint32_t capacity);
+
+/** \brief Return the number of elements in the ring */
+static inline uint32_t ring_count(const struct _ring* ring)
+{
+	return ring->head - ring->tail;
+}
+
+/** \brief Return the number of free slots in the ring */
+static inline uint32_t ring_space(const struct _ring* ring)
+{
+	return ring->mask + 1 - ring_count(ring);
+}
+
+/** \brief Check if the ring is empty */
+static inline bool ring_is_empty(const struct _ring* ring)
+{
+	return ring->head == ring->tail;
+}
+
+/** \brief Check if the ring is full */
+static inline bool ring_is_full(const struct _ring* ring)
+{
+	return ring_count(ring) > ring->mask;
+}
+
+/**
+ * \brief Get the contiguous free area at the producer side, for example to
+ * receive data by DMA. Elements written there are published with
+ * ring_write_commit().
+ * Producer side only.
+ * \param ring  Pointer to the ring
+ * \param span  Set to the start of the free area
+ * \return Number of contiguous free elements
+ */
+extern uint32_t ring_write_span(struct _ring* ring, void** span);
+
+/**
+ * \brief Publish count elements written to the area from ring_write_span().
+ * Producer side only.
+ */
+extern void ring_write_commit(struct _ring* ring, uint32_t count);
+
+/**
+ * \brief Get the contiguous filled area at the consumer side, for example
+ * to send data by DMA. Elements are released with ring_read_commit().
+ * Consumer side only.
+ * \param ring  Pointer to the ring
+ * \param span  Set to the start of the filled area
+ * \return Number of contiguous elements
+ */
+extern uint32_t ring_read_span(struct _ring* ring, void** span);
+
+/**
+ * \brief Release count elements read from the area from ring_read_span().
+ * Consumer side only.
+ */
+extern void ring_read_commit(struct _ring* ring, uint32_t count);
+
+/**
+ * \brief Copy up to count elements into the ring. Producer side only.
+ * \return Number of elements pushed
+ */
+extern uint32_t ring_push_n(struct _ring* ring, const void* elems, uint32_t count);
+
+/**
+ * \brief Copy up to count elements out of the ring. Consumer side only.
+ * \return Number of elements popped
+ */
+extern uint32_t ring_pop_n(struct _ring* ring, void* elems, uint32_t count);
+
+/** \brief Push one element, return false if the ring is full */
+static inline bool ring_push(struct _ring* ring, const void* elem)
+{
+	return ring_push_n(ring, elem, 1) == 1;
+}
+
+/** \brief Pop one element, return false if the ring is empty */
+static inline bool ring_pop(struct _ring* ring, void* elem)
+{
+	return ring_pop_n(ring, elem, 1) == 1;
+}
+
 #endif /* _RING_H_ */